@@ -4,19 +4,127 @@
       "target_name": "libvesktop",
       "sources": [
         "src/libvesktop.cc",
-        "src/status_notifier_item.cc"
+        "src/status_notifier_item.cc",
+        "src/status_notifier_item_binding.cc",
+        "src/image_decoder.cc",
+        "src/image_encoder.cc",
+        "src/pixmap.cc",
+        "src/dbus_recorder.cc",
+        "src/keybind_channel.cc",
+        "src/keybind_channel_binding.cc",
+        "src/global_shortcuts.cc",
+        "src/global_shortcuts_binding.cc",
+        "src/notifications.cc",
+        "src/notifications_binding.cc",
+        "src/launcher_entry.cc",
+        "src/session_monitor.cc",
+        "src/system_monitor.cc",
+        "src/system_monitor_binding.cc",
+        "src/memory_monitor.cc",
+        "src/memory_monitor_binding.cc",
+        "src/icon_tint.cc",
+        "src/icon_tint_binding.cc",
+        "src/control_service.cc",
+        "src/control_service_binding.cc",
+        "src/dbus_signature.cc",
+        "src/dbus_value.cc",
+        "src/dbus_call_binding.cc",
+        "src/dbus_signal.cc",
+        "src/dbus_signal_binding.cc",
+        "src/glib_uv_bridge.cc",
+        "src/stall_watchdog.cc",
+        "src/native_log.cc",
+        "src/trace.cc"
       ],
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")"
       ],
       "cflags_cc": [
-        "<!(pkg-config --cflags glib-2.0 gio-2.0)",
+        "<!(pkg-config --cflags glib-2.0 gio-2.0 zlib)",
         "-O3"
       ],
+      "libraries": [
+        "<!@(pkg-config  --libs-only-l --libs-only-other glib-2.0 gio-2.0 zlib)"
+      ],
+      "cflags_cc!": ["-fno-exceptions"],
+    },
+    {
+      "target_name": "sni_replay",
+      "type": "executable",
+      "sources": [
+        "tools/sni_replay.cc",
+        "src/status_notifier_item.cc",
+        "src/dbus_recorder.cc",
+        "src/session_monitor.cc",
+        "src/native_log.cc",
+        "src/trace.cc"
+      ],
+      "cflags_cc": [
+        "<!(pkg-config --cflags glib-2.0 gio-2.0)",
+        "-O3",
+        "-pthread"
+      ],
+      "ldflags": ["-pthread"],
+      "libraries": [
+        "<!@(pkg-config  --libs-only-l --libs-only-other glib-2.0 gio-2.0)"
+      ],
+      "cflags_cc!": ["-fno-exceptions"],
+    },
+    {
+      "target_name": "sni_soak",
+      "type": "executable",
+      "sources": [
+        "tools/sni_soak.cc",
+        "src/status_notifier_item.cc",
+        "src/dbus_recorder.cc",
+        "src/session_monitor.cc",
+        "src/native_log.cc",
+        "src/trace.cc"
+      ],
+      "cflags_cc": [
+        "<!(pkg-config --cflags glib-2.0 gio-2.0)",
+        "-O2",
+        "-pthread"
+      ],
+      "ldflags": ["-pthread"],
       "libraries": [
         "<!@(pkg-config  --libs-only-l --libs-only-other glib-2.0 gio-2.0)"
       ],
       "cflags_cc!": ["-fno-exceptions"],
+    },
+    {
+      "target_name": "equibop_ctl",
+      "type": "executable",
+      "sources": [
+        "tools/equibop_ctl.cc",
+        "src/control_service.cc",
+        "src/native_log.cc",
+        "src/trace.cc"
+      ],
+      "cflags_cc": [
+        "<!(pkg-config --cflags glib-2.0 gio-2.0)",
+        "-O2",
+        "-pthread"
+      ],
+      "ldflags": ["-pthread"],
+      "libraries": [
+        "<!@(pkg-config  --libs-only-l --libs-only-other glib-2.0 gio-2.0)"
+      ],
+      "cflags_cc!": ["-fno-exceptions"],
+    },
+    {
+      "target_name": "fake_portal",
+      "type": "executable",
+      "sources": [
+        "test/fake_portal.cc"
+      ],
+      "cflags_cc": [
+        "<!(pkg-config --cflags glib-2.0 gio-2.0 gio-unix-2.0)"
+      ],
+      "libraries": [
+        "<!@(pkg-config  --libs-only-l --libs-only-other glib-2.0 gio-2.0 gio-unix-2.0)"
+      ],
+      "cflags_cc!": ["-fno-exceptions"],
     }
   ]
-}
\ No newline at end of file
+}
@@ -1,7 +1,23 @@
-export function getAccentColor(): number | null;
-export function requestBackground(autoStart: boolean, commandLine: string[]): boolean;
+/** Reads the portal's accent color off the main thread; null if the portal has none or doesn't answer. */
+export function getAccentColor(): Promise<number | null>;
+/** Resolves to whether the Background portal accepted the request. The call runs off the main thread. */
+export function requestBackground(autoStart: boolean, commandLine: string[]): Promise<boolean>;
 export function updateUnityLauncherCount(count: number): boolean;
 
+export interface LauncherEntryState {
+    /** 0 hides the badge. */
+    count?: number;
+    /** 0..1, null hides the progress bar. NaN and infinities throw a TypeError. */
+    progress?: number | null;
+    urgent?: boolean;
+}
+
+/**
+ * Updates the exported com.canonical.Unity.LauncherEntry. Omitted keys keep their value; changes made in the same tick
+ * are sent as one Update carrying only the keys that changed.
+ */
+export function updateLauncherEntry(state: LauncherEntryState): boolean;
+
 export interface MenuItem {
     id: number;
     label?: string;
@@ -10,11 +26,530 @@ export interface MenuItem {
     type?: "separator";
 }
 
-export function initStatusNotifierItem(): boolean;
-export function setStatusNotifierIcon(pixmapData: Buffer): boolean;
-export function setStatusNotifierTitle(title: string): boolean;
-export function setStatusNotifierMenu(items: MenuItem[]): boolean;
-export function updateStatusNotifierMenuItem(id: number, label: string): boolean;
-export function setStatusNotifierMenuClickCallback(callback: (id: number) => void): boolean;
-export function setStatusNotifierActivateCallback(callback: () => void): boolean;
-export function destroyStatusNotifierItem(): void;
+export interface MenuItemPatch {
+    id: number;
+    label?: string;
+    enabled?: boolean;
+    visible?: boolean;
+}
+
+/** Every field is optional; whatever is left out keeps its current value. */
+export interface DesktopState {
+    icon?: Buffer;
+    title?: string;
+    status?: "Active" | "Passive" | "NeedsAttention";
+    /** Shown under the title in the tooltip */
+    tooltip?: string;
+    /** Changes to existing menu entries; use setMenu to add or remove entries */
+    menuPatch?: MenuItemPatch[];
+    /** Applied to the process-wide launcher entry, as with {@link updateLauncherEntry} */
+    badge?: LauncherEntryState;
+}
+
+export interface StatusNotifierItemOptions {
+    id?: string;
+    title?: string;
+    category?: string;
+    /** Defaults to /StatusNotifierItem for the first item and a numbered path for every other one */
+    objectPath?: string;
+    /** Defaults to `${objectPath}/Menu` */
+    menuPath?: string;
+}
+
+/**
+ * Whether the StatusNotifierWatcher knows about an item. Registration starts with the first icon, times out and
+ * retries with backoff, and ends up "failed" if the watcher never answers (until a new watcher appears).
+ */
+export type StatusNotifierItemState = "unregistered" | "pending" | "registered" | "failed";
+
+export type ScrollOrientation = "horizontal" | "vertical";
+
+/**
+ * A tray icon exported over D-Bus. Any number of items can exist at once; they share one session bus connection.
+ * Keep a reference for as long as the item should stay visible.
+ */
+export class StatusNotifierItem {
+    constructor(options?: StatusNotifierItemOptions);
+    setIcon(pixmapData: Buffer): boolean;
+    setTitle(title: string): boolean;
+    setMenu(items: MenuItem[]): boolean;
+    updateMenuItem(id: number, label: string): boolean;
+    /**
+     * Applies several changes in one call. The whole state is validated first: a wrong type, unknown status or
+     * unknown menu id throws and nothing is applied. Hosts then get one batch of signals for everything that changed
+     * rather than a signal per setter, so they never render a half-updated tray. Returns false without applying
+     * anything when a badge is given but there is no launcher entry to show it on.
+     */
+    applyDesktopState(state: DesktopState): boolean;
+    onMenuClick(callback: (id: number) => void): void;
+    onActivate(callback: () => void): void;
+    /** Middle click on most hosts; x and y are screen coordinates, or 0 when the host doesn't know them */
+    onSecondaryActivate(callback: (x: number, y: number) => void): void;
+    onContextMenu(callback: (x: number, y: number) => void): void;
+    /**
+     * Scroll deltas are summed per orientation and delivered at most once per frame (16ms), however often the host
+     * calls Scroll. Units are host-defined: KDE sends 120 per wheel notch, others 1.
+     */
+    onScroll(callback: (delta: number, orientation: ScrollOrientation) => void): void;
+    onStateChange(callback: (state: StatusNotifierItemState) => void): void;
+    getState(): StatusNotifierItemState;
+    destroy(): void;
+}
+
+/**
+ * Decodes a PNG or ICO file off the main thread into a pixmap suitable for {@link StatusNotifierItem.setIcon},
+ * resampled to size x size (default 32). Rejects for any other format.
+ */
+export function decodeStatusNotifierIcon(path: string, size?: number): Promise<Buffer>;
+
+export interface ThumbnailBitmap {
+    /** Premultiplied BGRA rows with no padding, as returned by NativeImage.toBitmap() */
+    bitmap: Buffer;
+    width: number;
+    height: number;
+}
+
+/**
+ * Scales each bitmap to fit within maxWidth x maxHeight (never enlarging) and encodes it as a PNG data URL, each as
+ * its own job on libuv's thread pool. Fast rather than small: meant for previews like the screen-share picker. A 0x0
+ * bitmap gives "data:image/png;base64,", as NativeImage.toDataURL does. The bitmaps must not be modified until the
+ * promise settles.
+ */
+export function encodeThumbnails(bitmaps: ThumbnailBitmap[], maxWidth: number, maxHeight: number): Promise<string[]>;
+
+/**
+ * Starts recording every method call and property read that hosts make on StatusNotifierItem and menu objects into
+ * a binary trace at path, for replay with tools/sni_replay. Also started at load when LIBVESKTOP_DBUS_TRACE is set.
+ */
+export function startDBusRecording(path: string): boolean;
+export function stopDBusRecording(): void;
+
+export interface KeybindChannelOptions {
+    /** Path of the control FIFO, recreated on start and removed on stop. */
+    fifoPath?: string;
+    /**
+     * Name of an abstract SOCK_SEQPACKET socket taking one command per packet. Only the same user may connect.
+     * Abstract names are shared by every user in the network namespace, so make it unique, e.g. with the uid. If it
+     * is taken the FIFO is used alone and a warning is logged.
+     */
+    socketName?: string;
+}
+
+/**
+ * Reads keybind commands (VCD_TOGGLE_SELF_MUTE, VCD_TOGGLE_SELF_DEAF, toggle-mic, toggle-deafen) on a native thread
+ * and calls back with the IPC event to forward plus the receive time in CLOCK_MONOTONIC milliseconds, the clock
+ * process.hrtime() uses. Replaces any channel already running. Throws if the FIFO can't be created, or the socket
+ * when there is no FIFO.
+ */
+export function startKeybindChannel(
+    options: KeybindChannelOptions,
+    callback: (event: string, receivedAtMs: number) => void
+): boolean;
+export function stopKeybindChannel(): void;
+
+export type ControlAction = "toggle-mute" | "toggle-deafen" | "show";
+
+export interface ControlServiceOptions {
+    /** Well-known name to own, also the org.freedesktop.Application id. Default "org.equicord.equibop". */
+    busName?: string;
+}
+
+/**
+ * Exports org.equicord.Equibop.Control (ToggleMute, ToggleDeafen, Show) and org.freedesktop.Application at the path
+ * derived from busName. Calls are answered immediately and delivered to callback without blocking the bus, with the
+ * receive time in CLOCK_MONOTONIC milliseconds. Replaces any service already running; throws if it can't be exported.
+ */
+export function startControlService(
+    options: ControlServiceOptions,
+    callback: (action: ControlAction, receivedAtMs: number) => void
+): boolean;
+export function stopControlService(): void;
+
+/**
+ * Sends action to the instance owning busName through ActivateAction. Blocks for at most timeoutMs (default 1000);
+ * false if no instance answered.
+ */
+export function callControlAction(action: ControlAction, options?: ControlServiceOptions & { timeoutMs?: number }): boolean;
+
+export type DBusBus = "session" | "system";
+
+/** A 'v' argument with an explicit type, for when inference from the JS value would pick the wrong one. */
+export interface DBusVariant {
+    readonly __dbusVariant: unique symbol;
+}
+
+export interface DBusCallOptions {
+    /** Defaults to GDBus's 25 seconds */
+    timeoutMs?: number;
+    /** Block the calling thread instead of returning a promise */
+    sync?: boolean;
+}
+
+/**
+ * Calls any D-Bus method. signature lists the argument types without parentheses ("sa{sv}"); args has one value per
+ * type. Signatures are compiled once and cached. Numbers (or bigints for x/t) map to integers, Buffers to ay without
+ * copying (don't modify them until the call settles), arrays to arrays and structs, plain objects to dicts. A plain
+ * value in a 'v' slot is typed by inference (boolean b, string s, int32 i, number d, bigint x, Buffer ay, array av,
+ * object a{sv}); use dbusVariant to pick the type yourself.
+ *
+ * Resolves with the reply's out arguments as an array: variants unwrapped, x/t as bigints, ay as Buffers. D-Bus
+ * errors reject with the remote error name in dbusError. Bad arguments throw a TypeError before anything is sent.
+ */
+export function dbusCall(
+    bus: DBusBus,
+    destination: string,
+    objectPath: string,
+    interfaceName: string,
+    method: string,
+    signature: string,
+    args: unknown[],
+    options?: DBusCallOptions & { sync?: false }
+): Promise<unknown[]>;
+export function dbusCall(
+    bus: DBusBus,
+    destination: string,
+    objectPath: string,
+    interfaceName: string,
+    method: string,
+    signature: string,
+    args: unknown[],
+    options: DBusCallOptions & { sync: true }
+): unknown[];
+
+export function dbusVariant(signature: string, value: unknown): DBusVariant;
+
+/** Omitted fields match anything. */
+export interface DBusSignalMatch {
+    /** Default "session" */
+    bus?: DBusBus;
+    sender?: string;
+    path?: string;
+    iface?: string;
+    member?: string;
+    /** The first argument, which must be a string */
+    arg0?: string;
+    /** The first argument as an object path, or a namespace of them when it ends in '/'. Excludes arg0. */
+    arg0path?: string;
+}
+
+export interface DBusSignal {
+    /** The sender's unique name */
+    sender: string;
+    path: string;
+    iface: string;
+    member: string;
+    /** Decoded like a dbusCall reply */
+    args: unknown[];
+    receivedAtMs: number;
+}
+
+export interface DBusSignalOptions {
+    /**
+     * Signals arriving within this many milliseconds of the first are delivered together, so a burst wakes the JS
+     * thread once. 0 (the default) delivers as soon as the JS thread is free.
+     */
+    batchMs?: number;
+}
+
+/**
+ * Subscribes to the signals matching match. The match becomes the bus match rule, so the daemon never routes anything
+ * else to this process, and everything up to decoding runs off the JS thread. Returns an id for
+ * unsubscribeDBusSignal. Doesn't keep the process alive.
+ */
+export function subscribeDBusSignal(
+    match: DBusSignalMatch,
+    callback: (signals: DBusSignal[]) => void,
+    options?: DBusSignalOptions
+): number;
+/** No further callbacks once this returns. False for an unknown id. */
+export function unsubscribeDBusSignal(id: number): boolean;
+
+export interface LatencyStats {
+    count: number;
+    meanUs: number;
+    maxUs: number;
+    lastUs: number;
+}
+
+export interface LibVesktopStats {
+    keybinds: {
+        received: number;
+        rejected: number;
+        /** Receive to hand-off to the JS thread. */
+        nativeLatency: LatencyStats;
+        /** Receive to the JS callback running. */
+        deliveryLatency: LatencyStats;
+    };
+    globalShortcuts: {
+        events: number;
+        /** Portal signal received to the JS callback running. */
+        deliveryLatency: LatencyStats;
+    };
+    notifications: {
+        sent: number;
+        /** Notifications folded into a burst summary instead of being shown. */
+        coalesced: number;
+        imageCacheHits: number;
+        imageCacheMisses: number;
+        imageCacheBytes: number;
+    };
+    dbusSignals: {
+        signals: number;
+        /** Callbacks made; each carries every signal queued by the time it ran. */
+        batches: number;
+        /** Signal received to the JS callback running. */
+        deliveryLatency: LatencyStats;
+    };
+    nativeLog: {
+        /** Records accepted by the level filter since load, drained or not. */
+        written: number;
+    };
+    glibMainLoop: {
+        attached: boolean;
+        /** GLib dispatches run from the libuv loop since attachGLibMainLoop. */
+        dispatches: number;
+    };
+}
+
+export function getLibVesktopStats(): LibVesktopStats;
+
+/**
+ * Dispatches the default GMainContext from Node's libuv loop, so D-Bus method calls, watcher signals and callbacks
+ * work under plain Node (tests, benchmarks). Never needed in Electron, where it returns false and does nothing.
+ * Doesn't keep the process alive. Throws if another thread owns the context.
+ */
+export function attachGLibMainLoop(): boolean;
+export function detachGLibMainLoop(): void;
+
+export interface StallWatchdogOptions {
+    /** Time between heartbeats. Default 250 */
+    intervalMs?: number;
+    /** Heartbeats that wait longer than this count as stalls. Default 50 */
+    thresholdMs?: number;
+}
+
+export interface StallOffender {
+    /** The libvesktop span that was open while the context was stalled, or "(outside libvesktop)" */
+    operation: string;
+    count: number;
+    totalMs: number;
+    maxMs: number;
+}
+
+export interface StallReport {
+    running: boolean;
+    heartbeats: number;
+    stalls: number;
+    /** Heartbeat latency; the last bucket's upToMs is Infinity */
+    histogram: { upToMs: number; count: number }[];
+    /** The ten worst by total stall time */
+    offenders: StallOffender[];
+}
+
+/**
+ * Starts a background thread that posts a heartbeat onto the default GMainContext every interval and times how
+ * long it waits to run, charging each stall to whatever libvesktop operation held the context. Also started at load
+ * when LIBVESKTOP_STALL_WATCHDOG is set. Starting again resets the report.
+ */
+export function startStallWatchdog(options?: StallWatchdogOptions): void;
+export function stopStallWatchdog(): void;
+export function getStallReport(): StallReport;
+
+export type NativeLogLevel = "debug" | "info" | "warning" | "error";
+
+export interface NativeLogRecord {
+    /** CLOCK_MONOTONIC nanoseconds, comparable to process.hrtime.bigint() */
+    timestamp: bigint;
+    level: NativeLogLevel;
+    /** The native function that logged it, e.g. "StatusNotifierItem::emit_item_signal" */
+    subsystem: string;
+    message: string;
+    /** Set when the record came from a GError */
+    errorDomain?: string;
+    errorCode?: number;
+}
+
+export interface NativeLogBatch {
+    records: NativeLogRecord[];
+    /** Records overwritten in the ring before this drain got to them */
+    lost: number;
+}
+
+/**
+ * Native errors and warnings go into a fixed-size in-memory ring instead of blocking on stderr. Returns the records
+ * logged since the previous drain, oldest first, at most max (default: the whole ring).
+ */
+export function drainNativeLog(max?: number): NativeLogBatch;
+
+export interface NativeLogOptions {
+    /** Records below this level are discarded before they are formatted. Default "warning", or LIBVESKTOP_LOG_LEVEL. */
+    level?: NativeLogLevel;
+    /** Mirror records to stderr from a background thread. On by default unless LIBVESKTOP_LOG_STDERR=0. */
+    stderr?: boolean;
+    /** File the ring is written to if the process dies on a fatal signal; null turns it off. */
+    crashFile?: string | null;
+}
+
+/** Returns false if the crash file can't be opened. */
+export function setNativeLogOptions(options: NativeLogOptions): boolean;
+
+/**
+ * Records spans around D-Bus handlers, portal calls, pixmap work and JS callback dispatch. Turning it on discards the
+ * previous session. Nearly free while off. Also turned on at load when LIBVESKTOP_TRACE is set.
+ */
+export function setNativeTracing(enabled: boolean): void;
+
+export interface NativeTrace {
+    /**
+     * Chrome Trace Event JSON ({ traceEvents: [...] }). Timestamps are CLOCK_MONOTONIC microseconds and tids are
+     * kernel tids, like in a trace from Electron's contentTracing, so the events can be appended to one.
+     */
+    json: string;
+    /** Spans lost because a thread's buffer was full */
+    dropped: number;
+}
+
+export function exportNativeTrace(): NativeTrace;
+
+export interface SessionState {
+    /** False while locked, asleep or behind the screen saver; tray and badge signals are held until it is true again. */
+    active: boolean;
+    locked: boolean;
+    sleeping: boolean;
+    screenSaverActive: boolean;
+}
+
+export function getSessionState(): SessionState;
+
+export type NetworkConnectivity = "local" | "limited" | "portal" | "full";
+
+/** GIO's GNetworkMonitor and GPowerProfileMonitor, kept up to date natively. */
+export interface SystemState {
+    networkAvailable: boolean;
+    networkMetered: boolean;
+    connectivity: NetworkConnectivity;
+    /** Bumped on every network change, including a new default route that leaves availability as it was */
+    networkChanges: number;
+    powerSaverEnabled: boolean;
+    /** False before GLib 2.70 or when no power profile monitor is available; powerSaverEnabled is then always false */
+    powerProfileMonitored: boolean;
+}
+
+export function getSystemState(): SystemState;
+/**
+ * Calls callback with the new state whenever it changes. Changes that arrive before the callback runs are folded into
+ * one call. Replaces any previous callback; null removes it. Doesn't keep the process alive.
+ */
+export function onSystemStateChange(callback: ((state: SystemState) => void) | null): void;
+
+/** GMemoryMonitor's low-memory-warning levels */
+export type MemoryPressureLevel = "low" | "medium" | "critical";
+
+export interface MemoryPressureEvent {
+    level: MemoryPressureLevel;
+    /**
+     * The native caches already dropped for it: "status-notifier-item" from low, "notification-images" and "malloc"
+     * (returning freed memory to the system) from medium, "icon-tints" only when critical
+     */
+    trimmed: string[];
+    receivedAtMs: number;
+}
+
+/**
+ * Calls callback on every system low-memory warning, after libvesktop has trimmed its own caches for that level, so
+ * JS can drop its caches too. Replaces any previous callback; null removes it. Returns false when GLib (before 2.64)
+ * has no memory monitor and no warning will ever come. Doesn't keep the process alive.
+ */
+export function onMemoryPressure(callback: ((event: MemoryPressureEvent) => void) | null): boolean;
+/** Trims the native caches as a warning of level would, without calling the onMemoryPressure callback. */
+export function trimNativeCaches(level: MemoryPressureLevel): string[];
+
+export interface GlobalShortcut {
+    id: string;
+    description?: string;
+    /** e.g. "CTRL+SHIFT+M". Only a hint; the portal lets the user pick the trigger. */
+    preferredTrigger?: string;
+}
+
+export interface GlobalShortcutEvent {
+    id: string;
+    /** true for Activated (press), false for Deactivated (release) */
+    pressed: boolean;
+    /** Portal timestamp in milliseconds. */
+    timestamp: number;
+    /** CLOCK_MONOTONIC milliseconds when the signal arrived, comparable with process.hrtime(). */
+    receivedAtMs: number;
+}
+
+export type GlobalShortcutsState = "idle" | "creating-session" | "binding" | "bound" | "failed";
+
+/**
+ * Client for the org.freedesktop.portal.GlobalShortcuts portal, running on its own thread. Events that arrive while
+ * the JS thread is busy are delivered together in one onEvents call.
+ */
+export class GlobalShortcuts {
+    constructor(options?: { busAddress?: string });
+    /** Replaces the session and binds the given shortcuts; progress is reported through onStateChange. */
+    bind(shortcuts: GlobalShortcut[]): void;
+    onEvents(callback: (events: GlobalShortcutEvent[]) => void): void;
+    /** detail is the comma separated list of bound ids for "bound" and the error for "failed". */
+    onStateChange(callback: (state: GlobalShortcutsState, detail: string) => void): void;
+    destroy(): void;
+}
+
+export interface DesktopNotificationsOptions {
+    appName?: string;
+    appIcon?: string;
+    /** Notifications on a channel within this many ms of the last one shown are folded together. 0 disables. */
+    burstWindowMs?: number;
+    /** Summary of a folded burst; {count} is replaced with the number of notifications. */
+    burstSummary?: string;
+    imageCacheEntries?: number;
+    imageCacheBytes?: number;
+}
+
+export interface DesktopNotification {
+    summary: string;
+    body?: string;
+    /** Decoded images are cached under this key, e.g. the avatar hash. image is ignored without one. */
+    imageKey?: string;
+    /** PNG or ICO bytes, only decoded when imageKey isn't cached yet. */
+    image?: Buffer;
+    actions?: { id: string; label?: string }[];
+    urgency?: "low" | "normal" | "critical";
+    /** -1 for the server default, 0 to never expire. */
+    timeoutMs?: number;
+    category?: string;
+}
+
+export interface DesktopNotificationEvent {
+    channel: string;
+    /** The invoked action id, or "closed" when the user dismissed the notification. */
+    action: string;
+}
+
+/**
+ * org.freedesktop.Notifications client. Each channel keeps at most one notification on screen, later ones replace it
+ * and bursts are folded into a single summary.
+ */
+export class DesktopNotifications {
+    constructor(options?: DesktopNotificationsOptions);
+    notify(channel: string, notification: DesktopNotification): void;
+    close(channel: string): void;
+    onAction(callback: (events: DesktopNotificationEvent[]) => void): void;
+    destroy(): void;
+}
+
+/**
+ * Tray icon variants recolored to the accent color, cached per (variant, accent, scheme). Sources are pixmaps as
+ * returned by decodeStatusNotifierIcon.
+ */
+export class TrayIconTints {
+    constructor();
+    /** Replaces the source for a variant and drops its tinted copies. */
+    setSource(variant: string, pixmap: Buffer): void;
+    /** Tints every source not yet cached for this accent and scheme on a worker thread; resolves with how many were tinted. */
+    retint(accent: number, scheme: "dark" | "light"): Promise<number>;
+    /** The tinted pixmap, or null until retint has finished for this accent and scheme. */
+    get(variant: string, accent: number, scheme: "dark" | "light"): Buffer | null;
+}
@@ -0,0 +1,315 @@
+#include "control_service.h"
+#include "native_log.h"
+#include "stats.h"
+#include "trace.h"
+
+namespace
+{
+    constexpr const char *introspection_xml = R"XML(
+<node>
+  <interface name="org.equicord.Equibop.Control">
+    <method name="ToggleMute"/>
+    <method name="ToggleDeafen"/>
+    <method name="Show"/>
+  </interface>
+  <interface name="org.freedesktop.Application">
+    <method name="Activate">
+      <arg type="a{sv}" name="platform_data" direction="in"/>
+    </method>
+    <method name="Open">
+      <arg type="as" name="uris" direction="in"/>
+      <arg type="a{sv}" name="platform_data" direction="in"/>
+    </method>
+    <method name="ActivateAction">
+      <arg type="s" name="action_name" direction="in"/>
+      <arg type="av" name="parameter" direction="in"/>
+      <arg type="a{sv}" name="platform_data" direction="in"/>
+    </method>
+  </interface>
+</node>
+)XML";
+
+    struct ActionName
+    {
+        const char *name;
+        ControlAction action;
+    };
+
+    constexpr ActionName ACTION_NAMES[] = {
+        {"toggle-mute", ControlAction::ToggleMute},
+        {"toggle-deafen", ControlAction::ToggleDeafen},
+        {"show", ControlAction::Show},
+    };
+}
+
+const char *control_action_name(ControlAction action)
+{
+    for (const auto &entry : ACTION_NAMES)
+    {
+        if (entry.action == action)
+            return entry.name;
+    }
+    return "";
+}
+
+bool parse_control_action(const char *name, ControlAction &out)
+{
+    for (const auto &entry : ACTION_NAMES)
+    {
+        if (g_strcmp0(entry.name, name) == 0)
+        {
+            out = entry.action;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool call_control_action(const std::string &bus_name, ControlAction action, int timeout_ms, std::string &error)
+{
+    TRACE_SPAN("call_control_action", control_action_name(action));
+    GError *gerror = nullptr;
+
+    GObjectPtr<GDBusConnection> bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &gerror));
+    if (!bus)
+    {
+        GErrorPtr error_ptr(gerror);
+        error = std::string("Failed to connect to session bus: ") + gerror->message;
+        return false;
+    }
+
+    // NO_AUTO_START: if nothing owns the name there is no instance to
+    // toggle, and D-Bus activation would only start one
+    GVariantPtr reply(g_dbus_connection_call_sync(
+        bus.get(),
+        bus_name.c_str(),
+        ControlService::object_path_for(bus_name).c_str(),
+        "org.freedesktop.Application",
+        "ActivateAction",
+        g_variant_new("(s@av@a{sv})", control_action_name(action),
+                      g_variant_new_array(G_VARIANT_TYPE_VARIANT, nullptr, 0),
+                      g_variant_new_array(G_VARIANT_TYPE("{sv}"), nullptr, 0)),
+        nullptr,
+        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+        timeout_ms,
+        nullptr,
+        &gerror));
+
+    if (!reply)
+    {
+        GErrorPtr error_ptr(gerror);
+        error = gerror->message;
+        return false;
+    }
+
+    return true;
+}
+
+std::string ControlService::object_path_for(const std::string &bus_name)
+{
+    // org.equicord.equibop -> /org/equicord/equibop, with '-' (valid in bus
+    // names, not in paths) mapped to '_'
+    std::string path = "/";
+    for (char c : bus_name)
+    {
+        if (c == '.')
+            path += '/';
+        else if (c == '-')
+            path += '_';
+        else
+            path += c;
+    }
+    return path;
+}
+
+GDBusNodeInfo *ControlService::node_info()
+{
+    static GDBusNodeInfo *info = nullptr;
+    if (!info)
+    {
+        GError *error = nullptr;
+        info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+        if (!info)
+        {
+            GErrorPtr error_ptr(error);
+            log_message(LogLevel::Error, "ControlService::node_info", error, "Invalid introspection XML");
+            return nullptr;
+        }
+    }
+    return info;
+}
+
+ControlService::ControlService(std::string name)
+    : bus_name(std::move(name)), object_path(object_path_for(bus_name))
+{
+    GError *error = nullptr;
+    bus.reset(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
+
+    if (!bus)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "ControlService", error, "Failed to connect to session bus");
+    }
+}
+
+ControlService::~ControlService()
+{
+    if (owner_id != 0)
+        g_bus_unown_name(owner_id);
+
+    if (bus)
+    {
+        if (control_registration_id != 0)
+            g_dbus_connection_unregister_object(bus.get(), control_registration_id);
+        if (application_registration_id != 0)
+            g_dbus_connection_unregister_object(bus.get(), application_registration_id);
+    }
+}
+
+bool ControlService::start(Callback cb, std::string &error)
+{
+    if (!bus)
+    {
+        error = "No session bus";
+        return false;
+    }
+
+    if (!g_dbus_is_name(bus_name.c_str()) || g_dbus_is_unique_name(bus_name.c_str()))
+    {
+        error = "Invalid bus name " + bus_name;
+        return false;
+    }
+
+    GDBusNodeInfo *info = node_info();
+    if (!info)
+    {
+        error = "Invalid introspection XML";
+        return false;
+    }
+
+    callback = std::move(cb);
+
+    static GDBusInterfaceVTable vtable = {
+        handle_method_call,
+        nullptr,
+        nullptr,
+        {}
+    };
+
+    guint *registration_ids[] = {&control_registration_id, &application_registration_id};
+    for (size_t i = 0; i < G_N_ELEMENTS(registration_ids); i++)
+    {
+        GError *gerror = nullptr;
+        *registration_ids[i] = g_dbus_connection_register_object(
+            bus.get(),
+            object_path.c_str(),
+            info->interfaces[i],
+            &vtable,
+            this,
+            nullptr,
+            &gerror);
+
+        if (*registration_ids[i] == 0)
+        {
+            GErrorPtr error_ptr(gerror);
+            error = std::string("Failed to export ") + info->interfaces[i]->name + " at " + object_path + ": " +
+                    gerror->message;
+            return false;
+        }
+    }
+
+    // a second instance must not steal the name from the first; it forwards
+    // its command to the owner instead
+    owner_id = g_bus_own_name_on_connection(
+        bus.get(),
+        bus_name.c_str(),
+        G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
+        nullptr,
+        on_name_lost,
+        this,
+        nullptr);
+
+    return true;
+}
+
+void ControlService::on_name_lost(GDBusConnection *connection, const gchar *name, gpointer user_data)
+{
+    (void)user_data;
+
+    // the objects stay exported on our unique name, so this only matters to
+    // callers that address the well-known name
+    if (connection)
+        log_message(LogLevel::Warning, "ControlService::on_name_lost", nullptr, "%s is owned by another process", name);
+}
+
+void ControlService::dispatch(ControlAction action, GDBusMethodInvocation *invocation)
+{
+    // reply before JS runs: the caller is usually a key binding waiting to
+    // exit, and nothing JS does can fail the call anyway
+    const uint64_t received_ns = monotonic_ns();
+    g_dbus_method_invocation_return_value(invocation, nullptr);
+
+    if (callback)
+        callback(action, received_ns);
+}
+
+void ControlService::handle_method_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                        const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                                        GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    TRACE_SPAN("ControlService::handle_method_call", method_name);
+    (void)connection;
+    (void)sender;
+    (void)object_path;
+
+    auto *self = static_cast<ControlService *>(user_data);
+    ControlAction action;
+
+    if (g_strcmp0(interface_name, CONTROL_INTERFACE) == 0)
+    {
+        if (g_strcmp0(method_name, "ToggleMute") == 0)
+        {
+            self->dispatch(ControlAction::ToggleMute, invocation);
+            return;
+        }
+        if (g_strcmp0(method_name, "ToggleDeafen") == 0)
+        {
+            self->dispatch(ControlAction::ToggleDeafen, invocation);
+            return;
+        }
+        if (g_strcmp0(method_name, "Show") == 0)
+        {
+            self->dispatch(ControlAction::Show, invocation);
+            return;
+        }
+    }
+    else if (g_strcmp0(interface_name, APPLICATION_INTERFACE) == 0)
+    {
+        // Open carries the URIs of a file association we don't have, so it
+        // is treated like a plain launch
+        if (g_strcmp0(method_name, "Activate") == 0 || g_strcmp0(method_name, "Open") == 0)
+        {
+            self->dispatch(ControlAction::Show, invocation);
+            return;
+        }
+
+        if (g_strcmp0(method_name, "ActivateAction") == 0)
+        {
+            const gchar *action_name = nullptr;
+            g_variant_get(parameters, "(&s@av@a{sv})", &action_name, nullptr, nullptr);
+
+            if (!parse_control_action(action_name, action))
+            {
+                g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                                      "Unknown action %s", action_name);
+                return;
+            }
+
+            self->dispatch(action, invocation);
+            return;
+        }
+    }
+
+    g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                          "Unknown method %s", method_name);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <gio/gio.h>
+#include <string>
+#include "glib_ptr.h"
+
+enum class ControlAction
+{
+    ToggleMute,
+    ToggleDeafen,
+    Show,
+};
+
+// GAction-style names ("toggle-mute", "toggle-deafen", "show"), used both for
+// org.freedesktop.Application.ActivateAction and the JS callback.
+const char *control_action_name(ControlAction action);
+bool parse_control_action(const char *name, ControlAction &out);
+
+// Client side: asks whoever owns bus_name to run action through
+// org.freedesktop.Application.ActivateAction. Used by `--toggle-mic` and
+// tools/equibop_ctl; fails fast when no instance is running.
+bool call_control_action(const std::string &bus_name, ControlAction action, int timeout_ms, std::string &error);
+
+// Owns the application's well-known name on the session bus and exports
+// org.equicord.Equibop.Control plus org.freedesktop.Application, so
+// `equibop --toggle-mic`, a compositor binding or a launcher can reach the
+// running instance with a single method call instead of starting a second
+// Electron. Runs on the default main context like StatusNotifierItem.
+class ControlService
+{
+public:
+    using Callback = std::function<void(ControlAction, uint64_t received_ns)>;
+
+    // bus_name is the desktop file id; the object path is derived from it
+    // the way org.freedesktop.Application expects
+    explicit ControlService(std::string bus_name);
+    ~ControlService();
+
+    ControlService(const ControlService &) = delete;
+    ControlService &operator=(const ControlService &) = delete;
+
+    bool start(Callback callback, std::string &error);
+
+    const std::string &get_object_path() const { return object_path; }
+
+    static std::string object_path_for(const std::string &bus_name);
+
+private:
+    static constexpr const char *CONTROL_INTERFACE = "org.equicord.Equibop.Control";
+    static constexpr const char *APPLICATION_INTERFACE = "org.freedesktop.Application";
+
+    std::string bus_name;
+    std::string object_path;
+    GObjectPtr<GDBusConnection> bus;
+    guint control_registration_id = 0;
+    guint application_registration_id = 0;
+    guint owner_id = 0;
+    Callback callback;
+
+    void dispatch(ControlAction action, GDBusMethodInvocation *invocation);
+
+    static GDBusNodeInfo *node_info();
+    static void on_name_lost(GDBusConnection *connection, const gchar *name, gpointer user_data);
+    static void handle_method_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                   const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                                   GDBusMethodInvocation *invocation, gpointer user_data);
+};
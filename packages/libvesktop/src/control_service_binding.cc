@@ -0,0 +1,127 @@
+#include "control_service_binding.h"
+#include "control_service.h"
+#include "trace.h"
+#include <memory>
+#include <string>
+
+namespace
+{
+    constexpr const char *DEFAULT_BUS_NAME = "org.equicord.equibop";
+
+    std::unique_ptr<ControlService> service;
+    Napi::ThreadSafeFunction action_callback;
+
+    void stop_service()
+    {
+        // unexport before releasing the TSFN the handlers call into
+        service.reset();
+
+        if (action_callback)
+        {
+            action_callback.Release();
+            action_callback = Napi::ThreadSafeFunction();
+        }
+    }
+
+    std::string bus_name_option(const Napi::Object &opts)
+    {
+        Napi::Value name = opts.Get("busName");
+        return name.IsString() ? name.As<Napi::String>().Utf8Value() : DEFAULT_BUS_NAME;
+    }
+
+    Napi::Value StartControlService(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction())
+        {
+            Napi::TypeError::New(env, "Expected (object, function)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        const std::string bus_name = bus_name_option(info[0].As<Napi::Object>());
+
+        stop_service();
+
+        action_callback = Napi::ThreadSafeFunction::New(
+            env,
+            info[1].As<Napi::Function>(),
+            "ControlServiceCallback",
+            0,
+            1
+        );
+        action_callback.Unref(env);
+
+        auto tsfn = action_callback;
+        service = std::make_unique<ControlService>(bus_name);
+
+        std::string error;
+        bool started = service->start([tsfn](ControlAction action, uint64_t received_ns) mutable {
+            // the handler already replied, so the caller never waits on JS
+            tsfn.NonBlockingCall([action, received_ns](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("ControlService::action dispatch");
+                jsCallback.Call({
+                    Napi::String::New(env, control_action_name(action)),
+                    Napi::Number::New(env, static_cast<double>(received_ns) / 1e6),
+                });
+            });
+        }, error);
+
+        if (!started)
+        {
+            stop_service();
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value StopControlService(const Napi::CallbackInfo &info)
+    {
+        stop_service();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value CallControlAction(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsString() || (info.Length() > 1 && !info[1].IsObject()))
+        {
+            Napi::TypeError::New(env, "Expected (string, object?)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        ControlAction action;
+        if (!parse_control_action(info[0].As<Napi::String>().Utf8Value().c_str(), action))
+        {
+            Napi::TypeError::New(env, "Unknown action").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::string bus_name = DEFAULT_BUS_NAME;
+        int timeout_ms = 1000;
+        if (info.Length() > 1)
+        {
+            Napi::Object opts = info[1].As<Napi::Object>();
+            bus_name = bus_name_option(opts);
+            if (opts.Get("timeoutMs").IsNumber())
+                timeout_ms = opts.Get("timeoutMs").As<Napi::Number>().Int32Value();
+        }
+
+        // blocking on purpose: this runs in a short-lived second process
+        // before Electron has created anything
+        std::string error;
+        return Napi::Boolean::New(env, call_control_action(bus_name, action, timeout_ms, error));
+    }
+}
+
+void InitControlServiceBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("startControlService", Napi::Function::New(env, StartControlService));
+    exports.Set("stopControlService", Napi::Function::New(env, StopControlService));
+    exports.Set("callControlAction", Napi::Function::New(env, CallControlAction));
+
+    napi_add_env_cleanup_hook(env, [](void *) { stop_service(); }, nullptr);
+}
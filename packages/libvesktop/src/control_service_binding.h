@@ -0,0 +1,7 @@
+#pragma once
+
+#include <napi.h>
+
+// startControlService / stopControlService / callControlAction: the D-Bus
+// entry point that lets --toggle-mic and friends skip a second Electron.
+void InitControlServiceBinding(Napi::Env env, Napi::Object exports);
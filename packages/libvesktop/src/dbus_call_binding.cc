@@ -0,0 +1,213 @@
+#include "dbus_call_binding.h"
+#include "dbus_value.h"
+#include "glib_ptr.h"
+#include "trace.h"
+#include <gio/gio.h>
+#include <string>
+
+namespace
+{
+    struct CallTarget
+    {
+        GBusType bus_type;
+        std::string destination;
+        std::string object_path;
+        std::string interface_name;
+        std::string method;
+        int timeout_ms = -1;
+    };
+
+    struct CallResult
+    {
+        GVariantPtr reply;
+        std::string error;
+        // the remote error name, e.g. org.freedesktop.DBus.Error.ServiceUnknown
+        std::string error_name;
+    };
+
+    // Blocks for up to timeout_ms; runs on the thread pool unless the caller
+    // asked for sync.
+    CallResult call(const CallTarget &target, GVariant *parameters)
+    {
+        TRACE_SPAN("dbusCall", target.method.c_str());
+        CallResult result;
+        GError *error = nullptr;
+
+        GObjectPtr<GDBusConnection> bus(g_bus_get_sync(target.bus_type, nullptr, &error));
+        if (bus)
+        {
+            result.reply.reset(g_dbus_connection_call_sync(
+                bus.get(),
+                target.destination.c_str(),
+                target.object_path.c_str(),
+                target.interface_name.c_str(),
+                target.method.c_str(),
+                parameters,
+                nullptr,
+                G_DBUS_CALL_FLAGS_NONE,
+                target.timeout_ms,
+                nullptr,
+                &error));
+        }
+
+        if (error)
+        {
+            GErrorPtr error_ptr(error);
+            if (gchar *name = g_dbus_error_get_remote_error(error))
+            {
+                result.error_name = name;
+                g_free(name);
+            }
+            g_dbus_error_strip_remote_error(error);
+            result.error = error->message;
+        }
+
+        return result;
+    }
+
+    Napi::Error call_error(Napi::Env env, const CallResult &result)
+    {
+        Napi::Error error = Napi::Error::New(env, result.error);
+        if (!result.error_name.empty())
+            error.Value().Set("dbusError", Napi::String::New(env, result.error_name));
+        return error;
+    }
+
+    class DBusCallWorker : public Napi::AsyncWorker
+    {
+    public:
+        DBusCallWorker(Napi::Env env, CallTarget target, GVariant *parameters)
+            : Napi::AsyncWorker(env, "DBusCallWorker"),
+              deferred(Napi::Promise::Deferred::New(env)),
+              target(std::move(target)),
+              parameters(parameters ? g_variant_ref_sink(parameters) : nullptr)
+        {
+        }
+
+        Napi::Promise GetPromise() const { return deferred.Promise(); }
+
+    protected:
+        void Execute() override
+        {
+            result = call(target, parameters.get());
+            if (!result.reply)
+                SetError(result.error);
+        }
+
+        void OnOK() override
+        {
+            deferred.Resolve(gvariant_to_js(Env(), result.reply.get()));
+        }
+
+        void OnError(const Napi::Error &) override
+        {
+            deferred.Reject(call_error(Env(), result).Value());
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        CallTarget target;
+        GVariantPtr parameters;
+        CallResult result;
+    };
+
+    Napi::Value DBusCall(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 7 || !info[1].IsString() || !info[2].IsString() || !info[3].IsString() ||
+            !info[4].IsString() || !info[5].IsString() || !info[6].IsArray() ||
+            (info.Length() > 7 && !info[7].IsObject() && !info[7].IsUndefined()))
+        {
+            Napi::TypeError::New(env, "Expected (string, string, string, string, string, string, array, object?)")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        CallTarget target;
+        if (!parse_bus_type(info[0], target.bus_type))
+        {
+            Napi::TypeError::New(env, "bus must be \"session\" or \"system\"").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        target.destination = info[1].As<Napi::String>().Utf8Value();
+        target.object_path = info[2].As<Napi::String>().Utf8Value();
+        target.interface_name = info[3].As<Napi::String>().Utf8Value();
+        target.method = info[4].As<Napi::String>().Utf8Value();
+
+        if (!g_dbus_is_name(target.destination.c_str()) || !g_variant_is_object_path(target.object_path.c_str()) ||
+            !g_dbus_is_interface_name(target.interface_name.c_str()) || !g_dbus_is_member_name(target.method.c_str()))
+        {
+            Napi::TypeError::New(env, "Invalid bus name, object path, interface or method").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        bool sync = false;
+        if (info.Length() > 7 && info[7].IsObject())
+        {
+            Napi::Object opts = info[7].As<Napi::Object>();
+            if (opts.Get("timeoutMs").IsNumber())
+                target.timeout_ms = opts.Get("timeoutMs").As<Napi::Number>().Int32Value();
+            if (opts.Get("sync").IsBoolean())
+                sync = opts.Get("sync").As<Napi::Boolean>().Value();
+        }
+
+        // the arguments as one tuple, which is what a method call body is
+        std::string error;
+        const SignaturePlan *plan = compile_signature("(" + info[5].As<Napi::String>().Utf8Value() + ")", error);
+        GVariant *parameters = plan ? js_to_gvariant(*plan, info[6], error) : nullptr;
+        if (!parameters)
+        {
+            Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        if (sync)
+        {
+            GVariantPtr owned(g_variant_ref_sink(parameters));
+            CallResult result = call(target, owned.get());
+            if (!result.reply)
+            {
+                call_error(env, result).ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            return gvariant_to_js(env, result.reply.get());
+        }
+
+        auto *worker = new DBusCallWorker(env, std::move(target), parameters);
+        Napi::Promise promise = worker->GetPromise();
+        worker->Queue();
+
+        return promise;
+    }
+
+    Napi::Value DBusVariant(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsString())
+        {
+            Napi::TypeError::New(env, "Expected (string, any)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        std::string error;
+        const SignaturePlan *plan = compile_signature(info[0].As<Napi::String>().Utf8Value(), error);
+        // held for an unknown time, so byte arrays are copied
+        GVariant *value = plan ? js_to_gvariant(*plan, info[1], error) : nullptr;
+        if (!value)
+        {
+            Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        return make_dbus_variant(env, value);
+    }
+}
+
+void InitDBusCallBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("dbusCall", Napi::Function::New(env, DBusCall));
+    exports.Set("dbusVariant", Napi::Function::New(env, DBusVariant));
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <napi.h>
+
+// dbusCall / dbusVariant: any D-Bus method from JS, marshalled through the
+// cached signature plans in dbus_value.h instead of a hand-written wrapper
+// per portal method.
+void InitDBusCallBinding(Napi::Env env, Napi::Object exports);
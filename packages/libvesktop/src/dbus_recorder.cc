@@ -0,0 +1,320 @@
+#include "dbus_recorder.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "glib_ptr.h"
+#include "native_log.h"
+
+namespace
+{
+    constexpr char TRACE_MAGIC[8] = {'V', 'S', 'K', 'T', 'R', 'A', 'C', 'E'};
+    constexpr uint32_t TRACE_VERSION = 1;
+    constexpr size_t TRACE_HEADER_SIZE = 16;
+    constexpr size_t RECORD_HEADER_SIZE = 18;
+
+    void put_u32(uint8_t *dst, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            dst[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+
+    void put_u64(uint8_t *dst, uint64_t value)
+    {
+        for (int i = 0; i < 8; i++)
+            dst[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+
+    uint32_t get_u32(const uint8_t *src)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= static_cast<uint32_t>(src[i]) << (i * 8);
+        return value;
+    }
+
+    uint64_t get_u64(const uint8_t *src)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++)
+            value |= static_cast<uint64_t>(src[i]) << (i * 8);
+        return value;
+    }
+
+    // The filter runs on the GDBus worker thread and may still be running
+    // after g_dbus_connection_remove_filter returns, so all state lives in a
+    // never-destroyed singleton guarded by a mutex rather than in user_data.
+    struct Recorder
+    {
+        std::mutex mutex;
+        std::map<std::string, TraceTarget> paths;
+        std::map<std::string, uint8_t> senders;
+        GObjectPtr<GDBusConnection> bus;
+        guint filter_id = 0;
+        gint64 start_time = 0;
+        TraceWriter writer;
+        bool recording = false;
+    };
+
+    Recorder &recorder()
+    {
+        static Recorder *instance = new Recorder();
+        return *instance;
+    }
+
+    GDBusMessage *record_filter(GDBusConnection *connection, GDBusMessage *message, gboolean incoming, gpointer user_data)
+    {
+        (void)connection;
+        (void)user_data;
+
+        if (!incoming || g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL)
+            return message;
+
+        const gchar *path = g_dbus_message_get_path(message);
+        if (!path)
+            return message;
+
+        auto &r = recorder();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.recording)
+            return message;
+
+        auto target = r.paths.find(path);
+        if (target == r.paths.end())
+            return message;
+
+        const gchar *interface_name = g_dbus_message_get_interface(message);
+        const gchar *member = g_dbus_message_get_member(message);
+        const gchar *sender = g_dbus_message_get_sender(message);
+
+        TraceRecord record;
+        record.timestamp_us = static_cast<uint64_t>(g_get_monotonic_time() - r.start_time);
+        record.target = target->second;
+        record.interface_name = interface_name ? interface_name : "";
+        record.member = member ? member : "";
+
+        auto known = r.senders.find(sender ? sender : "");
+        if (known == r.senders.end())
+        {
+            uint8_t index = static_cast<uint8_t>(std::min<size_t>(r.senders.size(), 255));
+            known = r.senders.emplace(sender ? sender : "", index).first;
+        }
+        record.sender = known->second;
+
+        GVariant *body = g_dbus_message_get_body(message);
+        if (body)
+        {
+            record.signature = g_variant_get_type_string(body);
+            const auto *data = static_cast<const uint8_t *>(g_variant_get_data(body));
+            record.body.assign(data, data + g_variant_get_size(body));
+        }
+
+        if (!r.writer.write(record))
+        {
+            log_message(LogLevel::Error, "record_filter", nullptr, "Failed to write trace record, stopping");
+            r.recording = false;
+            r.writer.close();
+        }
+
+        return message;
+    }
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const std::string &path, std::string &error)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        error = "Failed to open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE] = {};
+    std::memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    put_u32(header + 8, TRACE_VERSION);
+
+    if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header))
+    {
+        error = "Failed to write trace header to " + path;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool TraceWriter::write(const TraceRecord &record)
+{
+    if (!file)
+        return false;
+
+    if (record.interface_name.size() > 255 || record.member.size() > 255 || record.signature.size() > 255 ||
+        record.body.size() > UINT32_MAX)
+        return false;
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    put_u64(header, record.timestamp_us);
+    header[8] = static_cast<uint8_t>(record.target);
+    header[9] = record.sender;
+    header[10] = static_cast<uint8_t>(record.interface_name.size());
+    header[11] = static_cast<uint8_t>(record.member.size());
+    header[12] = static_cast<uint8_t>(record.signature.size());
+    header[13] = 0;
+    put_u32(header + 14, static_cast<uint32_t>(record.body.size()));
+
+    bool ok = std::fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    ok = ok && std::fwrite(record.interface_name.data(), 1, record.interface_name.size(), file) == record.interface_name.size();
+    ok = ok && std::fwrite(record.member.data(), 1, record.member.size(), file) == record.member.size();
+    ok = ok && std::fwrite(record.signature.data(), 1, record.signature.size(), file) == record.signature.size();
+    ok = ok && std::fwrite(record.body.data(), 1, record.body.size(), file) == record.body.size();
+    return ok;
+}
+
+void TraceWriter::close()
+{
+    if (file)
+    {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+bool read_dbus_trace(const std::string &path, std::vector<TraceRecord> &records, std::string &error)
+{
+    gchar *contents = nullptr;
+    gsize length = 0;
+    GError *gerror = nullptr;
+
+    if (!g_file_get_contents(path.c_str(), &contents, &length, &gerror))
+    {
+        GErrorPtr error_ptr(gerror);
+        error = error_ptr ? error_ptr->message : "Failed to read " + path;
+        return false;
+    }
+
+    std::unique_ptr<gchar, decltype(&g_free)> owned(contents, g_free);
+    const auto *data = reinterpret_cast<const uint8_t *>(contents);
+
+    if (length < TRACE_HEADER_SIZE || std::memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0)
+    {
+        error = path + " is not a D-Bus trace";
+        return false;
+    }
+
+    if (get_u32(data + 8) != TRACE_VERSION)
+    {
+        error = "Unsupported trace version " + std::to_string(get_u32(data + 8));
+        return false;
+    }
+
+    size_t offset = TRACE_HEADER_SIZE;
+    while (offset < length)
+    {
+        if (length - offset < RECORD_HEADER_SIZE)
+        {
+            error = "Truncated record header at offset " + std::to_string(offset);
+            return false;
+        }
+
+        const uint8_t *header = data + offset;
+        size_t interface_len = header[10];
+        size_t member_len = header[11];
+        size_t signature_len = header[12];
+        size_t body_len = get_u32(header + 14);
+        size_t payload = interface_len + member_len + signature_len + body_len;
+        offset += RECORD_HEADER_SIZE;
+
+        if (length - offset < payload)
+        {
+            error = "Truncated record at offset " + std::to_string(offset - RECORD_HEADER_SIZE);
+            return false;
+        }
+
+        TraceRecord record;
+        record.timestamp_us = get_u64(header);
+        record.target = static_cast<TraceTarget>(header[8]);
+        record.sender = header[9];
+
+        const char *p = reinterpret_cast<const char *>(data + offset);
+        record.interface_name.assign(p, interface_len);
+        p += interface_len;
+        record.member.assign(p, member_len);
+        p += member_len;
+        record.signature.assign(p, signature_len);
+        p += signature_len;
+        record.body.assign(reinterpret_cast<const uint8_t *>(p), reinterpret_cast<const uint8_t *>(p) + body_len);
+        offset += payload;
+
+        records.push_back(std::move(record));
+    }
+
+    return true;
+}
+
+void dbus_recorder_register_path(const std::string &path, TraceTarget target)
+{
+    auto &r = recorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.paths[path] = target;
+}
+
+void dbus_recorder_unregister_path(const std::string &path)
+{
+    auto &r = recorder();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.paths.erase(path);
+}
+
+bool start_dbus_recording(const std::string &path, std::string &error)
+{
+    stop_dbus_recording();
+
+    GError *gerror = nullptr;
+    GObjectPtr<GDBusConnection> bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &gerror));
+    if (!bus)
+    {
+        GErrorPtr error_ptr(gerror);
+        error = std::string("Failed to connect to session bus: ") + (error_ptr ? error_ptr->message : "unknown error");
+        return false;
+    }
+
+    auto &r = recorder();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.writer.open(path, error))
+            return false;
+
+        r.senders.clear();
+        r.start_time = g_get_monotonic_time();
+        r.recording = true;
+    }
+
+    r.filter_id = g_dbus_connection_add_filter(bus.get(), record_filter, nullptr, nullptr);
+    r.bus = std::move(bus);
+    return true;
+}
+
+void stop_dbus_recording()
+{
+    auto &r = recorder();
+
+    if (r.bus && r.filter_id != 0)
+    {
+        g_dbus_connection_remove_filter(r.bus.get(), r.filter_id);
+        r.filter_id = 0;
+    }
+    r.bus.reset();
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.recording = false;
+    r.writer.close();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <gio/gio.h>
+#include <string>
+#include <vector>
+
+// Records incoming method calls (including Properties Get/GetAll) against the
+// StatusNotifierItem and dbusmenu objects so host behaviour seen in the wild
+// can be replayed against a fresh item with tools/sni_replay.
+//
+// Trace format, all integers little endian:
+//   header: "VSKTRACE" u32 version u32 reserved
+//   record: u64 timestamp_us (since recording started)
+//           u8 target (TraceTarget) u8 sender (index of the caller, in order of first appearance)
+//           u8 interface_len u8 member_len u8 signature_len u8 reserved u32 body_len
+//           interface member signature body (GVariant serialized data)
+
+enum class TraceTarget : uint8_t
+{
+    Item = 0,
+    Menu = 1,
+};
+
+struct TraceRecord
+{
+    uint64_t timestamp_us = 0;
+    TraceTarget target = TraceTarget::Item;
+    uint8_t sender = 0;
+    std::string interface_name;
+    std::string member;
+    std::string signature;
+    std::vector<uint8_t> body;
+};
+
+class TraceWriter
+{
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool open(const std::string &path, std::string &error);
+    bool write(const TraceRecord &record);
+    void close();
+
+private:
+    FILE *file = nullptr;
+};
+
+bool read_dbus_trace(const std::string &path, std::vector<TraceRecord> &records, std::string &error);
+
+// Object paths that belong to SNI items, maintained by StatusNotifierItem.
+void dbus_recorder_register_path(const std::string &path, TraceTarget target);
+void dbus_recorder_unregister_path(const std::string &path);
+
+bool start_dbus_recording(const std::string &path, std::string &error);
+void stop_dbus_recording();
@@ -0,0 +1,247 @@
+#include "dbus_signal.h"
+#include <future>
+#include <thread>
+#include <unordered_map>
+
+DBusSignalStats &dbus_signal_stats()
+{
+    static DBusSignalStats stats;
+    return stats;
+}
+
+namespace
+{
+    struct Subscription
+    {
+        DBusSignalCallback callback;
+        uint32_t batch_ms;
+        GDBusConnection *bus;
+        guint subscription_id = 0;
+        // the open batch window, if any
+        GSource *flush_source = nullptr;
+        std::vector<DBusSignal> pending;
+    };
+
+    const char *or_null(const std::string &value)
+    {
+        return value.empty() ? nullptr : value.c_str();
+    }
+
+    // Owns the context every subscription dispatches on. Created on first
+    // use and never destroyed, so GDBus can always reach it.
+    class SignalThread
+    {
+    public:
+        static SignalThread &instance()
+        {
+            static SignalThread *thread = new SignalThread();
+            return *thread;
+        }
+
+        // null until the first subscription
+        static std::atomic<SignalThread *> started;
+
+        // Runs task on the signal thread and waits for it.
+        void run(const std::function<void()> &task)
+        {
+            if (std::this_thread::get_id() == thread.get_id())
+            {
+                task();
+                return;
+            }
+
+            struct Invocation
+            {
+                const std::function<void()> &task;
+                std::promise<void> done;
+            } invocation{task, {}};
+
+            std::future<void> done = invocation.done.get_future();
+            g_main_context_invoke(
+                context,
+                [](gpointer data) -> gboolean
+                {
+                    auto *invocation = static_cast<Invocation *>(data);
+                    invocation->task();
+                    invocation->done.set_value();
+                    return G_SOURCE_REMOVE;
+                },
+                &invocation);
+            done.wait();
+        }
+
+        // the rest is only touched on the signal thread
+
+        GDBusConnection *bus(GBusType bus_type, std::string &error)
+        {
+            GObjectPtr<GDBusConnection> &bus = bus_type == G_BUS_TYPE_SYSTEM ? system_bus : session_bus;
+            if (!bus)
+            {
+                GError *gerror = nullptr;
+                bus.reset(g_bus_get_sync(bus_type, nullptr, &gerror));
+                GErrorPtr error_ptr(gerror);
+                if (!bus)
+                    error = std::string("Failed to connect to bus: ") + (gerror ? gerror->message : "unknown error");
+            }
+            return bus.get();
+        }
+
+        std::unordered_map<uint64_t, Subscription *> subscriptions;
+        uint64_t next_id = 1;
+
+    private:
+        GMainContext *context;
+        GMainLoop *loop;
+        std::thread thread;
+        GObjectPtr<GDBusConnection> session_bus;
+        GObjectPtr<GDBusConnection> system_bus;
+
+        SignalThread()
+            : context(g_main_context_new()),
+              loop(g_main_loop_new(context, FALSE))
+        {
+            thread = std::thread([this]()
+            {
+                // subscriptions made from here dispatch on this context
+                g_main_context_push_thread_default(context);
+                g_main_loop_run(loop);
+            });
+            started = this;
+        }
+    };
+
+    std::atomic<SignalThread *> SignalThread::started{nullptr};
+
+    void deliver(Subscription &subscription)
+    {
+        std::vector<DBusSignal> batch;
+        batch.swap(subscription.pending);
+        subscription.callback(std::move(batch));
+    }
+
+    gboolean on_window_closed(gpointer user_data)
+    {
+        auto *subscription = static_cast<Subscription *>(user_data);
+        g_source_unref(subscription->flush_source);
+        subscription->flush_source = nullptr;
+        deliver(*subscription);
+        return G_SOURCE_REMOVE;
+    }
+
+    void on_signal(GDBusConnection *, const gchar *sender_name, const gchar *object_path, const gchar *interface_name,
+                   const gchar *signal_name, GVariant *parameters, gpointer user_data)
+    {
+        auto *subscription = static_cast<Subscription *>(user_data);
+        if (!subscription->callback)
+            return;
+
+        dbus_signal_stats().signals.fetch_add(1, std::memory_order_relaxed);
+
+        // decoding into JS values waits for the JS thread; this only keeps
+        // a reference
+        subscription->pending.push_back(DBusSignal{
+            sender_name ? sender_name : "",
+            object_path,
+            interface_name,
+            signal_name,
+            GVariantPtr(g_variant_ref(parameters)),
+            monotonic_ns(),
+        });
+
+        if (subscription->batch_ms == 0)
+        {
+            deliver(*subscription);
+            return;
+        }
+
+        // the first signal opens the window; everything until it closes
+        // rides along
+        if (!subscription->flush_source)
+        {
+            subscription->flush_source = g_timeout_source_new(subscription->batch_ms);
+            g_source_set_callback(subscription->flush_source, on_window_closed, subscription, nullptr);
+            g_source_attach(subscription->flush_source, g_main_context_get_thread_default());
+        }
+    }
+
+    void remove(SignalThread &signal_thread, uint64_t id)
+    {
+        auto it = signal_thread.subscriptions.find(id);
+        if (it == signal_thread.subscriptions.end())
+            return;
+
+        Subscription *subscription = it->second;
+        signal_thread.subscriptions.erase(it);
+
+        if (subscription->flush_source)
+        {
+            g_source_destroy(subscription->flush_source);
+            g_source_unref(subscription->flush_source);
+            subscription->flush_source = nullptr;
+        }
+        subscription->pending.clear();
+        subscription->callback = nullptr;
+
+        // frees the subscription through the destroy notify once GDBus is
+        // done with it
+        g_dbus_connection_signal_unsubscribe(subscription->bus, subscription->subscription_id);
+    }
+}
+
+uint64_t subscribe_dbus_signal(const DBusSignalMatch &match, uint32_t batch_ms, DBusSignalCallback callback,
+                               std::string &error)
+{
+    SignalThread &signal_thread = SignalThread::instance();
+    uint64_t id = 0;
+
+    signal_thread.run([&]()
+    {
+        GDBusConnection *bus = signal_thread.bus(match.bus_type, error);
+        if (!bus)
+            return;
+
+        auto *subscription = new Subscription();
+        subscription->callback = std::move(callback);
+        subscription->batch_ms = batch_ms;
+        subscription->bus = bus;
+        subscription->subscription_id = g_dbus_connection_signal_subscribe(
+            bus,
+            or_null(match.sender),
+            or_null(match.interface_name),
+            or_null(match.member),
+            or_null(match.object_path),
+            or_null(match.arg0),
+            match.arg0_is_path ? G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_PATH : G_DBUS_SIGNAL_FLAGS_NONE,
+            on_signal,
+            subscription,
+            [](gpointer data) { delete static_cast<Subscription *>(data); });
+
+        id = signal_thread.next_id++;
+        signal_thread.subscriptions.emplace(id, subscription);
+    });
+
+    return id;
+}
+
+void unsubscribe_dbus_signal(uint64_t id)
+{
+    if (!SignalThread::started)
+        return;
+
+    SignalThread &signal_thread = *SignalThread::started;
+    signal_thread.run([&]() { remove(signal_thread, id); });
+}
+
+void unsubscribe_all_dbus_signals()
+{
+    // nothing to do, and no thread worth starting, if nobody subscribed
+    if (!SignalThread::started)
+        return;
+
+    SignalThread &signal_thread = *SignalThread::started;
+    signal_thread.run([&]()
+    {
+        while (!signal_thread.subscriptions.empty())
+            remove(signal_thread, signal_thread.subscriptions.begin()->first);
+    });
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <gio/gio.h>
+#include <string>
+#include <vector>
+#include "glib_ptr.h"
+#include "stats.h"
+
+// Generic D-Bus signal subscriptions for JS. Every subscription lives on one
+// shared thread with its own GMainContext: the match is handed to
+// g_dbus_connection_signal_subscribe, which installs the same fields as the
+// bus match rule, so the daemon only routes matching signals to us and
+// nothing unwanted is seen on any thread. Matches are collected on that
+// thread for batch_ms and passed on in one piece; the JS thread is only
+// woken to decode and deliver them.
+
+struct DBusSignalMatch
+{
+    GBusType bus_type = G_BUS_TYPE_SESSION;
+    // empty matches anything
+    std::string sender;
+    std::string object_path;
+    std::string interface_name;
+    std::string member;
+    std::string arg0;
+    // arg0 is an object path prefix (arg0path=) rather than a string
+    bool arg0_is_path = false;
+};
+
+struct DBusSignal
+{
+    // the unique name, even when the match used a well-known one
+    std::string sender;
+    std::string object_path;
+    std::string interface_name;
+    std::string member;
+    GVariantPtr parameters;
+    // CLOCK_MONOTONIC when the signal reached us
+    uint64_t received_ns;
+};
+
+struct DBusSignalStats
+{
+    std::atomic<uint64_t> signals{0};
+    // JS callbacks made, each with every signal queued by then
+    std::atomic<uint64_t> batches{0};
+    // signal received -> JS callback running
+    LatencyStats delivery;
+};
+
+DBusSignalStats &dbus_signal_stats();
+
+// Runs on the signal thread, once per batch window.
+using DBusSignalCallback = std::function<void(std::vector<DBusSignal> &&)>;
+
+// batch_ms 0 passes every signal on as it arrives. Returns 0 with error set
+// if the bus is unavailable. Thread safe.
+uint64_t subscribe_dbus_signal(const DBusSignalMatch &match, uint32_t batch_ms, DBusSignalCallback callback,
+                               std::string &error);
+
+// Drops anything still waiting for its window. The callback is never called
+// again once this returns. Unknown ids are ignored.
+void unsubscribe_dbus_signal(uint64_t id);
+void unsubscribe_all_dbus_signals();
@@ -0,0 +1,215 @@
+#include "dbus_signal_binding.h"
+#include "dbus_signal.h"
+#include "dbus_value.h"
+#include "event_batch.h"
+#include "trace.h"
+#include <cmath>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    struct Listener
+    {
+        Napi::ThreadSafeFunction callback;
+        EventBatch<DBusSignal> batch;
+        // cleared on unsubscribe, for a dispatch that was already queued
+        bool active = true;
+    };
+
+    // JS thread only
+    std::unordered_map<uint64_t, std::shared_ptr<Listener>> listeners;
+
+    void dispatch(Napi::Env env, Napi::Function jsCallback, Listener &listener)
+    {
+        TRACE_SPAN("dbusSignal dispatch");
+        if (!listener.active)
+            return;
+
+        std::vector<DBusSignal> signals = listener.batch.drain();
+        if (signals.empty())
+            return;
+
+        auto &stats = dbus_signal_stats();
+        stats.batches.fetch_add(1, std::memory_order_relaxed);
+        const uint64_t now = monotonic_ns();
+
+        Napi::Array array = Napi::Array::New(env, signals.size());
+        for (size_t i = 0; i < signals.size(); i++)
+        {
+            const DBusSignal &signal = signals[i];
+            stats.delivery.record(now - signal.received_ns);
+
+            Napi::Object obj = Napi::Object::New(env);
+            obj.Set("sender", Napi::String::New(env, signal.sender));
+            obj.Set("path", Napi::String::New(env, signal.object_path));
+            obj.Set("iface", Napi::String::New(env, signal.interface_name));
+            obj.Set("member", Napi::String::New(env, signal.member));
+            obj.Set("args", gvariant_to_js(env, signal.parameters.get()));
+            obj.Set("receivedAtMs", Napi::Number::New(env, static_cast<double>(signal.received_ns) / 1e6));
+            array.Set(static_cast<uint32_t>(i), obj);
+        }
+
+        jsCallback.Call({array});
+    }
+
+    // Reads one optional string field, checking it with valid. False if it is
+    // there but isn't a string or isn't valid.
+    bool match_field(const Napi::Object &match, const char *key, bool (*valid)(const char *), std::string &out)
+    {
+        Napi::Value value = match.Get(key);
+        if (value.IsUndefined())
+            return true;
+        if (!value.IsString())
+            return false;
+
+        out = value.As<Napi::String>().Utf8Value();
+        return valid(out.c_str());
+    }
+
+    bool any_string(const char *) { return true; }
+    bool is_name(const char *value) { return g_dbus_is_name(value); }
+    bool is_object_path(const char *value) { return g_variant_is_object_path(value); }
+    bool is_interface_name(const char *value) { return g_dbus_is_interface_name(value); }
+    bool is_member_name(const char *value) { return g_dbus_is_member_name(value); }
+
+    // arg0path also matches a namespace, given as a path ending in '/'
+    bool is_path_prefix(const char *value)
+    {
+        const std::string path(value);
+        if (path.size() > 1 && path.back() == '/')
+            return g_variant_is_object_path(path.substr(0, path.size() - 1).c_str());
+        return g_variant_is_object_path(value);
+    }
+
+    Napi::Value SubscribeDBusSignal(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction() ||
+            (info.Length() > 2 && !info[2].IsObject() && !info[2].IsUndefined()))
+        {
+            Napi::TypeError::New(env, "Expected (object, function, object?)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Object obj = info[0].As<Napi::Object>();
+        DBusSignalMatch match;
+        std::string arg0_path;
+
+        const char *invalid = nullptr;
+        if (!obj.Get("bus").IsUndefined() && !parse_bus_type(obj.Get("bus"), match.bus_type))
+            invalid = "bus";
+        else if (!match_field(obj, "sender", is_name, match.sender))
+            invalid = "sender";
+        else if (!match_field(obj, "path", is_object_path, match.object_path))
+            invalid = "path";
+        else if (!match_field(obj, "iface", is_interface_name, match.interface_name))
+            invalid = "iface";
+        else if (!match_field(obj, "member", is_member_name, match.member))
+            invalid = "member";
+        else if (!match_field(obj, "arg0", any_string, match.arg0))
+            invalid = "arg0";
+        else if (!match_field(obj, "arg0path", is_path_prefix, arg0_path) || (!arg0_path.empty() && !match.arg0.empty()))
+            invalid = "arg0path";
+
+        if (invalid)
+        {
+            Napi::TypeError::New(env, std::string("Invalid '") + invalid + "' in signal match").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        if (!arg0_path.empty())
+        {
+            match.arg0 = arg0_path;
+            match.arg0_is_path = true;
+        }
+
+        uint32_t batch_ms = 0;
+        if (info.Length() > 2 && info[2].IsObject())
+        {
+            Napi::Value value = info[2].As<Napi::Object>().Get("batchMs");
+            if (!value.IsUndefined())
+            {
+                const double ms = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1;
+                if (!(ms >= 0 && ms <= 60000))
+                {
+                    Napi::TypeError::New(env, "batchMs must be between 0 and 60000").ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+                batch_ms = static_cast<uint32_t>(std::lround(ms));
+            }
+        }
+
+        auto listener = std::make_shared<Listener>();
+        listener->callback = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "DBusSignalCallback", 0, 1);
+        listener->callback.Unref(env);
+
+        // one JS call takes everything queued up to the moment it runs, so a
+        // window that closes while the JS thread is busy joins the previous one
+        auto on_signals = [listener](std::vector<DBusSignal> &&signals)
+        {
+            bool schedule = false;
+            for (DBusSignal &signal : signals)
+                schedule |= listener->batch.push(std::move(signal));
+
+            if (!schedule)
+                return;
+
+            const napi_status status =
+                listener->callback.NonBlockingCall([listener](Napi::Env env, Napi::Function jsCallback)
+                {
+                    dispatch(env, jsCallback, *listener);
+                });
+
+            // no dispatch will run for these, and an undrained batch would
+            // stop every later push from scheduling one
+            if (status != napi_ok)
+                listener->batch.drain();
+        };
+
+        std::string error;
+        const uint64_t id = subscribe_dbus_signal(match, batch_ms, std::move(on_signals), error);
+        if (!id)
+        {
+            listener->callback.Release();
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        listeners.emplace(id, listener);
+        return Napi::Number::New(env, static_cast<double>(id));
+    }
+
+    Napi::Value UnsubscribeDBusSignal(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber())
+        {
+            Napi::TypeError::New(env, "Expected (number)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        const int64_t id = info[0].As<Napi::Number>().Int64Value();
+        auto it = id > 0 ? listeners.find(static_cast<uint64_t>(id)) : listeners.end();
+        if (it == listeners.end())
+            return Napi::Boolean::New(env, false);
+
+        // once this returns the signal thread never touches the TSFN again
+        unsubscribe_dbus_signal(it->first);
+
+        it->second->active = false;
+        it->second->callback.Release();
+        listeners.erase(it);
+        return Napi::Boolean::New(env, true);
+    }
+}
+
+void InitDBusSignalBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("subscribeDBusSignal", Napi::Function::New(env, SubscribeDBusSignal));
+    exports.Set("unsubscribeDBusSignal", Napi::Function::New(env, UnsubscribeDBusSignal));
+}
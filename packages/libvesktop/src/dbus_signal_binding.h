@@ -0,0 +1,7 @@
+#pragma once
+
+#include <napi.h>
+
+// subscribeDBusSignal / unsubscribeDBusSignal: any D-Bus signal in JS,
+// filtered by the bus and delivered in batches (see dbus_signal.h).
+void InitDBusSignalBinding(Napi::Env env, Napi::Object exports);
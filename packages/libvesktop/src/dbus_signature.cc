@@ -0,0 +1,117 @@
+#include "dbus_signature.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+    bool build_plan(const GVariantType *type, SignaturePlan &plan, std::string &error)
+    {
+        const gsize length = g_variant_type_get_string_length(type);
+        plan.type_string.assign(g_variant_type_peek_string(type), length);
+
+        if (g_variant_type_is_basic(type))
+        {
+            switch (plan.type_string[0])
+            {
+            case 'b': plan.kind = SignatureKind::Boolean; return true;
+            case 'y': plan.kind = SignatureKind::Byte; return true;
+            case 'n': plan.kind = SignatureKind::Int16; return true;
+            case 'q': plan.kind = SignatureKind::Uint16; return true;
+            case 'i': plan.kind = SignatureKind::Int32; return true;
+            case 'u': plan.kind = SignatureKind::Uint32; return true;
+            case 'x': plan.kind = SignatureKind::Int64; return true;
+            case 't': plan.kind = SignatureKind::Uint64; return true;
+            case 'd': plan.kind = SignatureKind::Double; return true;
+            case 's': plan.kind = SignatureKind::String; return true;
+            case 'o': plan.kind = SignatureKind::ObjectPath; return true;
+            case 'g': plan.kind = SignatureKind::Signature; return true;
+            case 'h': plan.kind = SignatureKind::Handle; return true;
+            default:
+                error = "Unsupported type '" + plan.type_string + "'";
+                return false;
+            }
+        }
+
+        if (g_variant_type_is_variant(type))
+        {
+            plan.kind = SignatureKind::Variant;
+            return true;
+        }
+
+        if (g_variant_type_is_array(type))
+        {
+            const GVariantType *element = g_variant_type_element(type);
+            if (g_variant_type_equal(element, G_VARIANT_TYPE_BYTE))
+            {
+                plan.kind = SignatureKind::Bytes;
+                return true;
+            }
+
+            if (g_variant_type_is_dict_entry(element))
+            {
+                plan.kind = SignatureKind::Dict;
+                plan.children.resize(2);
+                return build_plan(g_variant_type_key(element), plan.children[0], error) &&
+                       build_plan(g_variant_type_value(element), plan.children[1], error);
+            }
+
+            plan.kind = SignatureKind::Array;
+            plan.children.resize(1);
+            return build_plan(element, plan.children[0], error);
+        }
+
+        if (g_variant_type_is_maybe(type))
+        {
+            plan.kind = SignatureKind::Maybe;
+            plan.children.resize(1);
+            return build_plan(g_variant_type_element(type), plan.children[0], error);
+        }
+
+        if (g_variant_type_is_tuple(type))
+        {
+            plan.kind = SignatureKind::Tuple;
+            plan.children.resize(g_variant_type_n_items(type));
+            size_t i = 0;
+            for (const GVariantType *field = g_variant_type_first(type); field; field = g_variant_type_next(field))
+            {
+                if (!build_plan(field, plan.children[i++], error))
+                    return false;
+            }
+            return true;
+        }
+
+        error = "Unsupported type '" + plan.type_string + "'";
+        return false;
+    }
+}
+
+const SignaturePlan *compile_signature(const std::string &type_string, std::string &error)
+{
+    static std::mutex mutex;
+    static auto *cache = new std::unordered_map<std::string, std::unique_ptr<SignaturePlan>>();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = cache->find(type_string);
+    if (it != cache->end())
+        return it->second.get();
+
+    if (!g_variant_type_string_is_valid(type_string.c_str()) ||
+        !g_variant_type_is_definite(reinterpret_cast<const GVariantType *>(type_string.c_str())))
+    {
+        error = "Invalid signature '" + type_string + "'";
+        return nullptr;
+    }
+
+    auto plan = std::make_unique<SignaturePlan>();
+    if (!build_plan(reinterpret_cast<const GVariantType *>(type_string.c_str()), *plan, error))
+        return nullptr;
+
+    return cache->emplace(type_string, std::move(plan)).first->second.get();
+}
+
+bool plan_signature(const GVariantType *type, SignaturePlan &plan, std::string &error)
+{
+    return build_plan(type, plan, error);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <glib.h>
+#include <string>
+#include <vector>
+
+// A GVariant type string parsed once into a tree that the JS <-> GVariant
+// converters in dbus_value.h walk directly, so a call never reparses its
+// signature or works out what to do from the JS value's shape.
+
+enum class SignatureKind : uint8_t
+{
+    Boolean,
+    Byte,
+    Int16,
+    Uint16,
+    Int32,
+    Uint32,
+    Int64,
+    Uint64,
+    Double,
+    String,
+    ObjectPath,
+    Signature,
+    // decoded as the fd-list index; can't be sent
+    Handle,
+    Variant,
+    // ay, to and from Buffers in one piece
+    Bytes,
+    Array,
+    // a{..}, children are the key and the value
+    Dict,
+    Tuple,
+    Maybe,
+};
+
+struct SignaturePlan
+{
+    SignatureKind kind;
+    std::string type_string;
+    // element for Array and Maybe, key and value for Dict, fields for Tuple
+    std::vector<SignaturePlan> children;
+
+    // a GVariantType is its type string
+    const GVariantType *type() const { return reinterpret_cast<const GVariantType *>(type_string.c_str()); }
+};
+
+// For signatures our own code supplies, a bounded set. Compiled plans are
+// cached for the life of the process and never move, so the pointer can be
+// kept. Fails for invalid or indefinite types. Thread-safe.
+const SignaturePlan *compile_signature(const std::string &type_string, std::string &error);
+
+// Plans a type without caching it, for types chosen by whoever sent us the
+// value (replies, signal arguments, the contents of a 'v'), which would
+// otherwise grow the cache without limit. The type must be definite.
+bool plan_signature(const GVariantType *type, SignaturePlan &plan, std::string &error);
@@ -0,0 +1,373 @@
+#include "dbus_value.h"
+#include "glib_ptr.h"
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    const napi_type_tag DBUS_VARIANT_TAG = {0x9a1f3c5e7b2d4f60ull, 0x1c8e6a4b3d2f5e70ull};
+
+    // largest integer a double holds exactly
+    constexpr double MAX_SAFE_INTEGER = 9007199254740991.0;
+
+    GVariant *fail(const SignaturePlan &plan, const char *expected, std::string &error)
+    {
+        error = std::string("Expected ") + expected + " for '" + plan.type_string + "'";
+        return nullptr;
+    }
+
+    bool integer_in_range(const Napi::Value &value, double min, double max, double &out)
+    {
+        if (!value.IsNumber())
+            return false;
+        out = value.As<Napi::Number>().DoubleValue();
+        return std::trunc(out) == out && out >= min && out <= max;
+    }
+
+    bool is_dbus_variant(const Napi::Value &value)
+    {
+        return value.IsExternal() && value.As<Napi::External<GVariant>>().CheckTypeTag(&DBUS_VARIANT_TAG);
+    }
+
+    bool is_uint8_array(const Napi::Value &value)
+    {
+        return value.IsTypedArray() && value.As<Napi::TypedArray>().TypedArrayType() == napi_uint8_array;
+    }
+
+    // Always a copy: the call may still be on the wire when JS detaches,
+    // transfers or rewrites the Buffer, and a reference doesn't stop either.
+    GVariant *bytes_to_gvariant(const Napi::Value &value)
+    {
+        Napi::Uint8Array array = value.As<Napi::Uint8Array>();
+        const size_t length = array.ElementLength();
+        if (length == 0)
+            return g_variant_new_array(G_VARIANT_TYPE_BYTE, nullptr, 0);
+
+        return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, array.Data(), length, 1);
+    }
+
+    const char *infer_signature(const Napi::Value &value)
+    {
+        if (value.IsBoolean())
+            return "b";
+        if (value.IsString())
+            return "s";
+        if (value.IsNumber())
+        {
+            const double number = value.As<Napi::Number>().DoubleValue();
+            return std::trunc(number) == number && number >= INT32_MIN && number <= INT32_MAX ? "i" : "d";
+        }
+        if (value.IsBigInt())
+            return "x";
+        if (is_uint8_array(value))
+            return "ay";
+        if (value.IsArray())
+            return "av";
+        if (value.IsObject() && !value.IsFunction())
+            return "a{sv}";
+        return nullptr;
+    }
+
+    GVariant *variant_to_gvariant(const SignaturePlan &plan, const Napi::Value &value, std::string &error)
+    {
+        if (is_dbus_variant(value))
+            return g_variant_new_variant(value.As<Napi::External<GVariant>>().Data());
+
+        const char *signature = infer_signature(value);
+        if (!signature)
+            return fail(plan, "a value whose D-Bus type can be inferred, or dbusVariant()", error);
+
+        const SignaturePlan *inner_plan = compile_signature(signature, error);
+        GVariant *inner = inner_plan ? js_to_gvariant(*inner_plan, value, error) : nullptr;
+        return inner ? g_variant_new_variant(inner) : nullptr;
+    }
+
+    GVariant *dict_to_gvariant(const SignaturePlan &plan, const Napi::Value &value, std::string &error)
+    {
+        if (!value.IsObject() || value.IsArray())
+            return fail(plan, "an object", error);
+
+        const SignaturePlan &key_plan = plan.children[0];
+        const SignaturePlan &value_plan = plan.children[1];
+        const bool string_keys = key_plan.kind == SignatureKind::String ||
+                                 key_plan.kind == SignatureKind::ObjectPath ||
+                                 key_plan.kind == SignatureKind::Signature;
+
+        Napi::Env env = value.Env();
+        Napi::Object obj = value.As<Napi::Object>();
+        Napi::Array keys = obj.GetPropertyNames();
+
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, plan.type());
+
+        for (uint32_t i = 0; i < keys.Length(); i++)
+        {
+            Napi::Value key = keys.Get(i);
+            // property names are always strings; numeric and boolean keys
+            // are parsed back into the key type
+            Napi::Value typed_key = key;
+            if (!string_keys)
+            {
+                const std::string text = key.ToString().Utf8Value();
+                if (key_plan.kind == SignatureKind::Boolean)
+                    typed_key = Napi::Boolean::New(env, text == "true");
+                else
+                    typed_key = Napi::Number::New(env, std::strtod(text.c_str(), nullptr));
+            }
+
+            GVariant *key_variant = js_to_gvariant(key_plan, typed_key, error);
+            GVariant *value_variant = key_variant ? js_to_gvariant(value_plan, obj.Get(key), error) : nullptr;
+            if (!value_variant)
+            {
+                if (key_variant)
+                    g_variant_unref(g_variant_ref_sink(key_variant));
+                g_variant_builder_clear(&builder);
+                return nullptr;
+            }
+
+            g_variant_builder_add_value(&builder, g_variant_new_dict_entry(key_variant, value_variant));
+        }
+
+        return g_variant_builder_end(&builder);
+    }
+
+    GVariant *container_to_gvariant(const SignaturePlan &plan, const Napi::Value &value, std::string &error)
+    {
+        if (!value.IsArray())
+            return fail(plan, plan.kind == SignatureKind::Tuple ? "an array of fields" : "an array", error);
+
+        Napi::Array array = value.As<Napi::Array>();
+        const uint32_t length = array.Length();
+        if (plan.kind == SignatureKind::Tuple && length != plan.children.size())
+            return fail(plan, ("exactly " + std::to_string(plan.children.size()) + " fields").c_str(), error);
+
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, plan.type());
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+            const SignaturePlan &child_plan = plan.kind == SignatureKind::Tuple ? plan.children[i] : plan.children[0];
+            GVariant *child = js_to_gvariant(child_plan, array.Get(i), error);
+            if (!child)
+            {
+                g_variant_builder_clear(&builder);
+                return nullptr;
+            }
+            g_variant_builder_add_value(&builder, child);
+        }
+
+        return g_variant_builder_end(&builder);
+    }
+}
+
+GVariant *js_to_gvariant(const SignaturePlan &plan, const Napi::Value &value, std::string &error)
+{
+    double number;
+
+    switch (plan.kind)
+    {
+    case SignatureKind::Boolean:
+        if (!value.IsBoolean())
+            return fail(plan, "a boolean", error);
+        return g_variant_new_boolean(value.As<Napi::Boolean>().Value());
+    case SignatureKind::Byte:
+        if (!integer_in_range(value, 0, UINT8_MAX, number))
+            return fail(plan, "an integer from 0 to 255", error);
+        return g_variant_new_byte(static_cast<guint8>(number));
+    case SignatureKind::Int16:
+        if (!integer_in_range(value, INT16_MIN, INT16_MAX, number))
+            return fail(plan, "a 16-bit integer", error);
+        return g_variant_new_int16(static_cast<gint16>(number));
+    case SignatureKind::Uint16:
+        if (!integer_in_range(value, 0, UINT16_MAX, number))
+            return fail(plan, "an unsigned 16-bit integer", error);
+        return g_variant_new_uint16(static_cast<guint16>(number));
+    case SignatureKind::Int32:
+        if (!integer_in_range(value, INT32_MIN, INT32_MAX, number))
+            return fail(plan, "a 32-bit integer", error);
+        return g_variant_new_int32(static_cast<gint32>(number));
+    case SignatureKind::Uint32:
+        if (!integer_in_range(value, 0, UINT32_MAX, number))
+            return fail(plan, "an unsigned 32-bit integer", error);
+        return g_variant_new_uint32(static_cast<guint32>(number));
+    case SignatureKind::Int64:
+        if (value.IsBigInt())
+        {
+            bool lossless;
+            const int64_t result = value.As<Napi::BigInt>().Int64Value(&lossless);
+            if (!lossless)
+                return fail(plan, "a bigint that fits in 64 bits", error);
+            return g_variant_new_int64(result);
+        }
+        if (!integer_in_range(value, -MAX_SAFE_INTEGER, MAX_SAFE_INTEGER, number))
+            return fail(plan, "a bigint or safe integer", error);
+        return g_variant_new_int64(static_cast<gint64>(number));
+    case SignatureKind::Uint64:
+        if (value.IsBigInt())
+        {
+            bool lossless;
+            const uint64_t result = value.As<Napi::BigInt>().Uint64Value(&lossless);
+            if (!lossless)
+                return fail(plan, "a bigint that fits in 64 bits", error);
+            return g_variant_new_uint64(result);
+        }
+        if (!integer_in_range(value, 0, MAX_SAFE_INTEGER, number))
+            return fail(plan, "a bigint or safe integer", error);
+        return g_variant_new_uint64(static_cast<guint64>(number));
+    case SignatureKind::Double:
+        if (!value.IsNumber())
+            return fail(plan, "a number", error);
+        return g_variant_new_double(value.As<Napi::Number>().DoubleValue());
+    case SignatureKind::String:
+        if (!value.IsString())
+            return fail(plan, "a string", error);
+        return g_variant_new_string(value.As<Napi::String>().Utf8Value().c_str());
+    case SignatureKind::ObjectPath:
+    {
+        const std::string path = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+        if (!g_variant_is_object_path(path.c_str()))
+            return fail(plan, "an object path", error);
+        return g_variant_new_object_path(path.c_str());
+    }
+    case SignatureKind::Signature:
+    {
+        if (!value.IsString())
+            return fail(plan, "a signature", error);
+        const std::string signature = value.As<Napi::String>().Utf8Value();
+        if (!g_variant_is_signature(signature.c_str()))
+            return fail(plan, "a signature", error);
+        return g_variant_new_signature(signature.c_str());
+    }
+    case SignatureKind::Handle:
+        error = "File descriptors ('h') can't be sent";
+        return nullptr;
+    case SignatureKind::Variant:
+        return variant_to_gvariant(plan, value, error);
+    case SignatureKind::Bytes:
+        if (!is_uint8_array(value))
+            return fail(plan, "a Buffer", error);
+        return bytes_to_gvariant(value);
+    case SignatureKind::Dict:
+        return dict_to_gvariant(plan, value, error);
+    case SignatureKind::Array:
+    case SignatureKind::Tuple:
+        return container_to_gvariant(plan, value, error);
+    case SignatureKind::Maybe:
+    {
+        if (value.IsNull() || value.IsUndefined())
+            return g_variant_new_maybe(plan.children[0].type(), nullptr);
+        GVariant *child = js_to_gvariant(plan.children[0], value, error);
+        return child ? g_variant_new_maybe(nullptr, child) : nullptr;
+    }
+    }
+
+    error = "Unsupported type '" + plan.type_string + "'";
+    return nullptr;
+}
+
+Napi::Value gvariant_to_js(Napi::Env env, const SignaturePlan &plan, GVariant *value)
+{
+    switch (plan.kind)
+    {
+    case SignatureKind::Boolean:
+        return Napi::Boolean::New(env, g_variant_get_boolean(value));
+    case SignatureKind::Byte:
+        return Napi::Number::New(env, g_variant_get_byte(value));
+    case SignatureKind::Int16:
+        return Napi::Number::New(env, g_variant_get_int16(value));
+    case SignatureKind::Uint16:
+        return Napi::Number::New(env, g_variant_get_uint16(value));
+    case SignatureKind::Int32:
+        return Napi::Number::New(env, g_variant_get_int32(value));
+    case SignatureKind::Uint32:
+        return Napi::Number::New(env, g_variant_get_uint32(value));
+    case SignatureKind::Int64:
+        return Napi::BigInt::New(env, static_cast<int64_t>(g_variant_get_int64(value)));
+    case SignatureKind::Uint64:
+        return Napi::BigInt::New(env, static_cast<uint64_t>(g_variant_get_uint64(value)));
+    case SignatureKind::Handle:
+        return Napi::Number::New(env, g_variant_get_handle(value));
+    case SignatureKind::Double:
+        return Napi::Number::New(env, g_variant_get_double(value));
+    case SignatureKind::String:
+    case SignatureKind::ObjectPath:
+    case SignatureKind::Signature:
+    {
+        gsize length;
+        const gchar *text = g_variant_get_string(value, &length);
+        return Napi::String::New(env, text, length);
+    }
+    case SignatureKind::Variant:
+    {
+        GVariantPtr inner(g_variant_get_variant(value));
+        return gvariant_to_js(env, inner.get());
+    }
+    case SignatureKind::Bytes:
+    {
+        gsize length;
+        const auto *data = static_cast<const uint8_t *>(g_variant_get_fixed_array(value, &length, 1));
+        // external buffers aren't allowed inside Electron's V8 sandbox
+        return length ? Napi::Buffer<uint8_t>::Copy(env, data, length) : Napi::Buffer<uint8_t>::New(env, 0);
+    }
+    case SignatureKind::Dict:
+    {
+        Napi::Object obj = Napi::Object::New(env);
+        const gsize count = g_variant_n_children(value);
+        for (gsize i = 0; i < count; i++)
+        {
+            GVariantPtr entry(g_variant_get_child_value(value, i));
+            GVariantPtr key(g_variant_get_child_value(entry.get(), 0));
+            GVariantPtr item(g_variant_get_child_value(entry.get(), 1));
+            obj.Set(gvariant_to_js(env, plan.children[0], key.get()), gvariant_to_js(env, plan.children[1], item.get()));
+        }
+        return obj;
+    }
+    case SignatureKind::Array:
+    case SignatureKind::Tuple:
+    {
+        const gsize count = g_variant_n_children(value);
+        Napi::Array array = Napi::Array::New(env, count);
+        for (gsize i = 0; i < count; i++)
+        {
+            GVariantPtr child(g_variant_get_child_value(value, i));
+            const SignaturePlan &child_plan = plan.kind == SignatureKind::Tuple ? plan.children[i] : plan.children[0];
+            array.Set(static_cast<uint32_t>(i), gvariant_to_js(env, child_plan, child.get()));
+        }
+        return array;
+    }
+    case SignatureKind::Maybe:
+    {
+        GVariantPtr child(g_variant_get_maybe(value));
+        return child ? gvariant_to_js(env, plan.children[0], child.get()) : env.Null();
+    }
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value gvariant_to_js(Napi::Env env, GVariant *value)
+{
+    SignaturePlan plan;
+    std::string error;
+    return plan_signature(g_variant_get_type(value), plan, error) ? gvariant_to_js(env, plan, value) : env.Undefined();
+}
+
+Napi::Value make_dbus_variant(Napi::Env env, GVariant *value)
+{
+    auto external = Napi::External<GVariant>::New(env, g_variant_ref_sink(value),
+                                                  [](Napi::Env, GVariant *held) { g_variant_unref(held); });
+    external.TypeTag(&DBUS_VARIANT_TAG);
+    return external;
+}
+
+bool parse_bus_type(const Napi::Value &value, GBusType &out)
+{
+    const std::string name = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+    if (name == "session")
+        out = G_BUS_TYPE_SESSION;
+    else if (name == "system")
+        out = G_BUS_TYPE_SYSTEM;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <napi.h>
+#include <string>
+#include "dbus_signature.h"
+
+// Conversions between JS values and GVariants, driven by a compiled
+// SignaturePlan. Must run on the JS thread.
+//
+// JS -> GVariant: numbers (or bigints for x/t) for integers, strings for
+// s/o/g, Buffers or Uint8Arrays for ay, arrays for arrays and tuples, plain
+// objects for dicts, null/undefined for an empty maybe. A 'v' takes either a
+// value made by dbusVariant(signature, value) or a plain JS value whose type
+// is inferred: boolean b, string s, int32 i, other numbers d, bigint x,
+// Buffer ay, array av, object a{sv}.
+//
+// GVariant -> JS is the reverse, with variants unwrapped, x/t as bigints,
+// ay as Buffer copies, every dict as a plain object and h as the index into
+// the message's fd list. Sending 'h' isn't supported.
+
+// Returns a floating reference, or null with error set. Buffers are copied,
+// so the result owns everything it points to.
+GVariant *js_to_gvariant(const SignaturePlan &plan, const Napi::Value &value, std::string &error);
+
+Napi::Value gvariant_to_js(Napi::Env env, const SignaturePlan &plan, GVariant *value);
+
+// Plans the value's own type on the spot, without touching the cache.
+Napi::Value gvariant_to_js(Napi::Env env, GVariant *value);
+
+// dbusVariant(signature, value): a typed 'v' argument, held as an External
+// so it can't be mistaken for anything a caller built by hand.
+Napi::Value make_dbus_variant(Napi::Env env, GVariant *value);
+
+// "session" or "system"
+bool parse_bus_type(const Napi::Value &value, GBusType &out);
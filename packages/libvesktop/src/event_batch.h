@@ -0,0 +1,34 @@
+#pragma once
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Producer/consumer hand-off for events crossing to the JS thread. push()
+// reports whether the batch was empty, i.e. whether the producer has to
+// schedule a drain; everything pushed before that drain runs rides along in
+// the same JS call.
+template <typename T>
+class EventBatch
+{
+public:
+    bool push(T event)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const bool was_empty = events.empty();
+        events.push_back(std::move(event));
+        return was_empty;
+    }
+
+    std::vector<T> drain()
+    {
+        std::vector<T> out;
+        std::lock_guard<std::mutex> lock(mutex);
+        out.swap(events);
+        return out;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<T> events;
+};
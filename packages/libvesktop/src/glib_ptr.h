@@ -0,0 +1,39 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <memory>
+
+template <typename T>
+struct GObjectDeleter
+{
+    void operator()(T *obj) const
+    {
+        if (obj)
+            g_object_unref(obj);
+    }
+};
+
+template <typename T>
+using GObjectPtr = std::unique_ptr<T, GObjectDeleter<T>>;
+
+struct GVariantDeleter
+{
+    void operator()(GVariant *variant) const
+    {
+        if (variant)
+            g_variant_unref(variant);
+    }
+};
+
+using GVariantPtr = std::unique_ptr<GVariant, GVariantDeleter>;
+
+struct GErrorDeleter
+{
+    void operator()(GError *error) const
+    {
+        if (error)
+            g_error_free(error);
+    }
+};
+
+using GErrorPtr = std::unique_ptr<GError, GErrorDeleter>;
@@ -0,0 +1,261 @@
+#include "glib_uv_bridge.h"
+#include "native_log.h"
+#include "trace.h"
+#include <map>
+#include <vector>
+
+namespace
+{
+    struct FdWatch
+    {
+        uv_poll_t handle;
+        int uv_events = 0;
+        // filled in by the poll callback, consumed by the next check
+        gushort revents = 0;
+        // generation of the last query that asked for this fd
+        uint64_t seen = 0;
+    };
+
+    struct Bridge
+    {
+        uv_loop_t *loop = nullptr;
+        GMainContext *context = nullptr;
+        uv_prepare_t prepare;
+        uv_check_t check;
+        uv_timer_t timer;
+        std::vector<GPollFD> fds;
+        std::map<int, FdWatch *> watches;
+        gint max_priority = 0;
+        uint64_t generation = 0;
+        uint64_t dispatches = 0;
+    };
+
+    Bridge *bridge = nullptr;
+
+    int to_uv_events(gushort events)
+    {
+        int result = 0;
+        if (events & G_IO_IN)
+            result |= UV_READABLE;
+        if (events & G_IO_OUT)
+            result |= UV_WRITABLE;
+        if (events & G_IO_PRI)
+            result |= UV_PRIORITIZED;
+        // errors and hangups are always reported by epoll; without any bit
+        // uv_poll_start would stop watching the fd altogether
+        return result != 0 ? result : UV_DISCONNECT;
+    }
+
+    gushort to_glib_events(int events)
+    {
+        gushort result = 0;
+        if (events & UV_READABLE)
+            result |= G_IO_IN;
+        if (events & UV_WRITABLE)
+            result |= G_IO_OUT;
+        if (events & UV_PRIORITIZED)
+            result |= G_IO_PRI;
+        if (events & UV_DISCONNECT)
+            result |= G_IO_HUP;
+        return result;
+    }
+
+    void on_poll(uv_poll_t *handle, int status, int events)
+    {
+        auto *watch = static_cast<FdWatch *>(handle->data);
+        watch->revents |= status < 0 ? static_cast<gushort>(G_IO_ERR | G_IO_HUP) : to_glib_events(events);
+    }
+
+    void close_watch(FdWatch *watch)
+    {
+        uv_poll_stop(&watch->handle);
+        uv_close(reinterpret_cast<uv_handle_t *>(&watch->handle), [](uv_handle_t *handle)
+        {
+            delete static_cast<FdWatch *>(handle->data);
+        });
+    }
+
+    // Brings the uv_poll_t set in line with what GLib just asked for. The set
+    // rarely changes between iterations, so this is usually one map lookup
+    // per fd and no syscalls.
+    void sync_watches(Bridge &b)
+    {
+        b.generation++;
+
+        std::map<int, int> wanted;
+        for (const GPollFD &fd : b.fds)
+            wanted[fd.fd] |= to_uv_events(fd.events);
+
+        for (const auto &[fd, uv_events] : wanted)
+        {
+            auto it = b.watches.find(fd);
+            FdWatch *watch = it != b.watches.end() ? it->second : nullptr;
+
+            if (!watch)
+            {
+                watch = new FdWatch();
+                if (uv_poll_init(b.loop, &watch->handle, fd) != 0)
+                {
+                    log_message(LogLevel::Warning, "sync_watches", nullptr, "libuv can't poll fd %d", fd);
+                    delete watch;
+                    continue;
+                }
+                watch->handle.data = watch;
+                uv_unref(reinterpret_cast<uv_handle_t *>(&watch->handle));
+                b.watches.emplace(fd, watch);
+            }
+
+            if (watch->uv_events != uv_events)
+            {
+                uv_poll_start(&watch->handle, uv_events, on_poll);
+                watch->uv_events = uv_events;
+            }
+            watch->seen = b.generation;
+        }
+
+        for (auto it = b.watches.begin(); it != b.watches.end();)
+        {
+            if (it->second->seen == b.generation)
+            {
+                ++it;
+                continue;
+            }
+
+            close_watch(it->second);
+            it = b.watches.erase(it);
+        }
+    }
+
+    void on_prepare(uv_prepare_t *handle)
+    {
+        Bridge &b = *static_cast<Bridge *>(handle->data);
+
+        g_main_context_prepare(b.context, &b.max_priority);
+
+        gint timeout = -1;
+        gint count;
+        while ((count = g_main_context_query(b.context, b.max_priority, &timeout, b.fds.data(),
+                                             static_cast<gint>(b.fds.size()))) > static_cast<gint>(b.fds.size()))
+        {
+            b.fds.resize(count);
+        }
+        b.fds.resize(count);
+
+        sync_watches(b);
+        for (auto &[fd, watch] : b.watches)
+            watch->revents = 0;
+
+        // wakes libuv's poll when a GLib timeout (or an already ready
+        // source, timeout 0) is due, even if no fd fires
+        if (timeout >= 0)
+            uv_timer_start(&b.timer, [](uv_timer_t *) {}, static_cast<uint64_t>(timeout), 0);
+        else
+            uv_timer_stop(&b.timer);
+    }
+
+    void on_check(uv_check_t *handle)
+    {
+        Bridge &b = *static_cast<Bridge *>(handle->data);
+
+        for (GPollFD &fd : b.fds)
+        {
+            auto it = b.watches.find(fd.fd);
+            fd.revents = it != b.watches.end()
+                             ? static_cast<gushort>(it->second->revents & (fd.events | G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+                             : 0;
+        }
+
+        if (g_main_context_check(b.context, b.max_priority, b.fds.data(), static_cast<gint>(b.fds.size())))
+        {
+            TRACE_SPAN("g_main_context_dispatch");
+            b.dispatches++;
+            g_main_context_dispatch(b.context);
+        }
+    }
+}
+
+bool attach_glib_to_uv(uv_loop_t *loop, std::string &error)
+{
+    if (bridge)
+        return true;
+
+    GMainContext *context = g_main_context_default();
+    if (!g_main_context_acquire(context))
+    {
+        error = "The default GMainContext is already owned by another thread";
+        return false;
+    }
+
+    bridge = new Bridge();
+    bridge->loop = loop;
+    bridge->context = context;
+
+    uv_prepare_init(loop, &bridge->prepare);
+    uv_check_init(loop, &bridge->check);
+    uv_timer_init(loop, &bridge->timer);
+    bridge->prepare.data = bridge;
+    bridge->check.data = bridge;
+    bridge->timer.data = bridge;
+
+    uv_unref(reinterpret_cast<uv_handle_t *>(&bridge->prepare));
+    uv_unref(reinterpret_cast<uv_handle_t *>(&bridge->check));
+    uv_unref(reinterpret_cast<uv_handle_t *>(&bridge->timer));
+
+    uv_prepare_start(&bridge->prepare, on_prepare);
+    uv_check_start(&bridge->check, on_check);
+    return true;
+}
+
+void detach_glib_from_uv()
+{
+    if (!bridge)
+        return;
+
+    Bridge *b = bridge;
+    bridge = nullptr;
+
+    uv_prepare_stop(&b->prepare);
+    uv_check_stop(&b->check);
+    uv_timer_stop(&b->timer);
+
+    for (auto &[fd, watch] : b->watches)
+        close_watch(watch);
+    b->watches.clear();
+
+    g_main_context_release(b->context);
+
+    // the three embedded handles are closed asynchronously; free the bridge
+    // once the last of them is gone
+    struct Closing
+    {
+        Bridge *bridge;
+        int remaining;
+    };
+    auto *closing = new Closing{b, 3};
+    auto on_closed = [](uv_handle_t *handle)
+    {
+        auto *state = static_cast<Closing *>(handle->data);
+        if (--state->remaining == 0)
+        {
+            delete state->bridge;
+            delete state;
+        }
+    };
+
+    b->prepare.data = closing;
+    b->check.data = closing;
+    b->timer.data = closing;
+    uv_close(reinterpret_cast<uv_handle_t *>(&b->prepare), on_closed);
+    uv_close(reinterpret_cast<uv_handle_t *>(&b->check), on_closed);
+    uv_close(reinterpret_cast<uv_handle_t *>(&b->timer), on_closed);
+}
+
+bool glib_uv_attached()
+{
+    return bridge != nullptr;
+}
+
+uint64_t glib_uv_dispatches()
+{
+    return bridge ? bridge->dispatches : 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <glib.h>
+#include <string>
+#include <uv.h>
+
+// Drives the default GMainContext from a libuv loop, for plain Node where
+// nothing else iterates it (tests, benchmarks, CI). Inside Electron,
+// Chromium's glib message pump already does, so this must not be attached
+// there.
+//
+// Each loop iteration runs GLib's prepare/query in a uv_prepare_t, mirrors
+// the fds GLib wants polled into uv_poll_t handles (one per fd, updated only
+// when the set changes), arms a uv_timer_t for GLib's timeout, and runs
+// check/dispatch in a uv_check_t after libuv has polled. Everything stays on
+// the JS thread, the same one Chromium would dispatch GLib on. The handles
+// are unref'd, so they never keep Node alive by themselves.
+bool attach_glib_to_uv(uv_loop_t *loop, std::string &error);
+void detach_glib_from_uv();
+bool glib_uv_attached();
+
+// g_main_context_dispatch calls made since attaching
+uint64_t glib_uv_dispatches();
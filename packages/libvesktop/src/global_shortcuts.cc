@@ -0,0 +1,463 @@
+#include "global_shortcuts.h"
+#include "trace.h"
+#include <algorithm>
+
+GlobalShortcutsStats &global_shortcuts_stats()
+{
+    static GlobalShortcutsStats stats;
+    return stats;
+}
+
+GlobalShortcutsClient::~GlobalShortcutsClient()
+{
+    stop();
+}
+
+const char *GlobalShortcutsClient::state_name(GlobalShortcutsState state)
+{
+    switch (state)
+    {
+    case GlobalShortcutsState::Idle:
+        return "idle";
+    case GlobalShortcutsState::CreatingSession:
+        return "creating-session";
+    case GlobalShortcutsState::Binding:
+        return "binding";
+    case GlobalShortcutsState::Bound:
+        return "bound";
+    case GlobalShortcutsState::Failed:
+        return "failed";
+    }
+    return "idle";
+}
+
+bool GlobalShortcutsClient::start(const GlobalShortcutsOptions &options, EventCallback on_event, StateCallback on_state,
+                                  std::string &error)
+{
+    stop();
+
+    event_callback = std::move(on_event);
+    state_callback = std::move(on_state);
+    context = g_main_context_new();
+    loop = g_main_loop_new(context, FALSE);
+
+    std::promise<std::string> ready;
+    std::future<std::string> result = ready.get_future();
+    thread = std::thread(&GlobalShortcutsClient::run, this, options, std::move(ready));
+
+    error = result.get();
+    if (!error.empty())
+    {
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+void GlobalShortcutsClient::stop()
+{
+    if (thread.joinable())
+    {
+        // a source rather than g_main_loop_quit, which would be lost if the
+        // loop hasn't started running yet
+        GSource *source = g_idle_source_new();
+        g_source_set_callback(
+            source,
+            [](gpointer data) -> gboolean
+            {
+                g_main_loop_quit(static_cast<GMainLoop *>(data));
+                return G_SOURCE_REMOVE;
+            },
+            loop,
+            nullptr);
+        g_source_attach(source, context);
+        g_source_unref(source);
+
+        thread.join();
+    }
+
+    if (loop)
+    {
+        g_main_loop_unref(loop);
+        loop = nullptr;
+    }
+    if (context)
+    {
+        g_main_context_unref(context);
+        context = nullptr;
+    }
+
+    event_callback = nullptr;
+    state_callback = nullptr;
+}
+
+void GlobalShortcutsClient::run(GlobalShortcutsOptions options, std::promise<std::string> ready)
+{
+    g_main_context_push_thread_default(context);
+
+    GError *error = nullptr;
+    if (options.bus_address.empty())
+    {
+        bus.reset(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
+    }
+    else
+    {
+        bus.reset(g_dbus_connection_new_for_address_sync(
+            options.bus_address.c_str(),
+            static_cast<GDBusConnectionFlags>(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                              G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr,
+            nullptr,
+            &error));
+    }
+
+    if (!bus)
+    {
+        GErrorPtr error_ptr(error);
+        ready.set_value(std::string("Failed to connect to bus: ") + (error_ptr ? error_ptr->message : "unknown error"));
+        g_main_context_pop_thread_default(context);
+        return;
+    }
+
+    // request and session paths embed our unique name: ":1.42" -> "1_42"
+    sender_token = g_dbus_connection_get_unique_name(bus.get()) + 1;
+    std::replace(sender_token.begin(), sender_token.end(), '.', '_');
+
+    cancellable.reset(g_cancellable_new());
+
+    // Subscribed here so they dispatch on this thread's context. The session
+    // is checked in the handler; match rules can't filter object path args.
+    activated_id = g_dbus_connection_signal_subscribe(
+        bus.get(), PORTAL_SERVICE, SHORTCUTS_INTERFACE, "Activated", PORTAL_PATH, nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_shortcut_signal, this, nullptr);
+    deactivated_id = g_dbus_connection_signal_subscribe(
+        bus.get(), PORTAL_SERVICE, SHORTCUTS_INTERFACE, "Deactivated", PORTAL_PATH, nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_shortcut_signal, this, nullptr);
+
+    ready.set_value({});
+
+    g_main_loop_run(loop);
+
+    teardown();
+    g_main_context_pop_thread_default(context);
+}
+
+void GlobalShortcutsClient::teardown()
+{
+    g_cancellable_cancel(cancellable.get());
+
+    if (response_id != 0)
+    {
+        g_dbus_connection_signal_unsubscribe(bus.get(), response_id);
+        response_id = 0;
+    }
+    if (activated_id != 0)
+    {
+        g_dbus_connection_signal_unsubscribe(bus.get(), activated_id);
+        activated_id = 0;
+    }
+    if (deactivated_id != 0)
+    {
+        g_dbus_connection_signal_unsubscribe(bus.get(), deactivated_id);
+        deactivated_id = 0;
+    }
+
+    close_session();
+    // make sure Close leaves before a private connection goes away
+    g_dbus_connection_flush_sync(bus.get(), nullptr, nullptr);
+
+    // let cancelled calls complete; their callbacks bail out on CANCELLED
+    while (g_main_context_iteration(context, FALSE))
+    {
+    }
+
+    cancellable.reset();
+    bus.reset();
+}
+
+void GlobalShortcutsClient::set_state(GlobalShortcutsState state, const std::string &detail)
+{
+    if (state_callback)
+        state_callback(state, detail);
+}
+
+std::string GlobalShortcutsClient::next_token(const char *prefix)
+{
+    return std::string(prefix) + std::to_string(++token_counter);
+}
+
+std::string GlobalShortcutsClient::request_path(const std::string &token) const
+{
+    return std::string(PORTAL_PATH) + "/request/" + sender_token + "/" + token;
+}
+
+void GlobalShortcutsClient::bind(std::vector<Shortcut> new_shortcuts)
+{
+    if (!context)
+        return;
+
+    struct BindRequest
+    {
+        GlobalShortcutsClient *self;
+        std::vector<Shortcut> shortcuts;
+    };
+
+    g_main_context_invoke_full(
+        context,
+        G_PRIORITY_DEFAULT,
+        [](gpointer data) -> gboolean
+        {
+            auto *request = static_cast<BindRequest *>(data);
+            auto *self = request->self;
+            self->shortcuts = std::move(request->shortcuts);
+
+            self->close_session();
+            self->create_session();
+            return G_SOURCE_REMOVE;
+        },
+        new BindRequest{this, std::move(new_shortcuts)},
+        [](gpointer data) { delete static_cast<BindRequest *>(data); });
+}
+
+void GlobalShortcutsClient::await_response(const std::string &token,
+                                           void (*handler)(GlobalShortcutsClient *, guint32, GVariant *))
+{
+    // Subscribing before the call goes out means a fast portal can't answer
+    // before we listen. Only the latest request is interesting.
+    if (response_id != 0)
+        g_dbus_connection_signal_unsubscribe(bus.get(), response_id);
+
+    response_handler = handler;
+    response_id = g_dbus_connection_signal_subscribe(
+        bus.get(), PORTAL_SERVICE, REQUEST_INTERFACE, "Response", request_path(token).c_str(), nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_response, this, nullptr);
+}
+
+void GlobalShortcutsClient::on_response(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                                        const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                                        gpointer user_data)
+{
+    TRACE_SPAN("GlobalShortcutsClient::on_response");
+    (void)connection;
+    (void)sender_name;
+    (void)object_path;
+    (void)interface_name;
+    (void)signal_name;
+
+    auto *self = static_cast<GlobalShortcutsClient *>(user_data);
+
+    g_dbus_connection_signal_unsubscribe(self->bus.get(), self->response_id);
+    self->response_id = 0;
+
+    guint32 response = 2;
+    GVariant *results = nullptr;
+    g_variant_get(parameters, "(u@a{sv})", &response, &results);
+    GVariantPtr results_ptr(results);
+
+    if (auto handler = self->response_handler)
+    {
+        self->response_handler = nullptr;
+        handler(self, response, results);
+    }
+}
+
+void GlobalShortcutsClient::on_call_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GError *error = nullptr;
+    GVariantPtr reply(g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error));
+    GErrorPtr error_ptr(error);
+
+    // cancelled during teardown; self may be half torn down
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    if (!reply)
+    {
+        auto *self = static_cast<GlobalShortcutsClient *>(user_data);
+        if (self->response_id != 0)
+        {
+            g_dbus_connection_signal_unsubscribe(self->bus.get(), self->response_id);
+            self->response_id = 0;
+        }
+        self->response_handler = nullptr;
+        self->set_state(GlobalShortcutsState::Failed, error_ptr ? error_ptr->message : "unknown error");
+    }
+}
+
+void GlobalShortcutsClient::close_session()
+{
+    if (session_path.empty())
+        return;
+
+    // fire and forget, nobody waits for the reply
+    g_dbus_connection_call(
+        bus.get(),
+        PORTAL_SERVICE,
+        session_path.c_str(),
+        SESSION_INTERFACE,
+        "Close",
+        nullptr,
+        nullptr,
+        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+        -1,
+        nullptr,
+        nullptr,
+        nullptr);
+
+    session_path.clear();
+}
+
+void GlobalShortcutsClient::create_session()
+{
+    TRACE_SPAN("GlobalShortcutsClient::create_session");
+    set_state(GlobalShortcutsState::CreatingSession);
+
+    const std::string token = next_token("equibop");
+    const std::string session_token = next_token("equibop_session");
+    await_response(token, on_session_created);
+
+    GVariantBuilder options;
+    g_variant_builder_init(&options, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&options, "{sv}", "handle_token", g_variant_new_string(token.c_str()));
+    g_variant_builder_add(&options, "{sv}", "session_handle_token", g_variant_new_string(session_token.c_str()));
+
+    g_dbus_connection_call(
+        bus.get(),
+        PORTAL_SERVICE,
+        PORTAL_PATH,
+        SHORTCUTS_INTERFACE,
+        "CreateSession",
+        g_variant_new("(a{sv})", &options),
+        G_VARIANT_TYPE("(o)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        CALL_TIMEOUT_MS,
+        cancellable.get(),
+        on_call_done,
+        this);
+}
+
+void GlobalShortcutsClient::on_session_created(GlobalShortcutsClient *self, guint32 response, GVariant *results)
+{
+    if (response != 0)
+    {
+        self->set_state(GlobalShortcutsState::Failed,
+                        response == 1 ? "CreateSession was cancelled" : "CreateSession failed");
+        return;
+    }
+
+    // the spec says "s", some implementations send "o"
+    GVariantPtr handle(g_variant_lookup_value(results, "session_handle", nullptr));
+    if (!handle || !(g_variant_is_of_type(handle.get(), G_VARIANT_TYPE_STRING) ||
+                     g_variant_is_of_type(handle.get(), G_VARIANT_TYPE_OBJECT_PATH)))
+    {
+        self->set_state(GlobalShortcutsState::Failed, "CreateSession returned no session handle");
+        return;
+    }
+
+    self->session_path = g_variant_get_string(handle.get(), nullptr);
+    self->bind_shortcuts();
+}
+
+void GlobalShortcutsClient::bind_shortcuts()
+{
+    TRACE_SPAN("GlobalShortcutsClient::bind_shortcuts");
+    set_state(GlobalShortcutsState::Binding);
+
+    const std::string token = next_token("equibop");
+    await_response(token, on_shortcuts_bound);
+
+    GVariantBuilder list;
+    g_variant_builder_init(&list, G_VARIANT_TYPE("a(sa{sv})"));
+    for (const auto &shortcut : shortcuts)
+    {
+        GVariantBuilder props;
+        g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(&props, "{sv}", "description", g_variant_new_string(shortcut.description.c_str()));
+        if (!shortcut.preferred_trigger.empty())
+            g_variant_builder_add(&props, "{sv}", "preferred_trigger", g_variant_new_string(shortcut.preferred_trigger.c_str()));
+
+        g_variant_builder_add(&list, "(sa{sv})", shortcut.id.c_str(), &props);
+    }
+
+    GVariantBuilder options;
+    g_variant_builder_init(&options, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&options, "{sv}", "handle_token", g_variant_new_string(token.c_str()));
+
+    g_dbus_connection_call(
+        bus.get(),
+        PORTAL_SERVICE,
+        PORTAL_PATH,
+        SHORTCUTS_INTERFACE,
+        "BindShortcuts",
+        g_variant_new("(oa(sa{sv})sa{sv})", session_path.c_str(), &list, "", &options),
+        G_VARIANT_TYPE("(o)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        CALL_TIMEOUT_MS,
+        cancellable.get(),
+        on_call_done,
+        this);
+}
+
+void GlobalShortcutsClient::on_shortcuts_bound(GlobalShortcutsClient *self, guint32 response, GVariant *results)
+{
+    if (response != 0)
+    {
+        self->set_state(GlobalShortcutsState::Failed,
+                        response == 1 ? "BindShortcuts was cancelled" : "BindShortcuts failed");
+        return;
+    }
+
+    // report what the user actually agreed to, comma separated
+    std::string bound;
+    GVariantPtr list(g_variant_lookup_value(results, "shortcuts", G_VARIANT_TYPE("a(sa{sv})")));
+    if (list)
+    {
+        GVariantIter iter;
+        const gchar *id;
+        g_variant_iter_init(&iter, list.get());
+        while (g_variant_iter_next(&iter, "(&s@a{sv})", &id, nullptr))
+        {
+            if (!bound.empty())
+                bound += ",";
+            bound += id;
+        }
+    }
+
+    self->set_state(GlobalShortcutsState::Bound, bound);
+}
+
+void GlobalShortcutsClient::on_shortcut_signal(GDBusConnection *connection, const gchar *sender_name,
+                                               const gchar *object_path, const gchar *interface_name,
+                                               const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+    TRACE_SPAN("GlobalShortcutsClient::on_shortcut_signal", signal_name);
+    (void)connection;
+    (void)sender_name;
+    (void)object_path;
+    (void)interface_name;
+
+    const uint64_t received_ns = monotonic_ns();
+    auto *self = static_cast<GlobalShortcutsClient *>(user_data);
+
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(osta{sv})")))
+        return;
+
+    // (o session, s id, t timestamp, a{sv} options); children are read in
+    // place, the options dict is never unpacked
+    const gchar *session = nullptr;
+    const gchar *id = nullptr;
+    guint64 timestamp = 0;
+    g_variant_get_child(parameters, 0, "&o", &session);
+    if (self->session_path != session)
+        return;
+    g_variant_get_child(parameters, 1, "&s", &id);
+    g_variant_get_child(parameters, 2, "t", &timestamp);
+
+    global_shortcuts_stats().events.fetch_add(1, std::memory_order_relaxed);
+
+    if (self->event_callback)
+    {
+        self->event_callback(ShortcutEvent{id, signal_name[0] == 'A', timestamp, received_ns});
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <gio/gio.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glib_ptr.h"
+#include "stats.h"
+
+struct Shortcut
+{
+    std::string id;
+    std::string description;
+    // e.g. "CTRL+SHIFT+M"; only a hint, the portal lets the user choose
+    std::string preferred_trigger;
+};
+
+struct ShortcutEvent
+{
+    std::string id;
+    bool pressed;
+    // from the portal, milliseconds on an unspecified clock
+    uint64_t timestamp;
+    // CLOCK_MONOTONIC when the signal reached us
+    uint64_t received_ns;
+};
+
+struct GlobalShortcutsOptions
+{
+    // empty for the session bus
+    std::string bus_address;
+};
+
+enum class GlobalShortcutsState
+{
+    Idle,
+    CreatingSession,
+    Binding,
+    Bound,
+    Failed,
+};
+
+struct GlobalShortcutsStats
+{
+    std::atomic<uint64_t> events{0};
+    // signal received -> JS callback running
+    LatencyStats delivery;
+};
+
+GlobalShortcutsStats &global_shortcuts_stats();
+
+// Client for org.freedesktop.portal.GlobalShortcuts. All D-Bus work happens
+// on a dedicated thread with its own GMainContext, so Activated/Deactivated
+// are handled without waiting on the JS thread or on the default main
+// context, and nothing on the way blocks on a D-Bus round trip.
+class GlobalShortcutsClient
+{
+public:
+    // both run on the portal thread
+    using EventCallback = std::function<void(ShortcutEvent &&)>;
+    using StateCallback = std::function<void(GlobalShortcutsState, const std::string &detail)>;
+
+    GlobalShortcutsClient() = default;
+    ~GlobalShortcutsClient();
+
+    GlobalShortcutsClient(const GlobalShortcutsClient &) = delete;
+    GlobalShortcutsClient &operator=(const GlobalShortcutsClient &) = delete;
+
+    bool start(const GlobalShortcutsOptions &options, EventCallback on_event, StateCallback on_state, std::string &error);
+    void stop();
+
+    // Creates a session if needed (replacing any previous one, since a
+    // session can only be bound once) and binds the shortcuts. Thread safe;
+    // the outcome is reported through the state callback.
+    void bind(std::vector<Shortcut> shortcuts);
+
+    static const char *state_name(GlobalShortcutsState state);
+
+private:
+    static constexpr const char *PORTAL_SERVICE = "org.freedesktop.portal.Desktop";
+    static constexpr const char *PORTAL_PATH = "/org/freedesktop/portal/desktop";
+    static constexpr const char *SHORTCUTS_INTERFACE = "org.freedesktop.portal.GlobalShortcuts";
+    static constexpr const char *REQUEST_INTERFACE = "org.freedesktop.portal.Request";
+    static constexpr const char *SESSION_INTERFACE = "org.freedesktop.portal.Session";
+    static constexpr gint CALL_TIMEOUT_MS = 25000;
+
+    GMainContext *context = nullptr;
+    GMainLoop *loop = nullptr;
+    std::thread thread;
+
+    // owned by the portal thread
+    GObjectPtr<GDBusConnection> bus;
+    GObjectPtr<GCancellable> cancellable;
+    std::string sender_token;
+    std::string session_path;
+    std::vector<Shortcut> shortcuts;
+    guint activated_id = 0;
+    guint deactivated_id = 0;
+    guint response_id = 0;
+    uint32_t token_counter = 0;
+
+    EventCallback event_callback;
+    StateCallback state_callback;
+
+    // sets ready to an empty string once connected, or to the error
+    void run(GlobalShortcutsOptions options, std::promise<std::string> ready);
+    void teardown();
+    void set_state(GlobalShortcutsState state, const std::string &detail = {});
+    std::string next_token(const char *prefix);
+    std::string request_path(const std::string &token) const;
+    void await_response(const std::string &token, void (*handler)(GlobalShortcutsClient *, guint32, GVariant *));
+    void close_session();
+    void create_session();
+    void bind_shortcuts();
+
+    static void on_response(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                            const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                            gpointer user_data);
+    static void on_call_done(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_session_created(GlobalShortcutsClient *self, guint32 response, GVariant *results);
+    static void on_shortcuts_bound(GlobalShortcutsClient *self, guint32 response, GVariant *results);
+    static void on_shortcut_signal(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                                   const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                                   gpointer user_data);
+
+    void (*response_handler)(GlobalShortcutsClient *, guint32, GVariant *) = nullptr;
+};
@@ -0,0 +1,265 @@
+#include "global_shortcuts_binding.h"
+#include "event_batch.h"
+#include "global_shortcuts.h"
+#include "trace.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Shared with callbacks on the portal thread; onEvents/onStateChange can
+    // swap the TSFNs while it is running.
+    struct Listeners
+    {
+        std::mutex mutex;
+        Napi::ThreadSafeFunction events;
+        Napi::ThreadSafeFunction state;
+        EventBatch<ShortcutEvent> batch;
+    };
+
+    void replace_listener(Napi::Env env, std::mutex &mutex, Napi::ThreadSafeFunction &slot, Napi::Function callback,
+                          const char *name)
+    {
+        auto tsfn = Napi::ThreadSafeFunction::New(env, callback, name, 0, 1);
+        tsfn.Unref(env);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (slot)
+            slot.Release();
+        slot = tsfn;
+    }
+}
+
+class GlobalShortcutsWrap : public Napi::ObjectWrap<GlobalShortcutsWrap>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    GlobalShortcutsWrap(const Napi::CallbackInfo &info);
+    ~GlobalShortcutsWrap();
+
+private:
+    std::unique_ptr<GlobalShortcutsClient> client;
+    std::shared_ptr<Listeners> listeners = std::make_shared<Listeners>();
+
+    bool check_alive(Napi::Env env);
+    void release();
+
+    Napi::Value Bind(const Napi::CallbackInfo &info);
+    Napi::Value OnEvents(const Napi::CallbackInfo &info);
+    Napi::Value OnStateChange(const Napi::CallbackInfo &info);
+    Napi::Value Destroy(const Napi::CallbackInfo &info);
+};
+
+Napi::Function GlobalShortcutsWrap::Define(Napi::Env env)
+{
+    return DefineClass(env, "GlobalShortcuts", {
+        InstanceMethod("bind", &GlobalShortcutsWrap::Bind),
+        InstanceMethod("onEvents", &GlobalShortcutsWrap::OnEvents),
+        InstanceMethod("onStateChange", &GlobalShortcutsWrap::OnStateChange),
+        InstanceMethod("destroy", &GlobalShortcutsWrap::Destroy),
+    });
+}
+
+GlobalShortcutsWrap::GlobalShortcutsWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<GlobalShortcutsWrap>(info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && !info[0].IsObject() && !info[0].IsUndefined())
+    {
+        Napi::TypeError::New(env, "Expected (object?)").ThrowAsJavaScriptException();
+        return;
+    }
+
+    GlobalShortcutsOptions options;
+    if (info.Length() > 0 && info[0].IsObject())
+    {
+        Napi::Value address = info[0].As<Napi::Object>().Get("busAddress");
+        if (address.IsString())
+            options.bus_address = address.As<Napi::String>().Utf8Value();
+    }
+
+    auto shared = listeners;
+    auto on_event = [shared](ShortcutEvent &&event)
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        if (!shared->events || !shared->batch.push(std::move(event)))
+            return;
+
+        // first event since the last drain: schedule one JS call that takes
+        // everything queued up to the moment it runs
+        const napi_status status = shared->events.NonBlockingCall([shared](Napi::Env env, Napi::Function jsCallback)
+        {
+            TRACE_SPAN("GlobalShortcuts::events dispatch");
+            std::vector<ShortcutEvent> events = shared->batch.drain();
+            const uint64_t now = monotonic_ns();
+
+            Napi::Array array = Napi::Array::New(env, events.size());
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                const auto &event = events[i];
+                global_shortcuts_stats().delivery.record(now - event.received_ns);
+
+                Napi::Object obj = Napi::Object::New(env);
+                obj.Set("id", Napi::String::New(env, event.id));
+                obj.Set("pressed", Napi::Boolean::New(env, event.pressed));
+                obj.Set("timestamp", Napi::Number::New(env, static_cast<double>(event.timestamp)));
+                obj.Set("receivedAtMs", Napi::Number::New(env, static_cast<double>(event.received_ns) / 1e6));
+                array.Set(static_cast<uint32_t>(i), obj);
+            }
+
+            jsCallback.Call({array});
+        });
+
+        // nothing is coming to drain this batch (the TSFN is closing), so
+        // empty it rather than leave every later push thinking a drain is
+        // already scheduled
+        if (status != napi_ok)
+            shared->batch.drain();
+    };
+
+    auto on_state = [shared](GlobalShortcutsState state, const std::string &detail)
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        if (!shared->state)
+            return;
+
+        shared->state.NonBlockingCall([state, detail](Napi::Env env, Napi::Function jsCallback)
+        {
+            TRACE_SPAN("GlobalShortcuts::state dispatch");
+            jsCallback.Call({Napi::String::New(env, GlobalShortcutsClient::state_name(state)), Napi::String::New(env, detail)});
+        });
+    };
+
+    client = std::make_unique<GlobalShortcutsClient>();
+
+    std::string error;
+    if (!client->start(options, on_event, on_state, error))
+    {
+        client.reset();
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+}
+
+GlobalShortcutsWrap::~GlobalShortcutsWrap()
+{
+    release();
+}
+
+void GlobalShortcutsWrap::release()
+{
+    // join the portal thread first so nothing calls into a released TSFN
+    client.reset();
+
+    std::lock_guard<std::mutex> lock(listeners->mutex);
+    if (listeners->events)
+    {
+        listeners->events.Release();
+        listeners->events = Napi::ThreadSafeFunction();
+    }
+    if (listeners->state)
+    {
+        listeners->state.Release();
+        listeners->state = Napi::ThreadSafeFunction();
+    }
+}
+
+bool GlobalShortcutsWrap::check_alive(Napi::Env env)
+{
+    if (client)
+        return true;
+
+    Napi::Error::New(env, "GlobalShortcuts has been destroyed").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value GlobalShortcutsWrap::Bind(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsArray())
+    {
+        Napi::TypeError::New(env, "Expected (array)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    Napi::Array array = info[0].As<Napi::Array>();
+    std::vector<Shortcut> shortcuts;
+
+    for (uint32_t i = 0; i < array.Length(); i++)
+    {
+        Napi::Value value = array.Get(i);
+        if (!value.IsObject())
+            continue;
+
+        Napi::Object obj = value.As<Napi::Object>();
+        if (!obj.Get("id").IsString())
+        {
+            Napi::TypeError::New(env, "Shortcut id must be a string").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Shortcut shortcut;
+        shortcut.id = obj.Get("id").As<Napi::String>().Utf8Value();
+        shortcut.description = obj.Get("description").IsString() ? obj.Get("description").As<Napi::String>().Utf8Value() : shortcut.id;
+        if (obj.Get("preferredTrigger").IsString())
+            shortcut.preferred_trigger = obj.Get("preferredTrigger").As<Napi::String>().Utf8Value();
+
+        shortcuts.push_back(std::move(shortcut));
+    }
+
+    client->bind(std::move(shortcuts));
+    return env.Undefined();
+}
+
+Napi::Value GlobalShortcutsWrap::OnEvents(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_listener(env, listeners->mutex, listeners->events, info[0].As<Napi::Function>(), "GlobalShortcutsEvents");
+    return env.Undefined();
+}
+
+Napi::Value GlobalShortcutsWrap::OnStateChange(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_listener(env, listeners->mutex, listeners->state, info[0].As<Napi::Function>(), "GlobalShortcutsState");
+    return env.Undefined();
+}
+
+Napi::Value GlobalShortcutsWrap::Destroy(const Napi::CallbackInfo &info)
+{
+    release();
+    return info.Env().Undefined();
+}
+
+void InitGlobalShortcutsBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("GlobalShortcuts", GlobalShortcutsWrap::Define(env));
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Exposes the GlobalShortcuts portal client to JS as a class.
+void InitGlobalShortcutsBinding(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,200 @@
+#include "icon_tint.h"
+#include "pixmap.h"
+#include "trace.h"
+
+namespace
+{
+    // four pixels per step in 128-bit vectors, which every x86-64 (SSE2) and
+    // arm64 (NEON) target has, so the compiler lowers this without intrinsics
+    constexpr size_t LANES = 4;
+    typedef int32_t i32x4 __attribute__((vector_size(LANES * sizeof(int32_t))));
+
+    // Rec. 601 weights in 8.8 fixed point; they sum to 256, so the luma of
+    // (accent - accent luma) is zero
+    constexpr int32_t LUMA_R = 77;
+    constexpr int32_t LUMA_G = 150;
+    constexpr int32_t LUMA_B = 29;
+
+    template <typename T>
+    inline T luma(T r, T g, T b)
+    {
+        return (LUMA_R * r + LUMA_G * g + LUMA_B * b + 128) >> 8;
+    }
+
+    // x / 255 rounded, valid for |x| <= 255 * 255
+    template <typename T>
+    inline T div255(T x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    template <typename T>
+    inline T clamp_vec(T value, T low, T high)
+    {
+        T below = value < low;
+        value = (value & ~below) | (low & below);
+        T above = value > high;
+        return (value & ~above) | (high & above);
+    }
+
+    inline int32_t clamp_scalar(int32_t value, int32_t low, int32_t high)
+    {
+        return value < low ? low : value > high ? high : value;
+    }
+}
+
+void tint_premultiplied_argb(uint8_t *argb, size_t pixel_count, uint32_t accent_rgb, IconScheme scheme)
+{
+    const int32_t accent_r = (accent_rgb >> 16) & 0xff;
+    const int32_t accent_g = (accent_rgb >> 8) & 0xff;
+    const int32_t accent_b = accent_rgb & 0xff;
+    const int32_t accent_luma = luma(accent_r, accent_g, accent_b);
+
+    const int32_t chroma_r = accent_r - accent_luma;
+    const int32_t chroma_g = accent_g - accent_luma;
+    const int32_t chroma_b = accent_b - accent_luma;
+    const bool invert = scheme == IconScheme::Light;
+
+    size_t i = 0;
+    for (; i + LANES <= pixel_count; i += LANES)
+    {
+        uint8_t *block = argb + i * 4;
+
+        i32x4 a, r, g, b;
+        for (size_t k = 0; k < LANES; k++)
+        {
+            a[k] = block[k * 4];
+            r[k] = block[k * 4 + 1];
+            g[k] = block[k * 4 + 2];
+            b[k] = block[k * 4 + 3];
+        }
+
+        // premultiplied luma, so it is already bounded by alpha
+        i32x4 y = luma(r, g, b);
+        if (invert)
+            y = a - y;
+
+        const i32x4 zero = {};
+        r = clamp_vec(y + div255(a * chroma_r), zero, a);
+        g = clamp_vec(y + div255(a * chroma_g), zero, a);
+        b = clamp_vec(y + div255(a * chroma_b), zero, a);
+
+        for (size_t k = 0; k < LANES; k++)
+        {
+            block[k * 4 + 1] = static_cast<uint8_t>(r[k]);
+            block[k * 4 + 2] = static_cast<uint8_t>(g[k]);
+            block[k * 4 + 3] = static_cast<uint8_t>(b[k]);
+        }
+    }
+
+    for (; i < pixel_count; i++)
+    {
+        uint8_t *px = argb + i * 4;
+        const int32_t a = px[0];
+
+        int32_t y = luma<int32_t>(px[1], px[2], px[3]);
+        if (invert)
+            y = a - y;
+
+        px[1] = static_cast<uint8_t>(clamp_scalar(y + div255(a * chroma_r), 0, a));
+        px[2] = static_cast<uint8_t>(clamp_scalar(y + div255(a * chroma_g), 0, a));
+        px[3] = static_cast<uint8_t>(clamp_scalar(y + div255(a * chroma_b), 0, a));
+    }
+}
+
+void IconTintCache::set_source(const std::string &variant, std::vector<uint8_t> pixmap)
+{
+    auto source = std::make_shared<const std::vector<uint8_t>>(std::move(pixmap));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    sources[variant] = std::move(source);
+
+    for (auto it = tinted.begin(); it != tinted.end();)
+    {
+        if (std::get<0>(it->first) == variant)
+            it = tinted.erase(it);
+        else
+            ++it;
+    }
+}
+
+IconTintCache::PixmapPtr IconTintCache::get(const std::string &variant, IconTintKey key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = tinted.find({variant, key.accent_rgb, key.scheme});
+    return it != tinted.end() ? it->second : nullptr;
+}
+
+size_t IconTintCache::retint(IconTintKey key)
+{
+    TRACE_SPAN("IconTintCache::retint");
+    struct Job
+    {
+        std::string variant;
+        PixmapPtr source;
+        PixmapPtr result;
+    };
+
+    std::vector<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // the old theme won't be shown again
+        for (auto it = tinted.begin(); it != tinted.end();)
+        {
+            if (std::get<1>(it->first) != key.accent_rgb || std::get<2>(it->first) != key.scheme)
+                it = tinted.erase(it);
+            else
+                ++it;
+        }
+
+        for (const auto &entry : sources)
+        {
+            if (tinted.count({entry.first, key.accent_rgb, key.scheme}) == 0)
+                jobs.push_back({entry.first, entry.second, nullptr});
+        }
+    }
+
+    // the pixel work happens without the lock, so get() never waits on it
+    for (auto &job : jobs)
+    {
+        if (job.source->size() < PIXMAP_HEADER_SIZE)
+            continue;
+
+        auto copy = std::make_shared<std::vector<uint8_t>>(*job.source);
+        tint_premultiplied_argb(copy->data() + PIXMAP_HEADER_SIZE, (copy->size() - PIXMAP_HEADER_SIZE) / 4,
+                                key.accent_rgb, key.scheme);
+        job.result = std::move(copy);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t stored = 0;
+    for (auto &job : jobs)
+    {
+        // a source replaced while we worked has to be tinted again
+        auto source = sources.find(job.variant);
+        if (!job.result || source == sources.end() || source->second != job.source)
+            continue;
+
+        tinted[{job.variant, key.accent_rgb, key.scheme}] = std::move(job.result);
+        stored++;
+    }
+
+    return stored;
+}
+
+void IconTintCache::clear_tinted()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tinted.clear();
+}
+
+size_t IconTintCache::tinted_bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = 0;
+    for (const auto &entry : tinted)
+        bytes += entry.second->size();
+    return bytes;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+enum class IconScheme : uint8_t
+{
+    // light glyphs on a dark panel, the way tray icons are usually drawn
+    Dark,
+    // glyph luminance is inverted so the icon stays readable on a light panel
+    Light,
+};
+
+// Recolors premultiplied ARGB32 (A, R, G, B byte order) in place. Each
+// pixel keeps its luminance and alpha and takes the accent's chroma: the
+// accent minus its own luma is added, scaled by alpha, which leaves the
+// pixel's luma unchanged except where the result has to be clamped.
+void tint_premultiplied_argb(uint8_t *argb, size_t pixel_count, uint32_t accent_rgb, IconScheme scheme);
+
+struct IconTintKey
+{
+    uint32_t accent_rgb;
+    IconScheme scheme;
+};
+
+// Source pixmaps per tray variant plus their tinted copies for one
+// (accent, scheme) at a time. Thread-safe: retint() is meant to run on a
+// worker thread while the JS thread keeps calling get().
+class IconTintCache
+{
+public:
+    using PixmapPtr = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // pixmap is in the serialized [w][h][ARGB] layout from pixmap.h
+    void set_source(const std::string &variant, std::vector<uint8_t> pixmap);
+
+    // nullptr until retint() has run for this key
+    PixmapPtr get(const std::string &variant, IconTintKey key) const;
+
+    // Tints every source that has no copy for key yet and drops copies made
+    // for any other key. Returns how many variants were tinted.
+    size_t retint(IconTintKey key);
+
+    void clear_tinted();
+    size_t tinted_bytes() const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, PixmapPtr> sources;
+    std::map<std::tuple<std::string, uint32_t, IconScheme>, PixmapPtr> tinted;
+};
@@ -0,0 +1,158 @@
+#include "icon_tint_binding.h"
+#include "icon_tint.h"
+#include "memory_monitor.h"
+#include <memory>
+#include <string>
+
+namespace
+{
+    bool parse_scheme(const Napi::Value &value, IconScheme &scheme)
+    {
+        if (!value.IsString())
+            return false;
+
+        std::string name = value.As<Napi::String>().Utf8Value();
+        if (name == "dark")
+            scheme = IconScheme::Dark;
+        else if (name == "light")
+            scheme = IconScheme::Light;
+        else
+            return false;
+        return true;
+    }
+
+    class RetintWorker : public Napi::AsyncWorker
+    {
+    public:
+        RetintWorker(Napi::Env env, std::shared_ptr<IconTintCache> cache, IconTintKey key)
+            : Napi::AsyncWorker(env, "RetintWorker"),
+              deferred(Napi::Promise::Deferred::New(env)),
+              cache(std::move(cache)),
+              key(key)
+        {
+        }
+
+        Napi::Promise GetPromise() const { return deferred.Promise(); }
+
+    protected:
+        void Execute() override
+        {
+            tinted = cache->retint(key);
+        }
+
+        void OnOK() override
+        {
+            deferred.Resolve(Napi::Number::New(Env(), static_cast<double>(tinted)));
+        }
+
+        void OnError(const Napi::Error &error) override
+        {
+            deferred.Reject(error.Value());
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        std::shared_ptr<IconTintCache> cache;
+        IconTintKey key;
+        size_t tinted = 0;
+    };
+}
+
+class TrayIconTintsWrap : public Napi::ObjectWrap<TrayIconTintsWrap>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    TrayIconTintsWrap(const Napi::CallbackInfo &info);
+    ~TrayIconTintsWrap();
+
+private:
+    // shared with in-flight workers, which may outlive the JS object
+    std::shared_ptr<IconTintCache> cache = std::make_shared<IconTintCache>();
+    guint trimmer_id = 0;
+
+    Napi::Value SetSource(const Napi::CallbackInfo &info);
+    Napi::Value Retint(const Napi::CallbackInfo &info);
+    Napi::Value Get(const Napi::CallbackInfo &info);
+};
+
+Napi::Function TrayIconTintsWrap::Define(Napi::Env env)
+{
+    return DefineClass(env, "TrayIconTints", {
+        InstanceMethod("setSource", &TrayIconTintsWrap::SetSource),
+        InstanceMethod("retint", &TrayIconTintsWrap::Retint),
+        InstanceMethod("get", &TrayIconTintsWrap::Get),
+    });
+}
+
+TrayIconTintsWrap::TrayIconTintsWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<TrayIconTintsWrap>(info)
+{
+    // get() returns null until the next retint, and callers fall back to
+    // the untinted icon, so this only goes when things are critical
+    IconTintCache *raw = cache.get();
+    trimmer_id = MemoryMonitor::instance().add_trimmer("icon-tints", MemoryPressure::Critical,
+                                                       [raw]() { raw->clear_tinted(); });
+}
+
+TrayIconTintsWrap::~TrayIconTintsWrap()
+{
+    MemoryMonitor::instance().remove_trimmer(trimmer_id);
+}
+
+Napi::Value TrayIconTintsWrap::SetSource(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsBuffer())
+    {
+        Napi::TypeError::New(env, "Expected (string, Buffer)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Buffer<uint8_t> buffer = info[1].As<Napi::Buffer<uint8_t>>();
+    cache->set_source(info[0].As<Napi::String>().Utf8Value(),
+                      std::vector<uint8_t>(buffer.Data(), buffer.Data() + buffer.Length()));
+    return env.Undefined();
+}
+
+Napi::Value TrayIconTintsWrap::Retint(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    IconScheme scheme;
+    if (info.Length() < 2 || !info[0].IsNumber() || !parse_scheme(info[1], scheme))
+    {
+        Napi::TypeError::New(env, "Expected (number, \"dark\" | \"light\")").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto *worker = new RetintWorker(env, cache, {info[0].As<Napi::Number>().Uint32Value() & 0xffffff, scheme});
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+Napi::Value TrayIconTintsWrap::Get(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    IconScheme scheme;
+    if (info.Length() < 3 || !info[0].IsString() || !info[1].IsNumber() || !parse_scheme(info[2], scheme))
+    {
+        Napi::TypeError::New(env, "Expected (string, number, \"dark\" | \"light\")").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto pixmap = cache->get(info[0].As<Napi::String>().Utf8Value(),
+                             {info[1].As<Napi::Number>().Uint32Value() & 0xffffff, scheme});
+    if (!pixmap)
+        return env.Null();
+
+    return Napi::Buffer<uint8_t>::Copy(env, pixmap->data(), pixmap->size());
+}
+
+void InitIconTintBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("TrayIconTints", TrayIconTintsWrap::Define(env));
+}
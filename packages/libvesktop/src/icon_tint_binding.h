@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Exposes the tray icon tint cache to JS as a class.
+void InitIconTintBinding(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,787 @@
+#include "image_decoder.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace
+{
+    // tray assets are tiny; anything bigger is almost certainly not meant
+    // for us and is better handled by nativeImage
+    constexpr uint32_t MAX_DIMENSION = 4096;
+
+    constexpr uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    uint32_t read_be32(const uint8_t *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    uint16_t read_le16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t read_le32(const uint8_t *p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    // MSB-first packed samples, shared by PNG scanlines and DIB rows
+    uint32_t packed_sample(const uint8_t *row, uint32_t index, uint8_t depth)
+    {
+        if (depth == 8)
+            return row[index];
+        if (depth == 16)
+            return (uint32_t(row[index * 2]) << 8) | row[index * 2 + 1];
+
+        uint32_t bit = index * depth;
+        uint8_t shift = static_cast<uint8_t>(8 - depth - (bit & 7));
+        return (row[bit >> 3] >> shift) & ((1u << depth) - 1);
+    }
+
+    uint8_t scale_to_8bit(uint32_t value, uint8_t depth)
+    {
+        if (depth == 8)
+            return static_cast<uint8_t>(value);
+        if (depth == 16)
+            return static_cast<uint8_t>(value >> 8);
+        return static_cast<uint8_t>(value * 255 / ((1u << depth) - 1));
+    }
+
+    class MappedFile
+    {
+    public:
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            if (data)
+                munmap(const_cast<uint8_t *>(data), size);
+        }
+
+        bool open(const std::string &path, std::string &error)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                error = path + ": " + std::strerror(errno);
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+            {
+                error = path + ": not a regular, non-empty file";
+                close(fd);
+                return false;
+            }
+
+            void *mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+
+            if (mapped == MAP_FAILED)
+            {
+                error = path + ": " + std::strerror(errno);
+                return false;
+            }
+
+            madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+            data = static_cast<const uint8_t *>(mapped);
+            size = static_cast<size_t>(st.st_size);
+            return true;
+        }
+    };
+
+    struct PngInfo
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint8_t bit_depth = 0;
+        uint8_t color_type = 0;
+        bool interlaced = false;
+
+        std::vector<uint8_t> palette;       // rgb triples
+        std::vector<uint8_t> palette_alpha; // from tRNS, may be shorter than the palette
+        bool has_trns_key = false;
+        uint16_t trns_key[3] = {0, 0, 0}; // gray or r, g, b
+
+        uint8_t channels() const
+        {
+            switch (color_type)
+            {
+            case 0:
+                return 1;
+            case 2:
+                return 3;
+            case 3:
+                return 1;
+            case 4:
+                return 2;
+            case 6:
+                return 4;
+            default:
+                return 0;
+            }
+        }
+
+        bool valid_depth() const
+        {
+            switch (color_type)
+            {
+            case 0:
+                return bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8 || bit_depth == 16;
+            case 3:
+                return bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8;
+            case 2:
+            case 4:
+            case 6:
+                return bit_depth == 8 || bit_depth == 16;
+            default:
+                return false;
+            }
+        }
+    };
+
+    // Inflates IDAT data as it arrives and unfilters one scanline at a time,
+    // so only two rows of filtered data are ever held in memory.
+    class PngStreamDecoder
+    {
+    public:
+        PngStreamDecoder(const PngInfo &info, Pixmap &out) : info(info), out(out) {}
+
+        ~PngStreamDecoder()
+        {
+            if (stream_initialized)
+                inflateEnd(&stream);
+        }
+
+        bool init(std::string &error)
+        {
+            std::memset(&stream, 0, sizeof(stream));
+            if (inflateInit(&stream) != Z_OK)
+            {
+                error = "failed to initialize zlib";
+                return false;
+            }
+            stream_initialized = true;
+
+            bits_per_pixel = info.channels() * info.bit_depth;
+            filter_stride = std::max(1u, bits_per_pixel / 8);
+
+            out.width = info.width;
+            out.height = info.height;
+            out.argb.assign(static_cast<size_t>(info.width) * info.height * 4, 0);
+
+            pass = info.interlaced ? 0 : NON_INTERLACED_PASS;
+            start_pass();
+            return true;
+        }
+
+        bool finished() const { return done; }
+
+        bool feed(const uint8_t *data, size_t size, std::string &error)
+        {
+            if (done)
+                return true;
+
+            stream.next_in = const_cast<Bytef *>(data);
+            stream.avail_in = static_cast<uInt>(size);
+
+            while (!done)
+            {
+                stream.next_out = scanline.data() + scanline_fill;
+                stream.avail_out = static_cast<uInt>(scanline.size() - scanline_fill);
+
+                int ret = inflate(&stream, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+                {
+                    error = stream.msg ? stream.msg : "corrupt image data";
+                    return false;
+                }
+
+                bool row_complete = stream.avail_out == 0;
+                scanline_fill = scanline.size() - stream.avail_out;
+
+                if (row_complete)
+                {
+                    if (!unfilter_row(error))
+                        return false;
+
+                    emit_row();
+                    scanline_fill = 0;
+
+                    if (++row >= pass_height)
+                    {
+                        pass++;
+                        start_pass();
+                    }
+                }
+
+                if (ret == Z_STREAM_END || !row_complete)
+                    break;
+            }
+
+            return true;
+        }
+
+    private:
+        static constexpr int NON_INTERLACED_PASS = 7;
+
+        // Adam7, plus a trailing entry describing a non-interlaced image
+        static constexpr uint8_t PASS_START_ROW[8] = {0, 0, 4, 0, 2, 0, 1, 0};
+        static constexpr uint8_t PASS_START_COL[8] = {0, 4, 0, 2, 0, 1, 0, 0};
+        static constexpr uint8_t PASS_ROW_STEP[8] = {8, 8, 8, 4, 4, 2, 2, 1};
+        static constexpr uint8_t PASS_COL_STEP[8] = {8, 8, 4, 4, 2, 2, 1, 1};
+
+        const PngInfo &info;
+        Pixmap &out;
+        z_stream stream;
+        bool stream_initialized = false;
+        bool done = false;
+
+        uint32_t bits_per_pixel = 0;
+        uint32_t filter_stride = 0;
+
+        int pass = 0;
+        uint32_t pass_width = 0;
+        uint32_t pass_height = 0;
+        uint32_t row = 0;
+
+        std::vector<uint8_t> scanline; // filter byte + row data
+        std::vector<uint8_t> previous;
+        size_t scanline_fill = 0;
+
+        void start_pass()
+        {
+            // interlaced images end after pass 6, plain ones after their single pass
+            for (; pass <= NON_INTERLACED_PASS; pass++)
+            {
+                if (pass == NON_INTERLACED_PASS && info.interlaced)
+                    break;
+
+                uint32_t start_col = PASS_START_COL[pass];
+                uint32_t start_row = PASS_START_ROW[pass];
+                pass_width = info.width > start_col ? (info.width - start_col + PASS_COL_STEP[pass] - 1) / PASS_COL_STEP[pass] : 0;
+                pass_height = info.height > start_row ? (info.height - start_row + PASS_ROW_STEP[pass] - 1) / PASS_ROW_STEP[pass] : 0;
+
+                if (pass_width == 0 || pass_height == 0)
+                    continue;
+
+                size_t row_bytes = (static_cast<size_t>(pass_width) * bits_per_pixel + 7) / 8;
+                scanline.assign(row_bytes + 1, 0);
+                previous.assign(row_bytes, 0);
+                scanline_fill = 0;
+                row = 0;
+                return;
+            }
+
+            done = true;
+        }
+
+        bool unfilter_row(std::string &error)
+        {
+            uint8_t *cur = scanline.data() + 1;
+            const uint8_t *prev = previous.data();
+            const size_t n = previous.size();
+            const size_t bpp = filter_stride;
+
+            switch (scanline[0])
+            {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = bpp; i < n; i++)
+                    cur[i] = static_cast<uint8_t>(cur[i] + cur[i - bpp]);
+                break;
+            case 2:
+                for (size_t i = 0; i < n; i++)
+                    cur[i] = static_cast<uint8_t>(cur[i] + prev[i]);
+                break;
+            case 3:
+                for (size_t i = 0; i < n; i++)
+                {
+                    uint32_t left = i >= bpp ? cur[i - bpp] : 0;
+                    cur[i] = static_cast<uint8_t>(cur[i] + ((left + prev[i]) >> 1));
+                }
+                break;
+            case 4:
+                for (size_t i = 0; i < n; i++)
+                {
+                    int a = i >= bpp ? cur[i - bpp] : 0;
+                    int b = prev[i];
+                    int c = i >= bpp ? prev[i - bpp] : 0;
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    cur[i] = static_cast<uint8_t>(cur[i] + predictor);
+                }
+                break;
+            default:
+                error = "invalid PNG filter type";
+                return false;
+            }
+
+            std::memcpy(previous.data(), cur, n);
+            return true;
+        }
+
+        void emit_row()
+        {
+            const uint8_t *src = scanline.data() + 1;
+            const uint8_t depth = info.bit_depth;
+            const uint32_t y = PASS_START_ROW[pass] + row * PASS_ROW_STEP[pass];
+            uint8_t *dst_row = out.argb.data() + static_cast<size_t>(y) * info.width * 4;
+
+            for (uint32_t i = 0; i < pass_width; i++)
+            {
+                const uint32_t x = PASS_START_COL[pass] + i * PASS_COL_STEP[pass];
+                uint8_t *dst = dst_row + static_cast<size_t>(x) * 4;
+                uint8_t r, g, b, a = 255;
+
+                switch (info.color_type)
+                {
+                case 0:
+                {
+                    uint32_t v = packed_sample(src, i, depth);
+                    r = g = b = scale_to_8bit(v, depth);
+                    if (info.has_trns_key && v == info.trns_key[0])
+                        a = 0;
+                    break;
+                }
+                case 2:
+                {
+                    uint32_t rv = packed_sample(src, i * 3, depth);
+                    uint32_t gv = packed_sample(src, i * 3 + 1, depth);
+                    uint32_t bv = packed_sample(src, i * 3 + 2, depth);
+                    r = scale_to_8bit(rv, depth);
+                    g = scale_to_8bit(gv, depth);
+                    b = scale_to_8bit(bv, depth);
+                    if (info.has_trns_key && rv == info.trns_key[0] && gv == info.trns_key[1] && bv == info.trns_key[2])
+                        a = 0;
+                    break;
+                }
+                case 3:
+                {
+                    uint32_t index = packed_sample(src, i, depth);
+                    if (index * 3 + 2 < info.palette.size())
+                    {
+                        r = info.palette[index * 3];
+                        g = info.palette[index * 3 + 1];
+                        b = info.palette[index * 3 + 2];
+                    }
+                    else
+                    {
+                        r = g = b = 0;
+                    }
+                    if (index < info.palette_alpha.size())
+                        a = info.palette_alpha[index];
+                    break;
+                }
+                case 4:
+                    r = g = b = scale_to_8bit(packed_sample(src, i * 2, depth), depth);
+                    a = scale_to_8bit(packed_sample(src, i * 2 + 1, depth), depth);
+                    break;
+                default: // 6
+                    r = scale_to_8bit(packed_sample(src, i * 4, depth), depth);
+                    g = scale_to_8bit(packed_sample(src, i * 4 + 1, depth), depth);
+                    b = scale_to_8bit(packed_sample(src, i * 4 + 2, depth), depth);
+                    a = scale_to_8bit(packed_sample(src, i * 4 + 3, depth), depth);
+                    break;
+                }
+
+                store_premultiplied_argb(dst, r, g, b, a);
+            }
+        }
+    };
+
+    bool chunk_is(const uint8_t *type, const char *name)
+    {
+        return std::memcmp(type, name, 4) == 0;
+    }
+
+    bool decode_dib(const uint8_t *data, size_t size, Pixmap &out, std::string &error)
+    {
+        if (size < 40)
+        {
+            error = "truncated ICO bitmap";
+            return false;
+        }
+
+        uint32_t header_size = read_le32(data);
+        int32_t width = static_cast<int32_t>(read_le32(data + 4));
+        int32_t stacked_height = static_cast<int32_t>(read_le32(data + 8));
+        uint16_t bpp = read_le16(data + 14);
+        uint32_t compression = read_le32(data + 16);
+        uint32_t colors_used = read_le32(data + 32);
+
+        if (header_size < 40 || header_size > size)
+        {
+            error = "invalid ICO bitmap header";
+            return false;
+        }
+
+        // the height covers both the colour bitmap and the AND mask
+        bool top_down = stacked_height < 0;
+        uint32_t height = static_cast<uint32_t>(top_down ? -static_cast<int64_t>(stacked_height) : stacked_height) / 2;
+
+        if (width <= 0 || height == 0 || static_cast<uint32_t>(width) > MAX_DIMENSION || height > MAX_DIMENSION)
+        {
+            error = "invalid ICO bitmap dimensions";
+            return false;
+        }
+
+        if (bpp != 1 && bpp != 4 && bpp != 8 && bpp != 24 && bpp != 32)
+        {
+            error = "unsupported ICO bit depth";
+            return false;
+        }
+
+        if (compression != 0 && !(compression == 3 && bpp == 32))
+        {
+            error = "unsupported ICO bitmap compression";
+            return false;
+        }
+
+        size_t palette_entries = 0;
+        if (bpp <= 8)
+            palette_entries = std::min<size_t>(colors_used ? colors_used : (1u << bpp), 256);
+
+        size_t palette_offset = header_size + (compression == 3 && header_size == 40 ? 12 : 0);
+        size_t pixel_offset = palette_offset + palette_entries * 4;
+
+        const size_t w = static_cast<size_t>(width);
+        const size_t xor_stride = ((w * bpp + 31) / 32) * 4;
+        const size_t and_stride = ((w + 31) / 32) * 4;
+
+        if (pixel_offset > size || xor_stride * height > size - pixel_offset)
+        {
+            error = "truncated ICO bitmap";
+            return false;
+        }
+
+        const uint8_t *palette = data + palette_offset;
+        const uint8_t *xor_bits = data + pixel_offset;
+        const uint8_t *and_bits = xor_bits + xor_stride * height;
+        const bool has_mask = and_stride * height <= size - pixel_offset - xor_stride * height;
+
+        // 32bpp icons normally carry real alpha, but old ones leave it zeroed
+        // and rely on the AND mask instead
+        bool use_alpha = false;
+        if (bpp == 32)
+        {
+            for (size_t r = 0; r < height && !use_alpha; r++)
+            {
+                const uint8_t *row = xor_bits + r * xor_stride;
+                for (size_t x = 0; x < w; x++)
+                {
+                    if (row[x * 4 + 3] != 0)
+                    {
+                        use_alpha = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        out.width = static_cast<uint32_t>(width);
+        out.height = height;
+        out.argb.assign(w * height * 4, 0);
+
+        for (size_t r = 0; r < height; r++)
+        {
+            const size_t y = top_down ? r : height - 1 - r;
+            const uint8_t *row = xor_bits + r * xor_stride;
+            const uint8_t *mask_row = and_bits + r * and_stride;
+            uint8_t *dst_row = out.argb.data() + y * w * 4;
+
+            for (size_t x = 0; x < w; x++)
+            {
+                uint8_t red, green, blue, alpha = 255;
+
+                if (bpp == 32)
+                {
+                    blue = row[x * 4];
+                    green = row[x * 4 + 1];
+                    red = row[x * 4 + 2];
+                    if (use_alpha)
+                        alpha = row[x * 4 + 3];
+                }
+                else if (bpp == 24)
+                {
+                    blue = row[x * 3];
+                    green = row[x * 3 + 1];
+                    red = row[x * 3 + 2];
+                }
+                else
+                {
+                    uint32_t index = packed_sample(row, static_cast<uint32_t>(x), static_cast<uint8_t>(bpp));
+                    if (index < palette_entries)
+                    {
+                        blue = palette[index * 4];
+                        green = palette[index * 4 + 1];
+                        red = palette[index * 4 + 2];
+                    }
+                    else
+                    {
+                        red = green = blue = 0;
+                    }
+                }
+
+                if (!use_alpha && has_mask && ((mask_row[x >> 3] >> (7 - (x & 7))) & 1))
+                    alpha = 0;
+
+                store_premultiplied_argb(dst_row + x * 4, red, green, blue, alpha);
+            }
+        }
+
+        return true;
+    }
+}
+
+bool decode_png(const uint8_t *data, size_t size, Pixmap &out, std::string &error)
+{
+    if (size < sizeof(PNG_SIGNATURE) || std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0)
+    {
+        error = "not a PNG file";
+        return false;
+    }
+
+    PngInfo info;
+    bool have_header = false;
+    std::unique_ptr<PngStreamDecoder> decoder;
+
+    size_t pos = sizeof(PNG_SIGNATURE);
+    while (pos + 12 <= size)
+    {
+        uint32_t length = read_be32(data + pos);
+        const uint8_t *type = data + pos + 4;
+        const uint8_t *body = data + pos + 8;
+
+        if (length > size - pos - 12)
+        {
+            error = "truncated PNG chunk";
+            return false;
+        }
+        pos += 12 + static_cast<size_t>(length);
+
+        if (chunk_is(type, "IHDR"))
+        {
+            if (length != 13 || have_header)
+            {
+                error = "invalid PNG header";
+                return false;
+            }
+
+            info.width = read_be32(body);
+            info.height = read_be32(body + 4);
+            info.bit_depth = body[8];
+            info.color_type = body[9];
+            info.interlaced = body[12] == 1;
+
+            if (info.width == 0 || info.height == 0 || info.width > MAX_DIMENSION || info.height > MAX_DIMENSION)
+            {
+                error = "unsupported PNG dimensions";
+                return false;
+            }
+
+            if (!info.valid_depth() || body[10] != 0 || body[11] != 0 || body[12] > 1)
+            {
+                error = "unsupported PNG format";
+                return false;
+            }
+
+            have_header = true;
+        }
+        else if (chunk_is(type, "PLTE"))
+        {
+            if (length % 3 != 0 || length > 768)
+            {
+                error = "invalid PNG palette";
+                return false;
+            }
+            info.palette.assign(body, body + length);
+        }
+        else if (chunk_is(type, "tRNS"))
+        {
+            if (info.color_type == 3)
+            {
+                info.palette_alpha.assign(body, body + std::min<uint32_t>(length, 256));
+            }
+            else if (info.color_type == 0 && length >= 2)
+            {
+                info.has_trns_key = true;
+                info.trns_key[0] = static_cast<uint16_t>((body[0] << 8) | body[1]);
+            }
+            else if (info.color_type == 2 && length >= 6)
+            {
+                info.has_trns_key = true;
+                for (int i = 0; i < 3; i++)
+                    info.trns_key[i] = static_cast<uint16_t>((body[i * 2] << 8) | body[i * 2 + 1]);
+            }
+        }
+        else if (chunk_is(type, "IDAT"))
+        {
+            if (!have_header)
+            {
+                error = "PNG data before header";
+                return false;
+            }
+
+            if (!decoder)
+            {
+                if (info.color_type == 3 && info.palette.empty())
+                {
+                    error = "missing PNG palette";
+                    return false;
+                }
+
+                decoder = std::make_unique<PngStreamDecoder>(info, out);
+                if (!decoder->init(error))
+                    return false;
+            }
+
+            if (!decoder->feed(body, length, error))
+                return false;
+        }
+        else if (chunk_is(type, "IEND"))
+        {
+            break;
+        }
+        else if ((type[0] & 0x20) == 0)
+        {
+            error = "unsupported critical PNG chunk";
+            return false;
+        }
+    }
+
+    if (!decoder || !decoder->finished())
+    {
+        error = "truncated PNG image data";
+        return false;
+    }
+
+    return true;
+}
+
+bool decode_ico(const uint8_t *data, size_t size, uint32_t preferred_size, Pixmap &out, std::string &error)
+{
+    if (size < 6 || read_le16(data) != 0 || (read_le16(data + 2) != 1 && read_le16(data + 2) != 2))
+    {
+        error = "not an ICO file";
+        return false;
+    }
+
+    const uint16_t count = read_le16(data + 4);
+    if (count == 0 || 6 + static_cast<size_t>(count) * 16 > size)
+    {
+        error = "truncated ICO directory";
+        return false;
+    }
+
+    // no preference means "as large as possible"
+    if (preferred_size == 0)
+        preferred_size = UINT32_MAX;
+
+    struct Entry
+    {
+        uint32_t size;
+        uint16_t bits;
+        uint32_t length;
+        uint32_t offset;
+    };
+
+    bool found = false;
+    Entry best{};
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const uint8_t *e = data + 6 + static_cast<size_t>(i) * 16;
+        Entry candidate{
+            std::max<uint32_t>(e[0] ? e[0] : 256, e[1] ? e[1] : 256),
+            read_le16(e + 6),
+            read_le32(e + 8),
+            read_le32(e + 12)};
+
+        if (candidate.offset > size || candidate.length > size - candidate.offset || candidate.length == 0)
+            continue;
+
+        if (!found)
+        {
+            best = candidate;
+            found = true;
+            continue;
+        }
+
+        // smallest entry that still covers the preferred size, else the largest one
+        bool candidate_fits = candidate.size >= preferred_size;
+        bool best_fits = best.size >= preferred_size;
+        bool better;
+        if (candidate_fits != best_fits)
+            better = candidate_fits;
+        else if (candidate.size != best.size)
+            better = candidate_fits ? candidate.size < best.size : candidate.size > best.size;
+        else
+            better = candidate.bits > best.bits;
+
+        if (better)
+            best = candidate;
+    }
+
+    if (!found)
+    {
+        error = "ICO file has no usable images";
+        return false;
+    }
+
+    const uint8_t *entry = data + best.offset;
+    if (best.length >= sizeof(PNG_SIGNATURE) && std::memcmp(entry, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+        return decode_png(entry, best.length, out, error);
+
+    return decode_dib(entry, best.length, out, error);
+}
+
+bool decode_image(const uint8_t *data, size_t size, uint32_t preferred_size, Pixmap &out, std::string &error)
+{
+    TRACE_SPAN("decode_image");
+    if (size >= sizeof(PNG_SIGNATURE) && std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+        return decode_png(data, size, out, error);
+
+    if (size >= 4 && data[0] == 0 && data[1] == 0 && (data[2] == 1 || data[2] == 2) && data[3] == 0)
+        return decode_ico(data, size, preferred_size, out, error);
+
+    error = "unsupported image format";
+    return false;
+}
+
+bool decode_image_file(const std::string &path, uint32_t target_size, Pixmap &out, std::string &error)
+{
+    TRACE_SPAN("decode_image_file", path.c_str());
+    MappedFile file;
+    if (!file.open(path, error))
+        return false;
+
+    Pixmap decoded;
+    if (!decode_image(file.data, file.size, target_size, decoded, error))
+    {
+        error = path + ": " + error;
+        return false;
+    }
+
+    out = target_size ? scale_pixmap(decoded, target_size, target_size) : std::move(decoded);
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "pixmap.h"
+
+// Minimal PNG/ICO decoder for tray assets. Decodes straight into a
+// premultiplied ARGB32 Pixmap; anything else (jpeg, webp, svg...) is
+// reported as unsupported so callers can fall back to Electron's nativeImage.
+
+bool decode_png(const uint8_t *data, size_t size, Pixmap &out, std::string &error);
+
+// Picks the icon entry that best matches preferred_size.
+bool decode_ico(const uint8_t *data, size_t size, uint32_t preferred_size, Pixmap &out, std::string &error);
+
+// Sniffs the format from the magic bytes.
+bool decode_image(const uint8_t *data, size_t size, uint32_t preferred_size, Pixmap &out, std::string &error);
+
+// mmaps the file and decodes it. If target_size is non-zero the result is
+// resampled to target_size x target_size.
+bool decode_image_file(const std::string &path, uint32_t target_size, Pixmap &out, std::string &error);
@@ -0,0 +1,203 @@
+#include "image_encoder.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+namespace
+{
+    constexpr uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    constexpr uint8_t FILTER_SUB = 1;
+
+    void write_be32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void write_chunk(std::vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t size)
+    {
+        write_be32(out, static_cast<uint32_t>(size));
+        const size_t type_offset = out.size();
+        out.insert(out.end(), type, type + 4);
+        if (size)
+            out.insert(out.end(), data, data + size);
+
+        const uLong crc = crc32(0, out.data() + type_offset, static_cast<uInt>(size + 4));
+        write_be32(out, static_cast<uint32_t>(crc));
+    }
+
+    bool is_opaque(const Pixmap &pixmap)
+    {
+        for (size_t i = 0; i < pixmap.argb.size(); i += 4)
+        {
+            if (pixmap.argb[i] != 0xff)
+                return false;
+        }
+        return true;
+    }
+
+    // Unpremultiplied scanlines, each prefixed with the Sub filter byte
+    std::vector<uint8_t> filtered_scanlines(const Pixmap &pixmap, uint32_t channels)
+    {
+        const size_t row_size = static_cast<size_t>(pixmap.width) * channels;
+        std::vector<uint8_t> out((row_size + 1) * pixmap.height);
+        std::vector<uint8_t> row(row_size);
+
+        for (uint32_t y = 0; y < pixmap.height; y++)
+        {
+            const uint8_t *src = pixmap.argb.data() + static_cast<size_t>(y) * pixmap.width * 4;
+            for (uint32_t x = 0; x < pixmap.width; x++)
+            {
+                const uint8_t *p = src + x * 4;
+                uint8_t *q = row.data() + x * channels;
+                const uint8_t a = p[0];
+
+                if (a == 0xff)
+                {
+                    q[0] = p[1];
+                    q[1] = p[2];
+                    q[2] = p[3];
+                }
+                else if (a == 0)
+                {
+                    q[0] = q[1] = q[2] = 0;
+                }
+                else
+                {
+                    for (int ch = 0; ch < 3; ch++)
+                        q[ch] = static_cast<uint8_t>(std::min(255, (p[ch + 1] * 255 + a / 2) / a));
+                }
+                if (channels == 4)
+                    q[3] = a;
+            }
+
+            uint8_t *dst = out.data() + y * (row_size + 1);
+            dst[0] = FILTER_SUB;
+            std::memcpy(dst + 1, row.data(), channels);
+            for (size_t i = channels; i < row_size; i++)
+                dst[1 + i] = static_cast<uint8_t>(row[i] - row[i - channels]);
+        }
+
+        return out;
+    }
+}
+
+std::vector<uint8_t> encode_png(const Pixmap &pixmap)
+{
+    TRACE_SPAN("encode_png");
+    const uint32_t channels = is_opaque(pixmap) ? 3 : 4;
+    const std::vector<uint8_t> scanlines = filtered_scanlines(pixmap, channels);
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, 1, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK)
+        return {};
+
+    std::vector<uint8_t> compressed(deflateBound(&stream, scanlines.size()));
+    stream.next_in = const_cast<Bytef *>(scanlines.data());
+    stream.avail_in = static_cast<uInt>(scanlines.size());
+    stream.next_out = compressed.data();
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    const int status = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END)
+        return {};
+
+    uint8_t header[13];
+    const uint32_t dimensions[2] = {pixmap.width, pixmap.height};
+    for (int i = 0; i < 2; i++)
+    {
+        header[i * 4 + 0] = static_cast<uint8_t>(dimensions[i] >> 24);
+        header[i * 4 + 1] = static_cast<uint8_t>(dimensions[i] >> 16);
+        header[i * 4 + 2] = static_cast<uint8_t>(dimensions[i] >> 8);
+        header[i * 4 + 3] = static_cast<uint8_t>(dimensions[i]);
+    }
+    header[8] = 8;                      // bit depth
+    header[9] = channels == 4 ? 6 : 2;  // truecolour, with or without alpha
+    header[10] = 0;                     // deflate
+    header[11] = 0;                     // adaptive filtering
+    header[12] = 0;                     // not interlaced
+
+    std::vector<uint8_t> out;
+    out.reserve(sizeof(PNG_SIGNATURE) + 3 * 12 + sizeof(header) + compressed.size());
+    out.insert(out.end(), PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+    write_chunk(out, "IHDR", header, sizeof(header));
+    write_chunk(out, "IDAT", compressed.data(), compressed.size());
+    write_chunk(out, "IEND", nullptr, 0);
+    return out;
+}
+
+std::string png_data_url(const std::vector<uint8_t> &png)
+{
+    TRACE_SPAN("png_data_url");
+    static constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static constexpr char PREFIX[] = "data:image/png;base64,";
+
+    std::string out;
+    out.reserve(sizeof(PREFIX) - 1 + (png.size() + 2) / 3 * 4);
+    out += PREFIX;
+
+    size_t i = 0;
+    for (; i + 3 <= png.size(); i += 3)
+    {
+        const uint32_t n = (uint32_t(png[i]) << 16) | (uint32_t(png[i + 1]) << 8) | png[i + 2];
+        out += ALPHABET[n >> 18];
+        out += ALPHABET[(n >> 12) & 63];
+        out += ALPHABET[(n >> 6) & 63];
+        out += ALPHABET[n & 63];
+    }
+
+    if (i < png.size())
+    {
+        const bool two = i + 1 < png.size();
+        const uint32_t n = (uint32_t(png[i]) << 16) | (two ? uint32_t(png[i + 1]) << 8 : 0);
+        out += ALPHABET[n >> 18];
+        out += ALPHABET[(n >> 12) & 63];
+        out += two ? ALPHABET[(n >> 6) & 63] : '=';
+        out += '=';
+    }
+
+    return out;
+}
+
+Pixmap pixmap_from_bgra(const uint8_t *bgra, uint32_t width, uint32_t height)
+{
+    TRACE_SPAN("pixmap_from_bgra");
+    Pixmap pixmap;
+    pixmap.width = width;
+    pixmap.height = height;
+    pixmap.argb.resize(static_cast<size_t>(width) * height * 4);
+
+    // already premultiplied, only the byte order differs
+    for (size_t i = 0; i < pixmap.argb.size(); i += 4)
+    {
+        pixmap.argb[i + 0] = bgra[i + 3];
+        pixmap.argb[i + 1] = bgra[i + 2];
+        pixmap.argb[i + 2] = bgra[i + 1];
+        pixmap.argb[i + 3] = bgra[i + 0];
+    }
+
+    return pixmap;
+}
+
+std::string encode_thumbnail(const Pixmap &pixmap, uint32_t max_width, uint32_t max_height)
+{
+    TRACE_SPAN("encode_thumbnail");
+    // what NativeImage.toDataURL returns for an empty image
+    if (pixmap.width == 0 || pixmap.height == 0)
+        return png_data_url({});
+
+    const double scale = std::min({1.0, static_cast<double>(max_width) / pixmap.width,
+                                   static_cast<double>(max_height) / pixmap.height});
+    const uint32_t width = std::max<uint32_t>(1, static_cast<uint32_t>(pixmap.width * scale + 0.5));
+    const uint32_t height = std::max<uint32_t>(1, static_cast<uint32_t>(pixmap.height * scale + 0.5));
+
+    if (width == pixmap.width && height == pixmap.height)
+        return png_data_url(encode_png(pixmap));
+    return png_data_url(encode_png(scale_pixmap(pixmap, width, height)));
+}
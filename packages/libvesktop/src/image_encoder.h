@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "pixmap.h"
+
+// Fast PNG encoding for previews that are decoded once and thrown away, like
+// the screen-share picker thumbnails. Rows use the Sub filter and zlib's RLE
+// strategy at level 1: repeated pixels turn into runs of zeros that RLE
+// catches, which is most of what a screenshot compresses down to, at a small
+// fraction of the time a full deflate search takes.
+
+// Opaque images are written as RGB, anything with transparency as RGBA.
+std::vector<uint8_t> encode_png(const Pixmap &pixmap);
+
+std::string png_data_url(const std::vector<uint8_t> &png);
+
+// Wraps premultiplied BGRA rows (what Electron's NativeImage.toBitmap returns
+// on little-endian machines) as a Pixmap.
+Pixmap pixmap_from_bgra(const uint8_t *bgra, uint32_t width, uint32_t height);
+
+// Scales into max_width x max_height, keeping the aspect ratio and never
+// enlarging, and encodes the result as a PNG data URL.
+std::string encode_thumbnail(const Pixmap &pixmap, uint32_t max_width, uint32_t max_height);
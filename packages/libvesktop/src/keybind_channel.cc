@@ -0,0 +1,414 @@
+#include "keybind_channel.h"
+#include "native_log.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    struct CommandName
+    {
+        const char *name;
+        KeybindCommand command;
+    };
+
+    constexpr CommandName COMMAND_NAMES[] = {
+        {"VCD_TOGGLE_SELF_MUTE", KeybindCommand::ToggleSelfMute},
+        {"VCD_TOGGLE_SELF_DEAF", KeybindCommand::ToggleSelfDeaf},
+        {"toggle-mic", KeybindCommand::ToggleSelfMute},
+        {"toggle-mute", KeybindCommand::ToggleSelfMute},
+        {"toggle-deafen", KeybindCommand::ToggleSelfDeaf},
+    };
+
+    bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0';
+    }
+
+    std::string errno_message(const char *what)
+    {
+        return std::string(what) + ": " + std::strerror(errno);
+    }
+}
+
+bool parse_keybind_command(const char *data, size_t length, KeybindCommand &out)
+{
+    while (length > 0 && is_space(data[0]))
+    {
+        data++;
+        length--;
+    }
+    while (length > 0 && is_space(data[length - 1]))
+        length--;
+
+    for (const auto &entry : COMMAND_NAMES)
+    {
+        if (std::strlen(entry.name) == length && std::memcmp(entry.name, data, length) == 0)
+        {
+            out = entry.command;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *keybind_command_event(KeybindCommand command)
+{
+    switch (command)
+    {
+    case KeybindCommand::ToggleSelfMute:
+        return "VCD_TOGGLE_SELF_MUTE";
+    case KeybindCommand::ToggleSelfDeaf:
+        return "VCD_TOGGLE_SELF_DEAF";
+    }
+    return "";
+}
+
+KeybindStats &keybind_stats()
+{
+    static KeybindStats stats;
+    return stats;
+}
+
+KeybindChannel::~KeybindChannel()
+{
+    stop();
+}
+
+bool KeybindChannel::start(const KeybindChannelOptions &options, Callback cb, std::string &error)
+{
+    stop();
+
+    callback = std::move(cb);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd < 0 || wake_fd < 0)
+    {
+        error = errno_message("Failed to create epoll instance");
+        stop();
+        return false;
+    }
+
+    if (!watch(wake_fd, error) || (!options.fifo_path.empty() && !open_fifo(options.fifo_path, error)))
+    {
+        stop();
+        return false;
+    }
+
+    // The abstract namespace is shared by the whole network namespace, so
+    // someone else may already hold the name. The FIFO alone is enough then.
+    if (!options.socket_name.empty() && !open_socket(options.socket_name, error))
+    {
+        if (fifo_fd < 0)
+        {
+            stop();
+            return false;
+        }
+
+        log_message(LogLevel::Warning, "KeybindChannel::start", nullptr, "%s, using the FIFO only", error.c_str());
+        error.clear();
+    }
+
+    thread = std::thread(&KeybindChannel::run, this);
+    return true;
+}
+
+void KeybindChannel::stop()
+{
+    if (thread.joinable())
+    {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0)
+        {
+            log_message(LogLevel::Error, "KeybindChannel::stop", nullptr, "Failed to wake epoll thread: %s", std::strerror(errno));
+        }
+        thread.join();
+    }
+
+    for (auto &entry : pending_input)
+    {
+        if (entry.first != fifo_fd)
+            close(entry.first);
+    }
+    pending_input.clear();
+
+    if (fifo_fd >= 0)
+    {
+        close(fifo_fd);
+        fifo_fd = -1;
+        unlink(fifo_path.c_str());
+        fifo_path.clear();
+    }
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    if (wake_fd >= 0)
+    {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+    if (epoll_fd >= 0)
+    {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+
+    callback = nullptr;
+}
+
+bool KeybindChannel::open_fifo(const std::string &path, std::string &error)
+{
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && unlink(path.c_str()) != 0)
+    {
+        error = errno_message(("Failed to remove stale " + path).c_str());
+        return false;
+    }
+
+    if (mkfifo(path.c_str(), 0600) != 0)
+    {
+        error = errno_message(("Failed to create FIFO " + path).c_str());
+        return false;
+    }
+
+    // Holding the FIFO read-write means there is always a writer, so the read
+    // side never sees EOF between commands and never has to be reopened.
+    fifo_fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fifo_fd < 0)
+    {
+        error = errno_message(("Failed to open FIFO " + path).c_str());
+        unlink(path.c_str());
+        return false;
+    }
+
+    fifo_path = path;
+    pending_input[fifo_fd];
+    return watch(fifo_fd, error);
+}
+
+bool KeybindChannel::open_socket(const std::string &name, std::string &error)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    // abstract namespace: leading NUL, no filesystem entry to clean up
+    if (name.size() + 1 > sizeof(addr.sun_path))
+    {
+        error = "Socket name too long: " + name;
+        return false;
+    }
+    std::memcpy(addr.sun_path + 1, name.data(), name.size());
+    socklen_t addr_len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        error = errno_message("Failed to create keybind socket");
+        return false;
+    }
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) != 0 || listen(listen_fd, 4) != 0 ||
+        !watch(listen_fd, error))
+    {
+        if (error.empty())
+            error = errno_message(("Failed to bind @" + name).c_str());
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool KeybindChannel::watch(int fd, std::string &error)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        error = errno_message("Failed to watch keybind fd");
+        return false;
+    }
+
+    return true;
+}
+
+void KeybindChannel::run()
+{
+    epoll_event events[8];
+
+    while (true)
+    {
+        int count = epoll_wait(epoll_fd, events, 8, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            log_message(LogLevel::Error, "KeybindChannel::run", nullptr, "epoll_wait failed: %s", std::strerror(errno));
+            return;
+        }
+
+        const uint64_t received_ns = monotonic_ns();
+
+        for (int i = 0; i < count; i++)
+        {
+            const int fd = events[i].data.fd;
+
+            if (fd == wake_fd)
+                return;
+            else if (fd == listen_fd)
+                accept_connections();
+            else if (fd == fifo_fd)
+                read_fifo(received_ns);
+            else
+                read_connection(fd, received_ns);
+        }
+    }
+}
+
+void KeybindChannel::accept_connections()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        // abstract sockets have no filesystem permissions, so check the peer
+        // is us before taking commands from it
+        ucred cred = {};
+        socklen_t cred_len = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 || cred.uid != getuid() ||
+            pending_input.size() > MAX_CONNECTIONS)
+        {
+            keybind_stats().rejected.fetch_add(1, std::memory_order_relaxed);
+            close(fd);
+            continue;
+        }
+
+        std::string error;
+        if (!watch(fd, error))
+        {
+            log_message(LogLevel::Warning, "KeybindChannel::accept_connections", nullptr, "%s", error.c_str());
+            close(fd);
+            continue;
+        }
+        pending_input[fd];
+    }
+}
+
+void KeybindChannel::read_fifo(uint64_t received_ns)
+{
+    char buffer[512];
+    std::string &pending = pending_input[fifo_fd];
+
+    while (true)
+    {
+        ssize_t n = read(fifo_fd, buffer, sizeof(buffer));
+        if (n <= 0)
+            return;
+
+        consume(pending, buffer, static_cast<size_t>(n), received_ns);
+    }
+}
+
+void KeybindChannel::read_connection(int fd, uint64_t received_ns)
+{
+    char buffer[MAX_COMMAND_LENGTH];
+
+    while (true)
+    {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            // every packet is a whole command (or newline-separated commands)
+            std::string &pending = pending_input[fd];
+            consume(pending, buffer, static_cast<size_t>(n), received_ns);
+            if (!pending.empty())
+            {
+                dispatch(pending.data(), pending.size(), received_ns);
+                pending.clear();
+            }
+            continue;
+        }
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        close_connection(fd);
+        return;
+    }
+}
+
+void KeybindChannel::close_connection(int fd)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    pending_input.erase(fd);
+    close(fd);
+}
+
+void KeybindChannel::consume(std::string &pending, const char *data, size_t length, uint64_t received_ns)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (data[i] != '\n')
+            continue;
+
+        if (pending.empty())
+        {
+            dispatch(data + start, i - start, received_ns);
+        }
+        else
+        {
+            pending.append(data + start, i - start);
+            dispatch(pending.data(), pending.size(), received_ns);
+            pending.clear();
+        }
+        start = i + 1;
+    }
+
+    pending.append(data + start, length - start);
+    if (pending.size() > MAX_COMMAND_LENGTH)
+    {
+        keybind_stats().rejected.fetch_add(1, std::memory_order_relaxed);
+        pending.clear();
+    }
+}
+
+void KeybindChannel::dispatch(const char *data, size_t length, uint64_t received_ns)
+{
+    auto &stats = keybind_stats();
+
+    KeybindCommand command;
+    if (!parse_keybind_command(data, length, command))
+    {
+        // blank lines are just `echo` noise, not worth counting
+        bool blank = true;
+        for (size_t i = 0; i < length && blank; i++)
+            blank = is_space(data[i]);
+        if (!blank)
+            stats.rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    stats.received.fetch_add(1, std::memory_order_relaxed);
+    if (callback)
+        callback(command, received_ns);
+    stats.native.record(monotonic_ns() - received_ns);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include "stats.h"
+
+enum class KeybindCommand
+{
+    ToggleSelfMute,
+    ToggleSelfDeaf,
+};
+
+// Accepts the IPC event names keybinds.ts has always used plus the CLI
+// spellings (toggle-mic, toggle-deafen), surrounded by optional whitespace.
+bool parse_keybind_command(const char *data, size_t length, KeybindCommand &out);
+// The IpcEvents value the renderer listens for.
+const char *keybind_command_event(KeybindCommand command);
+
+struct KeybindStats
+{
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> rejected{0};
+    // receive -> handed to the ThreadSafeFunction
+    LatencyStats native;
+    // receive -> JS callback running
+    LatencyStats delivery;
+};
+
+KeybindStats &keybind_stats();
+
+struct KeybindChannelOptions
+{
+    // FIFO for `echo VCD_TOGGLE_SELF_MUTE > $XDG_RUNTIME_DIR/vesktop-ipc`;
+    // empty to skip
+    std::string fifo_path;
+    // abstract SOCK_SEQPACKET name, one command per packet; empty to skip.
+    // Failing to bind it only logs a warning when there is a FIFO.
+    std::string socket_name;
+};
+
+// Owns the control FIFO and socket and reads both on a dedicated epoll
+// thread. Commands are parsed there and handed to the callback together with
+// their CLOCK_MONOTONIC receive time.
+class KeybindChannel
+{
+public:
+    using Callback = std::function<void(KeybindCommand, uint64_t received_ns)>;
+
+    KeybindChannel() = default;
+    ~KeybindChannel();
+
+    KeybindChannel(const KeybindChannel &) = delete;
+    KeybindChannel &operator=(const KeybindChannel &) = delete;
+
+    bool start(const KeybindChannelOptions &options, Callback callback, std::string &error);
+    void stop();
+
+private:
+    static constexpr size_t MAX_COMMAND_LENGTH = 256;
+    static constexpr size_t MAX_CONNECTIONS = 16;
+
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    int fifo_fd = -1;
+    int listen_fd = -1;
+    std::string fifo_path;
+    // partial lines per fd; FIFO writers may split a command across writes
+    std::map<int, std::string> pending_input;
+    Callback callback;
+    std::thread thread;
+
+    bool open_fifo(const std::string &path, std::string &error);
+    bool open_socket(const std::string &name, std::string &error);
+    bool watch(int fd, std::string &error);
+    void run();
+    void accept_connections();
+    void read_fifo(uint64_t received_ns);
+    void read_connection(int fd, uint64_t received_ns);
+    void close_connection(int fd);
+    void consume(std::string &buffer, const char *data, size_t length, uint64_t received_ns);
+    void dispatch(const char *data, size_t length, uint64_t received_ns);
+};
@@ -0,0 +1,92 @@
+#include "keybind_channel_binding.h"
+#include "keybind_channel.h"
+#include "trace.h"
+#include <memory>
+#include <string>
+
+namespace
+{
+    std::unique_ptr<KeybindChannel> channel;
+    Napi::ThreadSafeFunction command_callback;
+
+    void stop_channel()
+    {
+        // join the epoll thread before releasing the TSFN it calls into
+        channel.reset();
+
+        if (command_callback)
+        {
+            command_callback.Release();
+            command_callback = Napi::ThreadSafeFunction();
+        }
+    }
+
+    Napi::Value StartKeybindChannel(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction())
+        {
+            Napi::TypeError::New(env, "Expected (object, function)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        Napi::Object opts = info[0].As<Napi::Object>();
+        KeybindChannelOptions options;
+        if (opts.Get("fifoPath").IsString())
+            options.fifo_path = opts.Get("fifoPath").As<Napi::String>().Utf8Value();
+        if (opts.Get("socketName").IsString())
+            options.socket_name = opts.Get("socketName").As<Napi::String>().Utf8Value();
+
+        stop_channel();
+
+        command_callback = Napi::ThreadSafeFunction::New(
+            env,
+            info[1].As<Napi::Function>(),
+            "KeybindCallback",
+            0,
+            1
+        );
+        command_callback.Unref(env);
+
+        // unbounded queue, so the epoll thread never blocks on a busy JS thread
+        auto tsfn = command_callback;
+        channel = std::make_unique<KeybindChannel>();
+
+        std::string error;
+        bool started = channel->start(options, [tsfn](KeybindCommand command, uint64_t received_ns) mutable {
+            tsfn.BlockingCall([command, received_ns](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("KeybindChannel::command dispatch");
+                keybind_stats().delivery.record(monotonic_ns() - received_ns);
+                jsCallback.Call({
+                    Napi::String::New(env, keybind_command_event(command)),
+                    Napi::Number::New(env, static_cast<double>(received_ns) / 1e6),
+                });
+            });
+        }, error);
+
+        if (!started)
+        {
+            stop_channel();
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        return Napi::Boolean::New(env, true);
+    }
+
+    Napi::Value StopKeybindChannel(const Napi::CallbackInfo &info)
+    {
+        stop_channel();
+        return info.Env().Undefined();
+    }
+}
+
+void InitKeybindChannelBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("startKeybindChannel", Napi::Function::New(env, StartKeybindChannel));
+    exports.Set("stopKeybindChannel", Napi::Function::New(env, StopKeybindChannel));
+
+    // don't leave the FIFO behind or the thread running when the env goes away
+    napi_add_env_cleanup_hook(env, [](void *) { stop_channel(); }, nullptr);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <napi.h>
+
+// startKeybindChannel / stopKeybindChannel: the native replacement for the
+// mkfifo + net.Socket control pipe in keybinds.ts.
+void InitKeybindChannelBinding(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,245 @@
+#include "launcher_entry.h"
+#include "native_log.h"
+#include "session_monitor.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr const char *introspection_xml = R"XML(
+<node>
+  <interface name="com.canonical.Unity.LauncherEntry">
+    <method name="Query">
+      <arg type="s" name="app_uri" direction="out"/>
+      <arg type="a{sv}" name="properties" direction="out"/>
+    </method>
+    <signal name="Update">
+      <arg type="s" name="app_uri"/>
+      <arg type="a{sv}" name="properties"/>
+    </signal>
+  </interface>
+</node>
+)XML";
+}
+
+GDBusInterfaceInfo *LauncherEntry::interface_info()
+{
+    static GDBusNodeInfo *node_info = nullptr;
+    if (!node_info)
+    {
+        GError *error = nullptr;
+        node_info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+        if (!node_info)
+        {
+            GErrorPtr error_ptr(error);
+            log_message(LogLevel::Error, "LauncherEntry::interface_info", error, "Invalid introspection XML");
+            return nullptr;
+        }
+    }
+    return node_info->interfaces[0];
+}
+
+LauncherEntry::LauncherEntry(std::string uri)
+    : app_uri(std::move(uri)),
+      object_path("/com/canonical/unity/launcherentry/" + std::to_string(g_str_hash(app_uri.c_str())))
+{
+    GError *error = nullptr;
+    bus.reset(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
+
+    if (!bus)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "LauncherEntry", error, "Failed to connect to session bus");
+    }
+}
+
+LauncherEntry::~LauncherEntry()
+{
+    if (flush_source_id != 0)
+        g_source_remove(flush_source_id);
+
+    if (session_listener_id != 0)
+        SessionMonitor::instance().remove_listener(session_listener_id);
+
+    if (bus && registration_id != 0)
+        g_dbus_connection_unregister_object(bus.get(), registration_id);
+}
+
+bool LauncherEntry::initialize()
+{
+    if (!bus)
+        return false;
+
+    GDBusInterfaceInfo *info = interface_info();
+    if (!info)
+        return false;
+
+    static GDBusInterfaceVTable vtable = {
+        handle_method_call,
+        nullptr,
+        nullptr,
+        {}
+    };
+
+    GError *error = nullptr;
+    registration_id = g_dbus_connection_register_object(
+        bus.get(),
+        object_path.c_str(),
+        info,
+        &vtable,
+        this,
+        nullptr,
+        &error);
+
+    // without the object we can still broadcast, docks just can't Query
+    if (registration_id == 0)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "LauncherEntry::initialize", error, "Failed to export %s", object_path.c_str());
+    }
+
+    session_listener_id = SessionMonitor::instance().add_listener([this](bool active)
+    {
+        if (active)
+            flush();
+    });
+
+    return true;
+}
+
+void LauncherEntry::handle_method_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                       const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                                       GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    TRACE_SPAN("LauncherEntry::handle_method_call", method_name);
+    (void)connection;
+    (void)sender;
+    (void)object_path;
+    (void)interface_name;
+    (void)parameters;
+
+    auto *self = static_cast<LauncherEntry *>(user_data);
+
+    if (g_strcmp0(method_name, "Query") == 0)
+    {
+        g_dbus_method_invocation_return_value(
+            invocation,
+            g_variant_new("(s@a{sv})", self->app_uri.c_str(),
+                          self->properties(PENDING_COUNT | PENDING_PROGRESS | PENDING_URGENT)));
+        return;
+    }
+
+    g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                          "Unknown method %s", method_name);
+}
+
+GVariant *LauncherEntry::properties(uint32_t keys) const
+{
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    if (keys & PENDING_COUNT)
+    {
+        g_variant_builder_add(&builder, "{sv}", "count", g_variant_new_int64(count));
+        g_variant_builder_add(&builder, "{sv}", "count-visible", g_variant_new_boolean(count != 0));
+    }
+    if (keys & PENDING_PROGRESS)
+    {
+        g_variant_builder_add(&builder, "{sv}", "progress", g_variant_new_double(progress));
+        g_variant_builder_add(&builder, "{sv}", "progress-visible", g_variant_new_boolean(progress_visible));
+    }
+    if (keys & PENDING_URGENT)
+        g_variant_builder_add(&builder, "{sv}", "urgent", g_variant_new_boolean(urgent));
+
+    return g_variant_builder_end(&builder);
+}
+
+void LauncherEntry::set_count(int64_t value)
+{
+    if (value == count)
+        return;
+
+    count = value;
+    schedule_flush(PENDING_COUNT);
+}
+
+void LauncherEntry::set_progress(std::optional<double> value)
+{
+    // clamp passes NaN through, which would go out on the bus as is
+    if (value && !std::isfinite(*value))
+        return;
+
+    const bool visible = value.has_value();
+    const double clamped = visible ? std::clamp(*value, 0.0, 1.0) : progress;
+    if (visible == progress_visible && clamped == progress)
+        return;
+
+    progress = clamped;
+    progress_visible = visible;
+    schedule_flush(PENDING_PROGRESS);
+}
+
+void LauncherEntry::set_urgent(bool value)
+{
+    if (value == urgent)
+        return;
+
+    urgent = value;
+    schedule_flush(PENDING_URGENT);
+}
+
+void LauncherEntry::schedule_flush(uint32_t keys)
+{
+    pending |= keys;
+
+    // everything set during this turn of the main loop goes out as one Update
+    if (flush_source_id == 0)
+        flush_source_id = g_idle_add(on_flush, this);
+}
+
+gboolean LauncherEntry::on_flush(gpointer user_data)
+{
+    auto *self = static_cast<LauncherEntry *>(user_data);
+    self->flush_source_id = 0;
+    self->flush();
+    return G_SOURCE_REMOVE;
+}
+
+bool LauncherEntry::flush()
+{
+    TRACE_SPAN("LauncherEntry::flush");
+    if (flush_source_id != 0)
+    {
+        g_source_remove(flush_source_id);
+        flush_source_id = 0;
+    }
+
+    if (!bus || pending == 0)
+        return bus != nullptr;
+
+    // the keys stay pending and go out together once someone can see them
+    if (!SessionMonitor::instance().active())
+        return true;
+
+    GError *error = nullptr;
+    gboolean result = g_dbus_connection_emit_signal(
+        bus.get(),
+        nullptr,
+        object_path.c_str(),
+        LAUNCHER_ENTRY_INTERFACE,
+        "Update",
+        g_variant_new("(s@a{sv})", app_uri.c_str(), properties(pending)),
+        &error);
+
+    pending = 0;
+
+    if (!result || error)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "LauncherEntry::flush", error, "Failed to emit Update signal");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <gio/gio.h>
+#include <optional>
+#include <string>
+#include "glib_ptr.h"
+
+// com.canonical.Unity.LauncherEntry, exported at the path libunity would use
+// so docks that start after us can Query the current badge instead of waiting
+// for the next Update. Runs on the default main context like
+// StatusNotifierItem.
+class LauncherEntry
+{
+public:
+    explicit LauncherEntry(std::string app_uri);
+    ~LauncherEntry();
+
+    LauncherEntry(const LauncherEntry &) = delete;
+    LauncherEntry &operator=(const LauncherEntry &) = delete;
+
+    bool initialize();
+
+    // 0 hides the badge; -1 is shown by most docks as an unread dot
+    void set_count(int64_t count);
+    // 0..1, nullopt hides the progress bar
+    void set_progress(std::optional<double> progress);
+    void set_urgent(bool urgent);
+
+    // sends whatever is pending now rather than on the next idle; held back
+    // while the session is locked or asleep
+    bool flush();
+
+private:
+    static constexpr const char *LAUNCHER_ENTRY_INTERFACE = "com.canonical.Unity.LauncherEntry";
+    static constexpr uint32_t PENDING_COUNT = 1u << 0;
+    static constexpr uint32_t PENDING_PROGRESS = 1u << 1;
+    static constexpr uint32_t PENDING_URGENT = 1u << 2;
+
+    std::string app_uri;
+    std::string object_path;
+    GObjectPtr<GDBusConnection> bus;
+    guint registration_id = 0;
+    guint flush_source_id = 0;
+    guint session_listener_id = 0;
+    uint32_t pending = 0;
+
+    int64_t count = 0;
+    double progress = 0;
+    bool progress_visible = false;
+    bool urgent = false;
+
+    void schedule_flush(uint32_t keys);
+    GVariant *properties(uint32_t keys) const;
+
+    static GDBusInterfaceInfo *interface_info();
+    static gboolean on_flush(gpointer user_data);
+    static void handle_method_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                   const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                                   GDBusMethodInvocation *invocation, gpointer user_data);
+};
+
+// The process-wide entry for $CHROME_DESKTOP, created on first use; null
+// without a session bus. Defined in libvesktop.cc.
+LauncherEntry *launcher_entry();
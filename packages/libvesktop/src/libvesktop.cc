@@ -1,7 +1,6 @@
 #include <gio/gio.h>
 #include <cstdlib>
 #include <cstdint>
-#include <iostream>
 #include <napi.h>
 #include <optional>
 #include <cmath>
@@ -10,81 +9,72 @@
 #include <string>
 #include <vector>
 #include <cstring>
-#include "status_notifier_item.h"
-
-struct GVariantDeleter
+#include <algorithm>
+#include "glib_ptr.h"
+#include "glib_uv_bridge.h"
+#include "dbus_call_binding.h"
+#include "dbus_signal.h"
+#include "dbus_signal_binding.h"
+#include "dbus_recorder.h"
+#include "image_decoder.h"
+#include "image_encoder.h"
+#include "status_notifier_item_binding.h"
+#include "keybind_channel.h"
+#include "keybind_channel_binding.h"
+#include "global_shortcuts.h"
+#include "control_service_binding.h"
+#include "global_shortcuts_binding.h"
+#include "icon_tint_binding.h"
+#include "launcher_entry.h"
+#include "memory_monitor_binding.h"
+#include "native_log.h"
+#include "session_monitor.h"
+#include "stall_watchdog.h"
+#include "system_monitor_binding.h"
+#include "trace.h"
+#include "notifications.h"
+#include "notifications_binding.h"
+
+LauncherEntry *launcher_entry()
 {
-    void operator()(GVariant *variant) const
-    {
-        if (variant)
-            g_variant_unref(variant);
-    }
-};
+    // one entry per process, kept for its lifetime once it initializes. A
+    // failed attempt (no session bus yet) is retried on the next call rather
+    // than remembered. Only called from the JS thread.
+    static LauncherEntry *entry = nullptr;
+    if (entry)
+        return entry;
 
-using GVariantPtr = std::unique_ptr<GVariant, GVariantDeleter>;
-
-struct GErrorDeleter
-{
-    void operator()(GError *error) const
+    const char *chromeDesktop = std::getenv("CHROME_DESKTOP");
+    auto *created = new LauncherEntry(std::string("application://") + (chromeDesktop ? chromeDesktop : "vesktop.desktop"));
+    if (!created->initialize())
     {
-        if (error)
-            g_error_free(error);
+        delete created;
+        return nullptr;
     }
-};
-
-using GErrorPtr = std::unique_ptr<GError, GErrorDeleter>;
+    entry = created;
+    return entry;
+}
 
 bool update_launcher_count(int count)
 {
-    GError *error = nullptr;
-
-    const char *chromeDesktop = std::getenv("CHROME_DESKTOP");
-    std::string desktop_id = std::string("application://") + (chromeDesktop ? chromeDesktop : "vesktop.desktop");
-
-    GObjectPtr<GDBusConnection> bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
-    if (!bus)
-    {
-        GErrorPtr error_ptr(error);
-        std::cerr << "[libvesktop::update_launcher_count] Failed to connect to session bus: "
-                  << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
-        return false;
-    }
-
-    GVariantBuilder builder;
-    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&builder, "{sv}", "count", g_variant_new_int64(count));
-    g_variant_builder_add(&builder, "{sv}", "count-visible", g_variant_new_boolean(count != 0));
-
-    gboolean result = g_dbus_connection_emit_signal(
-        bus.get(),
-        nullptr,
-        "/",
-        "com.canonical.Unity.LauncherEntry",
-        "Update",
-        g_variant_new("(sa{sv})", desktop_id.c_str(), &builder),
-        &error);
-
-    if (!result || error)
-    {
-        GErrorPtr error_ptr(error);
-        std::cerr << "[libvesktop::update_launcher_count] Failed to emit Update signal: "
-                  << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
+    LauncherEntry *entry = launcher_entry();
+    if (!entry)
         return false;
-    }
 
+    entry->set_count(count);
     return true;
 }
 
 std::optional<int32_t> get_accent_color()
 {
+    TRACE_SPAN("get_accent_color");
     GError *error = nullptr;
 
     GObjectPtr<GDBusConnection> bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
     if (!bus)
     {
         GErrorPtr error_ptr(error);
-        std::cerr << "[libvesktop::get_accent_color] Failed to connect to session bus: "
-                  << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
+        log_message(LogLevel::Error, "get_accent_color", error, "Failed to connect to session bus");
         return std::nullopt;
     }
 
@@ -104,8 +94,7 @@ std::optional<int32_t> get_accent_color()
     if (!reply)
     {
         GErrorPtr error_ptr(error);
-        std::cerr << "[libvesktop::get_accent_color] Failed to call Read: "
-                  << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
+        log_message(LogLevel::Warning, "get_accent_color", error, "Failed to call Read");
         return std::nullopt;
     }
 
@@ -113,7 +102,7 @@ std::optional<int32_t> get_accent_color()
     g_variant_get(reply.get(), "(v)", &inner_raw);
     if (!inner_raw)
     {
-        std::cerr << "[libvesktop::get_accent_color] Inner variant is null" << std::endl;
+        log_message(LogLevel::Warning, "get_accent_color", nullptr, "Inner variant is null");
         return std::nullopt;
     }
 
@@ -129,7 +118,7 @@ std::optional<int32_t> get_accent_color()
     if (!g_variant_is_of_type(inner.get(), G_VARIANT_TYPE_TUPLE) ||
         g_variant_n_children(inner.get()) < 3)
     {
-        std::cerr << "[libvesktop::get_accent_color] Inner variant is not a tuple of 3 doubles" << std::endl;
+        log_message(LogLevel::Warning, "get_accent_color", nullptr, "Inner variant is not a tuple of 3 doubles");
         return std::nullopt;
     }
 
@@ -157,14 +146,14 @@ std::optional<int32_t> get_accent_color()
 
 bool request_background(bool autostart, const std::vector<std::string> &commandline)
 {
+    TRACE_SPAN("request_background");
     GError *error = nullptr;
 
     GObjectPtr<GDBusConnection> bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
     if (!bus)
     {
         GErrorPtr error_ptr(error);
-        std::cerr << "[libvesktop::request_background] Failed to connect to session bus: "
-                  << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
+        log_message(LogLevel::Error, "request_background", error, "Failed to connect to session bus");
         return false;
     }
 
@@ -197,18 +186,13 @@ bool request_background(bool autostart, const std::vector<std::string> &commandl
     if (!reply)
     {
         GErrorPtr error_ptr(error);
-        std::cerr << "[libvesktop::request_background] Failed to call RequestBackground: "
-                  << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
+        log_message(LogLevel::Warning, "request_background", error, "Failed to call RequestBackground");
         return false;
     }
 
     return true;
 }
 
-static std::unique_ptr<StatusNotifierItem> g_sni_instance;
-static Napi::ThreadSafeFunction g_menu_click_callback;
-static Napi::ThreadSafeFunction g_activate_callback;
-
 Napi::Value updateUnityLauncherCount(Napi::CallbackInfo const &info)
 {
     if (info.Length() < 1 || !info[0].IsNumber())
@@ -222,14 +206,127 @@ Napi::Value updateUnityLauncherCount(Napi::CallbackInfo const &info)
     return Napi::Boolean::New(info.Env(), success);
 }
 
+Napi::Value UpdateLauncherEntry(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "Expected (object)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object state = info[0].As<Napi::Object>();
+
+    // null hides the bar, undefined leaves it alone
+    Napi::Value progress = state.Get("progress");
+    if (progress.IsNumber() && !std::isfinite(progress.As<Napi::Number>().DoubleValue()))
+    {
+        Napi::TypeError::New(env, "Expected progress to be a finite number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    LauncherEntry *entry = launcher_entry();
+    if (!entry)
+        return Napi::Boolean::New(env, false);
+
+    if (state.Get("count").IsNumber())
+        entry->set_count(state.Get("count").As<Napi::Number>().Int64Value());
+
+    if (progress.IsNumber())
+        entry->set_progress(progress.As<Napi::Number>().DoubleValue());
+    else if (progress.IsNull())
+        entry->set_progress(std::nullopt);
+
+    if (state.Get("urgent").IsBoolean())
+        entry->set_urgent(state.Get("urgent").As<Napi::Boolean>().Value());
+
+    return Napi::Boolean::New(env, true);
+}
+
+// The portal calls below block for up to their D-Bus timeout when the portal
+// is slow or stuck, so they run on the libuv thread pool instead of the UI
+// thread.
+class AccentColorWorker : public Napi::AsyncWorker
+{
+public:
+    explicit AccentColorWorker(Napi::Env env)
+        : Napi::AsyncWorker(env, "AccentColorWorker"),
+          deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const { return deferred.Promise(); }
+
+protected:
+    void Execute() override
+    {
+        color = get_accent_color();
+    }
+
+    void OnOK() override
+    {
+        if (color)
+            deferred.Resolve(Napi::Number::New(Env(), *color));
+        else
+            deferred.Resolve(Env().Null());
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred;
+    std::optional<int32_t> color;
+};
+
 Napi::Value getAccentColor(const Napi::CallbackInfo &info)
 {
-    auto color = get_accent_color();
-    if (color)
-        return Napi::Number::New(info.Env(), *color);
-    return info.Env().Null();
+    auto *worker = new AccentColorWorker(info.Env());
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+
+    return promise;
 }
 
+class RequestBackgroundWorker : public Napi::AsyncWorker
+{
+public:
+    RequestBackgroundWorker(Napi::Env env, bool autostart, std::vector<std::string> commandline)
+        : Napi::AsyncWorker(env, "RequestBackgroundWorker"),
+          deferred(Napi::Promise::Deferred::New(env)),
+          autostart(autostart),
+          commandline(std::move(commandline))
+    {
+    }
+
+    Napi::Promise GetPromise() const { return deferred.Promise(); }
+
+protected:
+    void Execute() override
+    {
+        ok = request_background(autostart, commandline);
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(Napi::Boolean::New(Env(), ok));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred;
+    bool autostart;
+    std::vector<std::string> commandline;
+    bool ok = false;
+};
+
 Napi::Value RequestBackground(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
@@ -250,255 +347,618 @@ Napi::Value RequestBackground(const Napi::CallbackInfo &info)
             commandline.push_back(v.As<Napi::String>().Utf8Value());
     }
 
-    bool ok = request_background(autostart, commandline);
-    return Napi::Boolean::New(env, ok);
+    auto *worker = new RequestBackgroundWorker(env, autostart, std::move(commandline));
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+
+    return promise;
 }
 
-Napi::Value InitStatusNotifierItem(const Napi::CallbackInfo &info)
+class DecodeIconWorker : public Napi::AsyncWorker
 {
-    Napi::Env env = info.Env();
+public:
+    DecodeIconWorker(Napi::Env env, std::string path, uint32_t size)
+        : Napi::AsyncWorker(env, "DecodeIconWorker"),
+          deferred(Napi::Promise::Deferred::New(env)),
+          path(std::move(path)),
+          size(size)
+    {
+    }
 
-    if (g_sni_instance)
+    Napi::Promise GetPromise() const { return deferred.Promise(); }
+
+protected:
+    void Execute() override
     {
-        return Napi::Boolean::New(env, true);
+        Pixmap pixmap;
+        std::string error;
+        if (!decode_image_file(path, size, pixmap, error))
+        {
+            SetError(error);
+            return;
+        }
+
+        result = serialize_pixmap(pixmap);
     }
 
-    g_sni_instance = std::make_unique<StatusNotifierItem>();
-    bool success = g_sni_instance->initialize();
+    void OnOK() override
+    {
+        deferred.Resolve(Napi::Buffer<uint8_t>::Copy(Env(), result.data(), result.size()));
+    }
 
-    if (!success)
+    void OnError(const Napi::Error &error) override
     {
-        g_sni_instance.reset();
-        return Napi::Boolean::New(env, false);
+        deferred.Reject(error.Value());
     }
 
-    return Napi::Boolean::New(env, true);
-}
+private:
+    Napi::Promise::Deferred deferred;
+    std::string path;
+    uint32_t size;
+    std::vector<uint8_t> result;
+};
 
-Napi::Value SetStatusNotifierIcon(const Napi::CallbackInfo &info)
+Napi::Value DecodeStatusNotifierIcon(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() < 1 || !info[0].IsBuffer())
-    {
-        Napi::TypeError::New(env, "Expected (Buffer)").ThrowAsJavaScriptException();
-        return env.Null();
-    }
-
-    if (!g_sni_instance)
+    if (info.Length() < 1 || !info[0].IsString() || (info.Length() > 1 && !info[1].IsNumber() && !info[1].IsUndefined()))
     {
-        Napi::Error::New(env, "StatusNotifierItem not initialized").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected (string, number?)").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
-    std::vector<uint8_t> pixmap_data(buffer.Data(), buffer.Data() + buffer.Length());
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    uint32_t size = info.Length() > 1 && info[1].IsNumber() ? info[1].As<Napi::Number>().Uint32Value() : 32;
 
-    bool success = g_sni_instance->set_icon_pixmap(pixmap_data);
+    auto *worker = new DecodeIconWorker(env, std::move(path), size);
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
 
-    return Napi::Boolean::New(env, success);
+    return promise;
 }
 
-Napi::Value SetStatusNotifierTitle(const Napi::CallbackInfo &info)
+// Screen-share picker thumbnails: the BGRA bitmaps are only referenced, not
+// copied, and each one is scaled and encoded as its own job on libuv's
+// thread pool, so one slow screen doesn't hold up the rest and no thread is
+// started per call.
+struct ThumbnailBatch
 {
-    Napi::Env env = info.Env();
+    Napi::Promise::Deferred deferred;
+    std::vector<std::string> results;
+    size_t remaining;
+    bool settled = false;
+};
 
-    if (info.Length() < 1 || !info[0].IsString())
+class EncodeThumbnailWorker : public Napi::AsyncWorker
+{
+public:
+    EncodeThumbnailWorker(Napi::Env env, std::shared_ptr<ThumbnailBatch> batch, size_t index,
+                          Napi::Buffer<uint8_t> bitmap, uint32_t width, uint32_t height, uint32_t max_width,
+                          uint32_t max_height)
+        : Napi::AsyncWorker(env, "EncodeThumbnailWorker"),
+          batch(std::move(batch)),
+          index(index),
+          buffer(Napi::Persistent(bitmap)),
+          bgra(bitmap.Data()),
+          width(width),
+          height(height),
+          max_width(max_width),
+          max_height(max_height)
     {
-        Napi::TypeError::New(env, "Expected (string)").ThrowAsJavaScriptException();
-        return env.Null();
     }
 
-    if (!g_sni_instance)
+protected:
+    void Execute() override
     {
-        Napi::Error::New(env, "StatusNotifierItem not initialized").ThrowAsJavaScriptException();
-        return env.Null();
+        result = encode_thumbnail(pixmap_from_bgra(bgra, width, height), max_width, max_height);
     }
 
-    std::string title = info[0].As<Napi::String>().Utf8Value();
-    bool success = g_sni_instance->set_title(title);
+    void OnOK() override
+    {
+        batch->results[index] = std::move(result);
+        if (--batch->remaining || batch->settled)
+            return;
 
-    return Napi::Boolean::New(env, success);
-}
+        Napi::Env env = Env();
+        Napi::Array urls = Napi::Array::New(env, batch->results.size());
+        for (size_t i = 0; i < batch->results.size(); i++)
+            urls.Set(static_cast<uint32_t>(i), Napi::String::New(env, batch->results[i]));
+        batch->settled = true;
+        batch->deferred.Resolve(urls);
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        batch->remaining--;
+        if (batch->settled)
+            return;
 
-Napi::Value SetStatusNotifierMenu(const Napi::CallbackInfo &info)
+        batch->settled = true;
+        batch->deferred.Reject(error.Value());
+    }
+
+private:
+    std::shared_ptr<ThumbnailBatch> batch;
+    size_t index;
+    Napi::Reference<Napi::Buffer<uint8_t>> buffer;
+    const uint8_t *bgra;
+    uint32_t width;
+    uint32_t height;
+    uint32_t max_width;
+    uint32_t max_height;
+    std::string result;
+};
+
+Napi::Value EncodeThumbnails(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() < 1 || !info[0].IsArray())
+    if (info.Length() < 3 || !info[0].IsArray() || !info[1].IsNumber() || !info[2].IsNumber())
     {
-        Napi::TypeError::New(env, "Expected (array)").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected (array, number, number)").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (!g_sni_instance)
+    const uint32_t max_width = info[1].As<Napi::Number>().Uint32Value();
+    const uint32_t max_height = info[2].As<Napi::Number>().Uint32Value();
+    if (max_width == 0 || max_height == 0)
     {
-        Napi::Error::New(env, "StatusNotifierItem not initialized").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Thumbnail size must be positive").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    Napi::Array menu_array = info[0].As<Napi::Array>();
-    std::vector<MenuItem> items;
+    struct Frame
+    {
+        Napi::Buffer<uint8_t> bitmap;
+        uint32_t width;
+        uint32_t height;
+    };
 
-    for (uint32_t i = 0; i < menu_array.Length(); i++)
+    // everything is checked before the first job is queued
+    Napi::Array array = info[0].As<Napi::Array>();
+    std::vector<Frame> frames;
+    frames.reserve(array.Length());
+
+    for (uint32_t i = 0; i < array.Length(); i++)
     {
-        Napi::Value item_value = menu_array.Get(i);
-        if (!item_value.IsObject())
-            continue;
+        Napi::Value value = array.Get(i);
+        Napi::Object obj = value.IsObject() ? value.As<Napi::Object>() : Napi::Object();
+        if (obj.IsEmpty() || !obj.Get("bitmap").IsBuffer() || !obj.Get("width").IsNumber() || !obj.Get("height").IsNumber())
+        {
+            Napi::TypeError::New(env, "Expected { bitmap: Buffer, width: number, height: number }").ThrowAsJavaScriptException();
+            return env.Null();
+        }
 
-        Napi::Object item_obj = item_value.As<Napi::Object>();
+        Napi::Buffer<uint8_t> bitmap = obj.Get("bitmap").As<Napi::Buffer<uint8_t>>();
+        uint32_t width = obj.Get("width").As<Napi::Number>().Uint32Value();
+        uint32_t height = obj.Get("height").As<Napi::Number>().Uint32Value();
+        // an empty NativeImage (a minimized window, say) is 0x0 with an
+        // empty bitmap, and encodes to the same empty URL toDataURL gives
+        if (width == 0 || height == 0)
+            width = height = 0;
+        else if (bitmap.Length() / 4 / width < height)
+        {
+            Napi::TypeError::New(env, "Bitmap is smaller than width x height").ThrowAsJavaScriptException();
+            return env.Null();
+        }
 
-        MenuItem item;
-        item.id = item_obj.Get("id").As<Napi::Number>().Int32Value();
-        item.label = item_obj.Has("label") ? item_obj.Get("label").As<Napi::String>().Utf8Value() : "";
-        item.enabled = item_obj.Has("enabled") ? item_obj.Get("enabled").As<Napi::Boolean>().Value() : true;
-        item.visible = item_obj.Has("visible") ? item_obj.Get("visible").As<Napi::Boolean>().Value() : true;
-        item.is_separator = item_obj.Has("type") && item_obj.Get("type").As<Napi::String>().Utf8Value() == "separator";
+        frames.push_back({bitmap, width, height});
+    }
 
-        items.push_back(item);
+    auto batch = std::make_shared<ThumbnailBatch>(
+        ThumbnailBatch{Napi::Promise::Deferred::New(env), std::vector<std::string>(frames.size()), frames.size(), false});
+    Napi::Promise promise = batch->deferred.Promise();
+
+    if (frames.empty())
+    {
+        batch->deferred.Resolve(Napi::Array::New(env, 0));
+        return promise;
     }
 
-    bool success = g_sni_instance->set_menu(items);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const Frame &frame = frames[i];
+        auto *worker = new EncodeThumbnailWorker(env, batch, i, frame.bitmap, frame.width, frame.height, max_width,
+                                                 max_height);
+        worker->Queue();
+    }
 
-    return Napi::Boolean::New(env, success);
+    return promise;
 }
 
-Napi::Value UpdateStatusNotifierMenuItem(const Napi::CallbackInfo &info)
+Napi::Value StartDBusRecording(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString())
+    if (info.Length() < 1 || !info[0].IsString())
     {
-        Napi::TypeError::New(env, "Expected (number, string)").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected (string)").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (!g_sni_instance)
+    std::string error;
+    if (!start_dbus_recording(info[0].As<Napi::String>().Utf8Value(), error))
     {
-        Napi::Error::New(env, "StatusNotifierItem not initialized").ThrowAsJavaScriptException();
+        log_message(LogLevel::Error, "start_dbus_recording", nullptr, "%s", error.c_str());
+        return Napi::Boolean::New(env, false);
+    }
+
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value StopDBusRecording(const Napi::CallbackInfo &info)
+{
+    stop_dbus_recording();
+    return info.Env().Undefined();
+}
+
+Napi::Value GetSessionState(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    const auto &monitor = SessionMonitor::instance();
+
+    Napi::Object state = Napi::Object::New(env);
+    state.Set("active", Napi::Boolean::New(env, monitor.active()));
+    state.Set("locked", Napi::Boolean::New(env, monitor.is_locked()));
+    state.Set("sleeping", Napi::Boolean::New(env, monitor.is_sleeping()));
+    state.Set("screenSaverActive", Napi::Boolean::New(env, monitor.is_screen_saver_active()));
+    return state;
+}
+
+Napi::Value DrainNativeLog(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && !info[0].IsNumber() && !info[0].IsUndefined())
+    {
+        Napi::TypeError::New(env, "Expected (number?)").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    int32_t id = info[0].As<Napi::Number>().Int32Value();
-    std::string label = info[1].As<Napi::String>().Utf8Value();
+    size_t max = LOG_CAPACITY;
+    if (info.Length() > 0 && info[0].IsNumber())
+        max = static_cast<size_t>(std::max<int64_t>(0, info[0].As<Napi::Number>().Int64Value()));
 
-    bool success = g_sni_instance->update_menu_item_label(id, label);
+    uint64_t lost = 0;
+    std::vector<LogRecord> records = drain_log(max, lost);
 
-    return Napi::Boolean::New(env, success);
+    Napi::Array array = Napi::Array::New(env, records.size());
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const LogRecord &record = records[i];
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("timestamp", Napi::BigInt::New(env, record.timestamp_ns));
+        obj.Set("level", Napi::String::New(env, log_level_name(record.level)));
+        obj.Set("subsystem", Napi::String::New(env, record.subsystem));
+        obj.Set("message", Napi::String::New(env, record.message));
+        if (record.error_domain)
+        {
+            obj.Set("errorDomain", Napi::String::New(env, record.error_domain));
+            obj.Set("errorCode", Napi::Number::New(env, record.error_code));
+        }
+        array.Set(i, obj);
+    }
+
+    Napi::Object batch = Napi::Object::New(env);
+    batch.Set("records", array);
+    batch.Set("lost", Napi::Number::New(env, static_cast<double>(lost)));
+    return batch;
 }
 
-Napi::Value DestroyStatusNotifierItem(const Napi::CallbackInfo &info)
+Napi::Value SetNativeLogOptions(const Napi::CallbackInfo &info)
 {
-    if (g_sni_instance)
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject())
     {
-        g_sni_instance.reset();
+        Napi::TypeError::New(env, "Expected (object)").ThrowAsJavaScriptException();
+        return env.Null();
     }
-    if (g_menu_click_callback)
+
+    Napi::Object options = info[0].As<Napi::Object>();
+
+    Napi::Value level_value = options.Get("level");
+    if (level_value.IsString())
     {
-        g_menu_click_callback.Release();
+        LogLevel level;
+        if (!parse_log_level(level_value.As<Napi::String>().Utf8Value(), level))
+        {
+            Napi::TypeError::New(env, "level must be one of debug, info, warning, error").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        set_log_level(level);
     }
-    if (g_activate_callback)
+
+    Napi::Value stderr_value = options.Get("stderr");
+    if (stderr_value.IsBoolean())
+        set_log_stderr(stderr_value.As<Napi::Boolean>().Value());
+
+    Napi::Value crash_file_value = options.Get("crashFile");
+    if (crash_file_value.IsString() || crash_file_value.IsNull())
     {
-        g_activate_callback.Release();
+        std::string error;
+        const std::string path = crash_file_value.IsString() ? crash_file_value.As<Napi::String>().Utf8Value() : "";
+        if (!set_log_crash_file(path, error))
+        {
+            log_message(LogLevel::Error, "set_log_crash_file", nullptr, "%s", error.c_str());
+            return Napi::Boolean::New(env, false);
+        }
     }
-    return info.Env().Undefined();
+
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value SetNativeTracing(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsBoolean())
+    {
+        Napi::TypeError::New(env, "Expected (boolean)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    set_tracing(info[0].As<Napi::Boolean>().Value());
+    return env.Undefined();
 }
 
-Napi::Value SetStatusNotifierMenuClickCallback(const Napi::CallbackInfo &info)
+Napi::Value StartStallWatchdog(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() < 1 || !info[0].IsFunction())
+    if (info.Length() > 0 && !info[0].IsObject() && !info[0].IsUndefined())
     {
-        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected (object?)").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (!g_sni_instance)
+    StallWatchdogOptions options;
+    if (info.Length() > 0 && info[0].IsObject())
     {
-        Napi::Error::New(env, "StatusNotifierItem not initialized").ThrowAsJavaScriptException();
+        Napi::Object opts = info[0].As<Napi::Object>();
+        if (opts.Get("intervalMs").IsNumber())
+            options.interval_ms = opts.Get("intervalMs").As<Napi::Number>().Uint32Value();
+        if (opts.Get("thresholdMs").IsNumber())
+            options.threshold_ms = opts.Get("thresholdMs").As<Napi::Number>().Uint32Value();
+    }
+
+    std::string error;
+    if (!start_stall_watchdog(options, error))
+    {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (g_menu_click_callback)
+    return env.Undefined();
+}
+
+Napi::Value StopStallWatchdog(const Napi::CallbackInfo &info)
+{
+    stop_stall_watchdog();
+    return info.Env().Undefined();
+}
+
+Napi::Value GetStallReport(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    const StallReport report = stall_report(10);
+
+    Napi::Array histogram = Napi::Array::New(env, StallReport::BUCKET_COUNT);
+    for (size_t i = 0; i < StallReport::BUCKET_COUNT; i++)
+    {
+        Napi::Object bucket = Napi::Object::New(env);
+        // the last bucket has no upper bound
+        bucket.Set("upToMs", i + 1 < StallReport::BUCKET_COUNT
+                                 ? Napi::Number::New(env, StallReport::BUCKET_BOUNDS_MS[i])
+                                 : Napi::Number::New(env, INFINITY));
+        bucket.Set("count", Napi::Number::New(env, static_cast<double>(report.histogram[i])));
+        histogram.Set(static_cast<uint32_t>(i), bucket);
+    }
+
+    Napi::Array offenders = Napi::Array::New(env, report.offenders.size());
+    for (size_t i = 0; i < report.offenders.size(); i++)
     {
-        g_menu_click_callback.Release();
+        const StallOffender &offender = report.offenders[i];
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("operation", Napi::String::New(env, offender.operation));
+        obj.Set("count", Napi::Number::New(env, static_cast<double>(offender.count)));
+        obj.Set("totalMs", Napi::Number::New(env, offender.total_ns / 1e6));
+        obj.Set("maxMs", Napi::Number::New(env, offender.max_ns / 1e6));
+        offenders.Set(static_cast<uint32_t>(i), obj);
     }
 
-    g_menu_click_callback = Napi::ThreadSafeFunction::New(
-        env,
-        info[0].As<Napi::Function>(),
-        "MenuClickCallback",
-        0,
-        1
-    );
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("running", Napi::Boolean::New(env, report.running));
+    result.Set("heartbeats", Napi::Number::New(env, static_cast<double>(report.heartbeats)));
+    result.Set("stalls", Napi::Number::New(env, static_cast<double>(report.stalls)));
+    result.Set("histogram", histogram);
+    result.Set("offenders", offenders);
+    return result;
+}
 
-    g_sni_instance->set_menu_click_callback([](int32_t id) {
-        if (g_menu_click_callback)
-        {
-            g_menu_click_callback.BlockingCall([id](Napi::Env env, Napi::Function jsCallback) {
-                jsCallback.Call({Napi::Number::New(env, id)});
-            });
-        }
-    });
+Napi::Value ExportNativeTrace(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
 
-    return Napi::Boolean::New(env, true);
+    uint64_t dropped = 0;
+    std::string json = export_trace_json(dropped);
+
+    Napi::Object trace = Napi::Object::New(env);
+    trace.Set("json", Napi::String::New(env, json));
+    trace.Set("dropped", Napi::Number::New(env, static_cast<double>(dropped)));
+    return trace;
 }
 
-Napi::Value SetStatusNotifierActivateCallback(const Napi::CallbackInfo &info)
+Napi::Value AttachGLibMainLoop(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() < 1 || !info[0].IsFunction())
+    // Chromium's message pump already iterates the default context, and two
+    // owners would steal each other's wakeups
+    Napi::Value process = env.Global().Get("process");
+    if (process.IsObject())
     {
-        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
-        return env.Null();
+        Napi::Value versions = process.As<Napi::Object>().Get("versions");
+        if (versions.IsObject() && versions.As<Napi::Object>().Has("electron"))
+            return Napi::Boolean::New(env, false);
     }
 
-    if (!g_sni_instance)
+    uv_loop_t *loop = nullptr;
+    if (napi_get_uv_event_loop(env, &loop) != napi_ok || !loop)
     {
-        Napi::Error::New(env, "StatusNotifierItem not initialized").ThrowAsJavaScriptException();
+        Napi::Error::New(env, "No libuv loop for this environment").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    if (g_activate_callback)
+    std::string error;
+    if (!attach_glib_to_uv(loop, error))
     {
-        g_activate_callback.Release();
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
     }
 
-    g_activate_callback = Napi::ThreadSafeFunction::New(
-        env,
-        info[0].As<Napi::Function>(),
-        "ActivateCallback",
-        0,
-        1
-    );
+    return Napi::Boolean::New(env, true);
+}
 
-    g_sni_instance->set_activate_callback([]() {
-        if (g_activate_callback)
-        {
-            g_activate_callback.BlockingCall([](Napi::Env env, Napi::Function jsCallback) {
-                jsCallback.Call({});
-            });
-        }
-    });
+Napi::Value DetachGLibMainLoop(const Napi::CallbackInfo &info)
+{
+    detach_glib_from_uv();
+    return info.Env().Undefined();
+}
 
-    return Napi::Boolean::New(env, true);
+Napi::Object LatencyStatsObject(Napi::Env env, const LatencyStats &stats)
+{
+    const uint64_t count = stats.count.load(std::memory_order_relaxed);
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("count", Napi::Number::New(env, static_cast<double>(count)));
+    obj.Set("meanUs", Napi::Number::New(env, count ? stats.total_ns.load(std::memory_order_relaxed) / 1e3 / count : 0));
+    obj.Set("maxUs", Napi::Number::New(env, stats.max_ns.load(std::memory_order_relaxed) / 1e3));
+    obj.Set("lastUs", Napi::Number::New(env, stats.last_ns.load(std::memory_order_relaxed) / 1e3));
+    return obj;
+}
+
+Napi::Value GetLibVesktopStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    const auto &keybinds = keybind_stats();
+    Napi::Object keybind_obj = Napi::Object::New(env);
+    keybind_obj.Set("received", Napi::Number::New(env, static_cast<double>(keybinds.received.load(std::memory_order_relaxed))));
+    keybind_obj.Set("rejected", Napi::Number::New(env, static_cast<double>(keybinds.rejected.load(std::memory_order_relaxed))));
+    keybind_obj.Set("nativeLatency", LatencyStatsObject(env, keybinds.native));
+    keybind_obj.Set("deliveryLatency", LatencyStatsObject(env, keybinds.delivery));
+
+    const auto &shortcuts = global_shortcuts_stats();
+    Napi::Object shortcuts_obj = Napi::Object::New(env);
+    shortcuts_obj.Set("events", Napi::Number::New(env, static_cast<double>(shortcuts.events.load(std::memory_order_relaxed))));
+    shortcuts_obj.Set("deliveryLatency", LatencyStatsObject(env, shortcuts.delivery));
+
+    const auto &notifications = notification_stats();
+    Napi::Object notifications_obj = Napi::Object::New(env);
+    notifications_obj.Set("sent", Napi::Number::New(env, static_cast<double>(notifications.sent.load(std::memory_order_relaxed))));
+    notifications_obj.Set("coalesced", Napi::Number::New(env, static_cast<double>(notifications.coalesced.load(std::memory_order_relaxed))));
+    notifications_obj.Set("imageCacheHits", Napi::Number::New(env, static_cast<double>(notifications.image_cache_hits.load(std::memory_order_relaxed))));
+    notifications_obj.Set("imageCacheMisses", Napi::Number::New(env, static_cast<double>(notifications.image_cache_misses.load(std::memory_order_relaxed))));
+    notifications_obj.Set("imageCacheBytes", Napi::Number::New(env, static_cast<double>(notifications.image_cache_bytes.load(std::memory_order_relaxed))));
+
+    const auto &signals = dbus_signal_stats();
+    Napi::Object signals_obj = Napi::Object::New(env);
+    signals_obj.Set("signals", Napi::Number::New(env, static_cast<double>(signals.signals.load(std::memory_order_relaxed))));
+    signals_obj.Set("batches", Napi::Number::New(env, static_cast<double>(signals.batches.load(std::memory_order_relaxed))));
+    signals_obj.Set("deliveryLatency", LatencyStatsObject(env, signals.delivery));
+
+    Napi::Object log_obj = Napi::Object::New(env);
+    log_obj.Set("written", Napi::Number::New(env, static_cast<double>(log_records_written())));
+
+    Napi::Object glib_obj = Napi::Object::New(env);
+    glib_obj.Set("attached", Napi::Boolean::New(env, glib_uv_attached()));
+    glib_obj.Set("dispatches", Napi::Number::New(env, static_cast<double>(glib_uv_dispatches())));
+
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("keybinds", keybind_obj);
+    stats.Set("globalShortcuts", shortcuts_obj);
+    stats.Set("notifications", notifications_obj);
+    stats.Set("dbusSignals", signals_obj);
+    stats.Set("nativeLog", log_obj);
+    stats.Set("glibMainLoop", glib_obj);
+    return stats;
 }
 
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
+    LogLevel log_level;
+    if (const char *level_name = std::getenv("LIBVESKTOP_LOG_LEVEL"))
+    {
+        if (parse_log_level(level_name, log_level))
+            set_log_level(log_level);
+    }
+
+    // stderr used to be written synchronously on every error; it is now a
+    // background mirror of the ring that can be switched off
+    const char *log_stderr = std::getenv("LIBVESKTOP_LOG_STDERR");
+    set_log_stderr(!log_stderr || std::strcmp(log_stderr, "0") != 0);
+
+    // spans from the very first D-Bus calls, before JS gets a chance to
+    // turn tracing on
+    if (std::getenv("LIBVESKTOP_TRACE"))
+        set_tracing(true);
+
+    // stall numbers from the very start, where most of the D-Bus traffic is
+    if (std::getenv("LIBVESKTOP_STALL_WATCHDOG"))
+    {
+        std::string error;
+        if (!start_stall_watchdog({}, error))
+            log_message(LogLevel::Error, "Init", nullptr, "%s", error.c_str());
+    }
+
+    // lets a trace be captured from a packaged build without touching JS
+    if (const char *trace_path = std::getenv("LIBVESKTOP_DBUS_TRACE"))
+    {
+        std::string error;
+        if (!start_dbus_recording(trace_path, error))
+            log_message(LogLevel::Error, "Init", nullptr, "%s", error.c_str());
+    }
+
     exports.Set("updateUnityLauncherCount", Napi::Function::New(env, updateUnityLauncherCount));
+    exports.Set("updateLauncherEntry", Napi::Function::New(env, UpdateLauncherEntry));
     exports.Set("getAccentColor", Napi::Function::New(env, getAccentColor));
     exports.Set("requestBackground", Napi::Function::New(env, RequestBackground));
-    exports.Set("initStatusNotifierItem", Napi::Function::New(env, InitStatusNotifierItem));
-    exports.Set("setStatusNotifierIcon", Napi::Function::New(env, SetStatusNotifierIcon));
-    exports.Set("setStatusNotifierTitle", Napi::Function::New(env, SetStatusNotifierTitle));
-    exports.Set("setStatusNotifierMenu", Napi::Function::New(env, SetStatusNotifierMenu));
-    exports.Set("updateStatusNotifierMenuItem", Napi::Function::New(env, UpdateStatusNotifierMenuItem));
-    exports.Set("setStatusNotifierMenuClickCallback", Napi::Function::New(env, SetStatusNotifierMenuClickCallback));
-    exports.Set("setStatusNotifierActivateCallback", Napi::Function::New(env, SetStatusNotifierActivateCallback));
-    exports.Set("destroyStatusNotifierItem", Napi::Function::New(env, DestroyStatusNotifierItem));
+    exports.Set("decodeStatusNotifierIcon", Napi::Function::New(env, DecodeStatusNotifierIcon));
+    exports.Set("encodeThumbnails", Napi::Function::New(env, EncodeThumbnails));
+    exports.Set("startDBusRecording", Napi::Function::New(env, StartDBusRecording));
+    exports.Set("stopDBusRecording", Napi::Function::New(env, StopDBusRecording));
+    exports.Set("getSessionState", Napi::Function::New(env, GetSessionState));
+    exports.Set("drainNativeLog", Napi::Function::New(env, DrainNativeLog));
+    exports.Set("setNativeLogOptions", Napi::Function::New(env, SetNativeLogOptions));
+    exports.Set("setNativeTracing", Napi::Function::New(env, SetNativeTracing));
+    exports.Set("exportNativeTrace", Napi::Function::New(env, ExportNativeTrace));
+    exports.Set("getLibVesktopStats", Napi::Function::New(env, GetLibVesktopStats));
+    exports.Set("startStallWatchdog", Napi::Function::New(env, StartStallWatchdog));
+    exports.Set("stopStallWatchdog", Napi::Function::New(env, StopStallWatchdog));
+    exports.Set("getStallReport", Napi::Function::New(env, GetStallReport));
+    exports.Set("attachGLibMainLoop", Napi::Function::New(env, AttachGLibMainLoop));
+    exports.Set("detachGLibMainLoop", Napi::Function::New(env, DetachGLibMainLoop));
+    InitStatusNotifierItemBinding(env, exports);
+    InitKeybindChannelBinding(env, exports);
+    InitGlobalShortcutsBinding(env, exports);
+    InitNotificationsBinding(env, exports);
+    InitIconTintBinding(env, exports);
+    InitControlServiceBinding(env, exports);
+    InitDBusCallBinding(env, exports);
+    InitDBusSignalBinding(env, exports);
+    InitSystemMonitorBinding(env, exports);
+    InitMemoryMonitorBinding(env, exports);
+
+    napi_add_env_cleanup_hook(env, [](void *)
+    {
+        stop_stall_watchdog();
+        // before the TSFNs the subscriptions call into are finalized
+        unsubscribe_all_dbus_signals();
+        detach_glib_from_uv();
+    }, nullptr);
     return exports;
 }
 
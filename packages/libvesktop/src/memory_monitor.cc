@@ -0,0 +1,136 @@
+#include "memory_monitor.h"
+#include "native_log.h"
+#include "trace.h"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+MemoryMonitor &MemoryMonitor::instance()
+{
+    // never destroyed, so signal handlers can always assume it is alive
+    static MemoryMonitor *monitor = new MemoryMonitor();
+    return *monitor;
+}
+
+MemoryMonitor::MemoryMonitor()
+{
+#if GLIB_CHECK_VERSION(2, 64, 0)
+    monitor.reset(G_OBJECT(g_memory_monitor_dup_default()));
+    if (monitor)
+        g_signal_connect(monitor.get(), "low-memory-warning", G_CALLBACK(on_low_memory_warning), this);
+#endif
+}
+
+const char *MemoryMonitor::level_name(MemoryPressure level)
+{
+    switch (level)
+    {
+    case MemoryPressure::Low:
+        return "low";
+    case MemoryPressure::Medium:
+        return "medium";
+    case MemoryPressure::Critical:
+        return "critical";
+    }
+    return "low";
+}
+
+bool MemoryMonitor::parse_level(const std::string &name, MemoryPressure &out)
+{
+    for (MemoryPressure level : {MemoryPressure::Low, MemoryPressure::Medium, MemoryPressure::Critical})
+    {
+        if (name == level_name(level))
+        {
+            out = level;
+            return true;
+        }
+    }
+    return false;
+}
+
+guint MemoryMonitor::add_trimmer(std::string name, MemoryPressure min_level, Trimmer trimmer)
+{
+    guint id = next_id++;
+    trimmers.emplace(id, Registration{std::move(name), min_level, std::move(trimmer)});
+    return id;
+}
+
+void MemoryMonitor::remove_trimmer(guint id)
+{
+    trimmers.erase(id);
+}
+
+guint MemoryMonitor::add_listener(Listener listener)
+{
+    guint id = next_id++;
+    listeners.emplace(id, std::move(listener));
+    return id;
+}
+
+void MemoryMonitor::remove_listener(guint id)
+{
+    listeners.erase(id);
+}
+
+std::vector<std::string> MemoryMonitor::trim(MemoryPressure level)
+{
+    TRACE_SPAN("MemoryMonitor::trim", level_name(level));
+
+    // a trimmer may remove registrations (its own included) while we are
+    // calling out
+    std::vector<guint> ids;
+    ids.reserve(trimmers.size());
+    for (const auto &entry : trimmers)
+    {
+        if (entry.second.min_level <= level)
+            ids.push_back(entry.first);
+    }
+
+    std::vector<std::string> trimmed;
+    for (guint id : ids)
+    {
+        auto it = trimmers.find(id);
+        if (it == trimmers.end())
+            continue;
+
+        trimmed.push_back(it->second.name);
+        it->second.trimmer();
+    }
+
+#ifdef __GLIBC__
+    // what the caches freed mostly sits in glibc's arenas; hand it back
+    if (level >= MemoryPressure::Medium)
+    {
+        malloc_trim(0);
+        trimmed.push_back("malloc");
+    }
+#endif
+    return trimmed;
+}
+
+void MemoryMonitor::on_low_memory_warning(GObject *, int level, gpointer user_data)
+{
+    auto *self = static_cast<MemoryMonitor *>(user_data);
+
+    // GMemoryMonitorWarningLevel is open-ended: 50 low, 100 medium, 255
+    // critical, and possibly values in between later on
+    const MemoryPressure pressure = level >= 255   ? MemoryPressure::Critical
+                                    : level >= 100 ? MemoryPressure::Medium
+                                                   : MemoryPressure::Low;
+
+    const std::vector<std::string> trimmed = self->trim(pressure);
+    log_message(LogLevel::Info, "MemoryMonitor", nullptr, "%s memory warning (%d), trimmed %zu caches",
+                level_name(pressure), level, trimmed.size());
+
+    std::vector<guint> ids;
+    ids.reserve(self->listeners.size());
+    for (const auto &entry : self->listeners)
+        ids.push_back(entry.first);
+
+    for (guint id : ids)
+    {
+        auto it = self->listeners.find(id);
+        if (it != self->listeners.end())
+            it->second(pressure, trimmed);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <gio/gio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "glib_ptr.h"
+
+// GMemoryMonitor's low-memory-warning levels, mildest first
+enum class MemoryPressure : uint8_t
+{
+    Low,
+    Medium,
+    Critical,
+};
+
+// Listens for GIO's low-memory-warning (the memory-monitor portal inside a
+// sandbox, PSI otherwise) and drops native caches before the kernel starts
+// reclaiming. Owners register a trimmer with the mildest level it should
+// run at; a warning runs every trimmer at or below its level (plus
+// malloc_trim from medium on, with glibc), then tells the listeners which
+// ones ran.
+//
+// Like SessionMonitor it is created on first use and dispatches on the
+// thread-default main context of that moment, the default context
+// everywhere we use it. Trimmers are called on that thread too, so they may
+// touch main-context-only state. Without GLib 2.64 nothing ever warns, but
+// trim() still works.
+class MemoryMonitor
+{
+public:
+    using Trimmer = std::function<void()>;
+    // the names of the trimmers that ran
+    using Listener = std::function<void(MemoryPressure, const std::vector<std::string> &trimmed)>;
+
+    static MemoryMonitor &instance();
+
+    guint add_trimmer(std::string name, MemoryPressure min_level, Trimmer trimmer);
+    void remove_trimmer(guint id);
+
+    guint add_listener(Listener listener);
+    void remove_listener(guint id);
+
+    // Runs the trimmers for level as a warning would, without telling the
+    // listeners, and returns their names.
+    std::vector<std::string> trim(MemoryPressure level);
+
+    bool monitored() const { return monitor != nullptr; }
+
+    static const char *level_name(MemoryPressure level);
+    static bool parse_level(const std::string &name, MemoryPressure &out);
+
+private:
+    struct Registration
+    {
+        std::string name;
+        MemoryPressure min_level;
+        Trimmer trimmer;
+    };
+
+    GObjectPtr<GObject> monitor;
+    std::map<guint, Registration> trimmers;
+    std::map<guint, Listener> listeners;
+    guint next_id = 1;
+
+    MemoryMonitor();
+
+    static void on_low_memory_warning(GObject *monitor, int level, gpointer user_data);
+};
@@ -0,0 +1,93 @@
+#include "memory_monitor_binding.h"
+#include "memory_monitor.h"
+#include "stats.h"
+#include "trace.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+    Napi::ThreadSafeFunction pressure_callback;
+    guint listener_id = 0;
+
+    Napi::Array names_array(Napi::Env env, const std::vector<std::string> &names)
+    {
+        Napi::Array array = Napi::Array::New(env, names.size());
+        for (size_t i = 0; i < names.size(); i++)
+            array.Set(static_cast<uint32_t>(i), Napi::String::New(env, names[i]));
+        return array;
+    }
+
+    void release_callback()
+    {
+        if (listener_id)
+        {
+            MemoryMonitor::instance().remove_listener(listener_id);
+            listener_id = 0;
+        }
+
+        if (pressure_callback)
+        {
+            pressure_callback.Release();
+            pressure_callback = Napi::ThreadSafeFunction();
+        }
+    }
+
+    Napi::Value OnMemoryPressure(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || (!info[0].IsFunction() && !info[0].IsNull()))
+        {
+            Napi::TypeError::New(env, "Expected (function | null)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        release_callback();
+        if (info[0].IsNull())
+            return Napi::Boolean::New(env, MemoryMonitor::instance().monitored());
+
+        pressure_callback = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "MemoryPressureCallback", 0, 1);
+        pressure_callback.Unref(env);
+
+        auto tsfn = pressure_callback;
+        listener_id = MemoryMonitor::instance().add_listener(
+            [tsfn](MemoryPressure level, const std::vector<std::string> &trimmed) mutable
+            {
+                // the native caches are already gone; JS hears about it after
+                const uint64_t received_ns = monotonic_ns();
+                tsfn.NonBlockingCall([level, trimmed, received_ns](Napi::Env env, Napi::Function jsCallback)
+                {
+                    TRACE_SPAN("MemoryMonitor::pressure dispatch");
+                    Napi::Object event = Napi::Object::New(env);
+                    event.Set("level", Napi::String::New(env, MemoryMonitor::level_name(level)));
+                    event.Set("trimmed", names_array(env, trimmed));
+                    event.Set("receivedAtMs", Napi::Number::New(env, static_cast<double>(received_ns) / 1e6));
+                    jsCallback.Call({event});
+                });
+            });
+
+        return Napi::Boolean::New(env, MemoryMonitor::instance().monitored());
+    }
+
+    Napi::Value TrimNativeCaches(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        MemoryPressure level;
+        if (info.Length() < 1 || !info[0].IsString() ||
+            !MemoryMonitor::parse_level(info[0].As<Napi::String>().Utf8Value(), level))
+        {
+            Napi::TypeError::New(env, "Expected (\"low\" | \"medium\" | \"critical\")").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        return names_array(env, MemoryMonitor::instance().trim(level));
+    }
+}
+
+void InitMemoryMonitorBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("onMemoryPressure", Napi::Function::New(env, OnMemoryPressure));
+    exports.Set("trimNativeCaches", Napi::Function::New(env, TrimNativeCaches));
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <napi.h>
+
+// onMemoryPressure / trimNativeCaches: GMemoryMonitor warnings in JS and the
+// native cache trimming that MemoryMonitor runs for them.
+void InitMemoryMonitorBinding(Napi::Env env, Napi::Object exports);
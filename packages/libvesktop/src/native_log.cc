@@ -0,0 +1,415 @@
+#include "native_log.h"
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    // Each slot is a seqlock: 2 * pos + 1 while the record for position pos
+    // is being written, 2 * pos + 2 once it is complete. A reader copies the
+    // record and rereads the sequence; if it moved, a writer lapped it.
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        LogRecord record;
+    };
+
+    struct LogState
+    {
+        Slot slots[LOG_CAPACITY];
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint8_t> min_level{static_cast<uint8_t>(LogLevel::Warning)};
+
+        std::mutex drain_mutex;
+        uint64_t drain_cursor = 0;
+
+        std::atomic<bool> stderr_enabled{false};
+        std::atomic<bool> stderr_pending{false};
+        std::mutex stderr_mutex;
+        std::condition_variable stderr_cv;
+        bool stderr_running = false;
+        // owned by the stderr thread while it runs
+        uint64_t stderr_cursor = 0;
+
+        std::atomic<int> crash_fd{-1};
+        std::mutex crash_mutex;
+        bool crash_handlers_installed = false;
+    };
+
+    // Leaked on purpose: the stderr thread and the crash handler may still
+    // use it while static destructors run at exit.
+    LogState &state()
+    {
+        static LogState *instance = new LogState();
+        return *instance;
+    }
+
+    constexpr int FATAL_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    struct sigaction previous_actions[NSIG];
+
+    constexpr uint64_t complete_sequence(uint64_t pos)
+    {
+        return 2 * pos + 2;
+    }
+
+    enum class ReadResult
+    {
+        Ok,
+        NotReady,
+        Lost,
+    };
+
+    // async-signal-safe: only atomics and memcpy
+    ReadResult read_slot(const LogState &s, uint64_t pos, LogRecord &out)
+    {
+        const Slot &slot = s.slots[pos % LOG_CAPACITY];
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before < complete_sequence(pos))
+            return ReadResult::NotReady;
+        if (before > complete_sequence(pos))
+            return ReadResult::Lost;
+
+        std::memcpy(&out, &slot.record, sizeof(LogRecord));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == before ? ReadResult::Ok : ReadResult::Lost;
+    }
+
+    // Reads from cursor up to the newest complete record and advances cursor
+    // past everything it consumed or found overwritten.
+    template <typename Fn>
+    void read_from(const LogState &s, uint64_t &cursor, size_t max, uint64_t &lost, Fn &&fn)
+    {
+        const uint64_t end = s.head.load(std::memory_order_acquire);
+        if (end > LOG_CAPACITY && cursor < end - LOG_CAPACITY)
+        {
+            lost += end - LOG_CAPACITY - cursor;
+            cursor = end - LOG_CAPACITY;
+        }
+
+        LogRecord record;
+        for (size_t taken = 0; cursor < end && taken < max; cursor++)
+        {
+            switch (read_slot(s, cursor, record))
+            {
+            case ReadResult::Ok:
+                fn(record);
+                taken++;
+                break;
+            case ReadResult::Lost:
+                lost++;
+                break;
+            case ReadResult::NotReady:
+                // a writer is still filling it in; pick it up next time
+                return;
+            }
+        }
+    }
+
+    void write_stderr(const LogRecord &record)
+    {
+        if (record.error_domain)
+            std::fprintf(stderr, "[libvesktop::%s] %s (%s %d)\n", record.subsystem, record.message,
+                         record.error_domain, record.error_code);
+        else
+            std::fprintf(stderr, "[libvesktop::%s] %s\n", record.subsystem, record.message);
+    }
+
+    void stderr_loop()
+    {
+        LogState &s = state();
+        uint64_t lost = 0;
+
+        std::unique_lock<std::mutex> lock(s.stderr_mutex);
+        while (s.stderr_enabled.load(std::memory_order_relaxed))
+        {
+            // writers notify without the lock, so a wake-up can slip past;
+            // the timeout bounds how late such a record is printed
+            s.stderr_cv.wait_for(lock, std::chrono::seconds(1), [&s]()
+            {
+                return s.stderr_pending.exchange(false) || !s.stderr_enabled.load(std::memory_order_relaxed);
+            });
+            lock.unlock();
+
+            read_from(s, s.stderr_cursor, LOG_CAPACITY, lost, write_stderr);
+            if (lost != 0)
+            {
+                std::fprintf(stderr, "[libvesktop] %llu log records were overwritten before they were printed\n",
+                             static_cast<unsigned long long>(lost));
+                lost = 0;
+            }
+            std::fflush(stderr);
+
+            lock.lock();
+        }
+        s.stderr_running = false;
+    }
+
+    // Formatting for the crash handler, where printf isn't safe to call
+    struct CrashLine
+    {
+        char buffer[512];
+        size_t length = 0;
+
+        void append(const char *text)
+        {
+            while (text && *text && length < sizeof(buffer) - 1)
+                buffer[length++] = *text++;
+        }
+
+        void append(uint64_t value)
+        {
+            char digits[20];
+            size_t count = 0;
+            do
+            {
+                digits[count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+
+            while (count > 0 && length < sizeof(buffer) - 1)
+                buffer[length++] = digits[--count];
+        }
+
+        void append(int64_t value)
+        {
+            if (value < 0)
+            {
+                append("-");
+                append(static_cast<uint64_t>(-(value + 1)) + 1);
+            }
+            else
+            {
+                append(static_cast<uint64_t>(value));
+            }
+        }
+
+        void flush(int fd)
+        {
+            buffer[length++] = '\n';
+            for (size_t written = 0; written < length;)
+            {
+                ssize_t result = write(fd, buffer + written, length - written);
+                if (result < 0 && errno == EINTR)
+                    continue;
+                if (result <= 0)
+                    break;
+                written += static_cast<size_t>(result);
+            }
+            length = 0;
+        }
+    };
+
+    void dump_ring(int fd, int signal_number)
+    {
+        const LogState &s = state();
+
+        CrashLine line;
+        line.append("libvesktop: fatal signal ");
+        line.append(static_cast<int64_t>(signal_number));
+        line.append(", last log records follow");
+        line.flush(fd);
+
+        // the whole ring, not just what JS hasn't drained yet
+        const uint64_t end = s.head.load(std::memory_order_acquire);
+        LogRecord record;
+        for (uint64_t pos = end > LOG_CAPACITY ? end - LOG_CAPACITY : 0; pos < end; pos++)
+        {
+            if (read_slot(s, pos, record) != ReadResult::Ok)
+                continue;
+
+            line.append(record.timestamp_ns);
+            line.append(" ");
+            line.append(log_level_name(record.level));
+            line.append(" [libvesktop::");
+            line.append(record.subsystem);
+            line.append("] ");
+            line.append(record.message);
+            if (record.error_domain)
+            {
+                line.append(" (");
+                line.append(record.error_domain);
+                line.append(" ");
+                line.append(static_cast<int64_t>(record.error_code));
+                line.append(")");
+            }
+            line.flush(fd);
+        }
+    }
+
+    void on_fatal_signal(int signal_number, siginfo_t *info, void *context)
+    {
+        (void)context;
+
+        const int fd = state().crash_fd.exchange(-1);
+        if (fd >= 0)
+            dump_ring(fd, signal_number);
+
+        // Put back whoever was there before (Chromium's crash handler, or the
+        // default action). A fault re-executes the instruction and lands
+        // there with the real siginfo; a sent signal has to be raised again.
+        sigaction(signal_number, &previous_actions[signal_number], nullptr);
+        if (info == nullptr || info->si_code <= 0)
+            raise(signal_number);
+    }
+}
+
+bool log_enabled(LogLevel level)
+{
+    return static_cast<uint8_t>(level) >= state().min_level.load(std::memory_order_relaxed);
+}
+
+void set_log_level(LogLevel level)
+{
+    state().min_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+void log_message(LogLevel level, const char *subsystem, const GError *error, const char *format, ...)
+{
+    if (!log_enabled(level))
+        return;
+
+    LogState &s = state();
+    const uint64_t pos = s.head.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = s.slots[pos % LOG_CAPACITY];
+
+    slot.sequence.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    LogRecord &record = slot.record;
+    record.timestamp_ns = monotonic_ns();
+    record.subsystem = subsystem;
+    record.level = level;
+    record.error_domain = error ? g_quark_to_string(error->domain) : nullptr;
+    record.error_code = error ? error->code : 0;
+
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(record.message, sizeof(record.message), format, args);
+    va_end(args);
+
+    if (error && length >= 0 && static_cast<size_t>(length) < sizeof(record.message) - 1)
+        std::snprintf(record.message + length, sizeof(record.message) - length, ": %s", error->message);
+
+    slot.sequence.store(complete_sequence(pos), std::memory_order_release);
+
+    if (s.stderr_enabled.load(std::memory_order_relaxed))
+    {
+        s.stderr_pending.store(true, std::memory_order_relaxed);
+        s.stderr_cv.notify_one();
+    }
+}
+
+std::vector<LogRecord> drain_log(size_t max, uint64_t &lost)
+{
+    LogState &s = state();
+    std::vector<LogRecord> records;
+
+    std::lock_guard<std::mutex> lock(s.drain_mutex);
+    read_from(s, s.drain_cursor, max, lost, [&records](const LogRecord &record)
+    {
+        records.push_back(record);
+    });
+    return records;
+}
+
+void set_log_stderr(bool enabled)
+{
+    LogState &s = state();
+
+    std::lock_guard<std::mutex> lock(s.stderr_mutex);
+    s.stderr_enabled.store(enabled, std::memory_order_relaxed);
+
+    if (!enabled)
+    {
+        s.stderr_cv.notify_one();
+        return;
+    }
+
+    if (!s.stderr_running)
+    {
+        // only what is logged from now on; the backlog is for drain_log()
+        s.stderr_cursor = s.head.load(std::memory_order_acquire);
+        s.stderr_running = true;
+        std::thread(stderr_loop).detach();
+    }
+}
+
+bool set_log_crash_file(const std::string &path, std::string &error)
+{
+    LogState &s = state();
+    std::lock_guard<std::mutex> lock(s.crash_mutex);
+
+    int fd = -1;
+    if (!path.empty())
+    {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            error = "Failed to open " + path + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+
+    const int previous = s.crash_fd.exchange(fd);
+    if (previous >= 0)
+        close(previous);
+
+    if (fd >= 0 && !s.crash_handlers_installed)
+    {
+        struct sigaction action = {};
+        action.sa_sigaction = on_fatal_signal;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+
+        for (int signal_number : FATAL_SIGNALS)
+            sigaction(signal_number, &action, &previous_actions[signal_number]);
+        s.crash_handlers_installed = true;
+    }
+
+    return true;
+}
+
+uint64_t log_records_written()
+{
+    return state().head.load(std::memory_order_relaxed);
+}
+
+const char *log_level_name(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Debug:
+        return "debug";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Warning:
+        return "warning";
+    case LogLevel::Error:
+        return "error";
+    }
+    return "error";
+}
+
+bool parse_log_level(const std::string &name, LogLevel &level)
+{
+    for (LogLevel candidate : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Error})
+    {
+        if (name == log_level_name(candidate))
+        {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glib.h>
+#include <string>
+#include <vector>
+
+enum class LogLevel : uint8_t
+{
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+struct LogRecord
+{
+    static constexpr size_t MESSAGE_SIZE = 200;
+
+    // CLOCK_MONOTONIC, like monotonic_ns() in stats.h
+    uint64_t timestamp_ns;
+    // string literal naming the function, e.g. "StatusNotifierItem::flush"
+    const char *subsystem;
+    // interned GQuark string, so it stays valid forever; nullptr without a GError
+    const char *error_domain;
+    int32_t error_code;
+    LogLevel level;
+    // truncated, always NUL-terminated
+    char message[MESSAGE_SIZE];
+};
+
+// Fixed-size in-memory ring of the last LOG_CAPACITY records. Writers on any
+// thread claim a slot with one atomic increment and never block or allocate;
+// once the ring is full the oldest records are overwritten. Readers (the JS
+// drain, the optional stderr thread and the crash handler) each keep their
+// own cursor and count what was overwritten before they got to it.
+constexpr size_t LOG_CAPACITY = 1024;
+
+bool log_enabled(LogLevel level);
+void set_log_level(LogLevel level);
+
+// error may be null; its message is appended and its domain and code kept
+void log_message(LogLevel level, const char *subsystem, const GError *error, const char *format, ...)
+    G_GNUC_PRINTF(4, 5);
+
+// Records not yet seen by the JS reader, oldest first, at most max of them.
+// lost is incremented by the number overwritten since the previous drain.
+std::vector<LogRecord> drain_log(size_t max, uint64_t &lost);
+
+// Mirrors records to stderr from a background thread, so writers never wait
+// on a terminal or journald pipe. On by default once the addon is loaded.
+void set_log_stderr(bool enabled);
+
+// On SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT the whole ring is written to
+// path with async-signal-safe calls before the previous handler runs. An
+// empty path turns it off again.
+bool set_log_crash_file(const std::string &path, std::string &error);
+
+uint64_t log_records_written();
+
+const char *log_level_name(LogLevel level);
+bool parse_log_level(const std::string &name, LogLevel &level);
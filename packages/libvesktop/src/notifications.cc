@@ -0,0 +1,469 @@
+#include "notifications.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include "image_decoder.h"
+#include "native_log.h"
+#include "pixmap.h"
+#include "trace.h"
+
+namespace
+{
+    struct WindowContext
+    {
+        DesktopNotifications *self;
+        std::string channel;
+    };
+
+    struct NotifyContext
+    {
+        DesktopNotifications *self;
+        std::string channel;
+        uint64_t generation;
+    };
+}
+
+NotificationStats &notification_stats()
+{
+    static NotificationStats stats;
+    return stats;
+}
+
+DesktopNotifications::DesktopNotifications(DesktopNotificationsOptions opts)
+    : options(std::move(opts))
+{
+    GError *error = nullptr;
+    bus.reset(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
+
+    if (!bus)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "DesktopNotifications", error, "Failed to connect to session bus");
+    }
+}
+
+DesktopNotifications::~DesktopNotifications()
+{
+    if (cancellable)
+        g_cancellable_cancel(cancellable.get());
+
+    for (auto &entry : channels)
+    {
+        if (entry.second.window_timer != 0)
+            g_source_remove(entry.second.window_timer);
+    }
+
+    if (bus)
+    {
+        if (action_subscription != 0)
+            g_dbus_connection_signal_unsubscribe(bus.get(), action_subscription);
+        if (closed_subscription != 0)
+            g_dbus_connection_signal_unsubscribe(bus.get(), closed_subscription);
+    }
+
+    trim_image_cache();
+}
+
+bool DesktopNotifications::initialize()
+{
+    if (!bus)
+        return false;
+
+    cancellable.reset(g_cancellable_new());
+
+    action_subscription = g_dbus_connection_signal_subscribe(
+        bus.get(), NOTIFICATIONS_SERVICE, NOTIFICATIONS_INTERFACE, "ActionInvoked", NOTIFICATIONS_PATH, nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_signal, this, nullptr);
+    closed_subscription = g_dbus_connection_signal_subscribe(
+        bus.get(), NOTIFICATIONS_SERVICE, NOTIFICATIONS_INTERFACE, "NotificationClosed", NOTIFICATIONS_PATH, nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_signal, this, nullptr);
+
+    // until the answer is in, assume actions work and markup doesn't
+    g_dbus_connection_call(
+        bus.get(),
+        NOTIFICATIONS_SERVICE,
+        NOTIFICATIONS_PATH,
+        NOTIFICATIONS_INTERFACE,
+        "GetCapabilities",
+        nullptr,
+        G_VARIANT_TYPE("(as)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        cancellable.get(),
+        on_capabilities_reply,
+        this);
+
+    return true;
+}
+
+void DesktopNotifications::on_capabilities_reply(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GError *error = nullptr;
+    GVariantPtr reply(g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error));
+    GErrorPtr error_ptr(error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    if (!reply)
+    {
+        log_message(LogLevel::Warning, "DesktopNotifications::on_capabilities_reply", error, "GetCapabilities failed");
+        return;
+    }
+
+    auto *self = static_cast<DesktopNotifications *>(user_data);
+    GVariantIter *iter;
+    const gchar *capability;
+    bool actions = false;
+    bool markup = false;
+
+    g_variant_get(reply.get(), "(as)", &iter);
+    while (g_variant_iter_next(iter, "&s", &capability))
+    {
+        actions = actions || g_strcmp0(capability, "actions") == 0;
+        markup = markup || g_strcmp0(capability, "body-markup") == 0;
+    }
+    g_variant_iter_free(iter);
+
+    self->supports_actions = actions;
+    self->supports_markup = markup;
+}
+
+void DesktopNotifications::set_event_callback(EventCallback callback)
+{
+    event_callback = std::move(callback);
+}
+
+void DesktopNotifications::notify(const std::string &channel, DesktopNotification notification)
+{
+    if (!bus)
+        return;
+
+    auto [it, inserted] = channels.try_emplace(channel);
+    Channel &state = it->second;
+    if (inserted)
+        state.generation = next_generation++;
+
+    if (state.window_timer != 0)
+    {
+        // inside a burst: keep only the newest, it is sent when the window ends
+        state.held = std::move(notification);
+        state.held_count++;
+        notification_stats().coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    send(channel, notification);
+    start_window(channel);
+}
+
+void DesktopNotifications::close(const std::string &channel)
+{
+    auto it = channels.find(channel);
+    if (it == channels.end())
+        return;
+
+    Channel &state = it->second;
+    if (state.window_timer != 0)
+        g_source_remove(state.window_timer);
+
+    if (bus && state.replaces_id != 0)
+    {
+        id_to_channel.erase(state.replaces_id);
+        g_dbus_connection_call(
+            bus.get(),
+            NOTIFICATIONS_SERVICE,
+            NOTIFICATIONS_PATH,
+            NOTIFICATIONS_INTERFACE,
+            "CloseNotification",
+            g_variant_new("(u)", state.replaces_id),
+            nullptr,
+            G_DBUS_CALL_FLAGS_NONE,
+            -1,
+            nullptr,
+            nullptr,
+            nullptr);
+    }
+
+    channels.erase(it);
+}
+
+void DesktopNotifications::start_window(const std::string &channel)
+{
+    if (options.burst_window_ms == 0)
+        return;
+
+    channels[channel].window_timer = g_timeout_add_full(
+        G_PRIORITY_DEFAULT,
+        options.burst_window_ms,
+        on_window_end,
+        new WindowContext{this, channel},
+        [](gpointer data) { delete static_cast<WindowContext *>(data); });
+}
+
+gboolean DesktopNotifications::on_window_end(gpointer user_data)
+{
+    auto *context = static_cast<WindowContext *>(user_data);
+    auto *self = context->self;
+
+    auto it = self->channels.find(context->channel);
+    if (it == self->channels.end())
+        return G_SOURCE_REMOVE;
+
+    Channel &state = it->second;
+    if (!state.held)
+    {
+        state.window_timer = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    DesktopNotification notification = std::move(*state.held);
+    uint32_t count = state.held_count;
+    state.held.reset();
+    state.held_count = 0;
+
+    if (count > 1)
+    {
+        // everything after the first one of the burst, newest text shown
+        std::string summary = self->options.burst_summary;
+        size_t placeholder = summary.find("{count}");
+        if (placeholder != std::string::npos)
+            summary.replace(placeholder, 7, std::to_string(count));
+
+        notification.body = notification.summary + ": " + notification.body;
+        notification.summary = std::move(summary);
+    }
+
+    self->send(context->channel, notification);
+
+    // the burst may still be going; keep the window open for another round
+    return G_SOURCE_CONTINUE;
+}
+
+GVariant *DesktopNotifications::lookup_image(const DesktopNotification &notification)
+{
+    TRACE_SPAN("DesktopNotifications::lookup_image");
+    if (notification.image_key.empty())
+        return nullptr;
+
+    auto &stats = notification_stats();
+    auto found = image_index.find(notification.image_key);
+    if (found != image_index.end())
+    {
+        image_cache.splice(image_cache.begin(), image_cache, found->second);
+        stats.image_cache_hits.fetch_add(1, std::memory_order_relaxed);
+        return found->second->variant.get();
+    }
+
+    if (notification.image.empty())
+        return nullptr;
+
+    stats.image_cache_misses.fetch_add(1, std::memory_order_relaxed);
+
+    Pixmap pixmap;
+    std::string error;
+    if (!decode_image(notification.image.data(), notification.image.size(), MAX_IMAGE_SIZE, pixmap, error))
+    {
+        log_message(LogLevel::Warning, "DesktopNotifications::lookup_image", nullptr, "%s", error.c_str());
+        return nullptr;
+    }
+
+    if (pixmap.width > MAX_IMAGE_SIZE || pixmap.height > MAX_IMAGE_SIZE)
+    {
+        const double scale = static_cast<double>(MAX_IMAGE_SIZE) / std::max(pixmap.width, pixmap.height);
+        pixmap = scale_pixmap(pixmap, std::max<uint32_t>(1, static_cast<uint32_t>(pixmap.width * scale)),
+                              std::max<uint32_t>(1, static_cast<uint32_t>(pixmap.height * scale)));
+    }
+
+    std::vector<uint8_t> rgba = pixmap_to_rgba(pixmap);
+    GVariant *data = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, rgba.data(), rgba.size(), sizeof(uint8_t));
+    GVariant *variant = g_variant_ref_sink(g_variant_new(
+        "(iiibii@ay)",
+        static_cast<gint32>(pixmap.width),
+        static_cast<gint32>(pixmap.height),
+        static_cast<gint32>(pixmap.width * 4),
+        TRUE,
+        8,
+        4,
+        data));
+
+    image_cache.push_front(CachedImage{notification.image_key, GVariantPtr(variant), rgba.size()});
+    image_index[notification.image_key] = image_cache.begin();
+    image_cache_size += rgba.size();
+    evict_images();
+
+    return variant;
+}
+
+void DesktopNotifications::evict_images()
+{
+    // never evict the entry just inserted at the front
+    while (image_cache.size() > 1 &&
+           (image_cache.size() > options.image_cache_entries || image_cache_size > options.image_cache_bytes))
+    {
+        image_cache_size -= image_cache.back().bytes;
+        image_index.erase(image_cache.back().key);
+        image_cache.pop_back();
+    }
+
+    notification_stats().image_cache_bytes.store(image_cache_size, std::memory_order_relaxed);
+}
+
+void DesktopNotifications::trim_image_cache()
+{
+    image_index.clear();
+    image_cache.clear();
+    image_cache_size = 0;
+    notification_stats().image_cache_bytes.store(0, std::memory_order_relaxed);
+}
+
+void DesktopNotifications::send(const std::string &channel, const DesktopNotification &notification)
+{
+    TRACE_SPAN("DesktopNotifications::send", channel.c_str());
+    Channel &state = channels[channel];
+
+    GVariantBuilder actions;
+    g_variant_builder_init(&actions, G_VARIANT_TYPE("as"));
+    if (supports_actions)
+    {
+        for (const auto &action : notification.actions)
+        {
+            g_variant_builder_add(&actions, "s", action.id.c_str());
+            g_variant_builder_add(&actions, "s", action.label.c_str());
+        }
+    }
+
+    GVariantBuilder hints;
+    g_variant_builder_init(&hints, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&hints, "{sv}", "urgency", g_variant_new_byte(notification.urgency));
+    if (!notification.category.empty())
+        g_variant_builder_add(&hints, "{sv}", "category", g_variant_new_string(notification.category.c_str()));
+
+    // lets the server group us with our .desktop entry
+    if (const char *desktop = std::getenv("CHROME_DESKTOP"))
+    {
+        std::string entry = desktop;
+        if (entry.size() > 8 && entry.compare(entry.size() - 8, 8, ".desktop") == 0)
+            entry.resize(entry.size() - 8);
+        g_variant_builder_add(&hints, "{sv}", "desktop-entry", g_variant_new_string(entry.c_str()));
+    }
+
+    if (GVariant *image = lookup_image(notification))
+        g_variant_builder_add(&hints, "{sv}", "image-data", image);
+
+    gchar *escaped = supports_markup ? g_markup_escape_text(notification.body.c_str(), -1) : nullptr;
+
+    g_dbus_connection_call(
+        bus.get(),
+        NOTIFICATIONS_SERVICE,
+        NOTIFICATIONS_PATH,
+        NOTIFICATIONS_INTERFACE,
+        "Notify",
+        g_variant_new("(susssasa{sv}i)",
+                      options.app_name.c_str(),
+                      state.replaces_id,
+                      options.app_icon.c_str(),
+                      notification.summary.c_str(),
+                      escaped ? escaped : notification.body.c_str(),
+                      &actions,
+                      &hints,
+                      notification.timeout_ms),
+        G_VARIANT_TYPE("(u)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        cancellable.get(),
+        on_notify_reply,
+        new NotifyContext{this, channel, state.generation});
+
+    g_free(escaped);
+    notification_stats().sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DesktopNotifications::on_notify_reply(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    std::unique_ptr<NotifyContext> context(static_cast<NotifyContext *>(user_data));
+
+    GError *error = nullptr;
+    GVariantPtr reply(g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error));
+    GErrorPtr error_ptr(error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    auto *self = context->self;
+    if (!reply)
+    {
+        log_message(LogLevel::Warning, "DesktopNotifications::on_notify_reply", error, "Notify failed");
+        return;
+    }
+
+    auto it = self->channels.find(context->channel);
+    if (it == self->channels.end() || it->second.generation != context->generation)
+        return;
+
+    guint32 id;
+    g_variant_get(reply.get(), "(u)", &id);
+
+    Channel &state = it->second;
+    if (state.replaces_id != 0 && state.replaces_id != id)
+        self->id_to_channel.erase(state.replaces_id);
+    state.replaces_id = id;
+    self->id_to_channel[id] = context->channel;
+}
+
+void DesktopNotifications::on_signal(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                                     const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                                     gpointer user_data)
+{
+    TRACE_SPAN("DesktopNotifications::on_signal", signal_name);
+    (void)connection;
+    (void)sender_name;
+    (void)object_path;
+    (void)interface_name;
+
+    auto *self = static_cast<DesktopNotifications *>(user_data);
+    const bool invoked = g_strcmp0(signal_name, "ActionInvoked") == 0;
+
+    if (!g_variant_is_of_type(parameters, invoked ? G_VARIANT_TYPE("(us)") : G_VARIANT_TYPE("(uu)")))
+        return;
+
+    guint32 id;
+    g_variant_get_child(parameters, 0, "u", &id);
+
+    // ids are global to the server; anything not in the map isn't ours
+    auto owner = self->id_to_channel.find(id);
+    if (owner == self->id_to_channel.end())
+        return;
+
+    NotificationEvent event;
+    event.channel = owner->second;
+
+    if (invoked)
+    {
+        const gchar *action;
+        g_variant_get_child(parameters, 1, "&s", &action);
+        event.action = action;
+    }
+    else
+    {
+        guint32 reason;
+        g_variant_get_child(parameters, 1, "u", &reason);
+
+        auto channel = self->channels.find(owner->second);
+        if (channel != self->channels.end() && channel->second.replaces_id == id)
+        {
+            channel->second.replaces_id = 0;
+            channel->second.generation = self->next_generation++;
+        }
+        self->id_to_channel.erase(owner);
+
+        // expiry and our own CloseNotification aren't interesting to JS;
+        // 2 is "dismissed by the user"
+        if (reason != 2)
+            return;
+        event.action = "closed";
+    }
+
+    if (self->event_callback)
+        self->event_callback(std::move(event));
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <gio/gio.h>
+#include <list>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "glib_ptr.h"
+
+struct NotificationAction
+{
+    std::string id;
+    std::string label;
+};
+
+struct DesktopNotification
+{
+    std::string summary;
+    std::string body;
+    // cache key for image; the same key is assumed to mean the same picture
+    std::string image_key;
+    // encoded PNG/ICO bytes, only decoded on a cache miss
+    std::vector<uint8_t> image;
+    std::vector<NotificationAction> actions;
+    // 0 low, 1 normal, 2 critical
+    uint8_t urgency = 1;
+    // -1 server default, 0 never expire
+    int32_t timeout_ms = -1;
+    std::string category;
+};
+
+struct DesktopNotificationsOptions
+{
+    std::string app_name = "Equibop";
+    std::string app_icon = "equibop";
+    // further notifications on a channel within this window of the last one
+    // shown are folded into one summary when the window ends
+    uint32_t burst_window_ms = 1000;
+    // {count} is replaced with the number of notifications folded together
+    std::string burst_summary = "{count} new notifications";
+    size_t image_cache_entries = 64;
+    size_t image_cache_bytes = 4 * 1024 * 1024;
+};
+
+struct NotificationEvent
+{
+    std::string channel;
+    // the action id, or "closed" when the notification went away
+    std::string action;
+};
+
+struct NotificationStats
+{
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> image_cache_hits{0};
+    std::atomic<uint64_t> image_cache_misses{0};
+    std::atomic<uint64_t> image_cache_bytes{0};
+};
+
+NotificationStats &notification_stats();
+
+// org.freedesktop.Notifications client on the shared session connection.
+// Each channel (a DM, a guild channel...) keeps one notification on screen
+// that later ones replace, and bursts are folded into a summary instead of
+// stacking up. Runs on the default main context like StatusNotifierItem.
+class DesktopNotifications
+{
+public:
+    using EventCallback = std::function<void(NotificationEvent &&)>;
+
+    explicit DesktopNotifications(DesktopNotificationsOptions options = {});
+    ~DesktopNotifications();
+
+    DesktopNotifications(const DesktopNotifications &) = delete;
+    DesktopNotifications &operator=(const DesktopNotifications &) = delete;
+
+    bool initialize();
+    void notify(const std::string &channel, DesktopNotification notification);
+    void close(const std::string &channel);
+    void set_event_callback(EventCallback callback);
+
+    // drops every cached image-data variant
+    void trim_image_cache();
+
+private:
+    static constexpr const char *NOTIFICATIONS_SERVICE = "org.freedesktop.Notifications";
+    static constexpr const char *NOTIFICATIONS_PATH = "/org/freedesktop/Notifications";
+    static constexpr const char *NOTIFICATIONS_INTERFACE = "org.freedesktop.Notifications";
+    // avatars are scaled down to this before they are cached
+    static constexpr uint32_t MAX_IMAGE_SIZE = 128;
+
+    struct Channel
+    {
+        // id of the notification on screen, 0 if none
+        uint32_t replaces_id = 0;
+        // replaced when the notification goes away, so a Notify reply still
+        // in flight for an older one doesn't resurrect its id
+        uint64_t generation = 0;
+        guint window_timer = 0;
+        std::optional<DesktopNotification> held;
+        uint32_t held_count = 0;
+    };
+
+    struct CachedImage
+    {
+        std::string key;
+        GVariantPtr variant;
+        size_t bytes;
+    };
+
+    DesktopNotificationsOptions options;
+    GObjectPtr<GDBusConnection> bus;
+    GObjectPtr<GCancellable> cancellable;
+    guint action_subscription = 0;
+    guint closed_subscription = 0;
+    bool supports_actions = true;
+    bool supports_markup = false;
+    std::map<std::string, Channel> channels;
+    // notification id -> channel, for routing ActionInvoked/NotificationClosed
+    std::unordered_map<uint32_t, std::string> id_to_channel;
+    // most recently used at the front
+    std::list<CachedImage> image_cache;
+    std::unordered_map<std::string, std::list<CachedImage>::iterator> image_index;
+    size_t image_cache_size = 0;
+    uint64_t next_generation = 1;
+    EventCallback event_callback;
+
+    void send(const std::string &channel, const DesktopNotification &notification);
+    GVariant *lookup_image(const DesktopNotification &notification);
+    void evict_images();
+    void start_window(const std::string &channel);
+
+    static gboolean on_window_end(gpointer user_data);
+    static void on_notify_reply(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_capabilities_reply(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_signal(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                          const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                          gpointer user_data);
+};
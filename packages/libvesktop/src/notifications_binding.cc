@@ -0,0 +1,263 @@
+#include "notifications_binding.h"
+#include "event_batch.h"
+#include "memory_monitor.h"
+#include "notifications.h"
+#include "trace.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class DesktopNotificationsWrap : public Napi::ObjectWrap<DesktopNotificationsWrap>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    DesktopNotificationsWrap(const Napi::CallbackInfo &info);
+    ~DesktopNotificationsWrap();
+
+private:
+    std::unique_ptr<DesktopNotifications> notifications;
+    Napi::ThreadSafeFunction action_callback;
+    guint trimmer_id = 0;
+    std::shared_ptr<EventBatch<NotificationEvent>> batch = std::make_shared<EventBatch<NotificationEvent>>();
+
+    bool check_alive(Napi::Env env);
+    void release();
+
+    Napi::Value Notify(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+    Napi::Value OnAction(const Napi::CallbackInfo &info);
+    Napi::Value Destroy(const Napi::CallbackInfo &info);
+};
+
+Napi::Function DesktopNotificationsWrap::Define(Napi::Env env)
+{
+    return DefineClass(env, "DesktopNotifications", {
+        InstanceMethod("notify", &DesktopNotificationsWrap::Notify),
+        InstanceMethod("close", &DesktopNotificationsWrap::Close),
+        InstanceMethod("onAction", &DesktopNotificationsWrap::OnAction),
+        InstanceMethod("destroy", &DesktopNotificationsWrap::Destroy),
+    });
+}
+
+DesktopNotificationsWrap::DesktopNotificationsWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<DesktopNotificationsWrap>(info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && !info[0].IsObject() && !info[0].IsUndefined())
+    {
+        Napi::TypeError::New(env, "Expected (object?)").ThrowAsJavaScriptException();
+        return;
+    }
+
+    Napi::Object opts = info.Length() > 0 && info[0].IsObject() ? info[0].As<Napi::Object>() : Napi::Object::New(env);
+
+    DesktopNotificationsOptions options;
+    if (opts.Get("appName").IsString())
+        options.app_name = opts.Get("appName").As<Napi::String>().Utf8Value();
+    if (opts.Get("appIcon").IsString())
+        options.app_icon = opts.Get("appIcon").As<Napi::String>().Utf8Value();
+    if (opts.Get("burstWindowMs").IsNumber())
+        options.burst_window_ms = opts.Get("burstWindowMs").As<Napi::Number>().Uint32Value();
+    if (opts.Get("burstSummary").IsString())
+        options.burst_summary = opts.Get("burstSummary").As<Napi::String>().Utf8Value();
+    if (opts.Get("imageCacheEntries").IsNumber())
+        options.image_cache_entries = opts.Get("imageCacheEntries").As<Napi::Number>().Uint32Value();
+    if (opts.Get("imageCacheBytes").IsNumber())
+        options.image_cache_bytes = opts.Get("imageCacheBytes").As<Napi::Number>().Uint32Value();
+
+    notifications = std::make_unique<DesktopNotifications>(std::move(options));
+    if (!notifications->initialize())
+    {
+        notifications.reset();
+        Napi::Error::New(env, "Failed to connect to the notification service").ThrowAsJavaScriptException();
+        return;
+    }
+
+    // avatars come back from Discord's CDN, but each costs a decode and scale
+    DesktopNotifications *raw = notifications.get();
+    trimmer_id = MemoryMonitor::instance().add_trimmer("notification-images", MemoryPressure::Medium,
+                                                       [raw]() { raw->trim_image_cache(); });
+}
+
+DesktopNotificationsWrap::~DesktopNotificationsWrap()
+{
+    release();
+}
+
+void DesktopNotificationsWrap::release()
+{
+    if (trimmer_id)
+    {
+        MemoryMonitor::instance().remove_trimmer(trimmer_id);
+        trimmer_id = 0;
+    }
+
+    notifications.reset();
+
+    if (action_callback)
+    {
+        action_callback.Release();
+        action_callback = Napi::ThreadSafeFunction();
+    }
+}
+
+bool DesktopNotificationsWrap::check_alive(Napi::Env env)
+{
+    if (notifications)
+        return true;
+
+    Napi::Error::New(env, "DesktopNotifications has been destroyed").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value DesktopNotificationsWrap::Notify(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject())
+    {
+        Napi::TypeError::New(env, "Expected (string, object)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    Napi::Object obj = info[1].As<Napi::Object>();
+    auto get_string = [&obj](const char *key, std::string &out)
+    {
+        Napi::Value value = obj.Get(key);
+        if (value.IsString())
+            out = value.As<Napi::String>().Utf8Value();
+    };
+
+    DesktopNotification notification;
+    get_string("summary", notification.summary);
+    get_string("body", notification.body);
+    get_string("imageKey", notification.image_key);
+    get_string("category", notification.category);
+
+    Napi::Value image = obj.Get("image");
+    if (image.IsBuffer())
+    {
+        // without a key every call is a miss, so the image is only copied
+        // when it can be cached
+        Napi::Buffer<uint8_t> buffer = image.As<Napi::Buffer<uint8_t>>();
+        if (!notification.image_key.empty())
+            notification.image.assign(buffer.Data(), buffer.Data() + buffer.Length());
+    }
+
+    std::string urgency;
+    get_string("urgency", urgency);
+    notification.urgency = urgency == "low" ? 0 : urgency == "critical" ? 2 : 1;
+
+    if (obj.Get("timeoutMs").IsNumber())
+        notification.timeout_ms = obj.Get("timeoutMs").As<Napi::Number>().Int32Value();
+
+    Napi::Value actions = obj.Get("actions");
+    if (actions.IsArray())
+    {
+        Napi::Array array = actions.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++)
+        {
+            Napi::Value value = array.Get(i);
+            if (!value.IsObject())
+                continue;
+
+            Napi::Object action = value.As<Napi::Object>();
+            if (!action.Get("id").IsString())
+                continue;
+
+            NotificationAction entry;
+            entry.id = action.Get("id").As<Napi::String>().Utf8Value();
+            entry.label = action.Get("label").IsString() ? action.Get("label").As<Napi::String>().Utf8Value() : entry.id;
+            notification.actions.push_back(std::move(entry));
+        }
+    }
+
+    notifications->notify(info[0].As<Napi::String>().Utf8Value(), std::move(notification));
+    return env.Undefined();
+}
+
+Napi::Value DesktopNotificationsWrap::Close(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Expected (string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    notifications->close(info[0].As<Napi::String>().Utf8Value());
+    return env.Undefined();
+}
+
+Napi::Value DesktopNotificationsWrap::OnAction(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    if (action_callback)
+    {
+        action_callback.Release();
+    }
+
+    action_callback = Napi::ThreadSafeFunction::New(
+        env,
+        info[0].As<Napi::Function>(),
+        "NotificationActionCallback",
+        0,
+        1
+    );
+    action_callback.Unref(env);
+
+    auto events = batch;
+    notifications->set_event_callback([this, events](NotificationEvent &&event) {
+        if (!action_callback || !events->push(std::move(event)))
+            return;
+
+        // one JS call per burst of signals, however many piled up
+        action_callback.NonBlockingCall([events](Napi::Env env, Napi::Function jsCallback) {
+            TRACE_SPAN("DesktopNotifications::onAction dispatch");
+            std::vector<NotificationEvent> pending = events->drain();
+
+            Napi::Array array = Napi::Array::New(env, pending.size());
+            for (size_t i = 0; i < pending.size(); i++)
+            {
+                Napi::Object obj = Napi::Object::New(env);
+                obj.Set("channel", Napi::String::New(env, pending[i].channel));
+                obj.Set("action", Napi::String::New(env, pending[i].action));
+                array.Set(static_cast<uint32_t>(i), obj);
+            }
+
+            jsCallback.Call({array});
+        });
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value DesktopNotificationsWrap::Destroy(const Napi::CallbackInfo &info)
+{
+    release();
+    return info.Env().Undefined();
+}
+
+void InitNotificationsBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("DesktopNotifications", DesktopNotificationsWrap::Define(env));
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Exposes the desktop notification engine to JS as a class.
+void InitNotificationsBinding(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,162 @@
+#include "pixmap.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    struct Contribution
+    {
+        uint32_t first;
+        std::vector<float> weights;
+    };
+
+    std::vector<Contribution> compute_contributions(uint32_t src_size, uint32_t dst_size)
+    {
+        std::vector<Contribution> contributions(dst_size);
+        const double scale = static_cast<double>(src_size) / dst_size;
+
+        for (uint32_t o = 0; o < dst_size; o++)
+        {
+            double start = o * scale;
+            double end = std::min<double>((o + 1) * scale, src_size);
+            uint32_t first = static_cast<uint32_t>(std::floor(start));
+            uint32_t last = std::min<uint32_t>(static_cast<uint32_t>(std::ceil(end)), src_size);
+            if (last <= first)
+                last = first + 1;
+
+            auto &c = contributions[o];
+            c.first = first;
+            c.weights.reserve(last - first);
+
+            const double span = end - start;
+            for (uint32_t s = first; s < last; s++)
+            {
+                double covered = std::min<double>(end, s + 1) - std::max<double>(start, s);
+                c.weights.push_back(static_cast<float>(std::max(covered, 0.0) / span));
+            }
+        }
+
+        return contributions;
+    }
+}
+
+Pixmap scale_pixmap(const Pixmap &src, uint32_t width, uint32_t height)
+{
+    TRACE_SPAN("scale_pixmap");
+    if (src.width == width && src.height == height)
+        return src;
+
+    Pixmap dst;
+    dst.width = width;
+    dst.height = height;
+    dst.argb.assign(static_cast<size_t>(width) * height * 4, 0);
+
+    if (src.width == 0 || src.height == 0 || width == 0 || height == 0)
+        return dst;
+
+    const auto columns = compute_contributions(src.width, width);
+    const auto rows = compute_contributions(src.height, height);
+
+    // horizontal pass: src.height rows of `width` pixels
+    std::vector<float> tmp(static_cast<size_t>(width) * src.height * 4);
+    for (uint32_t y = 0; y < src.height; y++)
+    {
+        const uint8_t *src_row = src.argb.data() + static_cast<size_t>(y) * src.width * 4;
+        float *tmp_row = tmp.data() + static_cast<size_t>(y) * width * 4;
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const auto &c = columns[x];
+            float acc[4] = {0, 0, 0, 0};
+            for (size_t i = 0; i < c.weights.size(); i++)
+            {
+                const uint8_t *p = src_row + (c.first + i) * 4;
+                const float w = c.weights[i];
+                acc[0] += p[0] * w;
+                acc[1] += p[1] * w;
+                acc[2] += p[2] * w;
+                acc[3] += p[3] * w;
+            }
+            std::memcpy(tmp_row + x * 4, acc, sizeof(acc));
+        }
+    }
+
+    // vertical pass
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const auto &c = rows[y];
+        uint8_t *dst_row = dst.argb.data() + static_cast<size_t>(y) * width * 4;
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float acc[4] = {0, 0, 0, 0};
+            for (size_t i = 0; i < c.weights.size(); i++)
+            {
+                const float *p = tmp.data() + ((c.first + i) * static_cast<size_t>(width) + x) * 4;
+                const float w = c.weights[i];
+                acc[0] += p[0] * w;
+                acc[1] += p[1] * w;
+                acc[2] += p[2] * w;
+                acc[3] += p[3] * w;
+            }
+
+            for (int ch = 0; ch < 4; ch++)
+                dst_row[x * 4 + ch] = static_cast<uint8_t>(std::clamp(std::lround(acc[ch]), 0L, 255L));
+
+            // rounding can leave a colour channel a hair above alpha, which is
+            // not a valid premultiplied value
+            for (int ch = 1; ch < 4; ch++)
+                dst_row[x * 4 + ch] = std::min(dst_row[x * 4 + ch], dst_row[x * 4]);
+        }
+    }
+
+    return dst;
+}
+
+std::vector<uint8_t> serialize_pixmap(const Pixmap &pixmap)
+{
+    TRACE_SPAN("serialize_pixmap");
+    std::vector<uint8_t> out(PIXMAP_HEADER_SIZE + pixmap.argb.size());
+
+    uint32_t header[2] = {pixmap.width, pixmap.height};
+    for (int i = 0; i < 2; i++)
+    {
+        out[i * 4 + 0] = static_cast<uint8_t>(header[i]);
+        out[i * 4 + 1] = static_cast<uint8_t>(header[i] >> 8);
+        out[i * 4 + 2] = static_cast<uint8_t>(header[i] >> 16);
+        out[i * 4 + 3] = static_cast<uint8_t>(header[i] >> 24);
+    }
+
+    if (!pixmap.argb.empty())
+        std::memcpy(out.data() + PIXMAP_HEADER_SIZE, pixmap.argb.data(), pixmap.argb.size());
+
+    return out;
+}
+
+std::vector<uint8_t> pixmap_to_rgba(const Pixmap &pixmap)
+{
+    TRACE_SPAN("pixmap_to_rgba");
+    const size_t pixels = static_cast<size_t>(pixmap.width) * pixmap.height;
+    std::vector<uint8_t> out(pixels * 4);
+
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const uint8_t *src = pixmap.argb.data() + i * 4;
+        uint8_t *dst = out.data() + i * 4;
+        const uint8_t a = src[0];
+
+        if (a == 0)
+        {
+            dst[0] = dst[1] = dst[2] = dst[3] = 0;
+            continue;
+        }
+
+        for (int ch = 0; ch < 3; ch++)
+            dst[ch] = static_cast<uint8_t>(std::min(255, (src[ch + 1] * 255 + a / 2) / a));
+        dst[3] = a;
+    }
+
+    return out;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pixmaps cross the JS boundary as a Buffer laid out as
+// [u32 width LE][u32 height LE][premultiplied ARGB32 in network byte order],
+// which is what StatusNotifierItem::set_icon_pixmap expects.
+constexpr size_t PIXMAP_HEADER_SIZE = 8;
+
+struct Pixmap
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // premultiplied, 4 bytes per pixel in A, R, G, B order
+    std::vector<uint8_t> argb;
+};
+
+inline void store_premultiplied_argb(uint8_t *dst, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    dst[0] = a;
+    dst[1] = static_cast<uint8_t>((r * a + 127) / 255);
+    dst[2] = static_cast<uint8_t>((g * a + 127) / 255);
+    dst[3] = static_cast<uint8_t>((b * a + 127) / 255);
+}
+
+// Area-averaging resample. Works in premultiplied space, so transparent
+// pixels don't bleed colour into their neighbours.
+Pixmap scale_pixmap(const Pixmap &src, uint32_t width, uint32_t height);
+
+std::vector<uint8_t> serialize_pixmap(const Pixmap &pixmap);
+
+// Straight (non-premultiplied) RGBA, row after row with no padding, as used
+// by the image-data hint of org.freedesktop.Notifications.
+std::vector<uint8_t> pixmap_to_rgba(const Pixmap &pixmap);
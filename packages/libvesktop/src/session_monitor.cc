@@ -0,0 +1,214 @@
+#include "session_monitor.h"
+#include "native_log.h"
+#include "trace.h"
+#include <vector>
+
+SessionMonitor &SessionMonitor::instance()
+{
+    // never destroyed, so async replies and signal handlers can always
+    // assume it is alive
+    static SessionMonitor *monitor = new SessionMonitor();
+    return *monitor;
+}
+
+SessionMonitor::SessionMonitor()
+{
+    // both connect asynchronously; until they do we simply stay active
+    g_bus_get(G_BUS_TYPE_SYSTEM, nullptr, on_system_bus_ready, this);
+    g_bus_get(G_BUS_TYPE_SESSION, nullptr, on_session_bus_ready, this);
+}
+
+void SessionMonitor::on_system_bus_ready(GObject *, GAsyncResult *result, gpointer user_data)
+{
+    auto *self = static_cast<SessionMonitor *>(user_data);
+    GError *error = nullptr;
+    self->system_bus.reset(g_bus_get_finish(result, &error));
+
+    if (!self->system_bus)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "SessionMonitor", error, "System bus unavailable, not tracking sleep and lock");
+        return;
+    }
+
+    g_dbus_connection_signal_subscribe(
+        self->system_bus.get(), LOGIN1_SERVICE, LOGIN1_MANAGER_INTERFACE, "PrepareForSleep", LOGIN1_PATH, nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_signal, self, nullptr);
+
+    // "auto" resolves to the session of the caller, or the display
+    // session if the caller has none of its own
+    g_dbus_connection_call(
+        self->system_bus.get(),
+        LOGIN1_SERVICE,
+        LOGIN1_PATH,
+        LOGIN1_MANAGER_INTERFACE,
+        "GetSession",
+        g_variant_new("(s)", "auto"),
+        G_VARIANT_TYPE("(o)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        nullptr,
+        on_session_path_reply,
+        self);
+}
+
+void SessionMonitor::on_session_bus_ready(GObject *, GAsyncResult *result, gpointer user_data)
+{
+    auto *self = static_cast<SessionMonitor *>(user_data);
+    GError *error = nullptr;
+    self->session_bus.reset(g_bus_get_finish(result, &error));
+
+    if (!self->session_bus)
+    {
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "SessionMonitor", error, "Session bus unavailable, not tracking the screen saver");
+        return;
+    }
+
+    // the path differs between implementations, so match any
+    g_dbus_connection_signal_subscribe(
+        self->session_bus.get(), nullptr, SCREENSAVER_INTERFACE, "ActiveChanged", nullptr, nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_signal, self, nullptr);
+}
+
+guint SessionMonitor::add_listener(Listener listener)
+{
+    guint id = next_listener_id++;
+    listeners.emplace(id, std::move(listener));
+    return id;
+}
+
+void SessionMonitor::remove_listener(guint id)
+{
+    listeners.erase(id);
+}
+
+void SessionMonitor::set_state(bool &field, bool value)
+{
+    const bool was_active = active();
+    field = value;
+    if (active() == was_active)
+        return;
+
+    // a listener may remove itself or others while we are calling out
+    std::vector<guint> ids;
+    ids.reserve(listeners.size());
+    for (const auto &entry : listeners)
+        ids.push_back(entry.first);
+
+    const bool now_active = active();
+    for (guint id : ids)
+    {
+        auto it = listeners.find(id);
+        if (it != listeners.end())
+            it->second(now_active);
+    }
+}
+
+void SessionMonitor::on_session_path_reply(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GError *error = nullptr;
+    GVariantPtr reply(g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error));
+    GErrorPtr error_ptr(error);
+
+    if (!reply)
+    {
+        log_message(LogLevel::Warning, "SessionMonitor", error, "No logind session, not tracking lock state");
+        return;
+    }
+
+    auto *self = static_cast<SessionMonitor *>(user_data);
+    const gchar *path;
+    g_variant_get(reply.get(), "(&o)", &path);
+    self->session_path = path;
+
+    // Lock/Unlock only ask the screen locker to act, and an unlock at the
+    // greeter never sends Unlock; LockedHint is the actual state
+    g_dbus_connection_signal_subscribe(
+        self->system_bus.get(), LOGIN1_SERVICE, PROPERTIES_INTERFACE, "PropertiesChanged", path,
+        LOGIN1_SESSION_INTERFACE, G_DBUS_SIGNAL_FLAGS_NONE, on_signal, self, nullptr);
+
+    // we may have started behind a lock screen
+    self->read_locked_hint();
+}
+
+void SessionMonitor::read_locked_hint()
+{
+    g_dbus_connection_call(
+        system_bus.get(),
+        LOGIN1_SERVICE,
+        session_path.c_str(),
+        PROPERTIES_INTERFACE,
+        "Get",
+        g_variant_new("(ss)", LOGIN1_SESSION_INTERFACE, "LockedHint"),
+        G_VARIANT_TYPE("(v)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        nullptr,
+        on_locked_hint_reply,
+        this);
+}
+
+void SessionMonitor::on_locked_hint_reply(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GError *error = nullptr;
+    GVariantPtr reply(g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error));
+    GErrorPtr error_ptr(error);
+
+    if (!reply)
+        return;
+
+    GVariant *inner;
+    g_variant_get(reply.get(), "(v)", &inner);
+    GVariantPtr value(inner);
+
+    if (g_variant_is_of_type(value.get(), G_VARIANT_TYPE_BOOLEAN))
+    {
+        auto *self = static_cast<SessionMonitor *>(user_data);
+        self->set_state(self->locked, g_variant_get_boolean(value.get()));
+    }
+}
+
+void SessionMonitor::on_signal(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                               const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                               gpointer user_data)
+{
+    TRACE_SPAN("SessionMonitor::on_signal", signal_name);
+    (void)connection;
+    (void)sender_name;
+    (void)object_path;
+
+    auto *self = static_cast<SessionMonitor *>(user_data);
+
+    if (g_strcmp0(signal_name, "PropertiesChanged") == 0)
+    {
+        if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv}as)")))
+            return;
+
+        GVariantPtr changed(g_variant_get_child_value(parameters, 1));
+        gboolean locked_hint;
+        if (g_variant_lookup(changed.get(), "LockedHint", "b", &locked_hint))
+        {
+            self->set_state(self->locked, locked_hint);
+            return;
+        }
+
+        // logind may only say that it changed
+        GVariantPtr invalidated(g_variant_get_child_value(parameters, 2));
+        const gchar **names = g_variant_get_strv(invalidated.get(), nullptr);
+        const bool invalidates_hint = g_strv_contains(names, "LockedHint");
+        g_free(names);
+        if (invalidates_hint)
+            self->read_locked_hint();
+    }
+    else if (g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+    {
+        gboolean value;
+        g_variant_get(parameters, "(b)", &value);
+
+        if (g_strcmp0(interface_name, SCREENSAVER_INTERFACE) == 0)
+            self->set_state(self->screen_saver_active, value);
+        else
+            self->set_state(self->sleeping, value);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <gio/gio.h>
+#include <map>
+#include <string>
+#include "glib_ptr.h"
+
+// Tracks whether anyone can see the desktop: logind PrepareForSleep and the
+// session's LockedHint on the system bus, ScreenSaver.ActiveChanged on the
+// session bus. Emitters hold their signals while inactive and flush only
+// the final state from a listener once it turns active again.
+//
+// Created on first use, connecting to both buses asynchronously; signals are
+// dispatched on the thread-default main context of that moment, which is the
+// default context everywhere we use it. Without a system bus (sandboxes, CI)
+// it simply stays active.
+class SessionMonitor
+{
+public:
+    using Listener = std::function<void(bool active)>;
+
+    static SessionMonitor &instance();
+
+    bool active() const { return !sleeping && !locked && !screen_saver_active; }
+    bool is_sleeping() const { return sleeping; }
+    bool is_locked() const { return locked; }
+    bool is_screen_saver_active() const { return screen_saver_active; }
+
+    // called on every change of active(); returns an id for remove_listener
+    guint add_listener(Listener listener);
+    void remove_listener(guint id);
+
+private:
+    static constexpr const char *LOGIN1_SERVICE = "org.freedesktop.login1";
+    static constexpr const char *LOGIN1_PATH = "/org/freedesktop/login1";
+    static constexpr const char *LOGIN1_MANAGER_INTERFACE = "org.freedesktop.login1.Manager";
+    static constexpr const char *LOGIN1_SESSION_INTERFACE = "org.freedesktop.login1.Session";
+    static constexpr const char *SCREENSAVER_INTERFACE = "org.freedesktop.ScreenSaver";
+    static constexpr const char *PROPERTIES_INTERFACE = "org.freedesktop.DBus.Properties";
+
+    GObjectPtr<GDBusConnection> system_bus;
+    GObjectPtr<GDBusConnection> session_bus;
+    // our logind session, once GetSession has answered
+    std::string session_path;
+
+    bool sleeping = false;
+    bool locked = false;
+    bool screen_saver_active = false;
+
+    std::map<guint, Listener> listeners;
+    guint next_listener_id = 1;
+
+    SessionMonitor();
+
+    void set_state(bool &field, bool value);
+    void read_locked_hint();
+
+    static void on_system_bus_ready(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_session_bus_ready(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_session_path_reply(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_locked_hint_reply(GObject *source, GAsyncResult *result, gpointer user_data);
+    static void on_signal(GDBusConnection *connection, const gchar *sender_name, const gchar *object_path,
+                          const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+                          gpointer user_data);
+};
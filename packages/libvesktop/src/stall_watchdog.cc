@@ -0,0 +1,174 @@
+#include "stall_watchdog.h"
+#include "native_log.h"
+#include "stats.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <glib.h>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+
+namespace
+{
+    // Everything lives for the whole process: a heartbeat already being
+    // dispatched when the watchdog stops still finds its state.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    bool running = false;
+    StallWatchdogOptions options;
+
+    // set by the heartbeat on the dispatching thread
+    bool heartbeat_ran = false;
+    uint64_t heartbeat_ran_ns = 0;
+
+    uint64_t heartbeats = 0;
+    uint64_t stalls = 0;
+    uint64_t histogram[StallReport::BUCKET_COUNT] = {};
+    std::map<std::string, StallOffender> offenders;
+
+    gboolean on_heartbeat(gpointer)
+    {
+        // this is whichever thread dispatches the default context, Chromium's
+        // UI thread or the uv bridge; from now on its spans say what it's doing
+        mark_current_op_thread();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        heartbeat_ran = true;
+        heartbeat_ran_ns = monotonic_ns();
+        wake.notify_all();
+        return G_SOURCE_REMOVE;
+    }
+
+    void record(uint64_t posted_ns, uint64_t latency_ns, const char *culprit)
+    {
+        heartbeats++;
+
+        size_t bucket = 0;
+        while (bucket < StallReport::BUCKET_COUNT - 1 &&
+               latency_ns > StallReport::BUCKET_BOUNDS_MS[bucket] * 1000000ull)
+            bucket++;
+        histogram[bucket]++;
+
+        if (latency_ns <= options.threshold_ms * 1000000ull)
+            return;
+
+        stalls++;
+        const char *operation = culprit ? culprit : OUTSIDE_LIBVESKTOP;
+
+        auto [it, inserted] = offenders.try_emplace(operation);
+        StallOffender &offender = it->second;
+        offender.operation = operation;
+        offender.count++;
+        offender.total_ns += latency_ns;
+        offender.max_ns = std::max(offender.max_ns, latency_ns);
+
+        // shows up as its own row next to the span that caused it
+        if (tracing_enabled())
+            trace_detail::record("GLib stall", operation, posted_ns, posted_ns + latency_ns);
+
+        log_message(LogLevel::Info, "stall_watchdog", nullptr, "GMainContext stalled %.1fms in %s",
+                    latency_ns / 1e6, operation);
+    }
+
+    void run()
+    {
+        pthread_setname_np(pthread_self(), "vesktop-stall");
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running)
+        {
+            GSource *heartbeat = g_idle_source_new();
+            g_source_set_priority(heartbeat, G_PRIORITY_DEFAULT);
+            g_source_set_callback(heartbeat, on_heartbeat, nullptr, nullptr);
+            g_source_set_name(heartbeat, "libvesktop heartbeat");
+
+            heartbeat_ran = false;
+            const uint64_t posted_ns = monotonic_ns();
+            g_source_attach(heartbeat, g_main_context_default());
+
+            // Once the heartbeat is overdue, whatever span is open on the
+            // dispatching thread is what's holding the context. Keep sampling
+            // until one turns up, in case the stall started outside
+            // libvesktop and ended up in it.
+            const char *culprit = nullptr;
+            const auto threshold = std::chrono::milliseconds(options.threshold_ms);
+            while (running && !heartbeat_ran)
+            {
+                if (!wake.wait_for(lock, threshold, [] { return !running || heartbeat_ran; }) && !culprit)
+                    culprit = current_operation();
+            }
+
+            if (!heartbeat_ran)
+            {
+                g_source_destroy(heartbeat);
+                g_source_unref(heartbeat);
+                break;
+            }
+
+            g_source_unref(heartbeat);
+            record(posted_ns, heartbeat_ran_ns - posted_ns, culprit);
+
+            wake.wait_for(lock, std::chrono::milliseconds(options.interval_ms), [] { return !running; });
+        }
+    }
+}
+
+bool start_stall_watchdog(const StallWatchdogOptions &new_options, std::string &error)
+{
+    if (new_options.interval_ms == 0 || new_options.threshold_ms == 0)
+    {
+        error = "intervalMs and thresholdMs must be positive";
+        return false;
+    }
+
+    stop_stall_watchdog();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    options = new_options;
+    heartbeats = 0;
+    stalls = 0;
+    std::fill(std::begin(histogram), std::end(histogram), 0);
+    offenders.clear();
+
+    running = true;
+    thread = std::thread(run);
+    return true;
+}
+
+void stop_stall_watchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+            return;
+        running = false;
+        wake.notify_all();
+    }
+    thread.join();
+}
+
+StallReport stall_report(size_t max_offenders)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    StallReport report;
+    report.running = running;
+    report.heartbeats = heartbeats;
+    report.stalls = stalls;
+    std::copy(std::begin(histogram), std::end(histogram), report.histogram);
+
+    report.offenders.reserve(offenders.size());
+    for (const auto &[name, offender] : offenders)
+        report.offenders.push_back(offender);
+
+    std::sort(report.offenders.begin(), report.offenders.end(),
+              [](const StallOffender &a, const StallOffender &b) { return a.total_ns > b.total_ns; });
+    if (report.offenders.size() > max_offenders)
+        report.offenders.resize(max_offenders);
+
+    return report;
+}
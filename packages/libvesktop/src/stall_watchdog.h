@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Measures how long the default GMainContext takes to get around to a
+// heartbeat. A background thread attaches a G_PRIORITY_DEFAULT idle source
+// every interval and times how long it waits to be dispatched; anything
+// holding the context (a slow handler, a synchronous D-Bus call, or work
+// outside libvesktop entirely) shows up as heartbeat latency.
+//
+// While a heartbeat is overdue the thread samples current_operation() from
+// trace.h, so each stall is charged to the innermost libvesktop span open on
+// the dispatching thread, or to OUTSIDE_LIBVESKTOP when there was none.
+
+struct StallWatchdogOptions
+{
+    uint32_t interval_ms = 250;
+    // heartbeats waiting longer than this count as stalls
+    uint32_t threshold_ms = 50;
+};
+
+struct StallOffender
+{
+    const char *operation;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+struct StallReport
+{
+    // upper bounds of the latency histogram buckets; the last bucket is
+    // everything above the final bound
+    static constexpr uint32_t BUCKET_BOUNDS_MS[] = {1, 4, 16, 50, 100, 250, 1000};
+    static constexpr size_t BUCKET_COUNT = sizeof(BUCKET_BOUNDS_MS) / sizeof(BUCKET_BOUNDS_MS[0]) + 1;
+
+    bool running = false;
+    uint64_t heartbeats = 0;
+    uint64_t stalls = 0;
+    uint64_t histogram[BUCKET_COUNT] = {};
+    // sorted by total stall time, worst first
+    std::vector<StallOffender> offenders;
+};
+
+constexpr const char *OUTSIDE_LIBVESKTOP = "(outside libvesktop)";
+
+// Starting again restarts with the new options and an empty report.
+bool start_stall_watchdog(const StallWatchdogOptions &options, std::string &error);
+void stop_stall_watchdog();
+
+// at most max_offenders offenders; the counts keep going until the next start
+StallReport stall_report(size_t max_offenders);
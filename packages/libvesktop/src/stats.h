@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+// Counters read by getLibVesktopStats. Writers may be on any thread.
+
+inline uint64_t monotonic_ns()
+{
+    // CLOCK_MONOTONIC is what libuv's hrtime and process.hrtime() use, so
+    // timestamps can be compared from JS
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+struct LatencyStats
+{
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> last_ns{0};
+
+    void record(uint64_t ns)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(ns, std::memory_order_relaxed);
+        last_ns.store(ns, std::memory_order_relaxed);
+
+        uint64_t current = max_ns.load(std::memory_order_relaxed);
+        while (ns > current && !max_ns.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+};
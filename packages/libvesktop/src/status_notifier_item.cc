@@ -1,29 +1,14 @@
 #include "status_notifier_item.h"
-#include <iostream>
+#include "dbus_recorder.h"
+#include "native_log.h"
+#include "session_monitor.h"
+#include "trace.h"
 #include <cstring>
+#include <algorithm>
 #include <unistd.h>
 
-struct GVariantDeleter
-{
-    void operator()(GVariant *variant) const
-    {
-        if (variant)
-            g_variant_unref(variant);
-    }
-};
-
-using GVariantPtr = std::unique_ptr<GVariant, GVariantDeleter>;
-
-struct GErrorDeleter
-{
-    void operator()(GError *error) const
-    {
-        if (error)
-            g_error_free(error);
-    }
-};
-
-using GErrorPtr = std::unique_ptr<GError, GErrorDeleter>;
+std::vector<StatusNotifierItem *> StatusNotifierItem::live_items;
+guint StatusNotifierItem::shared_watcher_id = 0;
 
 const char *StatusNotifierItem::introspection_xml = R"XML(
 <node>
@@ -56,6 +41,7 @@ const char *StatusNotifierItem::introspection_xml = R"XML(
     </method>
     <signal name="NewIcon"/>
     <signal name="NewTitle"/>
+    <signal name="NewToolTip"/>
     <signal name="NewStatus">
       <arg type="s" name="status"/>
     </signal>
@@ -132,14 +118,48 @@ void StatusNotifierItem::handle_method_call(
     GDBusMethodInvocation *invocation,
     gpointer user_data)
 {
+    TRACE_SPAN("StatusNotifierItem::handle_method_call", method_name);
     (void)connection;
     (void)sender;
     (void)object_path;
-    (void)interface_name;
-    (void)parameters;
 
     auto *self = static_cast<StatusNotifierItem *>(user_data);
 
+    // Without a get_property vtable entry GDBus forwards Properties calls here,
+    // which lets Get/GetAll be answered from the prebuilt snapshot
+    if (g_strcmp0(interface_name, PROPERTIES_INTERFACE) == 0)
+    {
+        GVariant *snapshot = self->properties_snapshot();
+
+        if (g_strcmp0(method_name, "GetAll") == 0)
+        {
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(@a{sv})", snapshot));
+        }
+        else if (g_strcmp0(method_name, "Get") == 0)
+        {
+            const gchar *property_name;
+            g_variant_get(parameters, "(&s&s)", nullptr, &property_name);
+            TRACE_SPAN("StatusNotifierItem::Get", property_name);
+
+            GVariantPtr value(g_variant_lookup_value(snapshot, property_name, nullptr));
+            if (value)
+            {
+                g_dbus_method_invocation_return_value(invocation, g_variant_new("(v)", value.get()));
+            }
+            else
+            {
+                g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "No such property '%s'", property_name);
+            }
+        }
+        else
+        {
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_PROPERTY_READ_ONLY,
+                "Properties of %s are read-only", SNI_INTERFACE);
+        }
+        return;
+    }
+
     if (g_strcmp0(method_name, "Activate") == 0)
     {
         if (self->activate_callback)
@@ -150,44 +170,71 @@ void StatusNotifierItem::handle_method_call(
     }
     else if (g_strcmp0(method_name, "SecondaryActivate") == 0)
     {
+        gint32 x = 0, y = 0;
+        g_variant_get(parameters, "(ii)", &x, &y);
+        if (self->secondary_activate_callback)
+        {
+            self->secondary_activate_callback(x, y);
+        }
         g_dbus_method_invocation_return_value(invocation, nullptr);
     }
     else if (g_strcmp0(method_name, "ContextMenu") == 0)
     {
+        gint32 x = 0, y = 0;
+        g_variant_get(parameters, "(ii)", &x, &y);
+        if (self->context_menu_callback)
+        {
+            self->context_menu_callback(x, y);
+        }
         g_dbus_method_invocation_return_value(invocation, nullptr);
     }
     else if (g_strcmp0(method_name, "Scroll") == 0)
     {
+        gint32 delta = 0;
+        const gchar *orientation = nullptr;
+        g_variant_get(parameters, "(i&s)", &delta, &orientation);
+        self->accumulate_scroll(delta, orientation);
         g_dbus_method_invocation_return_value(invocation, nullptr);
     }
 }
 
-GVariant *StatusNotifierItem::handle_get_property(
-    GDBusConnection *connection,
-    const gchar *sender,
-    const gchar *object_path,
-    const gchar *interface_name,
-    const gchar *property_name,
-    GError **error,
-    gpointer user_data)
+GVariant *StatusNotifierItem::build_icon_pixmap() const
 {
-    auto *self = static_cast<StatusNotifierItem *>(user_data);
+    TRACE_SPAN("StatusNotifierItem::build_icon_pixmap");
+    if (current_icon_pixmap.size() < 8)
+        return g_variant_new_array(G_VARIANT_TYPE("(iiay)"), nullptr, 0);
+
+    int width, height;
+    memcpy(&width, current_icon_pixmap.data(), 4);
+    memcpy(&height, current_icon_pixmap.data() + 4, 4);
+
+    GVariant *data = g_variant_new_fixed_array(
+        G_VARIANT_TYPE_BYTE,
+        current_icon_pixmap.data() + 8,
+        current_icon_pixmap.size() - 8,
+        sizeof(uint8_t));
 
+    GVariant *entry = g_variant_new("(ii@ay)", width, height, data);
+    return g_variant_new_array(G_VARIANT_TYPE("(iiay)"), &entry, 1);
+}
+
+GVariant *StatusNotifierItem::build_property(const gchar *property_name)
+{
     if (g_strcmp0(property_name, "Category") == 0)
     {
-        return g_variant_new_string("Communications");
+        return g_variant_new_string(category.c_str());
     }
     else if (g_strcmp0(property_name, "Id") == 0)
     {
-        return g_variant_new_string("equibop");
+        return g_variant_new_string(item_id.c_str());
     }
     else if (g_strcmp0(property_name, "Title") == 0)
     {
-        return g_variant_new_string(self->current_title.c_str());
+        return g_variant_new_string(current_title.c_str());
     }
     else if (g_strcmp0(property_name, "Status") == 0)
     {
-        return g_variant_new_string(self->current_status.c_str());
+        return g_variant_new_string(current_status.c_str());
     }
     else if (g_strcmp0(property_name, "IconName") == 0)
     {
@@ -195,31 +242,11 @@ GVariant *StatusNotifierItem::handle_get_property(
     }
     else if (g_strcmp0(property_name, "IconPixmap") == 0)
     {
-        if (!self->current_icon_pixmap.empty() && self->current_icon_pixmap.size() >= 8)
-        {
-            GVariantBuilder builder;
-            g_variant_builder_init(&builder, G_VARIANT_TYPE("a(iiay)"));
-
-            int width, height;
-            memcpy(&width, self->current_icon_pixmap.data(), 4);
-            memcpy(&height, self->current_icon_pixmap.data() + 4, 4);
-
-            GVariantBuilder data_builder;
-            g_variant_builder_init(&data_builder, G_VARIANT_TYPE("ay"));
-
-            for (size_t i = 8; i < self->current_icon_pixmap.size(); i++)
-            {
-                g_variant_builder_add(&data_builder, "y", self->current_icon_pixmap[i]);
-            }
-
-            g_variant_builder_add(&builder, "(ii@ay)",
-                width,
-                height,
-                g_variant_builder_end(&data_builder));
-
-            return g_variant_builder_end(&builder);
-        }
-        return g_variant_new_array(G_VARIANT_TYPE("(iiay)"), nullptr, 0);
+        // copying the pixels is the expensive part, so keep that around
+        // across title/status changes
+        if (!icon_pixmap_variant)
+            icon_pixmap_variant.reset(g_variant_ref_sink(build_icon_pixmap()));
+        return icon_pixmap_variant.get();
     }
     else if (g_strcmp0(property_name, "AttentionIconName") == 0)
     {
@@ -229,11 +256,11 @@ GVariant *StatusNotifierItem::handle_get_property(
     {
         GVariantBuilder builder;
         g_variant_builder_init(&builder, G_VARIANT_TYPE("(sa(iiay)ss)"));
-        g_variant_builder_add(&builder, "s", "equibop");
+        g_variant_builder_add(&builder, "s", item_id.c_str());
         g_variant_builder_open(&builder, G_VARIANT_TYPE("a(iiay)"));
         g_variant_builder_close(&builder);
-        g_variant_builder_add(&builder, "s", self->current_title.c_str());
-        g_variant_builder_add(&builder, "s", "");
+        g_variant_builder_add(&builder, "s", current_title.c_str());
+        g_variant_builder_add(&builder, "s", current_tooltip.c_str());
         return g_variant_builder_end(&builder);
     }
     else if (g_strcmp0(property_name, "ItemIsMenu") == 0)
@@ -242,12 +269,56 @@ GVariant *StatusNotifierItem::handle_get_property(
     }
     else if (g_strcmp0(property_name, "Menu") == 0)
     {
-        return g_variant_new_object_path(self->menu_object_path.c_str());
+        return g_variant_new_object_path(menu_object_path.c_str());
     }
 
     return nullptr;
 }
 
+GVariant *StatusNotifierItem::properties_snapshot()
+{
+    TRACE_SPAN("StatusNotifierItem::properties_snapshot");
+    if (!snapshot)
+    {
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+        GDBusInterfaceInfo *interface_info = sni_interface_info();
+        for (GDBusPropertyInfo **prop = interface_info->properties; prop && *prop; prop++)
+        {
+            GVariant *value = build_property((*prop)->name);
+            if (value)
+                g_variant_builder_add(&builder, "{sv}", (*prop)->name, value);
+        }
+
+        snapshot.reset(g_variant_ref_sink(g_variant_builder_end(&builder)));
+    }
+
+    return snapshot.get();
+}
+
+namespace
+{
+    // replies that never change, built once and handed out by reference
+    GVariant *empty_int_array()
+    {
+        static GVariant *array = g_variant_ref_sink(g_variant_new_array(G_VARIANT_TYPE_INT32, nullptr, 0));
+        return array;
+    }
+
+    GVariant *root_group_properties()
+    {
+        static GVariant *properties = []()
+        {
+            GVariantBuilder builder;
+            g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+            g_variant_builder_add(&builder, "{sv}", "children-display", g_variant_new_string("submenu"));
+            return g_variant_ref_sink(g_variant_builder_end(&builder));
+        }();
+        return properties;
+    }
+}
+
 void StatusNotifierItem::handle_menu_method_call(
     GDBusConnection *connection,
     const gchar *sender,
@@ -258,6 +329,7 @@ void StatusNotifierItem::handle_menu_method_call(
     GDBusMethodInvocation *invocation,
     gpointer user_data)
 {
+    TRACE_SPAN("StatusNotifierItem::handle_menu_method_call", method_name);
     (void)connection;
     (void)sender;
     (void)object_path;
@@ -265,111 +337,43 @@ void StatusNotifierItem::handle_menu_method_call(
 
     auto *self = static_cast<StatusNotifierItem *>(user_data);
 
+    // Arguments are read in place (&s, fixed arrays) and unused ones are
+    // skipped, so handling a call doesn't copy anything out of the message
+
     if (g_strcmp0(method_name, "GetLayout") == 0)
     {
-        gint32 parent_id;
-        gint32 recursion_depth;
-        GVariantIter *property_names_iter;
-        g_variant_get(parameters, "(iias)", &parent_id, &recursion_depth, &property_names_iter);
-        g_variant_iter_free(property_names_iter);
-
-        GVariantBuilder layout_builder;
-        g_variant_builder_init(&layout_builder, G_VARIANT_TYPE("(ia{sv}av)"));
-
-        g_variant_builder_add(&layout_builder, "i", 0);
-
-        GVariantBuilder props_builder;
-        g_variant_builder_init(&props_builder, G_VARIANT_TYPE("a{sv}"));
-        g_variant_builder_add(&layout_builder, "a{sv}", &props_builder);
-
-        GVariantBuilder children_builder;
-        g_variant_builder_init(&children_builder, G_VARIANT_TYPE("av"));
-
-        for (const auto &item : self->menu_items)
-        {
-
-            GVariantBuilder item_builder;
-            g_variant_builder_init(&item_builder, G_VARIANT_TYPE("(ia{sv}av)"));
-
-            g_variant_builder_add(&item_builder, "i", item.id);
-
-            GVariantBuilder item_props_builder;
-            g_variant_builder_init(&item_props_builder, G_VARIANT_TYPE("a{sv}"));
-
-            if (item.is_separator)
-            {
-                g_variant_builder_add(&item_props_builder, "{sv}", "type", g_variant_new_string("separator"));
-                g_variant_builder_add(&item_props_builder, "{sv}", "visible", g_variant_new_boolean(item.visible));
-            }
-            else
-            {
-                g_variant_builder_add(&item_props_builder, "{sv}", "label", g_variant_new_string(item.label.c_str()));
-                g_variant_builder_add(&item_props_builder, "{sv}", "enabled", g_variant_new_boolean(item.enabled));
-                g_variant_builder_add(&item_props_builder, "{sv}", "visible", g_variant_new_boolean(item.visible));
-                g_variant_builder_add(&item_props_builder, "{sv}", "toggle-type", g_variant_new_string(""));
-            }
-
-            g_variant_builder_add(&item_builder, "a{sv}", &item_props_builder);
-
-            GVariantBuilder empty_children;
-            g_variant_builder_init(&empty_children, G_VARIANT_TYPE("av"));
-            g_variant_builder_add(&item_builder, "av", &empty_children);
-
-            g_variant_builder_add(&children_builder, "v", g_variant_builder_end(&item_builder));
-        }
-
-        g_variant_builder_add(&layout_builder, "av", &children_builder);
-
+        // the menu is flat and every property is always sent, so parentId,
+        // recursionDepth and propertyNames don't change the answer
         g_dbus_method_invocation_return_value(invocation,
-            g_variant_new("(u@(ia{sv}av))", self->menu_revision, g_variant_builder_end(&layout_builder)));
+            g_variant_new("(u@(ia{sv}av))", self->menu_revision, self->menu_layout()));
     }
     else if (g_strcmp0(method_name, "Event") == 0)
     {
         gint32 id;
         const gchar *event_id;
-        GVariant *data;
-        guint32 timestamp;
-        g_variant_get(parameters, "(isvu)", &id, &event_id, &data, &timestamp);
+        g_variant_get(parameters, "(i&s@vu)", &id, &event_id, nullptr, nullptr);
 
-        if (g_strcmp0(event_id, "clicked") == 0)
-        {
-            if (self->menu_click_callback)
-            {
-                self->menu_click_callback(id);
-            }
-        }
+        if (g_strcmp0(event_id, "clicked") == 0 && self->menu_click_callback)
+            self->menu_click_callback(id);
 
-        g_variant_unref(data);
         g_dbus_method_invocation_return_value(invocation, nullptr);
     }
     else if (g_strcmp0(method_name, "EventGroup") == 0)
     {
-        GVariantIter *events_iter;
-        g_variant_get(parameters, "(a(isvu))", &events_iter);
+        GVariantPtr events(g_variant_get_child_value(parameters, 0));
 
-        GVariantBuilder errors_builder;
-        g_variant_builder_init(&errors_builder, G_VARIANT_TYPE("ai"));
+        GVariantIter iter;
+        g_variant_iter_init(&iter, events.get());
 
         gint32 id;
         const gchar *event_id;
-        GVariant *data;
-        guint32 timestamp;
-
-        while (g_variant_iter_next(events_iter, "(isvu)", &id, &event_id, &data, &timestamp))
+        while (g_variant_iter_next(&iter, "(i&s@vu)", &id, &event_id, nullptr, nullptr))
         {
-            if (g_strcmp0(event_id, "clicked") == 0)
-            {
-                if (self->menu_click_callback)
-                {
-                    self->menu_click_callback(id);
-                }
-            }
-            g_variant_unref(data);
+            if (g_strcmp0(event_id, "clicked") == 0 && self->menu_click_callback)
+                self->menu_click_callback(id);
         }
 
-        g_variant_iter_free(events_iter);
-        g_dbus_method_invocation_return_value(invocation,
-            g_variant_new("(@ai)", g_variant_builder_end(&errors_builder)));
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(@ai)", empty_int_array()));
     }
     else if (g_strcmp0(method_name, "AboutToShow") == 0)
     {
@@ -377,112 +381,115 @@ void StatusNotifierItem::handle_menu_method_call(
     }
     else if (g_strcmp0(method_name, "AboutToShowGroup") == 0)
     {
-        GVariantIter *ids_iter;
-        g_variant_get(parameters, "(ai)", &ids_iter);
-        g_variant_iter_free(ids_iter);
-
-        GVariantBuilder updates_builder;
-        g_variant_builder_init(&updates_builder, G_VARIANT_TYPE("ai"));
-
-        GVariantBuilder errors_builder;
-        g_variant_builder_init(&errors_builder, G_VARIANT_TYPE("ai"));
-
         g_dbus_method_invocation_return_value(invocation,
-            g_variant_new("(@ai@ai)", g_variant_builder_end(&updates_builder), g_variant_builder_end(&errors_builder)));
+            g_variant_new("(@ai@ai)", empty_int_array(), empty_int_array()));
     }
     else if (g_strcmp0(method_name, "GetGroupProperties") == 0)
     {
-        GVariantIter *ids_iter;
-        GVariantIter *property_names_iter;
-        g_variant_get(parameters, "(aias)", &ids_iter, &property_names_iter);
+        GVariantPtr ids_variant(g_variant_get_child_value(parameters, 0));
+        gsize id_count;
+        const auto *ids = static_cast<const gint32 *>(
+            g_variant_get_fixed_array(ids_variant.get(), &id_count, sizeof(gint32)));
 
-        std::vector<int32_t> requested_ids;
-        gint32 id;
-        while (g_variant_iter_next(ids_iter, "i", &id))
+        // an empty list asks for everything
+        auto requested = [ids, id_count](gint32 id)
         {
-            requested_ids.push_back(id);
-        }
+            return id_count == 0 || std::find(ids, ids + id_count, id) != ids + id_count;
+        };
+
+        const auto &properties = self->menu_properties();
 
-        g_variant_iter_free(ids_iter);
-        g_variant_iter_free(property_names_iter);
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ia{sv})"));
 
-        GVariantBuilder props_builder;
-        g_variant_builder_init(&props_builder, G_VARIANT_TYPE("a(ia{sv})"));
+        if (requested(0))
+            g_variant_builder_add(&builder, "(i@a{sv})", 0, root_group_properties());
 
-        bool root_requested = false;
-        for (auto rid : requested_ids)
+        for (size_t i = 0; i < self->menu_items.size(); i++)
         {
-            if (rid == 0)
-            {
-                root_requested = true;
-                break;
-            }
+            if (requested(self->menu_items[i].id))
+                g_variant_builder_add(&builder, "(i@a{sv})", self->menu_items[i].id, properties[i].get());
         }
 
-        if (root_requested || requested_ids.empty())
-        {
-            GVariantBuilder root_builder;
-            g_variant_builder_init(&root_builder, G_VARIANT_TYPE("(ia{sv})"));
-            g_variant_builder_add(&root_builder, "i", 0);
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(@a(ia{sv}))", g_variant_builder_end(&builder)));
+    }
+    else if (g_strcmp0(method_name, "GetProperty") == 0)
+    {
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(v)", g_variant_new_string("")));
+    }
+}
 
-            GVariantBuilder root_props;
-            g_variant_builder_init(&root_props, G_VARIANT_TYPE("a{sv}"));
-            g_variant_builder_add(&root_props, "{sv}", "children-display", g_variant_new_string("submenu"));
+void StatusNotifierItem::invalidate_menu_cache()
+{
+    menu_item_properties.clear();
+    menu_layout_cache.reset();
+}
 
-            g_variant_builder_add(&root_builder, "@a{sv}", g_variant_builder_end(&root_props));
-            g_variant_builder_add(&props_builder, "@(ia{sv})", g_variant_builder_end(&root_builder));
-        }
+void StatusNotifierItem::trim_caches()
+{
+    snapshot.reset();
+    icon_pixmap_variant.reset();
+    invalidate_menu_cache();
+    menu_item_properties.shrink_to_fit();
+}
 
-        for (const auto &item : self->menu_items)
+const std::vector<GVariantPtr> &StatusNotifierItem::menu_properties()
+{
+    if (menu_item_properties.size() == menu_items.size())
+        return menu_item_properties;
+
+    menu_item_properties.clear();
+    menu_item_properties.reserve(menu_items.size());
+
+    for (const auto &item : menu_items)
+    {
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+        if (item.is_separator)
         {
-            if (!requested_ids.empty())
-            {
-                bool found = false;
-                for (auto req_id : requested_ids)
-                {
-                    if (req_id == item.id)
-                    {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found)
-                {
-                    continue;
-                }
-            }
+            g_variant_builder_add(&builder, "{sv}", "type", g_variant_new_string("separator"));
+            g_variant_builder_add(&builder, "{sv}", "visible", g_variant_new_boolean(item.visible));
+        }
+        else
+        {
+            g_variant_builder_add(&builder, "{sv}", "label", g_variant_new_string(item.label.c_str()));
+            g_variant_builder_add(&builder, "{sv}", "enabled", g_variant_new_boolean(item.enabled));
+            g_variant_builder_add(&builder, "{sv}", "visible", g_variant_new_boolean(item.visible));
+            g_variant_builder_add(&builder, "{sv}", "toggle-type", g_variant_new_string(""));
+        }
 
-            GVariantBuilder item_builder;
-            g_variant_builder_init(&item_builder, G_VARIANT_TYPE("(ia{sv})"));
-            g_variant_builder_add(&item_builder, "i", item.id);
+        menu_item_properties.emplace_back(g_variant_ref_sink(g_variant_builder_end(&builder)));
+    }
 
-            GVariantBuilder item_props;
-            g_variant_builder_init(&item_props, G_VARIANT_TYPE("a{sv}"));
+    return menu_item_properties;
+}
 
-            if (item.is_separator)
-            {
-                g_variant_builder_add(&item_props, "{sv}", "type", g_variant_new_string("separator"));
-                g_variant_builder_add(&item_props, "{sv}", "visible", g_variant_new_boolean(item.visible));
-            }
-            else
-            {
-                g_variant_builder_add(&item_props, "{sv}", "label", g_variant_new_string(item.label.c_str()));
-                g_variant_builder_add(&item_props, "{sv}", "enabled", g_variant_new_boolean(item.enabled));
-                g_variant_builder_add(&item_props, "{sv}", "visible", g_variant_new_boolean(item.visible));
-                g_variant_builder_add(&item_props, "{sv}", "toggle-type", g_variant_new_string(""));
-            }
+GVariant *StatusNotifierItem::menu_layout()
+{
+    TRACE_SPAN("StatusNotifierItem::menu_layout");
+    if (menu_layout_cache)
+        return menu_layout_cache.get();
 
-            g_variant_builder_add(&item_builder, "@a{sv}", g_variant_builder_end(&item_props));
-            g_variant_builder_add(&props_builder, "@(ia{sv})", g_variant_builder_end(&item_builder));
+    const auto &properties = menu_properties();
 
-        }
+    GVariantBuilder children;
+    g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
 
-        g_dbus_method_invocation_return_value(invocation, g_variant_new("(@a(ia{sv}))", g_variant_builder_end(&props_builder)));
-    }
-    else if (g_strcmp0(method_name, "GetProperty") == 0)
+    for (size_t i = 0; i < menu_items.size(); i++)
     {
-        g_dbus_method_invocation_return_value(invocation, g_variant_new("(v)", g_variant_new_string("")));
+        g_variant_builder_add(&children, "v",
+            g_variant_new("(i@a{sv}@av)", menu_items[i].id, properties[i].get(),
+                          g_variant_new_array(G_VARIANT_TYPE_VARIANT, nullptr, 0)));
     }
+
+    menu_layout_cache.reset(g_variant_ref_sink(g_variant_new(
+        "(i@a{sv}@av)",
+        0,
+        g_variant_new_array(G_VARIANT_TYPE("{sv}"), nullptr, 0),
+        g_variant_builder_end(&children))));
+
+    return menu_layout_cache.get();
 }
 
 GVariant *StatusNotifierItem::handle_menu_get_property(
@@ -494,6 +501,7 @@ GVariant *StatusNotifierItem::handle_menu_get_property(
     GError **error,
     gpointer user_data)
 {
+    TRACE_SPAN("StatusNotifierItem::handle_menu_get_property", property_name);
     (void)connection;
     (void)sender;
     (void)object_path;
@@ -523,36 +531,92 @@ GVariant *StatusNotifierItem::handle_menu_get_property(
     return nullptr;
 }
 
-StatusNotifierItem::StatusNotifierItem()
+GDBusInterfaceInfo *StatusNotifierItem::sni_interface_info()
 {
+    static GDBusNodeInfo *node_info = nullptr;
+    if (!node_info)
+    {
+        GError *error = nullptr;
+        node_info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+        if (!node_info)
+        {
+            GErrorPtr error_ptr(error);
+            log_message(LogLevel::Error, "StatusNotifierItem::sni_interface_info", error, "Invalid introspection XML");
+            return nullptr;
+        }
+    }
+    return node_info->interfaces[0];
+}
+
+GDBusInterfaceInfo *StatusNotifierItem::menu_interface_info()
+{
+    static GDBusNodeInfo *node_info = nullptr;
+    if (!node_info)
+    {
+        GError *error = nullptr;
+        node_info = g_dbus_node_info_new_for_xml(menu_introspection_xml, &error);
+        if (!node_info)
+        {
+            GErrorPtr error_ptr(error);
+            log_message(LogLevel::Error, "StatusNotifierItem::menu_interface_info", error, "Invalid introspection XML");
+            return nullptr;
+        }
+    }
+    return node_info->interfaces[0];
+}
+
+StatusNotifierItem::StatusNotifierItem(StatusNotifierItemOptions options)
+    : item_id(std::move(options.id)),
+      category(std::move(options.category)),
+      service_name(std::move(options.service_name)),
+      object_path(std::move(options.object_path)),
+      menu_object_path(std::move(options.menu_object_path)),
+      current_title(std::move(options.title))
+{
+    // g_bus_get_sync hands out the process-wide session connection, so every
+    // item shares it
     GError *error = nullptr;
     bus.reset(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error));
 
     if (!bus)
     {
         GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "StatusNotifierItem", error, "Failed to connect to session bus");
         return;
     }
-
-    service_name = "org.equicord.equibop.StatusNotifierItem";
-    object_path = "/StatusNotifierItem";
 }
 
 StatusNotifierItem::~StatusNotifierItem()
 {
-    if (bus)
+    cancel_registration();
+
+    if (scroll_flush_id != 0)
+        g_source_remove(scroll_flush_id);
+
+    if (session_listener_id != 0)
+        SessionMonitor::instance().remove_listener(session_listener_id);
+
+    if (subscribed_to_watcher)
     {
-        if (watcher_id != 0)
+        live_items.erase(std::remove(live_items.begin(), live_items.end(), this), live_items.end());
+        if (live_items.empty() && shared_watcher_id != 0)
         {
-            g_dbus_connection_signal_unsubscribe(bus.get(), watcher_id);
+            g_dbus_connection_signal_unsubscribe(bus.get(), shared_watcher_id);
+            shared_watcher_id = 0;
         }
+    }
+
+    if (bus)
+    {
         if (menu_registration_id != 0)
         {
             g_dbus_connection_unregister_object(bus.get(), menu_registration_id);
+            dbus_recorder_unregister_path(menu_object_path);
         }
         if (registration_id != 0)
         {
             g_dbus_connection_unregister_object(bus.get(), registration_id);
+            dbus_recorder_unregister_path(object_path);
         }
         if (owner_id != 0)
         {
@@ -570,68 +634,130 @@ bool StatusNotifierItem::initialize()
 
     static GDBusInterfaceVTable vtable = {
         handle_method_call,
-        handle_get_property,
+        nullptr,
         nullptr,
         {}
     };
 
-    GDBusNodeInfo *node_info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
-    if (!node_info)
-    {
-        GErrorPtr error_ptr(error);
+    GDBusInterfaceInfo *interface_info = sni_interface_info();
+    if (!interface_info)
         return false;
-    }
 
     registration_id = g_dbus_connection_register_object(
         bus.get(),
         object_path.c_str(),
-        node_info->interfaces[0],
+        interface_info,
         &vtable,
         this,
         nullptr,
         &error);
 
-    g_dbus_node_info_unref(node_info);
-
     if (registration_id == 0)
     {
         GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "StatusNotifierItem::initialize", error, "Failed to export %s", object_path.c_str());
         return false;
     }
 
-    GBusNameOwnerFlags flags = static_cast<GBusNameOwnerFlags>(
-        G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT | G_BUS_NAME_OWNER_FLAGS_REPLACE);
-
-    owner_id = g_bus_own_name_on_connection(
-        bus.get(),
-        service_name.c_str(),
-        flags,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr);
+    dbus_recorder_register_path(object_path, TraceTarget::Item);
 
-    if (owner_id == 0)
+    if (!service_name.empty())
     {
-        return false;
+        GBusNameOwnerFlags flags = static_cast<GBusNameOwnerFlags>(
+            G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT | G_BUS_NAME_OWNER_FLAGS_REPLACE);
+
+        owner_id = g_bus_own_name_on_connection(
+            bus.get(),
+            service_name.c_str(),
+            flags,
+            nullptr,
+            nullptr,
+            nullptr,
+            nullptr);
+
+        if (owner_id == 0)
+        {
+            return false;
+        }
     }
 
     subscribe_to_watcher();
 
+    session_listener_id = SessionMonitor::instance().add_listener([this](bool active)
+    {
+        if (!active)
+            return;
+
+        flush_pending_signals();
+        if (menu_layout_pending)
+            emit_layout_updated();
+    });
+
     return true;
 }
 
-bool StatusNotifierItem::register_with_watcher()
+const char *StatusNotifierItem::registration_state_name(RegistrationState state)
 {
-    if (!bus || registered_with_watcher)
-        return true;
+    switch (state)
+    {
+    case RegistrationState::Unregistered:
+        return "unregistered";
+    case RegistrationState::Pending:
+        return "pending";
+    case RegistrationState::Registered:
+        return "registered";
+    case RegistrationState::Failed:
+        return "failed";
+    }
+    return "unregistered";
+}
 
-    GError *error = nullptr;
+const char *StatusNotifierItem::scroll_orientation_name(ScrollOrientation orientation)
+{
+    return orientation == ScrollOrientation::Horizontal ? "horizontal" : "vertical";
+}
+
+void StatusNotifierItem::set_registration_state(RegistrationState state)
+{
+    if (registration_state == state)
+        return;
+
+    registration_state = state;
+    if (registration_state_callback)
+        registration_state_callback(state);
+}
+
+void StatusNotifierItem::cancel_registration()
+{
+    if (registration_cancellable)
+    {
+        g_cancellable_cancel(registration_cancellable.get());
+        registration_cancellable.reset();
+    }
+    if (registration_retry_id != 0)
+    {
+        g_source_remove(registration_retry_id);
+        registration_retry_id = 0;
+    }
+}
 
+void StatusNotifierItem::register_with_watcher()
+{
+    if (!bus || registration_state == RegistrationState::Pending || registration_state == RegistrationState::Registered)
+        return;
+
+    // Watchers assume DEFAULT_OBJECT_PATH when given a bus name. Every other
+    // item shares our connection, so it registers by object path instead and
+    // the watcher pairs that with the sender.
     const gchar *unique_name = g_dbus_connection_get_unique_name(bus.get());
-    const char *register_name = unique_name ? unique_name : service_name.c_str();
+    const char *register_name = object_path.c_str();
+    if (object_path == DEFAULT_OBJECT_PATH)
+        register_name = unique_name ? unique_name : service_name.c_str();
+
+    registration_cancellable.reset(g_cancellable_new());
+    set_registration_state(RegistrationState::Pending);
 
-    GVariantPtr reply(g_dbus_connection_call_sync(
+    g_dbus_connection_call(
         bus.get(),
         WATCHER_SERVICE,
         WATCHER_PATH,
@@ -640,91 +766,203 @@ bool StatusNotifierItem::register_with_watcher()
         g_variant_new("(s)", register_name),
         nullptr,
         G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        nullptr,
-        &error));
+        REGISTER_TIMEOUT_MS,
+        registration_cancellable.get(),
+        on_register_reply,
+        this);
+}
+
+void StatusNotifierItem::on_register_reply(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    TRACE_SPAN("StatusNotifierItem::on_register_reply");
+    GError *error = nullptr;
+    GVariantPtr reply(g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error));
+    GErrorPtr error_ptr(error);
+
+    // the item may already be gone, don't touch it
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
 
-    if (!reply)
+    auto *self = static_cast<StatusNotifierItem *>(user_data);
+    self->registration_cancellable.reset();
+
+    if (reply)
     {
-        GErrorPtr error_ptr(error);
-        return false;
+        self->registration_attempts = 0;
+        self->set_registration_state(RegistrationState::Registered);
+        self->pending_signals |= PENDING_NEW_STATUS;
+        self->flush_pending_signals();
+        return;
     }
 
-    g_dbus_connection_emit_signal(
-        bus.get(),
-        nullptr,
-        object_path.c_str(),
-        SNI_INTERFACE,
-        "NewStatus",
-        g_variant_new("(s)", "Active"),
-        nullptr);
+    // No watcher at all: wait for one to show up via NameOwnerChanged rather
+    // than polling for it
+    if (g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN) ||
+        g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER))
+    {
+        log_message(LogLevel::Info, "StatusNotifierItem::on_register_reply", error, "No StatusNotifierWatcher");
+        self->set_registration_state(RegistrationState::Unregistered);
+        return;
+    }
 
-    registered_with_watcher = true;
-    return true;
+    if (++self->registration_attempts >= REGISTER_MAX_ATTEMPTS)
+    {
+        log_message(LogLevel::Error, "StatusNotifierItem::on_register_reply", error,
+                    "Giving up on the watcher after %u attempts", self->registration_attempts);
+        self->set_registration_state(RegistrationState::Failed);
+        return;
+    }
+
+    log_message(LogLevel::Warning, "StatusNotifierItem::on_register_reply", error,
+                "RegisterStatusNotifierItem failed (attempt %u)", self->registration_attempts);
+
+    guint delay = std::min<guint>(REGISTER_BACKOFF_BASE_MS << (self->registration_attempts - 1), REGISTER_BACKOFF_MAX_MS);
+    self->set_registration_state(RegistrationState::Unregistered);
+    self->registration_retry_id = g_timeout_add(delay, on_registration_retry, self);
 }
 
-bool StatusNotifierItem::set_icon_pixmap(const std::vector<uint8_t> &pixmap_data)
+gboolean StatusNotifierItem::on_registration_retry(gpointer user_data)
 {
-    if (!bus)
-        return false;
+    auto *self = static_cast<StatusNotifierItem *>(user_data);
+    self->registration_retry_id = 0;
+    self->register_with_watcher();
+    return G_SOURCE_REMOVE;
+}
 
-    current_icon_pixmap = pixmap_data;
+bool StatusNotifierItem::emit_item_signal(const char *signal_name, GVariant *parameters)
+{
+    GError *error = nullptr;
+    gboolean result = g_dbus_connection_emit_signal(
+        bus.get(),
+        nullptr,
+        object_path.c_str(),
+        SNI_INTERFACE,
+        signal_name,
+        parameters,
+        &error);
 
-    if (!registered_with_watcher)
-    {
-        if (!register_with_watcher())
-        {
-            return false;
-        }
-    }
-    else
+    if (!result || error)
     {
-        GError *error = nullptr;
-        gboolean result = g_dbus_connection_emit_signal(
-            bus.get(),
-            nullptr,
-            object_path.c_str(),
-            SNI_INTERFACE,
-            "NewIcon",
-            nullptr,
-            &error);
-
-        if (!result || error)
-        {
-            GErrorPtr error_ptr(error);
-            return false;
-        }
+        GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "StatusNotifierItem::emit_item_signal", error, "Failed to emit %s", signal_name);
+        return false;
     }
 
     return true;
 }
 
-bool StatusNotifierItem::set_title(const std::string &title)
+bool StatusNotifierItem::emit_properties_changed(uint32_t changed)
 {
-    if (!bus || title == current_title)
-        return true;
+    // Hosts that understand PropertiesChanged get the new values inline and
+    // can skip the Get/GetAll round-trip the bare New* signals force on them
+    GVariant *values = properties_snapshot();
 
-    current_title = title;
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    auto add = [&](const char *name)
+    {
+        GVariantPtr value(g_variant_lookup_value(values, name, nullptr));
+        if (value)
+            g_variant_builder_add(&builder, "{sv}", name, value.get());
+    };
+
+    if (changed & PENDING_NEW_ICON)
+        add("IconPixmap");
+    if (changed & PENDING_NEW_TITLE)
+        add("Title");
+    if (changed & (PENDING_NEW_TITLE | PENDING_NEW_TOOLTIP))
+        add("ToolTip");
+    if (changed & PENDING_NEW_STATUS)
+        add("Status");
 
     GError *error = nullptr;
     gboolean result = g_dbus_connection_emit_signal(
         bus.get(),
         nullptr,
         object_path.c_str(),
-        SNI_INTERFACE,
-        "NewTitle",
-        nullptr,
+        PROPERTIES_INTERFACE,
+        "PropertiesChanged",
+        g_variant_new("(s@a{sv}@as)", SNI_INTERFACE, g_variant_builder_end(&builder), g_variant_new_strv(nullptr, 0)),
         &error);
 
     if (!result || error)
     {
         GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "StatusNotifierItem::emit_properties_changed", error,
+                    "Failed to emit PropertiesChanged");
         return false;
     }
 
     return true;
 }
 
+bool StatusNotifierItem::flush_pending_signals()
+{
+    // nobody is listening until the watcher knows about us; whatever changes
+    // in the meantime goes out as a single signal per property afterwards
+    if (registration_state != RegistrationState::Registered)
+        return true;
+
+    // nobody can see the tray while locked or asleep; the listener added in
+    // initialize() sends the final state on resume
+    if (!SessionMonitor::instance().active())
+        return true;
+
+    if (pending_signals == 0)
+        return true;
+
+    bool ok = true;
+    if (pending_signals & PENDING_NEW_ICON)
+        ok &= emit_item_signal("NewIcon", nullptr);
+    if (pending_signals & PENDING_NEW_TITLE)
+        ok &= emit_item_signal("NewTitle", nullptr);
+    if (pending_signals & PENDING_NEW_TOOLTIP)
+        ok &= emit_item_signal("NewToolTip", nullptr);
+    if (pending_signals & PENDING_NEW_STATUS)
+        ok &= emit_item_signal("NewStatus", g_variant_new("(s)", current_status.c_str()));
+
+    ok &= emit_properties_changed(pending_signals);
+
+    pending_signals = 0;
+    return ok;
+}
+
+bool StatusNotifierItem::set_icon_pixmap(const std::vector<uint8_t> &pixmap_data)
+{
+    TRACE_SPAN("StatusNotifierItem::set_icon_pixmap");
+    if (!bus)
+        return false;
+
+    current_icon_pixmap = pixmap_data;
+    icon_pixmap_variant.reset();
+    snapshot.reset();
+    pending_signals |= PENDING_NEW_ICON;
+
+    // the first icon is what makes the item worth showing
+    if (registration_state == RegistrationState::Unregistered && registration_retry_id == 0)
+        register_with_watcher();
+
+    return flush_pending_signals();
+}
+
+bool StatusNotifierItem::set_title(const std::string &title)
+{
+    if (!bus || title == current_title)
+        return true;
+
+    current_title = title;
+    snapshot.reset();
+    pending_signals |= PENDING_NEW_TITLE;
+
+    return flush_pending_signals();
+}
+
+void StatusNotifierItem::set_registration_state_callback(std::function<void(RegistrationState)> callback)
+{
+    registration_state_callback = callback;
+}
+
 bool StatusNotifierItem::register_menu()
 {
     if (!bus || menu_registration_id != 0)
@@ -741,30 +979,29 @@ bool StatusNotifierItem::register_menu()
         {}
     };
 
-    GDBusNodeInfo *node_info = g_dbus_node_info_new_for_xml(menu_introspection_xml, &error);
-    if (!node_info)
-    {
-        GErrorPtr error_ptr(error);
+    GDBusInterfaceInfo *interface_info = menu_interface_info();
+    if (!interface_info)
         return false;
-    }
 
     menu_registration_id = g_dbus_connection_register_object(
         bus.get(),
         menu_object_path.c_str(),
-        node_info->interfaces[0],
+        interface_info,
         &menu_vtable,
         this,
         nullptr,
         &error);
 
-    g_dbus_node_info_unref(node_info);
-
     if (menu_registration_id == 0)
     {
         GErrorPtr error_ptr(error);
+        log_message(LogLevel::Error, "StatusNotifierItem::register_menu", error, "Failed to export %s",
+                    menu_object_path.c_str());
         return false;
     }
 
+    dbus_recorder_register_path(menu_object_path, TraceTarget::Menu);
+
     return true;
 }
 
@@ -775,12 +1012,26 @@ bool StatusNotifierItem::set_menu(const std::vector<MenuItem> &items)
 
     menu_items = items;
     menu_revision++;
+    invalidate_menu_cache();
 
     if (!register_menu())
     {
         return false;
     }
 
+    return emit_layout_updated();
+}
+
+bool StatusNotifierItem::emit_layout_updated()
+{
+    if (!SessionMonitor::instance().active())
+    {
+        menu_layout_pending = true;
+        return true;
+    }
+
+    menu_layout_pending = false;
+
     GError *error = nullptr;
     gboolean result = g_dbus_connection_emit_signal(
         bus.get(),
@@ -794,6 +1045,7 @@ bool StatusNotifierItem::set_menu(const std::vector<MenuItem> &items)
     if (!result || error)
     {
         GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "StatusNotifierItem::emit_layout_updated", error, "Failed to emit LayoutUpdated");
         return false;
     }
 
@@ -820,6 +1072,15 @@ bool StatusNotifierItem::update_menu_item_label(int32_t id, const std::string &n
         return false;
 
     menu_revision++;
+    invalidate_menu_cache();
+
+    // a label change while inactive is folded into the LayoutUpdated sent
+    // on resume, which makes hosts refetch everything anyway
+    if (menu_layout_pending || !SessionMonitor::instance().active())
+    {
+        menu_layout_pending = true;
+        return true;
+    }
 
     GVariantBuilder updated_props_builder;
     g_variant_builder_init(&updated_props_builder, G_VARIANT_TYPE("a(ia{sv})"));
@@ -835,6 +1096,11 @@ bool StatusNotifierItem::update_menu_item_label(int32_t id, const std::string &n
     g_variant_builder_add(&item_builder, "@a{sv}", g_variant_builder_end(&props_builder));
     g_variant_builder_add(&updated_props_builder, "@(ia{sv})", g_variant_builder_end(&item_builder));
 
+    return emit_items_properties_updated(g_variant_builder_end(&updated_props_builder));
+}
+
+bool StatusNotifierItem::emit_items_properties_updated(GVariant *updated_props)
+{
     GVariantBuilder removed_props_builder;
     g_variant_builder_init(&removed_props_builder, G_VARIANT_TYPE("a(ias)"));
 
@@ -846,19 +1112,131 @@ bool StatusNotifierItem::update_menu_item_label(int32_t id, const std::string &n
         DBUSMENU_INTERFACE,
         "ItemsPropertiesUpdated",
         g_variant_new("(@a(ia{sv})@a(ias))",
-                      g_variant_builder_end(&updated_props_builder),
+                      updated_props,
                       g_variant_builder_end(&removed_props_builder)),
         &error);
 
     if (!result || error)
     {
         GErrorPtr error_ptr(error);
+        log_message(LogLevel::Warning, "StatusNotifierItem::emit_items_properties_updated", error,
+                    "Failed to emit ItemsPropertiesUpdated");
         return false;
     }
 
     return true;
 }
 
+bool StatusNotifierItem::is_valid_status(const std::string &status)
+{
+    return status == "Active" || status == "Passive" || status == "NeedsAttention";
+}
+
+bool StatusNotifierItem::apply_update(const StatusNotifierItemUpdate &update, std::string &error)
+{
+    TRACE_SPAN("StatusNotifierItem::apply_update");
+    if (!bus)
+        return false;
+
+    if (update.status && !is_valid_status(*update.status))
+    {
+        error = "Invalid status '" + *update.status + "'";
+        return false;
+    }
+
+    std::vector<MenuItem *> patched;
+    patched.reserve(update.menu_patch.size());
+    for (const auto &patch : update.menu_patch)
+    {
+        auto it = std::find_if(menu_items.begin(), menu_items.end(),
+                               [&patch](const MenuItem &item) { return item.id == patch.id; });
+        if (it == menu_items.end())
+        {
+            error = "No menu item with id " + std::to_string(patch.id);
+            return false;
+        }
+        patched.push_back(&*it);
+    }
+
+    // nothing below can fail, so from here on the whole update lands
+
+    if (update.icon_pixmap)
+    {
+        current_icon_pixmap = *update.icon_pixmap;
+        icon_pixmap_variant.reset();
+        pending_signals |= PENDING_NEW_ICON;
+    }
+    if (update.title && *update.title != current_title)
+    {
+        current_title = *update.title;
+        pending_signals |= PENDING_NEW_TITLE;
+    }
+    if (update.status && *update.status != current_status)
+    {
+        current_status = *update.status;
+        pending_signals |= PENDING_NEW_STATUS;
+    }
+    if (update.tooltip && *update.tooltip != current_tooltip)
+    {
+        current_tooltip = *update.tooltip;
+        pending_signals |= PENDING_NEW_TOOLTIP;
+    }
+    snapshot.reset();
+
+    bool ok = true;
+    if (!patched.empty())
+    {
+        GVariantBuilder updated_props_builder;
+        g_variant_builder_init(&updated_props_builder, G_VARIANT_TYPE("a(ia{sv})"));
+
+        for (size_t i = 0; i < patched.size(); i++)
+        {
+            const MenuItemPatch &patch = update.menu_patch[i];
+            MenuItem &item = *patched[i];
+
+            GVariantBuilder props_builder;
+            g_variant_builder_init(&props_builder, G_VARIANT_TYPE_VARDICT);
+            if (patch.label)
+            {
+                item.label = *patch.label;
+                g_variant_builder_add(&props_builder, "{sv}", "label", g_variant_new_string(item.label.c_str()));
+            }
+            if (patch.enabled)
+            {
+                item.enabled = *patch.enabled;
+                g_variant_builder_add(&props_builder, "{sv}", "enabled", g_variant_new_boolean(item.enabled));
+            }
+            if (patch.visible)
+            {
+                item.visible = *patch.visible;
+                g_variant_builder_add(&props_builder, "{sv}", "visible", g_variant_new_boolean(item.visible));
+            }
+            g_variant_builder_add(&updated_props_builder, "(i@a{sv})", item.id, g_variant_builder_end(&props_builder));
+        }
+
+        menu_revision++;
+        invalidate_menu_cache();
+
+        // same as update_menu_item_label: while inactive it all goes out
+        // with the LayoutUpdated sent on resume
+        if (menu_layout_pending || !SessionMonitor::instance().active())
+        {
+            g_variant_builder_clear(&updated_props_builder);
+            menu_layout_pending = true;
+        }
+        else
+        {
+            ok &= emit_items_properties_updated(g_variant_builder_end(&updated_props_builder));
+        }
+    }
+
+    if (update.icon_pixmap && registration_state == RegistrationState::Unregistered && registration_retry_id == 0)
+        register_with_watcher();
+
+    ok &= flush_pending_signals();
+    return ok;
+}
+
 void StatusNotifierItem::set_menu_click_callback(std::function<void(int32_t)> callback)
 {
     menu_click_callback = callback;
@@ -869,6 +1247,60 @@ void StatusNotifierItem::set_activate_callback(std::function<void()> callback)
     activate_callback = callback;
 }
 
+void StatusNotifierItem::set_secondary_activate_callback(std::function<void(int32_t, int32_t)> callback)
+{
+    secondary_activate_callback = callback;
+}
+
+void StatusNotifierItem::set_context_menu_callback(std::function<void(int32_t, int32_t)> callback)
+{
+    context_menu_callback = callback;
+}
+
+void StatusNotifierItem::set_scroll_callback(std::function<void(int32_t, ScrollOrientation)> callback)
+{
+    scroll_callback = callback;
+}
+
+void StatusNotifierItem::accumulate_scroll(int32_t delta, const gchar *orientation)
+{
+    if (delta == 0 || !scroll_callback)
+        return;
+
+    // the spec says "horizontal"/"vertical" but KDE capitalizes them
+    const auto index = static_cast<size_t>(
+        g_ascii_strcasecmp(orientation, "horizontal") == 0 ? ScrollOrientation::Horizontal : ScrollOrientation::Vertical);
+    scroll_accumulated[index] += delta;
+
+    if (scroll_flush_id == 0)
+        scroll_flush_id = g_timeout_add(SCROLL_FLUSH_MS, on_scroll_flush, this);
+}
+
+gboolean StatusNotifierItem::on_scroll_flush(gpointer user_data)
+{
+    TRACE_SPAN("StatusNotifierItem::on_scroll_flush");
+    auto *self = static_cast<StatusNotifierItem *>(user_data);
+    self->scroll_flush_id = 0;
+    self->flush_scroll();
+    return G_SOURCE_REMOVE;
+}
+
+void StatusNotifierItem::flush_scroll()
+{
+    for (auto orientation : {ScrollOrientation::Horizontal, ScrollOrientation::Vertical})
+    {
+        int64_t &accumulated = scroll_accumulated[static_cast<size_t>(orientation)];
+        // opposite flicks within one frame cancel out and aren't reported
+        if (accumulated == 0)
+            continue;
+
+        const auto delta = static_cast<int32_t>(std::clamp<int64_t>(accumulated, INT32_MIN, INT32_MAX));
+        accumulated = 0;
+        if (scroll_callback)
+            scroll_callback(delta, orientation);
+    }
+}
+
 void StatusNotifierItem::on_watcher_name_changed(
     GDBusConnection *connection,
     const gchar *sender_name,
@@ -878,13 +1310,13 @@ void StatusNotifierItem::on_watcher_name_changed(
     GVariant *parameters,
     gpointer user_data)
 {
+    TRACE_SPAN("StatusNotifierItem::on_watcher_name_changed");
     (void)connection;
     (void)sender_name;
     (void)object_path;
     (void)interface_name;
     (void)signal_name;
-
-    auto *self = static_cast<StatusNotifierItem *>(user_data);
+    (void)user_data;
 
     const gchar *name;
     const gchar *old_owner;
@@ -894,23 +1326,32 @@ void StatusNotifierItem::on_watcher_name_changed(
     if (g_strcmp0(name, WATCHER_SERVICE) != 0)
         return;
 
-    if (new_owner && new_owner[0] != '\0')
+    // a new (or restarted) watcher forgets everything, so start over with a
+    // fresh backoff; a vanished one just means waiting for the next owner
+    bool has_owner = new_owner && new_owner[0] != '\0';
+    auto items = live_items;
+    for (auto *item : items)
     {
-        self->registered_with_watcher = false;
-        self->register_with_watcher();
-    }
-    else
-    {
-        self->registered_with_watcher = false;
+        item->cancel_registration();
+        item->registration_attempts = 0;
+        item->set_registration_state(RegistrationState::Unregistered);
+        if (has_owner && !item->current_icon_pixmap.empty())
+            item->register_with_watcher();
     }
 }
 
 void StatusNotifierItem::subscribe_to_watcher()
 {
-    if (!bus || watcher_id != 0)
+    if (!bus || subscribed_to_watcher)
+        return;
+
+    live_items.push_back(this);
+    subscribed_to_watcher = true;
+
+    if (shared_watcher_id != 0)
         return;
 
-    watcher_id = g_dbus_connection_signal_subscribe(
+    shared_watcher_id = g_dbus_connection_signal_subscribe(
         bus.get(),
         "org.freedesktop.DBus",
         "org.freedesktop.DBus",
@@ -919,6 +1360,6 @@ void StatusNotifierItem::subscribe_to_watcher()
         WATCHER_SERVICE,
         G_DBUS_SIGNAL_FLAGS_NONE,
         on_watcher_name_changed,
-        this,
+        nullptr,
         nullptr);
 }
@@ -7,19 +7,8 @@
 #include <vector>
 #include <map>
 #include <functional>
-
-template <typename T>
-struct GObjectDeleter
-{
-    void operator()(T *obj) const
-    {
-        if (obj)
-            g_object_unref(obj);
-    }
-};
-
-template <typename T>
-using GObjectPtr = std::unique_ptr<T, GObjectDeleter<T>>;
+#include <optional>
+#include "glib_ptr.h"
 
 struct MenuItem
 {
@@ -30,6 +19,53 @@ struct MenuItem
     bool is_separator;
 };
 
+// Fields to change on an existing menu entry; unset ones are left alone
+struct MenuItemPatch
+{
+    int32_t id;
+    std::optional<std::string> label;
+    std::optional<bool> enabled;
+    std::optional<bool> visible;
+};
+
+// Everything apply_update can change at once; unset fields keep their
+// current value
+struct StatusNotifierItemUpdate
+{
+    std::optional<std::vector<uint8_t>> icon_pixmap;
+    std::optional<std::string> title;
+    // "Active", "Passive" or "NeedsAttention"
+    std::optional<std::string> status;
+    std::optional<std::string> tooltip;
+    std::vector<MenuItemPatch> menu_patch;
+};
+
+struct StatusNotifierItemOptions
+{
+    std::string id = "equibop";
+    std::string title = "Equibop";
+    std::string category = "Communications";
+    std::string object_path = "/StatusNotifierItem";
+    std::string menu_object_path = "/MenuBar";
+    // well-known name to own; if empty the item is only reachable through
+    // the connection's unique name
+    std::string service_name;
+};
+
+enum class RegistrationState
+{
+    Unregistered,
+    Pending,
+    Registered,
+    Failed,
+};
+
+enum class ScrollOrientation
+{
+    Horizontal,
+    Vertical,
+};
+
 class StatusNotifierItem
 {
 private:
@@ -37,28 +73,81 @@ private:
     guint registration_id = 0;
     guint menu_registration_id = 0;
     guint owner_id = 0;
-    guint watcher_id = 0;
-    bool registered_with_watcher = false;
+    bool subscribed_to_watcher = false;
+    RegistrationState registration_state = RegistrationState::Unregistered;
+    GObjectPtr<GCancellable> registration_cancellable;
+    guint registration_retry_id = 0;
+    guint registration_attempts = 0;
+    uint32_t pending_signals = 0;
+    // menu changes made while the session is inactive, sent as a single
+    // LayoutUpdated on resume
+    bool menu_layout_pending = false;
+    guint session_listener_id = 0;
+    std::string item_id;
+    std::string category;
     std::string service_name;
     std::string object_path;
-    std::string menu_object_path = "/MenuBar";
+    std::string menu_object_path;
     std::string current_status = "Active";
     std::string current_icon_path;
-    std::string current_title = "Equibop";
+    std::string current_title;
+    // ToolTip description; the tooltip title is always current_title
+    std::string current_tooltip;
     std::vector<uint8_t> current_icon_pixmap;
+    // a{sv} of every SNI property, answers GetAll/Get; reset whenever a
+    // property changes and rebuilt on the next read
+    GVariantPtr snapshot;
+    GVariantPtr icon_pixmap_variant;
     std::vector<MenuItem> menu_items;
     uint32_t menu_revision = 1;
+    // a{sv} per entry of menu_items and the GetLayout tree built from them;
+    // dropped on every menu change and rebuilt on the next read, so hosts
+    // polling the menu get references instead of fresh trees
+    std::vector<GVariantPtr> menu_item_properties;
+    GVariantPtr menu_layout_cache;
     std::function<void(int32_t)> menu_click_callback;
     std::function<void()> activate_callback;
+    std::function<void(int32_t, int32_t)> secondary_activate_callback;
+    std::function<void(int32_t, int32_t)> context_menu_callback;
+    std::function<void(int32_t, ScrollOrientation)> scroll_callback;
+    std::function<void(RegistrationState)> registration_state_callback;
+    // Scroll deltas summed per orientation since the last flush. Touchpads
+    // call Scroll dozens of times per second; the callback sees at most one
+    // event per orientation per frame interval.
+    int64_t scroll_accumulated[2] = {0, 0};
+    guint scroll_flush_id = 0;
 
     static constexpr const char *WATCHER_SERVICE = "org.kde.StatusNotifierWatcher";
     static constexpr const char *WATCHER_PATH = "/StatusNotifierWatcher";
     static constexpr const char *SNI_INTERFACE = "org.kde.StatusNotifierItem";
     static constexpr const char *DBUSMENU_INTERFACE = "com.canonical.dbusmenu";
+    static constexpr const char *PROPERTIES_INTERFACE = "org.freedesktop.DBus.Properties";
+
+    // A watcher that doesn't answer within the timeout is retried with
+    // exponential backoff: 500ms, 1s, 2s... capped at 30s, for a bounded
+    // number of attempts before giving up until the watcher is replaced.
+    static constexpr gint REGISTER_TIMEOUT_MS = 3000;
+    static constexpr guint REGISTER_BACKOFF_BASE_MS = 500;
+    static constexpr guint REGISTER_BACKOFF_MAX_MS = 30000;
+    static constexpr guint REGISTER_MAX_ATTEMPTS = 8;
+
+    static constexpr guint SCROLL_FLUSH_MS = 16;
+
+    static constexpr uint32_t PENDING_NEW_ICON = 1 << 0;
+    static constexpr uint32_t PENDING_NEW_TITLE = 1 << 1;
+    static constexpr uint32_t PENDING_NEW_STATUS = 1 << 2;
+    static constexpr uint32_t PENDING_NEW_TOOLTIP = 1 << 3;
 
     static const char *introspection_xml;
     static const char *menu_introspection_xml;
 
+    // Shared by every item: introspection data is parsed once, and a single
+    // NameOwnerChanged subscription fans out to all live items.
+    static GDBusInterfaceInfo *sni_interface_info();
+    static GDBusInterfaceInfo *menu_interface_info();
+    static std::vector<StatusNotifierItem *> live_items;
+    static guint shared_watcher_id;
+
     static void handle_method_call(
         GDBusConnection *connection,
         const gchar *sender,
@@ -69,15 +158,6 @@ private:
         GDBusMethodInvocation *invocation,
         gpointer user_data);
 
-    static GVariant *handle_get_property(
-        GDBusConnection *connection,
-        const gchar *sender,
-        const gchar *object_path,
-        const gchar *interface_name,
-        const gchar *property_name,
-        GError **error,
-        gpointer user_data);
-
     static void handle_menu_method_call(
         GDBusConnection *connection,
         const gchar *sender,
@@ -106,19 +186,62 @@ private:
         GVariant *parameters,
         gpointer user_data);
 
-    bool register_with_watcher();
+    static void on_register_reply(GObject *source, GAsyncResult *result, gpointer user_data);
+    static gboolean on_registration_retry(gpointer user_data);
+    static gboolean on_scroll_flush(gpointer user_data);
+
+    void register_with_watcher();
+    void cancel_registration();
+    void set_registration_state(RegistrationState state);
+    GVariant *build_icon_pixmap() const;
+    GVariant *build_property(const gchar *property_name);
+    GVariant *properties_snapshot();
+    bool emit_item_signal(const char *signal_name, GVariant *parameters);
+    bool emit_properties_changed(uint32_t changed);
+    bool flush_pending_signals();
+    bool emit_layout_updated();
+    bool emit_items_properties_updated(GVariant *updated_props);
+    void invalidate_menu_cache();
+    const std::vector<GVariantPtr> &menu_properties();
+    GVariant *menu_layout();
     bool register_menu();
     void subscribe_to_watcher();
+    void accumulate_scroll(int32_t delta, const gchar *orientation);
+    void flush_scroll();
 
 public:
-    StatusNotifierItem();
+    static constexpr const char *DEFAULT_OBJECT_PATH = "/StatusNotifierItem";
+
+    explicit StatusNotifierItem(StatusNotifierItemOptions options = {});
     ~StatusNotifierItem();
 
+    StatusNotifierItem(const StatusNotifierItem &) = delete;
+    StatusNotifierItem &operator=(const StatusNotifierItem &) = delete;
+
     bool initialize();
     bool set_icon_pixmap(const std::vector<uint8_t> &pixmap_data);
     bool set_title(const std::string &title);
     bool set_menu(const std::vector<MenuItem> &items);
     bool update_menu_item_label(int32_t id, const std::string &new_label);
+    // Checks the whole update first and changes nothing if any part of it
+    // is invalid (unknown status, unknown menu id), reporting why in error.
+    // Otherwise applies all of it and sends the result as one batch: a
+    // single ItemsPropertiesUpdated for the menu, then one New* signal per
+    // changed property and one PropertiesChanged, so hosts never see a
+    // half-applied state.
+    bool apply_update(const StatusNotifierItemUpdate &update, std::string &error);
+    // Drops the property snapshot, the icon pixmap variant and the menu
+    // trees; each is rebuilt on the next read.
+    void trim_caches();
     void set_menu_click_callback(std::function<void(int32_t)> callback);
     void set_activate_callback(std::function<void()> callback);
+    void set_secondary_activate_callback(std::function<void(int32_t x, int32_t y)> callback);
+    void set_context_menu_callback(std::function<void(int32_t x, int32_t y)> callback);
+    void set_scroll_callback(std::function<void(int32_t delta, ScrollOrientation orientation)> callback);
+    void set_registration_state_callback(std::function<void(RegistrationState)> callback);
+    RegistrationState get_registration_state() const { return registration_state; }
+
+    static bool is_valid_status(const std::string &status);
+    static const char *registration_state_name(RegistrationState state);
+    static const char *scroll_orientation_name(ScrollOrientation orientation);
 };
@@ -0,0 +1,655 @@
+#include "status_notifier_item_binding.h"
+#include "status_notifier_item.h"
+#include "launcher_entry.h"
+#include "memory_monitor.h"
+#include "trace.h"
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class StatusNotifierItemWrap : public Napi::ObjectWrap<StatusNotifierItemWrap>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    StatusNotifierItemWrap(const Napi::CallbackInfo &info);
+    ~StatusNotifierItemWrap();
+
+private:
+    // The first item without an explicit path takes the well-known paths and
+    // bus name hosts have always seen; later ones get numbered paths.
+    static bool default_path_in_use;
+    static uint32_t next_item_index;
+
+    std::unique_ptr<StatusNotifierItem> item;
+    bool uses_default_path = false;
+    guint trimmer_id = 0;
+    Napi::ThreadSafeFunction menu_click_callback;
+    Napi::ThreadSafeFunction activate_callback;
+    Napi::ThreadSafeFunction state_callback;
+    Napi::ThreadSafeFunction secondary_activate_callback;
+    Napi::ThreadSafeFunction context_menu_callback;
+    Napi::ThreadSafeFunction scroll_callback;
+
+    bool check_alive(Napi::Env env);
+    void release();
+    static void replace_callback(Napi::ThreadSafeFunction &tsfn, const Napi::CallbackInfo &info, const char *name);
+
+    Napi::Value SetIcon(const Napi::CallbackInfo &info);
+    Napi::Value SetTitle(const Napi::CallbackInfo &info);
+    Napi::Value SetMenu(const Napi::CallbackInfo &info);
+    Napi::Value UpdateMenuItem(const Napi::CallbackInfo &info);
+    Napi::Value ApplyDesktopState(const Napi::CallbackInfo &info);
+    Napi::Value OnMenuClick(const Napi::CallbackInfo &info);
+    Napi::Value OnActivate(const Napi::CallbackInfo &info);
+    Napi::Value OnSecondaryActivate(const Napi::CallbackInfo &info);
+    Napi::Value OnContextMenu(const Napi::CallbackInfo &info);
+    Napi::Value OnScroll(const Napi::CallbackInfo &info);
+    Napi::Value OnStateChange(const Napi::CallbackInfo &info);
+    Napi::Value GetState(const Napi::CallbackInfo &info);
+    Napi::Value Destroy(const Napi::CallbackInfo &info);
+};
+
+bool StatusNotifierItemWrap::default_path_in_use = false;
+uint32_t StatusNotifierItemWrap::next_item_index = 1;
+
+Napi::Function StatusNotifierItemWrap::Define(Napi::Env env)
+{
+    return DefineClass(env, "StatusNotifierItem", {
+        InstanceMethod("setIcon", &StatusNotifierItemWrap::SetIcon),
+        InstanceMethod("setTitle", &StatusNotifierItemWrap::SetTitle),
+        InstanceMethod("setMenu", &StatusNotifierItemWrap::SetMenu),
+        InstanceMethod("updateMenuItem", &StatusNotifierItemWrap::UpdateMenuItem),
+        InstanceMethod("applyDesktopState", &StatusNotifierItemWrap::ApplyDesktopState),
+        InstanceMethod("onMenuClick", &StatusNotifierItemWrap::OnMenuClick),
+        InstanceMethod("onActivate", &StatusNotifierItemWrap::OnActivate),
+        InstanceMethod("onSecondaryActivate", &StatusNotifierItemWrap::OnSecondaryActivate),
+        InstanceMethod("onContextMenu", &StatusNotifierItemWrap::OnContextMenu),
+        InstanceMethod("onScroll", &StatusNotifierItemWrap::OnScroll),
+        InstanceMethod("onStateChange", &StatusNotifierItemWrap::OnStateChange),
+        InstanceMethod("getState", &StatusNotifierItemWrap::GetState),
+        InstanceMethod("destroy", &StatusNotifierItemWrap::Destroy),
+    });
+}
+
+StatusNotifierItemWrap::StatusNotifierItemWrap(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<StatusNotifierItemWrap>(info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && !info[0].IsObject() && !info[0].IsUndefined())
+    {
+        Napi::TypeError::New(env, "Expected (object?)").ThrowAsJavaScriptException();
+        return;
+    }
+
+    Napi::Object opts = info.Length() > 0 && info[0].IsObject() ? info[0].As<Napi::Object>() : Napi::Object::New(env);
+    auto get_string = [&opts](const char *key, std::string &out)
+    {
+        Napi::Value value = opts.Get(key);
+        if (value.IsString())
+            out = value.As<Napi::String>().Utf8Value();
+    };
+
+    StatusNotifierItemOptions options;
+    get_string("id", options.id);
+    get_string("title", options.title);
+    get_string("category", options.category);
+
+    if (opts.Get("objectPath").IsString())
+    {
+        get_string("objectPath", options.object_path);
+        options.menu_object_path = options.object_path + "/Menu";
+        get_string("menuPath", options.menu_object_path);
+    }
+    else if (!default_path_in_use)
+    {
+        options.service_name = "org.equicord.equibop.StatusNotifierItem";
+        uses_default_path = true;
+    }
+    else
+    {
+        std::string suffix = std::to_string(next_item_index++);
+        options.object_path = std::string(StatusNotifierItem::DEFAULT_OBJECT_PATH) + "/" + suffix;
+        options.menu_object_path = "/MenuBar/" + suffix;
+    }
+
+    if (!g_variant_is_object_path(options.object_path.c_str()) ||
+        !g_variant_is_object_path(options.menu_object_path.c_str()))
+    {
+        Napi::TypeError::New(env, "Invalid D-Bus object path").ThrowAsJavaScriptException();
+        return;
+    }
+
+    item = std::make_unique<StatusNotifierItem>(std::move(options));
+    if (!item->initialize())
+    {
+        item.reset();
+        Napi::Error::New(env, "Failed to register StatusNotifierItem").ThrowAsJavaScriptException();
+        return;
+    }
+
+    if (uses_default_path)
+        default_path_in_use = true;
+
+    // everything it drops is rebuilt on the next D-Bus read, so it goes first
+    StatusNotifierItem *raw = item.get();
+    trimmer_id = MemoryMonitor::instance().add_trimmer("status-notifier-item", MemoryPressure::Low,
+                                                       [raw]() { raw->trim_caches(); });
+}
+
+StatusNotifierItemWrap::~StatusNotifierItemWrap()
+{
+    release();
+}
+
+void StatusNotifierItemWrap::release()
+{
+    if (trimmer_id)
+    {
+        MemoryMonitor::instance().remove_trimmer(trimmer_id);
+        trimmer_id = 0;
+    }
+
+    // drop the D-Bus objects first so no callback can fire into a released TSFN
+    item.reset();
+
+    if (uses_default_path)
+    {
+        default_path_in_use = false;
+        uses_default_path = false;
+    }
+    for (auto *tsfn : {&menu_click_callback, &activate_callback, &state_callback, &secondary_activate_callback,
+                       &context_menu_callback, &scroll_callback})
+    {
+        if (*tsfn)
+        {
+            tsfn->Release();
+            *tsfn = Napi::ThreadSafeFunction();
+        }
+    }
+}
+
+void StatusNotifierItemWrap::replace_callback(Napi::ThreadSafeFunction &tsfn, const Napi::CallbackInfo &info,
+                                              const char *name)
+{
+    if (tsfn)
+        tsfn.Release();
+
+    // the callbacks run on the main context, which must never wait on the JS
+    // thread, so every dispatch is a NonBlockingCall; a tray item alone
+    // shouldn't keep the event loop alive either
+    tsfn = Napi::ThreadSafeFunction::New(info.Env(), info[0].As<Napi::Function>(), name, 0, 1);
+    tsfn.Unref(info.Env());
+}
+
+bool StatusNotifierItemWrap::check_alive(Napi::Env env)
+{
+    if (item)
+        return true;
+
+    Napi::Error::New(env, "StatusNotifierItem has been destroyed").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value StatusNotifierItemWrap::SetIcon(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsBuffer())
+    {
+        Napi::TypeError::New(env, "Expected (Buffer)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
+    std::vector<uint8_t> pixmap_data(buffer.Data(), buffer.Data() + buffer.Length());
+
+    bool success = item->set_icon_pixmap(pixmap_data);
+
+    return Napi::Boolean::New(env, success);
+}
+
+Napi::Value StatusNotifierItemWrap::SetTitle(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Expected (string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    std::string title = info[0].As<Napi::String>().Utf8Value();
+    bool success = item->set_title(title);
+
+    return Napi::Boolean::New(env, success);
+}
+
+Napi::Value StatusNotifierItemWrap::SetMenu(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsArray())
+    {
+        Napi::TypeError::New(env, "Expected (array)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    Napi::Array menu_array = info[0].As<Napi::Array>();
+    std::vector<MenuItem> items;
+
+    for (uint32_t i = 0; i < menu_array.Length(); i++)
+    {
+        Napi::Value item_value = menu_array.Get(i);
+        if (!item_value.IsObject())
+            continue;
+
+        Napi::Object item_obj = item_value.As<Napi::Object>();
+
+        MenuItem menu_item;
+        menu_item.id = item_obj.Get("id").As<Napi::Number>().Int32Value();
+        menu_item.label = item_obj.Has("label") ? item_obj.Get("label").As<Napi::String>().Utf8Value() : "";
+        menu_item.enabled = item_obj.Has("enabled") ? item_obj.Get("enabled").As<Napi::Boolean>().Value() : true;
+        menu_item.visible = item_obj.Has("visible") ? item_obj.Get("visible").As<Napi::Boolean>().Value() : true;
+        menu_item.is_separator = item_obj.Has("type") && item_obj.Get("type").As<Napi::String>().Utf8Value() == "separator";
+
+        items.push_back(menu_item);
+    }
+
+    bool success = item->set_menu(items);
+
+    return Napi::Boolean::New(env, success);
+}
+
+Napi::Value StatusNotifierItemWrap::UpdateMenuItem(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString())
+    {
+        Napi::TypeError::New(env, "Expected (number, string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    int32_t id = info[0].As<Napi::Number>().Int32Value();
+    std::string label = info[1].As<Napi::String>().Utf8Value();
+
+    bool success = item->update_menu_item_label(id, label);
+
+    return Napi::Boolean::New(env, success);
+}
+
+namespace
+{
+    struct BadgeUpdate
+    {
+        std::optional<int64_t> count;
+        // outer: whether to touch the bar at all; inner nullopt hides it
+        std::optional<std::optional<double>> progress;
+        std::optional<bool> urgent;
+    };
+
+    // Reads one optional field; undefined means "leave it alone", anything
+    // else of the wrong type is an error so nothing gets half applied.
+    template <typename Check>
+    bool optional_field(Napi::Object obj, const char *key, Check check, Napi::Value &out)
+    {
+        out = obj.Get(key);
+        return out.IsUndefined() || check(out);
+    }
+
+    bool is_string(const Napi::Value &value) { return value.IsString(); }
+    bool is_boolean(const Napi::Value &value) { return value.IsBoolean(); }
+    bool is_number(const Napi::Value &value) { return value.IsNumber(); }
+    bool is_progress(const Napi::Value &value)
+    {
+        return value.IsNull() || (value.IsNumber() && std::isfinite(value.As<Napi::Number>().DoubleValue()));
+    }
+}
+
+// Everything is read and type-checked before the item is touched, and the
+// item checks status and menu ids before changing anything, so a bad field
+// throws without any of the others having been applied.
+Napi::Value StatusNotifierItemWrap::ApplyDesktopState(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    TRACE_SPAN("StatusNotifierItem::applyDesktopState");
+
+    if (info.Length() < 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "Expected (object)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    Napi::Object state = info[0].As<Napi::Object>();
+    StatusNotifierItemUpdate update;
+    Napi::Value value;
+
+    auto invalid = [&env](const char *field)
+    {
+        Napi::TypeError::New(env, std::string("Invalid '") + field + "' in desktop state").ThrowAsJavaScriptException();
+        return env.Null();
+    };
+
+    if (!optional_field(state, "icon", [](const Napi::Value &v) { return v.IsBuffer(); }, value))
+        return invalid("icon");
+    if (value.IsBuffer())
+    {
+        Napi::Buffer<uint8_t> buffer = value.As<Napi::Buffer<uint8_t>>();
+        update.icon_pixmap.emplace(buffer.Data(), buffer.Data() + buffer.Length());
+    }
+
+    for (auto [key, field] : {std::pair{"title", &update.title}, std::pair{"status", &update.status},
+                              std::pair{"tooltip", &update.tooltip}})
+    {
+        if (!optional_field(state, key, is_string, value))
+            return invalid(key);
+        if (value.IsString())
+            *field = value.As<Napi::String>().Utf8Value();
+    }
+
+    if (!optional_field(state, "menuPatch", [](const Napi::Value &v) { return v.IsArray(); }, value))
+        return invalid("menuPatch");
+    if (value.IsArray())
+    {
+        Napi::Array patches = value.As<Napi::Array>();
+        update.menu_patch.reserve(patches.Length());
+
+        for (uint32_t i = 0; i < patches.Length(); i++)
+        {
+            Napi::Value entry = patches.Get(i);
+            if (!entry.IsObject() || !entry.As<Napi::Object>().Get("id").IsNumber())
+                return invalid("menuPatch");
+
+            Napi::Object patch_obj = entry.As<Napi::Object>();
+            MenuItemPatch patch;
+            patch.id = patch_obj.Get("id").As<Napi::Number>().Int32Value();
+
+            if (!optional_field(patch_obj, "label", is_string, value))
+                return invalid("menuPatch");
+            if (value.IsString())
+                patch.label = value.As<Napi::String>().Utf8Value();
+
+            if (!optional_field(patch_obj, "enabled", is_boolean, value))
+                return invalid("menuPatch");
+            if (value.IsBoolean())
+                patch.enabled = value.As<Napi::Boolean>().Value();
+
+            if (!optional_field(patch_obj, "visible", is_boolean, value))
+                return invalid("menuPatch");
+            if (value.IsBoolean())
+                patch.visible = value.As<Napi::Boolean>().Value();
+
+            update.menu_patch.push_back(std::move(patch));
+        }
+    }
+
+    std::optional<BadgeUpdate> badge;
+    if (!optional_field(state, "badge", [](const Napi::Value &v) { return v.IsObject(); }, value))
+        return invalid("badge");
+    if (value.IsObject())
+    {
+        Napi::Object badge_obj = value.As<Napi::Object>();
+        badge.emplace();
+
+        if (!optional_field(badge_obj, "count", is_number, value))
+            return invalid("badge");
+        if (value.IsNumber())
+            badge->count = value.As<Napi::Number>().Int64Value();
+
+        // null hides the bar, like updateLauncherEntry
+        if (!optional_field(badge_obj, "progress", is_progress, value))
+            return invalid("badge");
+        if (value.IsNumber())
+            badge->progress = std::optional<double>(value.As<Napi::Number>().DoubleValue());
+        else if (value.IsNull())
+            badge->progress = std::optional<double>();
+
+        if (!optional_field(badge_obj, "urgent", is_boolean, value))
+            return invalid("badge");
+        if (value.IsBoolean())
+            badge->urgent = value.As<Napi::Boolean>().Value();
+    }
+
+    // without a launcher entry the badge can't be shown, so neither half is
+    // applied rather than leaving the tray ahead of the badge
+    LauncherEntry *entry = nullptr;
+    if (badge)
+    {
+        entry = launcher_entry();
+        if (!entry)
+            return Napi::Boolean::New(env, false);
+    }
+
+    std::string error;
+    bool success = item->apply_update(update, error);
+    if (!error.empty())
+    {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (entry)
+    {
+        if (badge->count)
+            entry->set_count(*badge->count);
+        if (badge->progress)
+            entry->set_progress(*badge->progress);
+        if (badge->urgent)
+            entry->set_urgent(*badge->urgent);
+        // right away rather than on the next idle, next to the tray signals
+        success &= entry->flush();
+    }
+
+    return Napi::Boolean::New(env, success);
+}
+
+Napi::Value StatusNotifierItemWrap::OnMenuClick(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_callback(menu_click_callback, info, "MenuClickCallback");
+
+    item->set_menu_click_callback([this](int32_t id) {
+        if (menu_click_callback)
+        {
+            menu_click_callback.NonBlockingCall([id](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("StatusNotifierItem::onMenuClick dispatch");
+                jsCallback.Call({Napi::Number::New(env, id)});
+            });
+        }
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value StatusNotifierItemWrap::OnActivate(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_callback(activate_callback, info, "ActivateCallback");
+
+    item->set_activate_callback([this]() {
+        if (activate_callback)
+        {
+            activate_callback.NonBlockingCall([](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("StatusNotifierItem::onActivate dispatch");
+                jsCallback.Call({});
+            });
+        }
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value StatusNotifierItemWrap::OnSecondaryActivate(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_callback(secondary_activate_callback, info, "SecondaryActivateCallback");
+
+    item->set_secondary_activate_callback([this](int32_t x, int32_t y) {
+        if (secondary_activate_callback)
+        {
+            secondary_activate_callback.NonBlockingCall([x, y](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("StatusNotifierItem::onSecondaryActivate dispatch");
+                jsCallback.Call({Napi::Number::New(env, x), Napi::Number::New(env, y)});
+            });
+        }
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value StatusNotifierItemWrap::OnContextMenu(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_callback(context_menu_callback, info, "ContextMenuCallback");
+
+    item->set_context_menu_callback([this](int32_t x, int32_t y) {
+        if (context_menu_callback)
+        {
+            context_menu_callback.NonBlockingCall([x, y](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("StatusNotifierItem::onContextMenu dispatch");
+                jsCallback.Call({Napi::Number::New(env, x), Napi::Number::New(env, y)});
+            });
+        }
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value StatusNotifierItemWrap::OnScroll(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_callback(scroll_callback, info, "ScrollCallback");
+
+    // the item already sums deltas per frame, so this fires at most ~60
+    // times a second per orientation and never waits on the JS thread
+    item->set_scroll_callback([this](int32_t delta, ScrollOrientation orientation) {
+        if (scroll_callback)
+        {
+            scroll_callback.NonBlockingCall([delta, orientation](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("StatusNotifierItem::onScroll dispatch");
+                jsCallback.Call({Napi::Number::New(env, delta),
+                                 Napi::String::New(env, StatusNotifierItem::scroll_orientation_name(orientation))});
+            });
+        }
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value StatusNotifierItemWrap::OnStateChange(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!check_alive(env))
+        return env.Null();
+
+    replace_callback(state_callback, info, "StateChangeCallback");
+
+    item->set_registration_state_callback([this](RegistrationState state) {
+        if (state_callback)
+        {
+            state_callback.NonBlockingCall([state](Napi::Env env, Napi::Function jsCallback) {
+                TRACE_SPAN("StatusNotifierItem::onStateChange dispatch");
+                jsCallback.Call({Napi::String::New(env, StatusNotifierItem::registration_state_name(state))});
+            });
+        }
+    });
+
+    return env.Undefined();
+}
+
+Napi::Value StatusNotifierItemWrap::GetState(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (!check_alive(env))
+        return env.Null();
+
+    return Napi::String::New(env, StatusNotifierItem::registration_state_name(item->get_registration_state()));
+}
+
+Napi::Value StatusNotifierItemWrap::Destroy(const Napi::CallbackInfo &info)
+{
+    release();
+    return info.Env().Undefined();
+}
+
+void InitStatusNotifierItemBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("StatusNotifierItem", StatusNotifierItemWrap::Define(env));
+}
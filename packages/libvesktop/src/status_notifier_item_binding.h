@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Exposes StatusNotifierItem to JS as a class, one instance per tray item.
+void InitStatusNotifierItemBinding(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,121 @@
+#include "system_monitor.h"
+#include "trace.h"
+#include <vector>
+
+SystemMonitor &SystemMonitor::instance()
+{
+    // never destroyed, so signal handlers can always assume it is alive
+    static SystemMonitor *monitor = new SystemMonitor();
+    return *monitor;
+}
+
+SystemMonitor::SystemMonitor()
+{
+    // owned by GIO, and the same object for everyone in the process
+    network_monitor = g_network_monitor_get_default();
+    g_signal_connect(network_monitor, "network-changed", G_CALLBACK(on_network_changed), this);
+    g_signal_connect(network_monitor, "notify::network-metered", G_CALLBACK(on_notify), this);
+    g_signal_connect(network_monitor, "notify::connectivity", G_CALLBACK(on_notify), this);
+
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    power_profile_monitor.reset(G_OBJECT(g_power_profile_monitor_dup_default()));
+    if (power_profile_monitor)
+        g_signal_connect(power_profile_monitor.get(), "notify::power-saver-enabled", G_CALLBACK(on_notify), this);
+#endif
+
+    refresh(false);
+}
+
+const char *SystemMonitor::connectivity_name(NetworkConnectivity connectivity)
+{
+    switch (connectivity)
+    {
+    case NetworkConnectivity::Local:
+        return "local";
+    case NetworkConnectivity::Limited:
+        return "limited";
+    case NetworkConnectivity::Portal:
+        return "portal";
+    case NetworkConnectivity::Full:
+        return "full";
+    }
+    return "full";
+}
+
+guint SystemMonitor::add_listener(Listener listener)
+{
+    guint id = next_listener_id++;
+    listeners.emplace(id, std::move(listener));
+    return id;
+}
+
+void SystemMonitor::remove_listener(guint id)
+{
+    listeners.erase(id);
+}
+
+void SystemMonitor::refresh(bool network_changed)
+{
+    SystemState next;
+    next.network_available = g_network_monitor_get_network_available(network_monitor);
+    next.network_metered = g_network_monitor_get_network_metered(network_monitor);
+    next.network_changes = current.network_changes + (network_changed ? 1 : 0);
+
+    switch (g_network_monitor_get_connectivity(network_monitor))
+    {
+    case G_NETWORK_CONNECTIVITY_LOCAL:
+        next.connectivity = NetworkConnectivity::Local;
+        break;
+    case G_NETWORK_CONNECTIVITY_LIMITED:
+        next.connectivity = NetworkConnectivity::Limited;
+        break;
+    case G_NETWORK_CONNECTIVITY_PORTAL:
+        next.connectivity = NetworkConnectivity::Portal;
+        break;
+    case G_NETWORK_CONNECTIVITY_FULL:
+        next.connectivity = NetworkConnectivity::Full;
+        break;
+    }
+
+#if GLIB_CHECK_VERSION(2, 70, 0)
+    if (power_profile_monitor)
+    {
+        next.power_profile_monitored = true;
+        next.power_saver_enabled =
+            g_power_profile_monitor_get_power_saver_enabled(G_POWER_PROFILE_MONITOR(power_profile_monitor.get()));
+    }
+#endif
+
+    // notify:: fires on every set, not only on changes
+    const bool changed = network_changed || next.network_metered != current.network_metered ||
+                         next.connectivity != current.connectivity ||
+                         next.power_saver_enabled != current.power_saver_enabled;
+    current = next;
+    if (!changed)
+        return;
+
+    // a listener may remove itself or others while we are calling out
+    std::vector<guint> ids;
+    ids.reserve(listeners.size());
+    for (const auto &entry : listeners)
+        ids.push_back(entry.first);
+
+    for (guint id : ids)
+    {
+        auto it = listeners.find(id);
+        if (it != listeners.end())
+            it->second(current);
+    }
+}
+
+void SystemMonitor::on_network_changed(GNetworkMonitor *, gboolean, gpointer user_data)
+{
+    TRACE_SPAN("SystemMonitor::on_network_changed");
+    static_cast<SystemMonitor *>(user_data)->refresh(true);
+}
+
+void SystemMonitor::on_notify(GObject *, GParamSpec *pspec, gpointer user_data)
+{
+    TRACE_SPAN("SystemMonitor::on_notify", g_param_spec_get_name(pspec));
+    static_cast<SystemMonitor *>(user_data)->refresh(false);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <gio/gio.h>
+#include <map>
+#include "glib_ptr.h"
+
+enum class NetworkConnectivity
+{
+    // no route beyond the local network
+    Local,
+    // a route, but the internet isn't reachable
+    Limited,
+    // behind a captive portal
+    Portal,
+    Full,
+};
+
+struct SystemState
+{
+    bool network_available = true;
+    bool network_metered = false;
+    NetworkConnectivity connectivity = NetworkConnectivity::Full;
+    // bumped on every GNetworkMonitor network-changed, which also fires when
+    // the default route moves without availability changing (wifi -> cable)
+    uint32_t network_changes = 0;
+    bool power_saver_enabled = false;
+    // false before GLib 2.70 or without a power profile monitor
+    bool power_profile_monitored = false;
+};
+
+// GIO's GNetworkMonitor and GPowerProfileMonitor, cached and with change
+// listeners, so JS hears about a network switch or power-saver mode the
+// moment GIO does instead of through Chromium's heuristics.
+//
+// Like SessionMonitor it is created on first use and its signals are
+// dispatched on the thread-default main context of that moment, which is
+// the default context everywhere we use it.
+class SystemMonitor
+{
+public:
+    using Listener = std::function<void(const SystemState &)>;
+
+    static SystemMonitor &instance();
+
+    const SystemState &state() const { return current; }
+
+    // called once per signal that changed the state; returns an id for
+    // remove_listener
+    guint add_listener(Listener listener);
+    void remove_listener(guint id);
+
+    static const char *connectivity_name(NetworkConnectivity connectivity);
+
+private:
+    GNetworkMonitor *network_monitor = nullptr;
+    GObjectPtr<GObject> power_profile_monitor;
+
+    SystemState current;
+
+    std::map<guint, Listener> listeners;
+    guint next_listener_id = 1;
+
+    SystemMonitor();
+
+    void refresh(bool network_changed);
+
+    static void on_network_changed(GNetworkMonitor *monitor, gboolean available, gpointer user_data);
+    static void on_notify(GObject *object, GParamSpec *pspec, gpointer user_data);
+};
@@ -0,0 +1,91 @@
+#include "system_monitor_binding.h"
+#include "system_monitor.h"
+#include "trace.h"
+#include <atomic>
+
+namespace
+{
+    Napi::ThreadSafeFunction state_callback;
+    guint listener_id = 0;
+    // a dispatch is queued; it reads the state when it runs, so a burst of
+    // changes (a network switch is several) reaches JS as one call
+    std::atomic<bool> dispatch_pending{false};
+
+    Napi::Object state_object(Napi::Env env, const SystemState &state)
+    {
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("networkAvailable", Napi::Boolean::New(env, state.network_available));
+        obj.Set("networkMetered", Napi::Boolean::New(env, state.network_metered));
+        obj.Set("connectivity", Napi::String::New(env, SystemMonitor::connectivity_name(state.connectivity)));
+        obj.Set("networkChanges", Napi::Number::New(env, state.network_changes));
+        obj.Set("powerSaverEnabled", Napi::Boolean::New(env, state.power_saver_enabled));
+        obj.Set("powerProfileMonitored", Napi::Boolean::New(env, state.power_profile_monitored));
+        return obj;
+    }
+
+    void release_callback()
+    {
+        if (listener_id)
+        {
+            SystemMonitor::instance().remove_listener(listener_id);
+            listener_id = 0;
+        }
+
+        if (state_callback)
+        {
+            state_callback.Release();
+            state_callback = Napi::ThreadSafeFunction();
+        }
+        dispatch_pending = false;
+    }
+
+    Napi::Value GetSystemState(const Napi::CallbackInfo &info)
+    {
+        return state_object(info.Env(), SystemMonitor::instance().state());
+    }
+
+    Napi::Value OnSystemStateChange(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || (!info[0].IsFunction() && !info[0].IsNull()))
+        {
+            Napi::TypeError::New(env, "Expected (function | null)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        release_callback();
+        if (info[0].IsNull())
+            return env.Undefined();
+
+        state_callback = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "SystemStateCallback", 0, 1);
+        state_callback.Unref(env);
+
+        auto tsfn = state_callback;
+        listener_id = SystemMonitor::instance().add_listener([tsfn](const SystemState &) mutable
+        {
+            if (dispatch_pending.exchange(true))
+                return;
+
+            const napi_status status = tsfn.NonBlockingCall([](Napi::Env env, Napi::Function jsCallback)
+            {
+                TRACE_SPAN("SystemMonitor::state dispatch");
+                dispatch_pending = false;
+                jsCallback.Call({state_object(env, SystemMonitor::instance().state())});
+            });
+
+            // the dispatch that would clear the flag never runs, and leaving
+            // it set would swallow every later change
+            if (status != napi_ok)
+                dispatch_pending = false;
+        });
+
+        return env.Undefined();
+    }
+}
+
+void InitSystemMonitorBinding(Napi::Env env, Napi::Object exports)
+{
+    exports.Set("getSystemState", Napi::Function::New(env, GetSystemState));
+    exports.Set("onSystemStateChange", Napi::Function::New(env, OnSystemStateChange));
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <napi.h>
+
+// getSystemState / onSystemStateChange: network and power-saver state from
+// SystemMonitor.
+void InitSystemMonitorBinding(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,278 @@
+#include "trace.h"
+#include "stats.h"
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+std::atomic<bool> trace_detail::enabled{false};
+thread_local bool trace_detail::marks_current_op = false;
+std::atomic<const char *> trace_detail::current_op{nullptr};
+
+namespace
+{
+    // 8192 spans of 64 bytes, so 512 KiB per thread that records anything;
+    // only allocated once tracing has been turned on
+    constexpr size_t BUFFER_CAPACITY = 8192;
+    constexpr size_t DETAIL_SIZE = 40;
+
+    struct TraceEvent
+    {
+        const char *name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        char detail[DETAIL_SIZE];
+    };
+
+    // Written only by its thread. count is published with release so the
+    // exporter sees complete events; a new session resets it lazily from the
+    // owning thread on its next span.
+    struct ThreadBuffer
+    {
+        pid_t tid = 0;
+        char thread_name[16] = {};
+        std::atomic<uint32_t> generation{0};
+        std::atomic<size_t> count{0};
+        std::atomic<uint64_t> dropped{0};
+        // set under registry_mutex when the thread is gone
+        bool exited = false;
+        TraceEvent events[BUFFER_CAPACITY];
+    };
+
+    std::atomic<uint32_t> current_generation{0};
+
+    // A buffer outlives its thread only as long as it holds spans of the
+    // current session: it is freed once those have been exported or a new
+    // session starts, so threads that come and go don't add up.
+    std::mutex registry_mutex;
+    std::vector<ThreadBuffer *> &registry()
+    {
+        static auto *buffers = new std::vector<ThreadBuffer *>();
+        return *buffers;
+    }
+
+    // registry_mutex held
+    void free_exited_buffers(bool keep_current)
+    {
+        const uint32_t generation = current_generation.load(std::memory_order_acquire);
+        auto &buffers = registry();
+        for (auto it = buffers.begin(); it != buffers.end();)
+        {
+            ThreadBuffer *buffer = *it;
+            const bool current = buffer->generation.load(std::memory_order_acquire) == generation &&
+                                 buffer->count.load(std::memory_order_acquire) > 0;
+            if (buffer->exited && !(keep_current && current))
+            {
+                it = buffers.erase(it);
+                delete buffer;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    struct LocalBuffer
+    {
+        ThreadBuffer *buffer = nullptr;
+
+        ~LocalBuffer()
+        {
+            if (!buffer)
+                return;
+
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            buffer->exited = true;
+            free_exited_buffers(true);
+        }
+    };
+
+    thread_local LocalBuffer local_buffer;
+
+    ThreadBuffer *thread_buffer()
+    {
+        if (local_buffer.buffer)
+            return local_buffer.buffer;
+
+        auto *buffer = new ThreadBuffer();
+        buffer->tid = static_cast<pid_t>(syscall(SYS_gettid));
+        pthread_getname_np(pthread_self(), buffer->thread_name, sizeof(buffer->thread_name));
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry().push_back(buffer);
+        local_buffer.buffer = buffer;
+        return buffer;
+    }
+
+    // Copies at most DETAIL_SIZE - 1 bytes, cutting before a UTF-8 sequence
+    // that wouldn't fit whole so the export stays valid JSON text.
+    void copy_detail(char *out, const char *detail)
+    {
+        size_t length = strnlen(detail, DETAIL_SIZE);
+        if (length == DETAIL_SIZE)
+        {
+            length = DETAIL_SIZE - 1;
+            while (length > 0 && (static_cast<unsigned char>(detail[length]) & 0xc0) == 0x80)
+                length--;
+        }
+        std::memcpy(out, detail, length);
+        out[length] = '\0';
+    }
+
+    void append_json_string(std::string &out, const char *text)
+    {
+        out += '"';
+        for (const char *p = text; *p; p++)
+        {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += *p;
+            }
+            else if (c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else
+            {
+                out += *p;
+            }
+        }
+        out += '"';
+    }
+
+    // Chrome traces count in microseconds; keep the nanoseconds as decimals
+    void append_us(std::string &out, uint64_t ns)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+                      static_cast<unsigned long long>(ns % 1000));
+        out += text;
+    }
+}
+
+uint64_t trace_detail::now_ns()
+{
+    return monotonic_ns();
+}
+
+void trace_detail::record(const char *name, const char *detail, uint64_t start_ns, uint64_t end_ns)
+{
+    ThreadBuffer *buffer = thread_buffer();
+
+    const uint32_t generation = current_generation.load(std::memory_order_acquire);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation)
+    {
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+
+    const size_t index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= BUFFER_CAPACITY)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent &event = buffer->events[index];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns - start_ns;
+    if (detail)
+        copy_detail(event.detail, detail);
+    else
+        event.detail[0] = '\0';
+
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void mark_current_op_thread()
+{
+    trace_detail::marks_current_op = true;
+}
+
+void set_tracing(bool enabled)
+{
+    if (enabled)
+    {
+        current_generation.fetch_add(1, std::memory_order_acq_rel);
+        // what exited threads recorded belongs to the session just dropped
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        free_exited_buffers(false);
+    }
+    trace_detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::string export_trace_json(uint64_t &dropped)
+{
+    const uint32_t generation = current_generation.load(std::memory_order_acquire);
+    const pid_t pid = getpid();
+    dropped = 0;
+    char number[32];
+
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    auto begin_event = [&]()
+    {
+        if (!first)
+            out += ',';
+        first = false;
+    };
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const ThreadBuffer *buffer : registry())
+    {
+        if (buffer->generation.load(std::memory_order_acquire) != generation)
+            continue;
+
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+        if (count == 0)
+            continue;
+
+        std::snprintf(number, sizeof(number), "%d", static_cast<int>(buffer->tid));
+        const std::string tid = number;
+        std::snprintf(number, sizeof(number), "%d", static_cast<int>(pid));
+        const std::string pid_text = number;
+
+        begin_event();
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid_text + ",\"tid\":" + tid + ",\"args\":{\"name\":";
+        append_json_string(out, buffer->thread_name[0] ? buffer->thread_name : "libvesktop");
+        out += "}}";
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const TraceEvent &event = buffer->events[i];
+
+            begin_event();
+            out += "{\"name\":";
+            append_json_string(out, event.name);
+            out += ",\"cat\":\"libvesktop\",\"ph\":\"X\",\"ts\":";
+            append_us(out, event.start_ns);
+            out += ",\"dur\":";
+            append_us(out, event.duration_ns);
+            out += ",\"pid\":" + pid_text + ",\"tid\":" + tid;
+            if (event.detail[0])
+            {
+                out += ",\"args\":{\"detail\":";
+                append_json_string(out, event.detail);
+                out += '}';
+            }
+            out += '}';
+        }
+    }
+
+    // exited threads can't add anything, and their spans are in this export
+    free_exited_buffers(false);
+
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
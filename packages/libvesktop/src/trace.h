@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped spans around native work, exported as Chrome Trace Event JSON so a
+// libvesktop trace can be loaded next to (or merged into) one recorded with
+// Electron's contentTracing. Timestamps are CLOCK_MONOTONIC microseconds,
+// which is what Chromium's TimeTicks use on Linux, and tids are kernel tids.
+//
+// Off by default. While off a span is one relaxed atomic load; while on it is
+// two clock reads and a store into a buffer owned by the current thread.
+//
+// Independently of tracing, spans on the thread that dispatches the default
+// GMainContext also publish their name as the current operation, which the
+// stall watchdog samples to say what was holding the context. On every other
+// thread that costs a thread_local load.
+
+namespace trace_detail
+{
+    extern std::atomic<bool> enabled;
+    extern thread_local bool marks_current_op;
+    extern std::atomic<const char *> current_op;
+
+    void record(const char *name, const char *detail, uint64_t start_ns, uint64_t end_ns);
+    uint64_t now_ns();
+}
+
+inline bool tracing_enabled()
+{
+    return trace_detail::enabled.load(std::memory_order_relaxed);
+}
+
+class TraceSpan
+{
+public:
+    // name must be a string literal; detail is copied (truncated to whole
+    // UTF-8 characters) when the span ends, so it only has to outlive the span
+    explicit TraceSpan(const char *name, const char *detail = nullptr)
+        : name(name), detail(detail), start_ns(tracing_enabled() ? trace_detail::now_ns() : 0),
+          marked(trace_detail::marks_current_op),
+          previous_op(marked ? trace_detail::current_op.exchange(name, std::memory_order_relaxed) : nullptr)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (marked)
+            trace_detail::current_op.store(previous_op, std::memory_order_relaxed);
+        if (start_ns != 0 && tracing_enabled())
+            trace_detail::record(name, detail, start_ns, trace_detail::now_ns());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    const char *detail;
+    uint64_t start_ns;
+    bool marked;
+    const char *previous_op;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(trace_span_, __COUNTER__)(__VA_ARGS__)
+
+// Makes spans on the calling thread publish the current operation; called
+// from the GMainContext's dispatching thread.
+void mark_current_op_thread();
+
+// Name of the innermost span open on the marked thread, or null when none is.
+inline const char *current_operation()
+{
+    return trace_detail::current_op.load(std::memory_order_relaxed);
+}
+
+// Starting drops whatever an earlier session recorded.
+void set_tracing(bool enabled);
+
+// Spans recorded since tracing was last started, as a Chrome trace
+// ({"traceEvents": [...]}), including thread name metadata. dropped is set to
+// the number of spans that didn't fit in their thread's buffer. Buffers of
+// threads that have exited are freed here, so their spans are only in the
+// first export after they exit.
+std::string export_trace_json(uint64_t &dropped);
@@ -5,8 +5,8 @@ const libVesktop = require(".");
 const test = require("node:test");
 const assert = require("node:assert/strict");
 
-test("getAccentColor should return a number", () => {
-    const color = libVesktop.getAccentColor();
+test("getAccentColor should return a number", async () => {
+    const color = await libVesktop.getAccentColor();
     assert.strictEqual(typeof color, "number");
 });
 
@@ -16,7 +16,550 @@ test("updateUnityLauncherCount should return true (success)", () => {
     assert.strictEqual(libVesktop.updateUnityLauncherCount(10), true);
 });
 
-test("requestBackground should return true (success)", () => {
-    assert.strictEqual(libVesktop.requestBackground(true, ["bash"]), true);
-    assert.strictEqual(libVesktop.requestBackground(false, []), true);
+test("updateLauncherEntry accepts partial state", () => {
+    assert.strictEqual(libVesktop.updateLauncherEntry({ progress: 0.25 }), true);
+    assert.strictEqual(libVesktop.updateLauncherEntry({ progress: null, urgent: true }), true);
+    assert.strictEqual(libVesktop.updateLauncherEntry({}), true);
+    assert.throws(() => libVesktop.updateLauncherEntry(3));
+    assert.throws(() => libVesktop.updateLauncherEntry({ progress: NaN }), TypeError);
+});
+
+test("getSessionState reports every flag as a boolean", () => {
+    const state = libVesktop.getSessionState();
+    for (const key of ["active", "locked", "sleeping", "screenSaverActive"]) {
+        assert.strictEqual(typeof state[key], "boolean");
+    }
+    assert.strictEqual(state.active, !state.locked && !state.sleeping && !state.screenSaverActive);
+});
+
+test("getSystemState reports network and power state", () => {
+    const state = libVesktop.getSystemState();
+    assert.strictEqual(typeof state.networkAvailable, "boolean");
+    assert.strictEqual(typeof state.networkMetered, "boolean");
+    assert.ok(["local", "limited", "portal", "full"].includes(state.connectivity));
+    assert.strictEqual(typeof state.powerSaverEnabled, "boolean");
+
+    libVesktop.onSystemStateChange(() => {});
+    libVesktop.onSystemStateChange(null);
+    assert.throws(() => libVesktop.onSystemStateChange(42), TypeError);
+});
+
+test("onSystemStateChange reports a metered change from the portal", async t => {
+    const fs = require("node:fs");
+    const path = require("node:path");
+    const { spawn } = require("node:child_process");
+    const { once } = require("node:events");
+    const readline = require("node:readline");
+
+    const fakePortal = path.join(__dirname, "build/Release/fake_portal");
+    if (!fs.existsSync(fakePortal)) {
+        t.skip("fake_portal not built");
+        return;
+    }
+
+    const portal = spawn(fakePortal, [], { stdio: ["pipe", "pipe", "inherit"] });
+    t.after(() => portal.kill());
+    const portalLines = readline.createInterface({ input: portal.stdout })[Symbol.asyncIterator]();
+    const { value: busAddress } = await portalLines.next();
+
+    // GIO picks its network monitor once per process, so the portal-backed one
+    // needs a fresh process pointed at the fixture's bus
+    const child = spawn(
+        process.execPath,
+        [
+            "-e",
+            `const libVesktop = require(${JSON.stringify(__dirname)});
+            libVesktop.attachGLibMainLoop();
+            const timeout = setTimeout(() => process.exit(1), 5000);
+            libVesktop.onSystemStateChange(state => {
+                console.log(JSON.stringify(state));
+                if (state.networkMetered) {
+                    clearTimeout(timeout);
+                    process.exit(0);
+                }
+            });
+            console.log("ready");`
+        ],
+        {
+            env: { ...process.env, DBUS_SESSION_BUS_ADDRESS: busAddress, GIO_USE_PORTALS: "1", GTK_USE_PORTAL: "1" },
+            stdio: ["ignore", "pipe", "inherit"]
+        }
+    );
+    t.after(() => child.kill());
+    const childLines = readline.createInterface({ input: child.stdout })[Symbol.asyncIterator]();
+    assert.strictEqual((await childLines.next()).value, "ready");
+
+    portal.stdin.write("metered on\n");
+    assert.strictEqual((await portalLines.next()).value, "ok metered on");
+
+    const states = [];
+    for await (const line of childLines) states.push(JSON.parse(line));
+    const [code] = child.exitCode === null ? await once(child, "exit") : [child.exitCode];
+    assert.strictEqual(code, 0, "no change callback reported the metered network");
+    assert.strictEqual(states.at(-1).networkMetered, true);
+    assert.strictEqual(states.at(-1).networkAvailable, true);
+});
+
+test("requestBackground should return true (success)", async () => {
+    assert.strictEqual(await libVesktop.requestBackground(true, ["bash"]), true);
+    assert.strictEqual(await libVesktop.requestBackground(false, []), true);
+});
+
+test("decodeStatusNotifierIcon should decode a png into a 32x32 pixmap", async () => {
+    const pixmap = await libVesktop.decodeStatusNotifierIcon(require.resolve("../../static/tray/tray.png"));
+    assert.strictEqual(pixmap.readUInt32LE(0), 32);
+    assert.strictEqual(pixmap.readUInt32LE(4), 32);
+    assert.strictEqual(pixmap.length, 8 + 32 * 32 * 4);
+});
+
+test("decodeStatusNotifierIcon should reject unsupported files", async () => {
+    await assert.rejects(libVesktop.decodeStatusNotifierIcon(__filename));
+});
+
+test("encodeThumbnails scales BGRA bitmaps into PNG data URLs", async () => {
+    const width = 64;
+    const height = 32;
+    const bitmap = Buffer.alloc(width * height * 4, 0xff);
+
+    const urls = await libVesktop.encodeThumbnails(
+        [
+            { bitmap, width, height },
+            { bitmap, width: 8, height: 8 }
+        ],
+        16,
+        16
+    );
+    assert.strictEqual(urls.length, 2);
+
+    const png = Buffer.from(urls[0].slice("data:image/png;base64,".length), "base64");
+    assert.ok(urls[0].startsWith("data:image/png;base64,"));
+    assert.strictEqual(png.readUInt32BE(16), 16);
+    assert.strictEqual(png.readUInt32BE(20), 8);
+
+    assert.throws(() => libVesktop.encodeThumbnails([{ bitmap: Buffer.alloc(4), width, height }], 16, 16), TypeError);
+
+    // empty NativeImages, e.g. minimized windows, don't fail the batch
+    const [empty, full] = await libVesktop.encodeThumbnails(
+        [
+            { bitmap: Buffer.alloc(0), width: 0, height: 0 },
+            { bitmap, width, height }
+        ],
+        16,
+        16
+    );
+    assert.strictEqual(empty, "data:image/png;base64,");
+    assert.ok(full.length > empty.length);
+});
+
+test("TrayIconTints tints every variant once per accent and scheme", async () => {
+    const pixmap = await libVesktop.decodeStatusNotifierIcon(require.resolve("../../static/tray/tray.png"));
+    const tints = new libVesktop.TrayIconTints();
+    tints.setSource("tray", pixmap);
+    tints.setSource("trayUnread", pixmap);
+
+    assert.strictEqual(tints.get("tray", 0x3584e4, "dark"), null);
+    assert.strictEqual(await tints.retint(0x3584e4, "dark"), 2);
+    assert.strictEqual(await tints.retint(0x3584e4, "dark"), 0);
+
+    const tinted = tints.get("tray", 0x3584e4, "dark");
+    assert.strictEqual(tinted.length, pixmap.length);
+    assert.deepStrictEqual(tinted.subarray(0, 8), pixmap.subarray(0, 8));
+    // alpha is left alone
+    for (let i = 8; i < pixmap.length; i += 4) assert.strictEqual(tinted[i], pixmap[i]);
+});
+
+test("multiple StatusNotifierItems can coexist", () => {
+    const main = new libVesktop.StatusNotifierItem({ title: "main" });
+    const secondary = new libVesktop.StatusNotifierItem({ id: "equibop-call", title: "call" });
+
+    assert.strictEqual(main.setTitle("main title"), true);
+    assert.strictEqual(secondary.setMenu([{ id: 1, label: "Leave call" }]), true);
+
+    secondary.destroy();
+    main.destroy();
+    assert.throws(() => main.setTitle("gone"));
+});
+
+test("StatusNotifierItem reports its watcher registration state", () => {
+    const item = new libVesktop.StatusNotifierItem();
+    assert.strictEqual(item.getState(), "unregistered");
+
+    // setting the icon starts registration without waiting for the watcher
+    const pixmap = Buffer.alloc(8 + 2 * 2 * 4);
+    pixmap.writeUInt32LE(2, 0);
+    pixmap.writeUInt32LE(2, 4);
+
+    const start = performance.now();
+    item.setIcon(pixmap);
+    assert.ok(performance.now() - start < 50);
+    assert.ok(["pending", "registered", "unregistered"].includes(item.getState()));
+
+    item.destroy();
+});
+
+test("StatusNotifierItem accepts scroll and secondary activation handlers", () => {
+    const item = new libVesktop.StatusNotifierItem({ objectPath: "/org/equicord/ScrollTest" });
+
+    item.onScroll(() => {});
+    item.onSecondaryActivate(() => {});
+    item.onContextMenu(() => {});
+    assert.throws(() => item.onScroll("not a function"), TypeError);
+
+    item.destroy();
+    assert.throws(() => item.onScroll(() => {}));
+});
+
+test("applyDesktopState validates everything before applying anything", () => {
+    const item = new libVesktop.StatusNotifierItem({ objectPath: "/org/equicord/StateTest" });
+    item.setMenu([{ id: 1, label: "Mute" }, { id: 2, label: "Deafen" }]);
+
+    const pixmap = Buffer.alloc(8 + 2 * 2 * 4);
+    pixmap.writeUInt32LE(2, 0);
+    pixmap.writeUInt32LE(2, 4);
+
+    assert.strictEqual(
+        item.applyDesktopState({
+            icon: pixmap,
+            title: "muted",
+            status: "NeedsAttention",
+            tooltip: "Microphone muted",
+            menuPatch: [{ id: 1, label: "Unmute" }, { id: 2, enabled: false }]
+        }),
+        true
+    );
+    assert.strictEqual(item.applyDesktopState({}), true);
+
+    assert.throws(() => item.applyDesktopState({ title: 1 }), TypeError);
+    assert.throws(() => item.applyDesktopState({ status: "Busy" }), /status/);
+    assert.throws(() => item.applyDesktopState({ title: "x", menuPatch: [{ id: 42, label: "?" }] }), /42/);
+    assert.throws(() => item.applyDesktopState({ badge: { count: "3" } }), TypeError);
+    assert.throws(() => item.applyDesktopState({ badge: { progress: Infinity } }), TypeError);
+
+    item.destroy();
+    assert.throws(() => item.applyDesktopState({}));
+});
+
+test("trimNativeCaches drops each cache from its own level up", async t => {
+    const pixmap = await libVesktop.decodeStatusNotifierIcon(require.resolve("../../static/tray/tray.png"));
+    const objectPath = "/org/equicord/Test/Trim";
+    const item = new libVesktop.StatusNotifierItem({ title: "trim", objectPath });
+    item.setIcon(pixmap);
+    item.setMenu([{ id: 1, label: "Quit" }]);
+    const tints = new libVesktop.TrayIconTints();
+    tints.setSource("tray", pixmap);
+    assert.strictEqual(await tints.retint(0x5865f2, "dark"), 1);
+    assert.notStrictEqual(tints.get("tray", 0x5865f2, "dark"), null);
+
+    const low = libVesktop.trimNativeCaches("low");
+    assert.ok(low.includes("status-notifier-item"));
+    assert.ok(!low.includes("icon-tints"));
+    assert.notStrictEqual(tints.get("tray", 0x5865f2, "dark"), null);
+    assert.ok(libVesktop.trimNativeCaches("critical").includes("icon-tints"));
+    assert.strictEqual(tints.get("tray", 0x5865f2, "dark"), null);
+
+    // the item rebuilds what was dropped when it's next read over the bus;
+    // items share this process's session connection, found by its pid
+    assert.strictEqual(libVesktop.attachGLibMainLoop(), true);
+    t.after(() => libVesktop.detachGLibMainLoop());
+    const bus = ["session", "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus"];
+    const [names] = await libVesktop.dbusCall(...bus, "ListNames", "", []);
+    let self;
+    for (const name of names.filter(n => n.startsWith(":"))) {
+        const [pid] = await libVesktop.dbusCall(...bus, "GetConnectionUnixProcessID", "s", [name]).catch(() => [0]);
+        if (pid === process.pid) self = name;
+    }
+    assert.ok(self, "no session connection for this process");
+
+    const [properties] = await libVesktop.dbusCall(
+        "session",
+        self,
+        objectPath,
+        "org.freedesktop.DBus.Properties",
+        "GetAll",
+        "s",
+        ["org.kde.StatusNotifierItem"]
+    );
+    assert.strictEqual(properties.Title, "trim");
+    const [[width, height, data]] = properties.IconPixmap;
+    assert.strictEqual(data.length, width * height * 4);
+    const [, layout] = await libVesktop.dbusCall(
+        "session",
+        self,
+        `${objectPath}/Menu`,
+        "com.canonical.dbusmenu",
+        "GetLayout",
+        "iias",
+        [0, -1, []]
+    );
+    assert.strictEqual(layout[2][0][1].label, "Quit");
+
+    item.destroy();
+    assert.ok(!libVesktop.trimNativeCaches("low").includes("status-notifier-item"));
+
+    assert.strictEqual(typeof libVesktop.onMemoryPressure(() => {}), "boolean");
+    libVesktop.onMemoryPressure(null);
+    assert.throws(() => libVesktop.trimNativeCaches("high"), TypeError);
+});
+
+test("startDBusRecording writes a trace header", () => {
+    const fs = require("node:fs");
+    const path = require("node:path");
+    const os = require("node:os");
+
+    const tracePath = path.join(os.tmpdir(), `libvesktop-trace-${process.pid}.bin`);
+    assert.strictEqual(libVesktop.startDBusRecording(tracePath), true);
+    libVesktop.stopDBusRecording();
+
+    assert.strictEqual(fs.readFileSync(tracePath).subarray(0, 8).toString("latin1"), "VSKTRACE");
+    fs.unlinkSync(tracePath);
+});
+
+test("keybind channel delivers FIFO commands with receive timestamps", async () => {
+    const fs = require("node:fs");
+    const path = require("node:path");
+    const os = require("node:os");
+
+    const fifoPath = path.join(os.tmpdir(), `libvesktop-keybinds-${process.pid}`);
+    // the channel doesn't keep the loop alive by itself, the timeout does
+    const received = new Promise((resolve, reject) => {
+        const timeout = setTimeout(() => reject(new Error("no keybind delivered")), 2000);
+        libVesktop.startKeybindChannel({ fifoPath }, (event, receivedAtMs) => {
+            clearTimeout(timeout);
+            resolve({ event, receivedAtMs });
+        });
+    });
+
+    fs.writeFileSync(fifoPath, "toggle-mic\n");
+    const { event, receivedAtMs } = await received;
+    libVesktop.stopKeybindChannel();
+
+    assert.strictEqual(event, "VCD_TOGGLE_SELF_MUTE");
+    assert.ok(receivedAtMs <= Number(process.hrtime.bigint()) / 1e6);
+    assert.ok(libVesktop.getLibVesktopStats().keybinds.received >= 1);
+    assert.strictEqual(fs.existsSync(fifoPath), false);
+});
+
+test("control service exports and validates actions", () => {
+    const busName = `org.equicord.equibop.Test${process.pid}`;
+    assert.strictEqual(libVesktop.startControlService({ busName }, () => {}), true);
+    // replacing the running service is fine
+    assert.strictEqual(libVesktop.startControlService({ busName }, () => {}), true);
+    libVesktop.stopControlService();
+
+    assert.throws(() => libVesktop.startControlService({ busName: "not a name" }, () => {}));
+    assert.throws(() => libVesktop.callControlAction("reboot"), TypeError);
+    // nobody owns it any more, so the call fails fast instead of auto-starting anything
+    assert.strictEqual(libVesktop.callControlAction("show", { busName, timeoutMs: 200 }), false);
+});
+
+test("dbusCall marshals arguments and replies through the signature", async () => {
+    const bus = ["session", "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus"];
+
+    assert.deepStrictEqual(await libVesktop.dbusCall(...bus, "NameHasOwner", "s", ["org.freedesktop.DBus"]), [true]);
+
+    const [names] = libVesktop.dbusCall(...bus, "ListNames", "", [], { sync: true });
+    assert.ok(names.includes("org.freedesktop.DBus"));
+
+    await assert.rejects(libVesktop.dbusCall(...bus, "GetNameOwner", "s", ["org.equicord.Nobody"]), {
+        dbusError: "org.freedesktop.DBus.Error.NameHasNoOwner"
+    });
+
+    assert.throws(() => libVesktop.dbusCall(...bus, "NameHasOwner", "s", [42]), TypeError);
+    assert.throws(() => libVesktop.dbusCall(...bus, "NameHasOwner", "h", [0]), TypeError);
+    assert.throws(() => libVesktop.dbusVariant("u", -1), TypeError);
+    assert.ok(libVesktop.dbusVariant("a{sv}", { handle_token: libVesktop.dbusVariant("s", "t1"), n: 1 }));
+});
+
+test("subscribeDBusSignal delivers only the signals its match rule lets through", async t => {
+    const bus = ["session", "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus"];
+    const wanted = `org.equicord.equibop.Signal${process.pid}`;
+    const other = `${wanted}.Other`;
+
+    const signals = [];
+    let timeout;
+    let released;
+    const done = new Promise((resolve, reject) => {
+        released = resolve;
+        timeout = setTimeout(() => reject(new Error("no release signal")), 5000);
+    });
+    const match = { sender: "org.freedesktop.DBus", iface: "org.freedesktop.DBus", member: "NameOwnerChanged", arg0: wanted };
+    const id = libVesktop.subscribeDBusSignal(match, batch => {
+        signals.push(...batch);
+        if (batch.some(signal => signal.args[2] === "")) released();
+    }, { batchMs: 20 });
+    t.after(() => libVesktop.unsubscribeDBusSignal(id));
+
+    for (const name of [other, wanted]) await libVesktop.dbusCall(...bus, "RequestName", "su", [name, 0]);
+    for (const name of [other, wanted]) await libVesktop.dbusCall(...bus, "ReleaseName", "s", [name]);
+    await done;
+    clearTimeout(timeout);
+
+    assert.deepStrictEqual(signals.map(signal => signal.args[0]), [wanted, wanted]);
+    assert.strictEqual(signals[0].member, "NameOwnerChanged");
+    assert.strictEqual(signals[0].path, "/org/freedesktop/DBus");
+    assert.ok(libVesktop.getLibVesktopStats().dbusSignals.batches >= 1);
+
+    assert.strictEqual(libVesktop.unsubscribeDBusSignal(id), true);
+    assert.strictEqual(libVesktop.unsubscribeDBusSignal(id), false);
+    assert.throws(() => libVesktop.subscribeDBusSignal({ arg0: "a", arg0path: "/a" }, () => {}), TypeError);
+    assert.throws(() => libVesktop.subscribeDBusSignal({ path: "not/a/path" }, () => {}), TypeError);
+    assert.throws(() => libVesktop.subscribeDBusSignal({}, () => {}, { batchMs: -1 }), TypeError);
+});
+
+test("attachGLibMainLoop dispatches D-Bus calls under plain node", async t => {
+    const { execFile } = require("node:child_process");
+
+    assert.strictEqual(libVesktop.attachGLibMainLoop(), true);
+    t.after(() => libVesktop.detachGLibMainLoop());
+
+    const busName = `org.equicord.equibop.Loop${process.pid}`;
+    const action = new Promise((resolve, reject) => {
+        const timeout = setTimeout(() => reject(new Error("no action dispatched")), 5000);
+        libVesktop.startControlService({ busName }, (name, receivedAtMs) => {
+            clearTimeout(timeout);
+            resolve({ name, receivedAtMs });
+        });
+    });
+
+    // a separate process, as a blocking call from this thread would wait on the very loop that has to answer it
+    const script = `process.exit(require(${JSON.stringify(__dirname)}).callControlAction("toggle-deafen", { busName: ${JSON.stringify(busName)} }) ? 0 : 1)`;
+    const exited = new Promise(resolve => execFile(process.execPath, ["-e", script], error => resolve(error?.code ?? 0)));
+
+    const { name, receivedAtMs } = await action;
+    assert.strictEqual(await exited, 0);
+    libVesktop.stopControlService();
+
+    assert.strictEqual(name, "toggle-deafen");
+    assert.ok(receivedAtMs <= Number(process.hrtime.bigint()) / 1e6);
+    assert.ok(libVesktop.getLibVesktopStats().glibMainLoop.dispatches > 0);
+});
+
+test("stall watchdog charges a blocked main context to its culprit", async t => {
+    const { setTimeout: sleep } = require("node:timers/promises");
+
+    libVesktop.attachGLibMainLoop();
+    t.after(() => libVesktop.detachGLibMainLoop());
+    libVesktop.startStallWatchdog({ intervalMs: 10, thresholdMs: 20 });
+    t.after(() => libVesktop.stopStallWatchdog());
+
+    while (libVesktop.getStallReport().heartbeats === 0) await sleep(5);
+
+    // JS hogging the thread isn't any libvesktop operation
+    const until = performance.now() + 100;
+    while (performance.now() < until);
+    await sleep(50);
+
+    const report = libVesktop.getStallReport();
+    assert.strictEqual(report.running, true);
+    assert.ok(report.stalls >= 1);
+    assert.strictEqual(report.histogram.at(-1).upToMs, Infinity);
+    assert.strictEqual(
+        report.histogram.reduce((sum, bucket) => sum + bucket.count, 0),
+        report.heartbeats
+    );
+    const outside = report.offenders.find(o => o.operation === "(outside libvesktop)");
+    assert.ok(outside && outside.maxMs >= 20);
+
+    assert.throws(() => libVesktop.startStallWatchdog({ intervalMs: 0 }), TypeError);
+});
+
+test("GlobalShortcuts delivers press and release from the portal", async t => {
+    const fs = require("node:fs");
+    const path = require("node:path");
+    const { spawn } = require("node:child_process");
+    const { once } = require("node:events");
+    const readline = require("node:readline");
+
+    const fakePortal = path.join(__dirname, "build/Release/fake_portal");
+    if (!fs.existsSync(fakePortal)) {
+        t.skip("fake_portal not built");
+        return;
+    }
+
+    const portal = spawn(fakePortal, [], { stdio: ["pipe", "pipe", "inherit"] });
+    t.after(() => portal.kill());
+    // the fixture prints the address of its private bus once it is ready
+    const [busAddress] = await once(readline.createInterface({ input: portal.stdout }), "line");
+
+    const shortcuts = new libVesktop.GlobalShortcuts({ busAddress });
+    const events = [];
+    const done = new Promise((resolve, reject) => {
+        const timeout = setTimeout(() => reject(new Error("no shortcut events")), 5000);
+        shortcuts.onStateChange((state, detail) => {
+            if (state === "failed") reject(new Error(detail));
+        });
+        shortcuts.onEvents(batch => {
+            events.push(...batch);
+            if (events.length >= 2) {
+                clearTimeout(timeout);
+                resolve();
+            }
+        });
+    });
+
+    shortcuts.bind([{ id: "push-to-talk", description: "Push to talk" }]);
+    await done;
+    shortcuts.destroy();
+
+    assert.deepStrictEqual(
+        events.map(e => [e.id, e.pressed]),
+        [
+            ["push-to-talk", true],
+            ["push-to-talk", false]
+        ]
+    );
+    assert.ok(events.every(e => e.receivedAtMs <= Number(process.hrtime.bigint()) / 1e6));
+});
+
+test("DesktopNotifications folds a burst on one channel", () => {
+    const notifications = new libVesktop.DesktopNotifications({ burstWindowMs: 60_000 });
+    const before = libVesktop.getLibVesktopStats().notifications;
+
+    notifications.notify("dm:1", { summary: "alice", body: "hi" });
+    notifications.notify("dm:1", { summary: "alice", body: "are you there" });
+    notifications.notify("dm:1", { summary: "alice", body: "hello?" });
+
+    const after = libVesktop.getLibVesktopStats().notifications;
+    assert.strictEqual(after.sent - before.sent, 1);
+    assert.strictEqual(after.coalesced - before.coalesced, 2);
+
+    notifications.close("dm:1");
+    notifications.destroy();
+    assert.throws(() => notifications.notify("dm:1", { summary: "alice" }));
+});
+
+test("native log keeps errors for drainNativeLog", () => {
+    libVesktop.setNativeLogOptions({ stderr: false });
+    libVesktop.drainNativeLog();
+    const before = libVesktop.getLibVesktopStats().nativeLog.written;
+
+    assert.strictEqual(libVesktop.setNativeLogOptions({ crashFile: "/nonexistent/libvesktop-crash.log" }), false);
+
+    const { records, lost } = libVesktop.drainNativeLog();
+    assert.strictEqual(lost, 0);
+    assert.strictEqual(records.length, 1);
+    assert.strictEqual(records[0].level, "error");
+    assert.strictEqual(records[0].subsystem, "set_log_crash_file");
+    assert.ok(records[0].timestamp <= process.hrtime.bigint());
+    assert.strictEqual(libVesktop.getLibVesktopStats().nativeLog.written - before, 1);
+    assert.strictEqual(libVesktop.drainNativeLog().records.length, 0);
+});
+
+test("native trace spans export as Chrome trace events", async () => {
+    libVesktop.setNativeTracing(true);
+    const pixmap = await libVesktop.decodeStatusNotifierIcon(require.resolve("../../static/tray/tray.png"), 16);
+    libVesktop.setNativeTracing(false);
+    assert.ok(pixmap.length > 8);
+
+    const { json, dropped } = libVesktop.exportNativeTrace();
+    const { traceEvents } = JSON.parse(json);
+    assert.strictEqual(dropped, 0);
+
+    const decode = traceEvents.find(e => e.name === "decode_image_file");
+    assert.ok(decode);
+    assert.strictEqual(decode.ph, "X");
+    assert.strictEqual(decode.pid, process.pid);
+    // same clock as process.hrtime(), in microseconds
+    assert.ok(decode.ts <= Number(process.hrtime.bigint() / 1000n));
+    assert.ok(traceEvents.some(e => e.ph === "M" && e.tid === decode.tid));
 });
@@ -0,0 +1,169 @@
+// Runs libvesktop against test/fake_portal with the portal and the
+// StatusNotifierWatcher answering late, not at all, or restarting, and fails
+// if any call from JS into the addon spends longer than the budget on the
+// calling thread. In Electron that thread is the UI thread, so a blocking
+// D-Bus round trip there is a frozen window.
+//
+// Needs its own process: the session bus address has to be set before the
+// addon first connects.
+
+const test = require("node:test");
+const assert = require("node:assert/strict");
+const fs = require("node:fs");
+const path = require("node:path");
+const readline = require("node:readline");
+const { spawn } = require("node:child_process");
+const { once } = require("node:events");
+const { performance } = require("node:perf_hooks");
+
+const BUDGET_MS = Number(process.env.LIBVESKTOP_CALL_BUDGET_MS) || 50;
+const REPLY_DELAY_MS = 1500;
+
+const fakePortal = path.join(__dirname, "../build/Release/fake_portal");
+
+// name -> longest synchronous time spent inside it
+const slowest = new Map();
+
+function record(name, start) {
+    const elapsed = performance.now() - start;
+    slowest.set(name, Math.max(slowest.get(name) ?? 0, elapsed));
+}
+
+function timed(name, fn) {
+    return function (...args) {
+        const start = performance.now();
+        try {
+            return new.target ? Reflect.construct(fn, args) : fn.apply(this, args);
+        } finally {
+            record(name, start);
+        }
+    };
+}
+
+// Wraps every export, and every method of every exported class, so nothing
+// the tests touch can slip past the measurement.
+function instrument(lib) {
+    const wrapped = {};
+    for (const [name, value] of Object.entries(lib)) {
+        if (typeof value !== "function") {
+            wrapped[name] = value;
+            continue;
+        }
+
+        for (const method of Object.getOwnPropertyNames(value.prototype ?? {})) {
+            const original = value.prototype[method];
+            if (method === "constructor" || typeof original !== "function") continue;
+            value.prototype[method] = timed(`${name}.${method}`, original);
+        }
+        wrapped[name] = timed(name, value);
+        wrapped[name].prototype = value.prototype;
+    }
+    return wrapped;
+}
+
+function waitFor(predicate, timeoutMs, what) {
+    return new Promise((resolve, reject) => {
+        const deadline = performance.now() + timeoutMs;
+        const poll = setInterval(() => {
+            if (predicate()) {
+                clearInterval(poll);
+                resolve();
+            } else if (performance.now() > deadline) {
+                clearInterval(poll);
+                reject(new Error(`timed out waiting for ${what}`));
+            }
+        }, 10);
+    });
+}
+
+function trayPixmap() {
+    const pixmap = Buffer.alloc(8 + 2 * 2 * 4, 0xff);
+    pixmap.writeUInt32LE(2, 0);
+    pixmap.writeUInt32LE(2, 4);
+    return pixmap;
+}
+
+test("libvesktop stays off the calling thread while services misbehave", async t => {
+    if (!fs.existsSync(fakePortal)) {
+        t.skip("fake_portal not built");
+        return;
+    }
+
+    const portal = spawn(fakePortal, ["--delay-ms", String(REPLY_DELAY_MS), "--accent", "1,0,0"], {
+        stdio: ["pipe", "pipe", "inherit"]
+    });
+    t.after(() => portal.kill());
+
+    const lines = readline.createInterface({ input: portal.stdout });
+    const [busAddress] = await once(lines, "line");
+    const acknowledged = [];
+    lines.on("line", line => acknowledged.push(line));
+    async function command(line) {
+        portal.stdin.write(line + "\n");
+        await waitFor(() => acknowledged.includes(`ok ${line}`), 2000, line);
+        acknowledged.length = 0;
+    }
+
+    process.env.DBUS_SESSION_BUS_ADDRESS = busAddress;
+    /** @type {typeof import("..")} */
+    const libVesktop = instrument(require(".."));
+    libVesktop.attachGLibMainLoop();
+    t.after(() => libVesktop.detachGLibMainLoop());
+
+    await t.test("slow portal", async () => {
+        const start = performance.now();
+        const accent = libVesktop.getAccentColor();
+        const background = libVesktop.requestBackground(true, ["equibop"]);
+
+        assert.strictEqual(await accent, 0xff0000);
+        assert.strictEqual(await background, true);
+        // the replies really were late, so the budget below means something
+        assert.ok(performance.now() - start >= REPLY_DELAY_MS * 0.9);
+    });
+
+    const item = new libVesktop.StatusNotifierItem({ title: "budget" });
+    const states = [];
+    item.onStateChange(state => states.push(state));
+    t.after(() => item.destroy());
+
+    await t.test("slow watcher", async () => {
+        item.setMenu([{ id: 1, label: "Quit" }]);
+        item.setIcon(trayPixmap());
+        assert.notStrictEqual(item.getState(), "registered");
+
+        await waitFor(() => item.getState() === "registered", REPLY_DELAY_MS * 3, "registration");
+    });
+
+    await t.test("watcher restart", async () => {
+        await command("delay 0");
+        states.length = 0;
+        await command("restart");
+
+        await waitFor(() => states.includes("unregistered"), 2000, "the watcher to vanish");
+        await waitFor(() => item.getState() === "registered", 2000, "registration with the new watcher");
+    });
+
+    await t.test("dropped replies", async () => {
+        await command("drop on");
+
+        // nothing ever answers; all that matters is that asking didn't block
+        const pending = [libVesktop.getAccentColor(), libVesktop.requestBackground(false, [])];
+        item.setTitle("still responsive");
+        item.setIcon(trayPixmap());
+        libVesktop.updateLauncherEntry({ count: 3 });
+        libVesktop.getSessionState();
+
+        await command("drop off");
+        await command("restart");
+        // the restart fails the held calls, so nothing is left running
+        assert.deepStrictEqual(await Promise.all(pending), [null, false]);
+    });
+
+    const over = [...slowest].filter(([, ms]) => ms > BUDGET_MS);
+    assert.deepStrictEqual(
+        over.map(([name, ms]) => `${name}: ${ms.toFixed(1)}ms`),
+        [],
+        `calls over the ${BUDGET_MS}ms budget`
+    );
+    assert.ok(slowest.has("getAccentColor") && slowest.has("StatusNotifierItem.setIcon"));
+});
@@ -0,0 +1,700 @@
+// Stand-in for xdg-desktop-portal and the StatusNotifierWatcher used by
+// test.js and test/budget.js. Starts a private bus, prints its address on
+// stdout and serves org.freedesktop.portal.Desktop and
+// org.kde.StatusNotifierWatcher on it until stdin closes or SIGTERM arrives.
+//
+// GlobalShortcuts: CreateSession and BindShortcuts answer through Request
+// objects like the real portal. After binding, every shortcut is pressed and
+// released once (after --trigger-delay-ms, default 50) so clients can be
+// tested without a keyboard.
+//
+// Settings, Background and the watcher can be made misbehave, to check that
+// clients don't block on them:
+//   --delay-ms N      answer their method calls N ms late
+//   --drop            never answer them at all
+//   --accent R,G,B    accent-color returned by Settings.Read (0..1 each)
+// The same can be changed at runtime with one command per line on stdin,
+// each acknowledged with "ok <command>" on stdout:
+//   delay N | drop on | drop off | accent R G B (also emits SettingChanged)
+//   restart           drops both names and takes them back, the way a
+//                     crashed service comes back; unanswered calls fail
+//   metered on|off    flips NetworkMonitor's metered flag and emits changed
+//
+// NetworkMonitor (version 3) is what GIO's GNetworkMonitor reads when it is
+// told to use portals (GIO_USE_PORTALS=1), so network changes can be faked.
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+    constexpr const char *PORTAL_SERVICE = "org.freedesktop.portal.Desktop";
+    constexpr const char *PORTAL_PATH = "/org/freedesktop/portal/desktop";
+    constexpr const char *SHORTCUTS_INTERFACE = "org.freedesktop.portal.GlobalShortcuts";
+    constexpr const char *SETTINGS_INTERFACE = "org.freedesktop.portal.Settings";
+    constexpr const char *BACKGROUND_INTERFACE = "org.freedesktop.portal.Background";
+    constexpr const char *NETWORK_INTERFACE = "org.freedesktop.portal.NetworkMonitor";
+    constexpr const char *WATCHER_SERVICE = "org.kde.StatusNotifierWatcher";
+    constexpr const char *WATCHER_PATH = "/StatusNotifierWatcher";
+
+    constexpr const char *introspection_xml = R"XML(
+<node>
+  <interface name="org.freedesktop.portal.GlobalShortcuts">
+    <method name="CreateSession">
+      <arg type="a{sv}" name="options" direction="in"/>
+      <arg type="o" name="handle" direction="out"/>
+    </method>
+    <method name="BindShortcuts">
+      <arg type="o" name="session_handle" direction="in"/>
+      <arg type="a(sa{sv})" name="shortcuts" direction="in"/>
+      <arg type="s" name="parent_window" direction="in"/>
+      <arg type="a{sv}" name="options" direction="in"/>
+      <arg type="o" name="request_handle" direction="out"/>
+    </method>
+    <signal name="Activated">
+      <arg type="o" name="session_handle"/>
+      <arg type="s" name="shortcut_id"/>
+      <arg type="t" name="timestamp"/>
+      <arg type="a{sv}" name="options"/>
+    </signal>
+    <signal name="Deactivated">
+      <arg type="o" name="session_handle"/>
+      <arg type="s" name="shortcut_id"/>
+      <arg type="t" name="timestamp"/>
+      <arg type="a{sv}" name="options"/>
+    </signal>
+  </interface>
+  <interface name="org.freedesktop.portal.Session">
+    <method name="Close"/>
+  </interface>
+  <interface name="org.freedesktop.portal.Settings">
+    <method name="Read">
+      <arg type="s" name="namespace" direction="in"/>
+      <arg type="s" name="key" direction="in"/>
+      <arg type="v" name="value" direction="out"/>
+    </method>
+    <signal name="SettingChanged">
+      <arg type="s" name="namespace"/>
+      <arg type="s" name="key"/>
+      <arg type="v" name="value"/>
+    </signal>
+  </interface>
+  <interface name="org.freedesktop.portal.Background">
+    <method name="RequestBackground">
+      <arg type="s" name="parent_window" direction="in"/>
+      <arg type="a{sv}" name="options" direction="in"/>
+      <arg type="o" name="handle" direction="out"/>
+    </method>
+  </interface>
+  <interface name="org.freedesktop.portal.NetworkMonitor">
+    <method name="GetAvailable">
+      <arg type="b" name="available" direction="out"/>
+    </method>
+    <method name="GetMetered">
+      <arg type="b" name="metered" direction="out"/>
+    </method>
+    <method name="GetConnectivity">
+      <arg type="u" name="connectivity" direction="out"/>
+    </method>
+    <method name="GetStatus">
+      <arg type="a{sv}" name="status" direction="out"/>
+    </method>
+    <method name="CanReach">
+      <arg type="s" name="hostname" direction="in"/>
+      <arg type="u" name="port" direction="in"/>
+      <arg type="b" name="reachable" direction="out"/>
+    </method>
+    <signal name="changed"/>
+    <property name="version" type="u" access="read"/>
+  </interface>
+  <interface name="org.kde.StatusNotifierWatcher">
+    <method name="RegisterStatusNotifierItem">
+      <arg type="s" name="service" direction="in"/>
+    </method>
+    <method name="RegisterStatusNotifierHost">
+      <arg type="s" name="service" direction="in"/>
+    </method>
+    <property name="RegisteredStatusNotifierItems" type="as" access="read"/>
+    <property name="IsStatusNotifierHostRegistered" type="b" access="read"/>
+    <property name="ProtocolVersion" type="i" access="read"/>
+    <signal name="StatusNotifierItemRegistered">
+      <arg type="s" name="service"/>
+    </signal>
+  </interface>
+</node>
+)XML";
+
+    struct Portal
+    {
+        GDBusConnection *bus = nullptr;
+        GDBusNodeInfo *node_info = nullptr;
+        GMainLoop *loop = nullptr;
+        guint trigger_delay_ms = 50;
+        // session path -> registration id of its Session object
+        std::map<std::string, guint> sessions;
+
+        guint reply_delay_ms = 0;
+        bool drop_replies = false;
+        double accent[3] = {0.21, 0.52, 0.89};
+        bool network_metered = false;
+        std::vector<std::string> registered_items;
+        // calls held back by --delay-ms or --drop, answered or failed later
+        std::vector<GDBusMethodInvocation *> held;
+        guint owner_ids[2] = {0, 0};
+        guint names_acquired = 0;
+        // printed once both names are first acquired, then cleared
+        std::string address;
+        std::string stdin_line;
+    };
+
+    struct DelayedReply
+    {
+        Portal *portal;
+        GDBusMethodInvocation *invocation;
+        GVariant *value;
+    };
+
+    struct PendingTrigger
+    {
+        Portal *portal;
+        std::string session;
+        std::vector<std::string> ids;
+    };
+
+    std::string sender_token(const gchar *sender)
+    {
+        std::string token = sender[0] == ':' ? sender + 1 : sender;
+        for (auto &c : token)
+        {
+            if (c == '.')
+                c = '_';
+        }
+        return token;
+    }
+
+    std::string lookup_token(GVariant *options, const char *key, const char *fallback)
+    {
+        const gchar *value = nullptr;
+        if (g_variant_lookup(options, key, "&s", &value))
+            return value;
+        return fallback;
+    }
+
+    void emit_response(Portal *portal, const gchar *destination, const std::string &request_path, GVariant *results)
+    {
+        g_dbus_connection_emit_signal(portal->bus, destination, request_path.c_str(), "org.freedesktop.portal.Request",
+                                      "Response", g_variant_new("(u@a{sv})", 0u, results), nullptr);
+    }
+
+    gboolean fire_triggers(gpointer data)
+    {
+        auto *trigger = static_cast<PendingTrigger *>(data);
+        Portal *portal = trigger->portal;
+
+        if (portal->sessions.count(trigger->session) == 0)
+            return G_SOURCE_REMOVE;
+
+        for (const auto &id : trigger->ids)
+        {
+            for (const char *signal_name : {"Activated", "Deactivated"})
+            {
+                g_dbus_connection_emit_signal(
+                    portal->bus, nullptr, PORTAL_PATH, SHORTCUTS_INTERFACE, signal_name,
+                    g_variant_new("(ost@a{sv})", trigger->session.c_str(), id.c_str(),
+                                  static_cast<guint64>(g_get_monotonic_time() / 1000),
+                                  g_variant_new_array(G_VARIANT_TYPE("{sv}"), nullptr, 0)),
+                    nullptr);
+            }
+        }
+
+        return G_SOURCE_REMOVE;
+    }
+
+    void handle_session_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                             const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                             GDBusMethodInvocation *invocation, gpointer user_data)
+    {
+        (void)sender;
+        (void)interface_name;
+        (void)method_name;
+        (void)parameters;
+
+        auto *portal = static_cast<Portal *>(user_data);
+        auto it = portal->sessions.find(object_path);
+        if (it != portal->sessions.end())
+        {
+            g_dbus_connection_unregister_object(connection, it->second);
+            portal->sessions.erase(it);
+        }
+
+        g_dbus_method_invocation_return_value(invocation, nullptr);
+    }
+
+    void handle_shortcuts_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                               const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                               GDBusMethodInvocation *invocation, gpointer user_data)
+    {
+        (void)object_path;
+        (void)interface_name;
+
+        auto *portal = static_cast<Portal *>(user_data);
+        // sender and parameters belong to the invocation, which is gone once
+        // it has been answered
+        const std::string caller = sender;
+        const std::string token = sender_token(sender);
+
+        if (g_strcmp0(method_name, "CreateSession") == 0)
+        {
+            GVariant *options = g_variant_get_child_value(parameters, 0);
+            std::string request_path = std::string(PORTAL_PATH) + "/request/" + token + "/" +
+                                       lookup_token(options, "handle_token", "t");
+            std::string session_path = std::string(PORTAL_PATH) + "/session/" + token + "/" +
+                                       lookup_token(options, "session_handle_token", "s");
+            g_variant_unref(options);
+
+            static GDBusInterfaceVTable session_vtable = {handle_session_call, nullptr, nullptr, {}};
+            guint id = g_dbus_connection_register_object(connection, session_path.c_str(), portal->node_info->interfaces[1],
+                                                         &session_vtable, portal, nullptr, nullptr);
+            portal->sessions[session_path] = id;
+
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(o)", request_path.c_str()));
+
+            GVariantBuilder results;
+            g_variant_builder_init(&results, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&results, "{sv}", "session_handle", g_variant_new_string(session_path.c_str()));
+            emit_response(portal, caller.c_str(), request_path, g_variant_builder_end(&results));
+        }
+        else if (g_strcmp0(method_name, "BindShortcuts") == 0)
+        {
+            const gchar *session = nullptr;
+            GVariant *shortcuts = nullptr;
+            GVariant *options = nullptr;
+            g_variant_get(parameters, "(&o@a(sa{sv})&s@a{sv})", &session, &shortcuts, nullptr, &options);
+
+            std::string request_path = std::string(PORTAL_PATH) + "/request/" + token + "/" +
+                                       lookup_token(options, "handle_token", "t");
+            auto *trigger = new PendingTrigger{portal, session, {}};
+            GVariantIter iter;
+            const gchar *id;
+            g_variant_iter_init(&iter, shortcuts);
+            while (g_variant_iter_next(&iter, "(&s@a{sv})", &id, nullptr))
+                trigger->ids.push_back(id);
+
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(o)", request_path.c_str()));
+
+            GVariantBuilder results;
+            g_variant_builder_init(&results, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&results, "{sv}", "shortcuts", shortcuts);
+            emit_response(portal, caller.c_str(), request_path, g_variant_builder_end(&results));
+
+            g_timeout_add_full(G_PRIORITY_DEFAULT, portal->trigger_delay_ms, fire_triggers, trigger,
+                               [](gpointer data) { delete static_cast<PendingTrigger *>(data); });
+
+            g_variant_unref(shortcuts);
+            g_variant_unref(options);
+        }
+    }
+
+    // Answers now, after reply_delay_ms, or never, depending on how the
+    // fixture was told to behave. value is consumed.
+    void reply(Portal *portal, GDBusMethodInvocation *invocation, GVariant *value)
+    {
+        if (value)
+            g_variant_ref_sink(value);
+
+        if (portal->drop_replies)
+        {
+            portal->held.push_back(invocation);
+            if (value)
+                g_variant_unref(value);
+            return;
+        }
+
+        if (portal->reply_delay_ms == 0)
+        {
+            g_dbus_method_invocation_return_value(invocation, value);
+            if (value)
+                g_variant_unref(value);
+            return;
+        }
+
+        portal->held.push_back(invocation);
+        g_timeout_add(portal->reply_delay_ms, [](gpointer data) -> gboolean
+        {
+            auto *delayed = static_cast<DelayedReply *>(data);
+            Portal *portal = delayed->portal;
+
+            // a restart in the meantime already failed it
+            auto it = std::find(portal->held.begin(), portal->held.end(), delayed->invocation);
+            if (it != portal->held.end())
+            {
+                portal->held.erase(it);
+                g_dbus_method_invocation_return_value(delayed->invocation, delayed->value);
+            }
+
+            if (delayed->value)
+                g_variant_unref(delayed->value);
+            delete delayed;
+            return G_SOURCE_REMOVE;
+        }, new DelayedReply{portal, invocation, value});
+    }
+
+    GVariant *accent_value(Portal *portal)
+    {
+        return g_variant_new("(ddd)", portal->accent[0], portal->accent[1], portal->accent[2]);
+    }
+
+    void handle_settings_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                              const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                              GDBusMethodInvocation *invocation, gpointer user_data)
+    {
+        (void)connection;
+        (void)sender;
+        (void)object_path;
+        (void)interface_name;
+        (void)method_name;
+
+        auto *portal = static_cast<Portal *>(user_data);
+        const gchar *name_space = nullptr;
+        const gchar *key = nullptr;
+        g_variant_get(parameters, "(&s&s)", &name_space, &key);
+
+        if (g_strcmp0(name_space, "org.freedesktop.appearance") != 0 || g_strcmp0(key, "accent-color") != 0)
+        {
+            g_dbus_method_invocation_return_dbus_error(invocation, "org.freedesktop.portal.Error.NotFound",
+                                                       "Requested setting not found");
+            return;
+        }
+
+        // the real portal wraps the value in a second variant
+        reply(portal, invocation, g_variant_new("(v)", g_variant_new_variant(accent_value(portal))));
+    }
+
+    void handle_background_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                                GDBusMethodInvocation *invocation, gpointer user_data)
+    {
+        (void)connection;
+        (void)object_path;
+        (void)interface_name;
+        (void)method_name;
+        (void)parameters;
+
+        auto *portal = static_cast<Portal *>(user_data);
+        std::string request_path = std::string(PORTAL_PATH) + "/request/" + sender_token(sender) + "/background";
+        reply(portal, invocation, g_variant_new("(o)", request_path.c_str()));
+    }
+
+    void handle_network_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                             const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                             GDBusMethodInvocation *invocation, gpointer user_data)
+    {
+        (void)connection;
+        (void)sender;
+        (void)object_path;
+        (void)interface_name;
+        (void)parameters;
+
+        auto *portal = static_cast<Portal *>(user_data);
+        // always available with full connectivity; only metered changes
+        constexpr guint32 CONNECTIVITY_FULL = 4;
+
+        if (g_strcmp0(method_name, "GetStatus") == 0)
+        {
+            GVariantBuilder status;
+            g_variant_builder_init(&status, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&status, "{sv}", "available", g_variant_new_boolean(TRUE));
+            g_variant_builder_add(&status, "{sv}", "metered", g_variant_new_boolean(portal->network_metered));
+            g_variant_builder_add(&status, "{sv}", "connectivity", g_variant_new_uint32(CONNECTIVITY_FULL));
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(a{sv})", &status));
+        }
+        else if (g_strcmp0(method_name, "GetMetered") == 0)
+        {
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(b)", portal->network_metered));
+        }
+        else if (g_strcmp0(method_name, "GetConnectivity") == 0)
+        {
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(u)", CONNECTIVITY_FULL));
+        }
+        else
+        {
+            // GetAvailable and CanReach
+            g_dbus_method_invocation_return_value(invocation, g_variant_new("(b)", TRUE));
+        }
+    }
+
+    GVariant *get_network_property(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                   const gchar *interface_name, const gchar *property_name, GError **error,
+                                   gpointer user_data)
+    {
+        (void)connection;
+        (void)sender;
+        (void)object_path;
+        (void)interface_name;
+        (void)property_name;
+        (void)error;
+        (void)user_data;
+
+        // version is the only property; 3 has GetStatus
+        return g_variant_new_uint32(3);
+    }
+
+    void handle_watcher_call(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                             const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+                             GDBusMethodInvocation *invocation, gpointer user_data)
+    {
+        (void)connection;
+        (void)object_path;
+        (void)interface_name;
+
+        auto *portal = static_cast<Portal *>(user_data);
+
+        if (g_strcmp0(method_name, "RegisterStatusNotifierItem") == 0)
+        {
+            const gchar *service = nullptr;
+            g_variant_get(parameters, "(&s)", &service);
+
+            // an object path means "this path on the sender's connection"
+            std::string item = service[0] == '/' ? std::string(sender) + service : std::string(service);
+            portal->registered_items.push_back(item);
+            g_dbus_connection_emit_signal(portal->bus, nullptr, WATCHER_PATH, WATCHER_SERVICE,
+                                          "StatusNotifierItemRegistered", g_variant_new("(s)", item.c_str()), nullptr);
+        }
+
+        reply(portal, invocation, nullptr);
+    }
+
+    GVariant *get_watcher_property(GDBusConnection *connection, const gchar *sender, const gchar *object_path,
+                                   const gchar *interface_name, const gchar *property_name, GError **error,
+                                   gpointer user_data)
+    {
+        (void)connection;
+        (void)sender;
+        (void)object_path;
+        (void)interface_name;
+        (void)error;
+
+        auto *portal = static_cast<Portal *>(user_data);
+
+        if (g_strcmp0(property_name, "RegisteredStatusNotifierItems") == 0)
+        {
+            GVariantBuilder builder;
+            g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
+            for (const auto &item : portal->registered_items)
+                g_variant_builder_add(&builder, "s", item.c_str());
+            return g_variant_builder_end(&builder);
+        }
+        if (g_strcmp0(property_name, "IsStatusNotifierHostRegistered") == 0)
+            return g_variant_new_boolean(TRUE);
+        return g_variant_new_int32(0);
+    }
+
+    void on_name_acquired(GDBusConnection *, const gchar *, gpointer user_data)
+    {
+        auto *portal = static_cast<Portal *>(user_data);
+        if (++portal->names_acquired < G_N_ELEMENTS(portal->owner_ids) || portal->address.empty())
+            return;
+
+        // clients only connect once the names are owned
+        std::printf("%s\n", portal->address.c_str());
+        std::fflush(stdout);
+        portal->address.clear();
+    }
+
+    // Only ever through GDBus's name owning, never a RequestName of our own:
+    // GDBus would see ALREADY_OWNER, and g_bus_unown_name would then leave
+    // the name with us and no NameOwnerChanged would be sent on restart.
+    void own_names(Portal *portal)
+    {
+        const char *names[] = {PORTAL_SERVICE, WATCHER_SERVICE};
+        portal->names_acquired = 0;
+        for (size_t i = 0; i < G_N_ELEMENTS(names); i++)
+        {
+            portal->owner_ids[i] = g_bus_own_name_on_connection(portal->bus, names[i], G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                                on_name_acquired, nullptr, portal, nullptr);
+        }
+    }
+
+    void restart(Portal *portal)
+    {
+        for (guint &owner_id : portal->owner_ids)
+        {
+            g_bus_unown_name(owner_id);
+            owner_id = 0;
+        }
+
+        // a service that went away never answers what it was holding
+        for (GDBusMethodInvocation *invocation : portal->held)
+        {
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY,
+                                                  "Service restarted");
+        }
+        portal->held.clear();
+        portal->registered_items.clear();
+
+        // give clients a moment without an owner, as with a real crash
+        g_timeout_add(50, [](gpointer data) -> gboolean
+        {
+            own_names(static_cast<Portal *>(data));
+            return G_SOURCE_REMOVE;
+        }, portal);
+    }
+
+    void run_command(Portal *portal, const std::string &line)
+    {
+        double r, g, b;
+        char toggle[8] = {};
+        guint delay;
+
+        if (line == "restart")
+        {
+            restart(portal);
+        }
+        else if (std::sscanf(line.c_str(), "delay %u", &delay) == 1)
+        {
+            portal->reply_delay_ms = delay;
+        }
+        else if (std::sscanf(line.c_str(), "drop %7s", toggle) == 1)
+        {
+            portal->drop_replies = std::strcmp(toggle, "on") == 0;
+        }
+        else if (std::sscanf(line.c_str(), "metered %7s", toggle) == 1)
+        {
+            portal->network_metered = std::strcmp(toggle, "on") == 0;
+            g_dbus_connection_emit_signal(portal->bus, nullptr, PORTAL_PATH, NETWORK_INTERFACE, "changed", nullptr,
+                                          nullptr);
+        }
+        else if (std::sscanf(line.c_str(), "accent %lf %lf %lf", &r, &g, &b) == 3)
+        {
+            portal->accent[0] = r;
+            portal->accent[1] = g;
+            portal->accent[2] = b;
+            g_dbus_connection_emit_signal(
+                portal->bus, nullptr, PORTAL_PATH, SETTINGS_INTERFACE, "SettingChanged",
+                g_variant_new("(ssv)", "org.freedesktop.appearance", "accent-color", accent_value(portal)), nullptr);
+        }
+        else
+        {
+            std::fprintf(stderr, "fake_portal: unknown command %s\n", line.c_str());
+            return;
+        }
+
+        g_dbus_connection_flush_sync(portal->bus, nullptr, nullptr);
+        std::printf("ok %s\n", line.c_str());
+        std::fflush(stdout);
+    }
+
+    gboolean quit_loop(gpointer data)
+    {
+        g_main_loop_quit(static_cast<GMainLoop *>(data));
+        return G_SOURCE_REMOVE;
+    }
+
+    gboolean on_stdin(gint fd, GIOCondition condition, gpointer data)
+    {
+        (void)condition;
+
+        auto *portal = static_cast<Portal *>(data);
+        char buffer[256];
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length > 0)
+        {
+            portal->stdin_line.append(buffer, static_cast<size_t>(length));
+
+            size_t newline;
+            while ((newline = portal->stdin_line.find('\n')) != std::string::npos)
+            {
+                std::string line = portal->stdin_line.substr(0, newline);
+                portal->stdin_line.erase(0, newline + 1);
+                if (!line.empty())
+                    run_command(portal, line);
+            }
+            return G_SOURCE_CONTINUE;
+        }
+
+        g_main_loop_quit(portal->loop);
+        return G_SOURCE_REMOVE;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Portal portal;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--trigger-delay-ms") == 0 && i + 1 < argc)
+            portal.trigger_delay_ms = static_cast<guint>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--delay-ms") == 0 && i + 1 < argc)
+            portal.reply_delay_ms = static_cast<guint>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--drop") == 0)
+            portal.drop_replies = true;
+        else if (std::strcmp(argv[i], "--accent") == 0 && i + 1 < argc)
+            std::sscanf(argv[++i], "%lf,%lf,%lf", &portal.accent[0], &portal.accent[1], &portal.accent[2]);
+    }
+
+    GTestDBus *test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(test_bus);
+
+    GError *error = nullptr;
+    portal.bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+    portal.node_info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+    if (!portal.bus || !portal.node_info)
+    {
+        std::fprintf(stderr, "fake_portal: %s\n", error ? error->message : "setup failed");
+        return 1;
+    }
+
+    static GDBusInterfaceVTable shortcuts_vtable = {handle_shortcuts_call, nullptr, nullptr, {}};
+    static GDBusInterfaceVTable settings_vtable = {handle_settings_call, nullptr, nullptr, {}};
+    static GDBusInterfaceVTable background_vtable = {handle_background_call, nullptr, nullptr, {}};
+    static GDBusInterfaceVTable network_vtable = {handle_network_call, get_network_property, nullptr, {}};
+    static GDBusInterfaceVTable watcher_vtable = {handle_watcher_call, get_watcher_property, nullptr, {}};
+    const struct
+    {
+        const char *path;
+        const char *interface_name;
+        const GDBusInterfaceVTable *vtable;
+    } objects[] = {
+        {PORTAL_PATH, SHORTCUTS_INTERFACE, &shortcuts_vtable},
+        {PORTAL_PATH, SETTINGS_INTERFACE, &settings_vtable},
+        {PORTAL_PATH, BACKGROUND_INTERFACE, &background_vtable},
+        {PORTAL_PATH, NETWORK_INTERFACE, &network_vtable},
+        {WATCHER_PATH, WATCHER_SERVICE, &watcher_vtable},
+    };
+    for (const auto &object : objects)
+    {
+        g_dbus_connection_register_object(portal.bus, object.path,
+                                          g_dbus_node_info_lookup_interface(portal.node_info, object.interface_name),
+                                          object.vtable, &portal, nullptr, nullptr);
+    }
+
+    portal.address = g_test_dbus_get_bus_address(test_bus);
+    own_names(&portal);
+
+    portal.loop = g_main_loop_new(nullptr, FALSE);
+    g_unix_signal_add(SIGTERM, quit_loop, portal.loop);
+    g_unix_signal_add(SIGINT, quit_loop, portal.loop);
+    g_unix_fd_add(0, G_IO_IN | G_IO_HUP, on_stdin, &portal);
+
+    g_main_loop_run(portal.loop);
+
+    for (GDBusMethodInvocation *invocation : portal.held)
+        g_object_unref(invocation);
+
+    g_main_loop_unref(portal.loop);
+    g_dbus_node_info_unref(portal.node_info);
+    g_object_unref(portal.bus);
+    g_test_dbus_down(test_bus);
+    g_object_unref(test_bus);
+    return 0;
+}
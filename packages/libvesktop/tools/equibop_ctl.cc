@@ -0,0 +1,49 @@
+// Sends an action to the running Equibop over D-Bus and exits, for
+// compositor key bindings that shouldn't pay for starting Electron.
+//
+//   equibop_ctl [--bus-name NAME] toggle-mute|toggle-deafen|show
+//
+// Exits 0 once the instance has accepted the action, 1 if none is running.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "../src/control_service.h"
+
+namespace
+{
+    int usage()
+    {
+        std::fprintf(stderr, "usage: equibop_ctl [--bus-name NAME] toggle-mute|toggle-deafen|show\n");
+        return 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string bus_name = "org.equicord.equibop";
+    const char *action_name = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--bus-name") == 0 && i + 1 < argc)
+            bus_name = argv[++i];
+        else if (!action_name && argv[i][0] != '-')
+            action_name = argv[i];
+        else
+            return usage();
+    }
+
+    ControlAction action;
+    if (!action_name || !parse_control_action(action_name, action))
+        return usage();
+
+    std::string error;
+    if (!call_control_action(bus_name, action, 1000, error))
+    {
+        std::fprintf(stderr, "equibop_ctl: %s\n", error.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,540 @@
+// Replays a trace captured with startDBusRecording / LIBVESKTOP_DBUS_TRACE
+// against a fresh StatusNotifierItem on a private bus and reports throughput,
+// latency percentiles and allocation counts.
+//
+//   sni_replay [--paced] [--iterations N] TRACE
+//   sni_replay --synthesize TRACE [--count N]
+//
+// Needs dbus-daemon in PATH; nothing else from the desktop session is used.
+
+#include <gio/gio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/dbus_recorder.h"
+#include "../src/glib_ptr.h"
+#include "../src/native_log.h"
+#include "../src/status_notifier_item.h"
+
+// Count every allocation made by the process while a measurement is running.
+// glibc exports the real allocator under __libc_*, so no dlsym dance needed.
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+    std::atomic<bool> counting_allocations{false};
+    std::atomic<uint64_t> allocation_count{0};
+
+    inline void count_allocation()
+    {
+        if (counting_allocations.load(std::memory_order_relaxed))
+            allocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+extern "C"
+{
+    void *malloc(size_t size)
+    {
+        count_allocation();
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        count_allocation();
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        count_allocation();
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr const char *SNI_INTERFACE = "org.kde.StatusNotifierItem";
+    constexpr const char *PROPERTIES_INTERFACE = "org.freedesktop.DBus.Properties";
+    constexpr const char *DBUSMENU_INTERFACE = "com.canonical.dbusmenu";
+    constexpr const char *MENU_OBJECT_PATH = "/MenuBar";
+    constexpr gint CALL_TIMEOUT_MS = 5000;
+    constexpr int PING_CALIBRATION_CALLS = 200;
+
+    struct PreparedCall
+    {
+        uint64_t timestamp_us;
+        const char *object_path;
+        std::string interface_name;
+        std::string member;
+        GVariantPtr parameters;
+    };
+
+    struct CallResult
+    {
+        size_t call_index;
+        double latency_us;
+        bool failed;
+    };
+
+    struct Options
+    {
+        bool paced = false;
+        int iterations = 1;
+        int synthesize_count = 0;
+        std::string synthesize_path;
+        std::string trace_path;
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: sni_replay [--paced] [--iterations N] TRACE\n"
+                  << "       sni_replay --synthesize TRACE [--count N]" << std::endl;
+    }
+
+    bool parse_args(int argc, char **argv, Options &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--paced")
+                options.paced = true;
+            else if (arg == "--iterations" && i + 1 < argc)
+                options.iterations = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--count" && i + 1 < argc)
+                options.synthesize_count = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--synthesize" && i + 1 < argc)
+                options.synthesize_path = argv[++i];
+            else if (!arg.empty() && arg[0] != '-' && options.trace_path.empty())
+                options.trace_path = arg;
+            else
+                return false;
+        }
+
+        return !options.synthesize_path.empty() || !options.trace_path.empty();
+    }
+
+    TraceRecord make_record(uint64_t timestamp_us, TraceTarget target, uint8_t sender, const char *interface_name,
+                            const char *member, GVariant *parameters)
+    {
+        GVariantPtr body(g_variant_ref_sink(parameters));
+
+        TraceRecord record;
+        record.timestamp_us = timestamp_us;
+        record.target = target;
+        record.sender = sender;
+        record.interface_name = interface_name;
+        record.member = member;
+        record.signature = g_variant_get_type_string(body.get());
+
+        const auto *data = static_cast<const uint8_t *>(g_variant_get_data(body.get()));
+        record.body.assign(data, data + g_variant_get_size(body.get()));
+        return record;
+    }
+
+    // A rough imitation of a panel: one host reads everything once, then the
+    // user hovers and opens the menu every so often while a second host polls
+    // the icon.
+    bool synthesize_trace(const std::string &path, int count, std::string &error)
+    {
+        TraceWriter writer;
+        if (!writer.open(path, error))
+            return false;
+
+        uint64_t t = 0;
+        bool ok = writer.write(make_record(t, TraceTarget::Item, 0, PROPERTIES_INTERFACE, "GetAll",
+                                           g_variant_new("(s)", SNI_INTERFACE)));
+        ok = ok && writer.write(make_record(t += 200, TraceTarget::Menu, 0, DBUSMENU_INTERFACE, "GetLayout",
+                                            g_variant_new("(ii@as)", 0, -1, g_variant_new_strv(nullptr, 0))));
+
+        for (int i = 0; ok && i < count; i++)
+        {
+            t += 50000;
+            ok = ok && writer.write(make_record(t, TraceTarget::Item, 1, PROPERTIES_INTERFACE, "Get",
+                                                g_variant_new("(ss)", SNI_INTERFACE, "IconPixmap")));
+            ok = ok && writer.write(make_record(t += 300, TraceTarget::Item, 1, PROPERTIES_INTERFACE, "Get",
+                                                g_variant_new("(ss)", SNI_INTERFACE, "ToolTip")));
+
+            if (i % 4 == 0)
+            {
+                const gint32 ids[] = {1, 2, 3};
+                ok = ok && writer.write(make_record(t += 1000, TraceTarget::Menu, 0, DBUSMENU_INTERFACE, "AboutToShow",
+                                                    g_variant_new("(i)", 0)));
+                ok = ok && writer.write(make_record(t += 500, TraceTarget::Menu, 0, DBUSMENU_INTERFACE, "GetLayout",
+                                                    g_variant_new("(ii@as)", 0, -1, g_variant_new_strv(nullptr, 0))));
+                ok = ok && writer.write(make_record(
+                    t += 500, TraceTarget::Menu, 0, DBUSMENU_INTERFACE, "GetGroupProperties",
+                    g_variant_new("(@ai@as)",
+                                  g_variant_new_fixed_array(G_VARIANT_TYPE_INT32, ids, G_N_ELEMENTS(ids), sizeof(gint32)),
+                                  g_variant_new_strv(nullptr, 0))));
+                ok = ok && writer.write(make_record(t += 800, TraceTarget::Menu, 0, DBUSMENU_INTERFACE, "Event",
+                                                    g_variant_new("(isvu)", 0, "opened", g_variant_new_int32(0), 0u)));
+                ok = ok && writer.write(make_record(t += 2000, TraceTarget::Menu, 0, DBUSMENU_INTERFACE, "Event",
+                                                    g_variant_new("(isvu)", 0, "closed", g_variant_new_int32(0), 0u)));
+            }
+        }
+
+        writer.close();
+        if (!ok)
+            error = "Failed to write " + path;
+        return ok;
+    }
+
+    bool prepare_calls(const std::vector<TraceRecord> &records, std::map<uint8_t, std::vector<PreparedCall>> &by_sender,
+                       std::string &error)
+    {
+        for (const auto &record : records)
+        {
+            PreparedCall call;
+            call.timestamp_us = record.timestamp_us;
+            call.object_path = record.target == TraceTarget::Menu ? MENU_OBJECT_PATH : StatusNotifierItem::DEFAULT_OBJECT_PATH;
+            call.interface_name = record.interface_name;
+            call.member = record.member;
+
+            if (!record.signature.empty())
+            {
+                if (!g_variant_type_string_is_valid(record.signature.c_str()) || record.signature[0] != '(')
+                {
+                    error = "Invalid signature '" + record.signature + "' for " + record.member;
+                    return false;
+                }
+
+                GBytes *bytes = g_bytes_new(record.body.data(), record.body.size());
+                GVariant *body = g_variant_new_from_bytes(G_VARIANT_TYPE(record.signature.c_str()), bytes, FALSE);
+                g_bytes_unref(bytes);
+                call.parameters.reset(g_variant_ref_sink(body));
+            }
+
+            by_sender[record.sender].push_back(std::move(call));
+        }
+
+        return true;
+    }
+
+    GDBusConnection *open_client(const gchar *address, std::string &error)
+    {
+        GError *gerror = nullptr;
+        GDBusConnection *connection = g_dbus_connection_new_for_address_sync(
+            address,
+            static_cast<GDBusConnectionFlags>(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                              G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr,
+            nullptr,
+            &gerror);
+
+        if (!connection)
+        {
+            GErrorPtr error_ptr(gerror);
+            error = std::string("Failed to connect to private bus: ") + (error_ptr ? error_ptr->message : "unknown error");
+        }
+
+        return connection;
+    }
+
+    bool call(GDBusConnection *connection, const char *destination, const PreparedCall &prepared)
+    {
+        GError *error = nullptr;
+        GVariantPtr reply(g_dbus_connection_call_sync(
+            connection,
+            destination,
+            prepared.object_path,
+            prepared.interface_name.empty() ? nullptr : prepared.interface_name.c_str(),
+            prepared.member.c_str(),
+            prepared.parameters.get(),
+            nullptr,
+            G_DBUS_CALL_FLAGS_NONE,
+            CALL_TIMEOUT_MS,
+            nullptr,
+            &error));
+
+        GErrorPtr error_ptr(error);
+        return reply != nullptr;
+    }
+
+    // Allocations per round trip of a call GDBus answers by itself, so the
+    // cost of the client side and the bus can be subtracted out.
+    double calibrate_ping(GDBusConnection *connection, const char *destination)
+    {
+        PreparedCall ping{0, "/", "org.freedesktop.DBus.Peer", "Ping", {}};
+
+        allocation_count = 0;
+        counting_allocations = true;
+        for (int i = 0; i < PING_CALIBRATION_CALLS; i++)
+            call(connection, destination, ping);
+        counting_allocations = false;
+
+        return static_cast<double>(allocation_count.load()) / PING_CALIBRATION_CALLS;
+    }
+
+    double percentile(std::vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    std::vector<uint8_t> make_icon(uint32_t size)
+    {
+        std::vector<uint8_t> pixmap(8 + size * size * 4, 0xff);
+        for (int i = 0; i < 4; i++)
+        {
+            pixmap[i] = static_cast<uint8_t>(size >> (i * 8));
+            pixmap[4 + i] = static_cast<uint8_t>(size >> (i * 8));
+        }
+        return pixmap;
+    }
+
+    std::vector<MenuItem> make_menu()
+    {
+        std::vector<MenuItem> items;
+        for (int32_t id = 1; id <= 10; id++)
+        {
+            if (id == 5)
+                items.push_back({id, "", true, true, true});
+            else
+                items.push_back({id, "Item " + std::to_string(id), true, true, false});
+        }
+        return items;
+    }
+
+    int replay(const Options &options)
+    {
+        std::vector<TraceRecord> records;
+        std::string error;
+        if (!read_dbus_trace(options.trace_path, records, error))
+        {
+            std::cerr << "sni_replay: " << error << std::endl;
+            return 1;
+        }
+
+        std::map<uint8_t, std::vector<PreparedCall>> by_sender;
+        if (!prepare_calls(records, by_sender, error))
+        {
+            std::cerr << "sni_replay: " << error << std::endl;
+            return 1;
+        }
+
+        if (by_sender.empty())
+        {
+            std::cerr << "sni_replay: trace is empty" << std::endl;
+            return 1;
+        }
+
+        // points DBUS_SESSION_BUS_ADDRESS at a throwaway dbus-daemon, so the
+        // item's g_bus_get_sync lands on it
+        GTestDBus *test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(test_bus);
+        const gchar *address = g_test_dbus_get_bus_address(test_bus);
+
+        int status = 0;
+        {
+            auto item = std::make_unique<StatusNotifierItem>();
+            if (!item->initialize() || !item->set_menu(make_menu()) || !item->set_icon_pixmap(make_icon(32)))
+            {
+                std::cerr << "sni_replay: failed to set up StatusNotifierItem" << std::endl;
+                item.reset();
+                g_test_dbus_down(test_bus);
+                g_object_unref(test_bus);
+                return 1;
+            }
+
+            GObjectPtr<GDBusConnection> item_bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr));
+            std::string destination = g_dbus_connection_get_unique_name(item_bus.get());
+
+            std::map<uint8_t, GObjectPtr<GDBusConnection>> clients;
+            for (const auto &entry : by_sender)
+            {
+                GDBusConnection *client = open_client(address, error);
+                if (!client)
+                {
+                    std::cerr << "sni_replay: " << error << std::endl;
+                    status = 1;
+                    break;
+                }
+                clients[entry.first].reset(client);
+            }
+
+            GMainLoop *loop = g_main_loop_new(nullptr, FALSE);
+            std::vector<CallResult> results;
+            double ping_allocations = 0;
+            uint64_t replay_allocations = 0;
+            double elapsed_s = 0;
+
+            // the item dispatches on this thread's main loop, so the hosts run
+            // on their own threads, one per recorded sender
+            std::thread driver([&]()
+            {
+                if (status != 0)
+                {
+                    g_main_loop_quit(loop);
+                    return;
+                }
+
+                ping_allocations = calibrate_ping(clients.begin()->second.get(), destination.c_str());
+
+                std::vector<std::vector<CallResult>> per_sender(by_sender.size());
+                std::vector<std::thread> hosts;
+                const auto start = Clock::now();
+
+                allocation_count = 0;
+                counting_allocations = true;
+
+                size_t slot = 0;
+                size_t base_index = 0;
+                for (const auto &entry : by_sender)
+                {
+                    GDBusConnection *client = clients[entry.first].get();
+                    const auto *calls = &entry.second;
+                    auto *out = &per_sender[slot++];
+                    const size_t first_index = base_index;
+                    base_index += calls->size();
+
+                    hosts.emplace_back([&, client, calls, out, first_index]()
+                    {
+                        out->reserve(calls->size() * options.iterations);
+                        uint64_t trace_length_us = calls->empty() ? 0 : calls->back().timestamp_us;
+
+                        for (int iteration = 0; iteration < options.iterations; iteration++)
+                        {
+                            for (size_t i = 0; i < calls->size(); i++)
+                            {
+                                const auto &prepared = (*calls)[i];
+                                if (options.paced)
+                                {
+                                    uint64_t offset = iteration * (trace_length_us + 1) + prepared.timestamp_us;
+                                    std::this_thread::sleep_until(start + std::chrono::microseconds(offset));
+                                }
+
+                                auto before = Clock::now();
+                                bool ok = call(client, destination.c_str(), prepared);
+                                auto after = Clock::now();
+
+                                out->push_back({first_index + i,
+                                                std::chrono::duration<double, std::micro>(after - before).count(),
+                                                !ok});
+                            }
+                        }
+                    });
+                }
+
+                for (auto &host : hosts)
+                    host.join();
+
+                counting_allocations = false;
+                replay_allocations = allocation_count.load();
+                elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+                for (auto &chunk : per_sender)
+                    results.insert(results.end(), chunk.begin(), chunk.end());
+
+                g_main_loop_quit(loop);
+            });
+
+            g_main_loop_run(loop);
+            driver.join();
+            g_main_loop_unref(loop);
+
+            if (status == 0)
+            {
+                std::vector<const PreparedCall *> flat;
+                for (const auto &entry : by_sender)
+                    for (const auto &prepared : entry.second)
+                        flat.push_back(&prepared);
+
+                std::vector<double> latencies;
+                std::map<std::string, std::vector<double>> by_member;
+                size_t failures = 0;
+                for (const auto &result : results)
+                {
+                    latencies.push_back(result.latency_us);
+                    by_member[flat[result.call_index]->member].push_back(result.latency_us);
+                    failures += result.failed ? 1 : 0;
+                }
+                std::sort(latencies.begin(), latencies.end());
+
+                const double per_call = results.empty() ? 0 : static_cast<double>(replay_allocations) / results.size();
+
+                std::printf("trace        %s (%zu records, %zu senders, %d iteration%s, %s)\n",
+                            options.trace_path.c_str(), records.size(), by_sender.size(), options.iterations,
+                            options.iterations == 1 ? "" : "s", options.paced ? "paced" : "flat out");
+                std::printf("calls        %zu (%zu failed)\n", results.size(), failures);
+                std::printf("elapsed      %.3f s\n", elapsed_s);
+                std::printf("throughput   %.0f calls/s\n", elapsed_s > 0 ? results.size() / elapsed_s : 0.0);
+                std::printf("latency us   p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+                            percentile(latencies, 0.50), percentile(latencies, 0.90),
+                            percentile(latencies, 0.99), latencies.empty() ? 0.0 : latencies.back());
+                std::printf("allocations  %llu total, %.1f/call (Peer.Ping baseline %.1f/call, net %.1f/call)\n",
+                            static_cast<unsigned long long>(replay_allocations), per_call, ping_allocations,
+                            per_call - ping_allocations);
+
+                for (auto &entry : by_member)
+                {
+                    std::sort(entry.second.begin(), entry.second.end());
+                    std::printf("  %-20s %8zu calls  p50 %6.0f  p99 %6.0f us\n", entry.first.c_str(), entry.second.size(),
+                                percentile(entry.second, 0.50), percentile(entry.second, 0.99));
+                }
+
+                if (failures != 0)
+                    status = 1;
+            }
+
+            clients.clear();
+            item_bus.reset();
+            item.reset();
+        }
+
+        g_test_dbus_down(test_bus);
+        g_object_unref(test_bus);
+        return status;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_args(argc, argv, options))
+    {
+        usage();
+        return 2;
+    }
+
+    // errors the item logs while replaying are part of the result
+    set_log_stderr(true);
+
+    if (!options.synthesize_path.empty())
+    {
+        std::string error;
+        if (!synthesize_trace(options.synthesize_path, options.synthesize_count ? options.synthesize_count : 1000, error))
+        {
+            std::cerr << "sni_replay: " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    return replay(options);
+}
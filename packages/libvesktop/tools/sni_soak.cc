@@ -0,0 +1,351 @@
+// Long-running leak check for the dbusmenu side of StatusNotifierItem.
+// Hammers Event, EventGroup, GetLayout and GetGroupProperties on a private
+// bus and fails if the number of live allocations or the RSS keeps growing
+// once the warm-up is over.
+//
+//   sni_soak [--rounds N] [--warmup N] [--samples N]
+//            [--max-live-growth N] [--max-rss-growth-kb N]
+//
+// Each round makes four calls, so the default of 1M rounds is 4M calls.
+// Needs dbus-daemon in PATH, like sni_replay.
+
+#include <gio/gio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../src/glib_ptr.h"
+#include "../src/status_notifier_item.h"
+
+// Live allocations = blocks handed out minus blocks returned. GLib 2.76+
+// routes GSlice through malloc as well; on older versions slab growth only
+// shows up in the RSS check.
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+    std::atomic<int64_t> live_allocations{0};
+}
+
+extern "C"
+{
+    void *malloc(size_t size)
+    {
+        void *ptr = __libc_malloc(size);
+        if (ptr)
+            live_allocations.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        void *ptr = __libc_calloc(count, size);
+        if (ptr)
+            live_allocations.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        void *result = __libc_realloc(ptr, size);
+        if (!ptr && result)
+            live_allocations.fetch_add(1, std::memory_order_relaxed);
+        else if (ptr && size == 0)
+            live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void free(void *ptr)
+    {
+        if (ptr)
+            live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        __libc_free(ptr);
+    }
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr const char *DBUSMENU_INTERFACE = "com.canonical.dbusmenu";
+    constexpr const char *MENU_OBJECT_PATH = "/MenuBar";
+    constexpr gint CALL_TIMEOUT_MS = 5000;
+    constexpr int32_t MENU_SIZE = 10;
+
+    struct Options
+    {
+        long rounds = 1000000;
+        long warmup = 20000;
+        int samples = 20;
+        int64_t max_live_growth = 256;
+        long max_rss_growth_kb = 1024;
+    };
+
+    struct Sample
+    {
+        long round;
+        int64_t live;
+        long rss_kb;
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: sni_soak [--rounds N] [--warmup N] [--samples N]\n"
+                  << "                [--max-live-growth N] [--max-rss-growth-kb N]" << std::endl;
+    }
+
+    bool parse_args(int argc, char **argv, Options &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                return false;
+
+            if (arg == "--rounds")
+                options.rounds = std::max(1L, std::atol(argv[++i]));
+            else if (arg == "--warmup")
+                options.warmup = std::max(0L, std::atol(argv[++i]));
+            else if (arg == "--samples")
+                options.samples = std::max(2, std::atoi(argv[++i]));
+            else if (arg == "--max-live-growth")
+                options.max_live_growth = std::max(0L, std::atol(argv[++i]));
+            else if (arg == "--max-rss-growth-kb")
+                options.max_rss_growth_kb = std::max(0L, std::atol(argv[++i]));
+            else
+                return false;
+        }
+
+        return true;
+    }
+
+    long rss_kb()
+    {
+        std::ifstream statm("/proc/self/statm");
+        long pages = 0;
+        long resident = 0;
+        statm >> pages >> resident;
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    std::vector<MenuItem> make_menu()
+    {
+        std::vector<MenuItem> items;
+        for (int32_t id = 1; id <= MENU_SIZE; id++)
+            items.push_back({id, "Item " + std::to_string(id), true, true, false});
+        return items;
+    }
+
+    // the parameters are built once; only the round trips are in the loop
+    struct Calls
+    {
+        GVariantPtr event;
+        GVariantPtr event_group;
+        GVariantPtr get_layout;
+        GVariantPtr get_group_properties;
+    };
+
+    Calls make_calls()
+    {
+        Calls calls;
+        calls.event.reset(g_variant_ref_sink(
+            g_variant_new("(isvu)", 1, "clicked", g_variant_new_int32(0), 0u)));
+
+        GVariantBuilder events;
+        g_variant_builder_init(&events, G_VARIANT_TYPE("a(isvu)"));
+        for (int32_t id = 1; id <= 4; id++)
+            g_variant_builder_add(&events, "(isvu)", id, id % 2 ? "clicked" : "hovered", g_variant_new_int32(0), 0u);
+        calls.event_group.reset(g_variant_ref_sink(g_variant_new("(@a(isvu))", g_variant_builder_end(&events))));
+
+        const gchar *no_names[] = {nullptr};
+        calls.get_layout.reset(g_variant_ref_sink(g_variant_new("(ii^as)", 0, -1, no_names)));
+
+        const gint32 ids[] = {0, 1, 2, 3};
+        calls.get_group_properties.reset(g_variant_ref_sink(g_variant_new(
+            "(@ai^as)",
+            g_variant_new_fixed_array(G_VARIANT_TYPE_INT32, ids, G_N_ELEMENTS(ids), sizeof(gint32)),
+            no_names)));
+
+        return calls;
+    }
+
+    bool call(GDBusConnection *connection, const char *destination, const char *member, GVariant *parameters)
+    {
+        GError *error = nullptr;
+        GVariantPtr reply(g_dbus_connection_call_sync(
+            connection,
+            destination,
+            MENU_OBJECT_PATH,
+            DBUSMENU_INTERFACE,
+            member,
+            parameters,
+            nullptr,
+            G_DBUS_CALL_FLAGS_NONE,
+            CALL_TIMEOUT_MS,
+            nullptr,
+            &error));
+
+        GErrorPtr error_ptr(error);
+        if (!reply)
+            std::cerr << "sni_soak: " << member << " failed: " << (error_ptr ? error_ptr->message : "unknown error")
+                      << std::endl;
+        return reply != nullptr;
+    }
+
+    int soak(const Options &options)
+    {
+        GTestDBus *test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+        g_test_dbus_up(test_bus);
+        const gchar *address = g_test_dbus_get_bus_address(test_bus);
+
+        int status = 0;
+        {
+            std::atomic<uint64_t> clicks{0};
+
+            auto item = std::make_unique<StatusNotifierItem>();
+            if (!item->initialize() || !item->set_menu(make_menu()))
+            {
+                std::cerr << "sni_soak: failed to set up StatusNotifierItem" << std::endl;
+                item.reset();
+                g_test_dbus_down(test_bus);
+                g_object_unref(test_bus);
+                return 1;
+            }
+            item->set_menu_click_callback([&clicks](int32_t) { clicks.fetch_add(1, std::memory_order_relaxed); });
+
+            GObjectPtr<GDBusConnection> item_bus(g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr));
+            std::string destination = g_dbus_connection_get_unique_name(item_bus.get());
+
+            GError *error = nullptr;
+            GObjectPtr<GDBusConnection> client(g_dbus_connection_new_for_address_sync(
+                address,
+                static_cast<GDBusConnectionFlags>(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                  G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                nullptr,
+                nullptr,
+                &error));
+            if (!client)
+            {
+                GErrorPtr error_ptr(error);
+                std::cerr << "sni_soak: failed to connect to private bus: "
+                          << (error_ptr ? error_ptr->message : "unknown error") << std::endl;
+                status = 1;
+            }
+
+            Calls calls = make_calls();
+            // reserved up front so recording a sample doesn't count as growth
+            std::vector<Sample> samples;
+            samples.reserve(options.samples + 2);
+            long completed = 0;
+            double elapsed_s = 0;
+
+            GMainLoop *loop = g_main_loop_new(nullptr, FALSE);
+
+            // the item answers on this thread's main loop, so the client
+            // drives it from its own thread
+            std::thread driver([&]()
+            {
+                const long total = options.warmup + options.rounds;
+                const long sample_every = std::max(1L, options.rounds / (options.samples - 1));
+                const auto start = Clock::now();
+
+                for (long round = 0; status == 0 && round < total; round++)
+                {
+                    if (round >= options.warmup && (round - options.warmup) % sample_every == 0)
+                        samples.push_back({round - options.warmup, live_allocations.load(), rss_kb()});
+
+                    if (!call(client.get(), destination.c_str(), "Event", calls.event.get()) ||
+                        !call(client.get(), destination.c_str(), "EventGroup", calls.event_group.get()) ||
+                        !call(client.get(), destination.c_str(), "GetLayout", calls.get_layout.get()) ||
+                        !call(client.get(), destination.c_str(), "GetGroupProperties", calls.get_group_properties.get()))
+                    {
+                        status = 1;
+                        break;
+                    }
+                    completed = round + 1;
+                }
+
+                samples.push_back({completed - options.warmup, live_allocations.load(), rss_kb()});
+                elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+                g_main_loop_quit(loop);
+            });
+
+            g_main_loop_run(loop);
+            driver.join();
+            g_main_loop_unref(loop);
+
+            if (status == 0 && samples.size() >= 2)
+            {
+                const Sample &first = samples.front();
+                const Sample &last = samples.back();
+                const int64_t live_growth = last.live - first.live;
+                const long rss_growth = last.rss_kb - first.rss_kb;
+                // one click per Event plus two per EventGroup
+                const uint64_t expected_clicks = static_cast<uint64_t>(completed) * 3;
+
+                std::printf("rounds       %ld after %ld warm-up (%ld calls)\n", completed - options.warmup,
+                            options.warmup, completed * 4);
+                std::printf("elapsed      %.1f s, %.0f calls/s\n", elapsed_s,
+                            elapsed_s > 0 ? completed * 4 / elapsed_s : 0.0);
+                std::printf("clicks       %llu of %llu expected\n", static_cast<unsigned long long>(clicks.load()),
+                            static_cast<unsigned long long>(expected_clicks));
+                for (const auto &sample : samples)
+                    std::printf("  round %9ld  live %8lld  rss %7ld kB\n", sample.round,
+                                static_cast<long long>(sample.live), sample.rss_kb);
+                std::printf("growth       %+lld live allocations (limit %lld), %+ld kB rss (limit %ld)\n",
+                            static_cast<long long>(live_growth), static_cast<long long>(options.max_live_growth),
+                            rss_growth, options.max_rss_growth_kb);
+
+                if (live_growth > options.max_live_growth || rss_growth > options.max_rss_growth_kb)
+                {
+                    std::printf("FAIL: memory keeps growing\n");
+                    status = 1;
+                }
+                else if (clicks.load() != expected_clicks)
+                {
+                    std::printf("FAIL: menu clicks were lost\n");
+                    status = 1;
+                }
+                else
+                {
+                    std::printf("OK\n");
+                }
+            }
+
+            calls = {};
+            client.reset();
+            item_bus.reset();
+            item.reset();
+        }
+
+        g_test_dbus_down(test_bus);
+        g_object_unref(test_bus);
+        return status;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_args(argc, argv, options))
+    {
+        usage();
+        return 2;
+    }
+
+    return soak(options);
+}
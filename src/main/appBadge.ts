@@ -11,6 +11,7 @@ import { BADGE_DIR } from "shared/paths";
 import { updateUnityLauncherCount } from "./dbus";
 import { AppEvents } from "./events";
 import { mainWin } from "./mainWindow";
+import { setNativeTrayBadge } from "./tray";
 
 const imgCache = new Map<number, NativeImage>();
 function loadBadge(index: number) {
@@ -30,12 +31,21 @@ const voiceStateListener = (inCall: boolean) => {
     isInVoiceCall = inCall;
 };
 
+const memoryPressureListener = (level: string) => {
+    if (level !== "low") imgCache.clear();
+};
+
 if (!AppEvents.listeners("voiceCallStateChanged").includes(voiceStateListener)) {
     AppEvents.on("voiceCallStateChanged", voiceStateListener);
 }
 
+if (!AppEvents.listeners("memoryPressure").includes(memoryPressureListener)) {
+    AppEvents.on("memoryPressure", memoryPressureListener);
+}
+
 export function destroyAppBadge() {
     AppEvents.off("voiceCallStateChanged", voiceStateListener);
+    AppEvents.off("memoryPressure", memoryPressureListener);
     imgCache.clear();
 }
 
@@ -44,8 +54,13 @@ export function destroyAppBadge() {
  * 0 = clear
  */
 export function setBadgeCount(count: number) {
-    if (!isInVoiceCall) {
-        AppEvents.emit("setTrayVariant", count !== 0 ? "trayUnread" : "tray");
+    const variant = isInVoiceCall ? null : count !== 0 ? "trayUnread" : "tray";
+
+    // the native tray takes the icon and the launcher count in one update
+    if (process.platform === "linux" && setNativeTrayBadge(variant, count)) return;
+
+    if (variant) {
+        AppEvents.emit("setTrayVariant", variant);
     }
 
     switch (process.platform) {
@@ -63,6 +63,12 @@ const options = {
         type: "boolean",
         short: "r",
         description: "Re-download Equicord and restart"
+    },
+    "trace-native": {
+        type: "string",
+        hidden: process.platform !== "linux",
+        argumentName: "file",
+        description: "Record a Chromium trace with libvesktop's native spans merged in, written to file on quit"
     }
 } satisfies Record<string, Option>;
 
@@ -185,6 +191,16 @@ function checkCommandLineForToggleCommands() {
     const { "toggle-mic": toggleMic, "toggle-deafen": toggleDeafen } = CommandLine.values;
 
     if (!toggleMic && !toggleDeafen) return false;
+
+    // one D-Bus call to the running instance; only fall back to the single instance handshake if that isn't there
+    if (process.platform === "linux") {
+        const { callControlAction } = require("./dbus") as typeof import("./dbus");
+        if (callControlAction(toggleMic ? "toggle-mute" : "toggle-deafen")) {
+            app.exit(0);
+            return true;
+        }
+    }
+
     if (!app.requestSingleInstanceLock({ IS_DEV })) {
         app.exit(0);
     }
@@ -4,10 +4,12 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-import { app } from "electron";
+import { app, NativeImage } from "electron";
 import { join } from "path";
 import { STATIC_DIR } from "shared/paths";
 
+import { DATA_DIR } from "./constants";
+
 let libVesktop: typeof import("libvesktop") | null = null;
 
 function loadLibVesktop() {
@@ -22,8 +24,8 @@ function loadLibVesktop() {
     return libVesktop;
 }
 
-export function getAccentColor() {
-    return loadLibVesktop()?.getAccentColor() ?? null;
+export async function getAccentColor() {
+    return (await loadLibVesktop()?.getAccentColor()) ?? null;
 }
 
 export function updateUnityLauncherCount(count: number) {
@@ -35,6 +37,78 @@ export function updateUnityLauncherCount(count: number) {
     return libVesktop.updateUnityLauncherCount(count);
 }
 
-export function requestBackground(autoStart: boolean, commandLine: string[]) {
-    return loadLibVesktop()?.requestBackground(autoStart, commandLine) ?? false;
+export function updateLauncherEntry(state: import("libvesktop").LauncherEntryState) {
+    return loadLibVesktop()?.updateLauncherEntry?.(state) ?? false;
+}
+
+export async function requestBackground(autoStart: boolean, commandLine: string[]) {
+    return (await loadLibVesktop()?.requestBackground(autoStart, commandLine)) ?? false;
+}
+
+// PNG-encodes (and if needed downscales) thumbnails off the main thread; falls back to toDataURL without libvesktop
+export async function thumbnailDataUrls(images: NativeImage[], maxWidth: number, maxHeight: number) {
+    const libVesktop = loadLibVesktop();
+    if (libVesktop?.encodeThumbnails) {
+        try {
+            const frames = images.map(image => ({ bitmap: image.toBitmap(), ...image.getSize() }));
+            return await libVesktop.encodeThumbnails(frames, maxWidth, maxHeight);
+        } catch (e) {
+            console.error("Failed to encode thumbnails natively:", e);
+        }
+    }
+
+    return images.map(image => image.toDataURL());
+}
+
+export function startKeybindChannel(
+    options: import("libvesktop").KeybindChannelOptions,
+    callback: (event: string, receivedAtMs: number) => void
+) {
+    const libVesktop = loadLibVesktop();
+    if (!libVesktop?.startKeybindChannel) return false;
+
+    try {
+        return libVesktop.startKeybindChannel(options, callback);
+    } catch (err) {
+        console.error("Failed to start native keybind channel:", err);
+        return false;
+    }
+}
+
+export function startControlService(callback: (action: import("libvesktop").ControlAction) => void) {
+    const libVesktop = loadLibVesktop();
+    if (!libVesktop?.startControlService) return false;
+
+    try {
+        return libVesktop.startControlService({}, callback);
+    } catch (e) {
+        console.error("Failed to export the D-Bus control service:", e);
+        return false;
+    }
+}
+
+export function callControlAction(action: import("libvesktop").ControlAction) {
+    return loadLibVesktop()?.callControlAction?.(action) ?? false;
+}
+
+export function initNativeLog() {
+    // if the main process dies on a native fault, libvesktop's last log records are left next to the app data
+    return loadLibVesktop()?.setNativeLogOptions?.({ crashFile: join(DATA_DIR, "libvesktop-crash.log") }) ?? false;
+}
+
+// libvesktop trims its own caches before calling back, so the callback only has to take care of the JS ones
+export function onMemoryPressure(callback: (level: import("libvesktop").MemoryPressureLevel) => void) {
+    return loadLibVesktop()?.onMemoryPressure?.(event => callback(event.level)) ?? false;
+}
+
+export function setNativeTracing(enabled: boolean) {
+    const libVesktop = loadLibVesktop();
+    if (!libVesktop?.setNativeTracing) return false;
+
+    libVesktop.setNativeTracing(enabled);
+    return true;
+}
+
+export function exportNativeTrace() {
+    return loadLibVesktop()?.exportNativeTrace?.() ?? null;
 }
@@ -13,4 +13,5 @@ export const AppEvents = new EventEmitter<{
     userAssetChanged: [UserAssetType];
     setTrayVariant: ["tray" | "trayUnread" | "traySpeaking" | "trayIdle" | "trayMuted" | "trayDeafened"];
     voiceCallStateChanged: [boolean];
+    memoryPressure: [import("libvesktop").MemoryPressureLevel];
 }>();
@@ -11,6 +11,7 @@ import { join } from "node:path";
 import { Socket } from "net";
 import { IpcEvents } from "shared/IpcEvents";
 
+import { startControlService, startKeybindChannel } from "./dbus";
 import { mainWin } from "./mainWindow";
 
 const xdgRuntimeDir = process.env.XDG_RUNTIME_DIR || process.env.TMP || "/tmp";
@@ -71,7 +72,34 @@ function cleanup() {
 
 process.on("exit", cleanup);
 
+const ControlActions = {
+    "toggle-mute": IpcEvents.TOGGLE_SELF_MUTE,
+    "toggle-deafen": IpcEvents.TOGGLE_SELF_DEAF
+} as const;
+
 export function initKeybinds() {
+    // org.equicord.Equibop.Control, so `--toggle-mic` and `gdbus call` reach us without a second Electron
+    startControlService(action => {
+        if (action === "show") {
+            if (mainWin.isMinimized()) mainWin.restore();
+            if (!mainWin.isVisible()) mainWin.show();
+            mainWin.focus();
+            return;
+        }
+
+        mainWin.webContents.send(ControlActions[action]);
+    });
+
+    // libvesktop owns the FIFO (and an abstract socket named after it) and parses commands off the main thread. Abstract
+    // names are visible to every user on the host, hence the uid.
+    const socketName = `vesktop-ipc-${process.getuid?.() ?? 0}`;
+    const native = startKeybindChannel({ fifoPath: socketFile, socketName }, action => {
+        if (Actions.has(action as IpcEvents)) {
+            mainWin.webContents.send(action);
+        }
+    });
+    if (native) return;
+
     if (createFIFO()) {
         openFIFO();
     }
@@ -0,0 +1,44 @@
+/*
+ * Vesktop, a desktop app aiming to give you a snappier Discord Experience
+ * Copyright (c) 2025 Vendicated and Vesktop contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+import { app, contentTracing } from "electron";
+import { readFile, writeFile } from "fs/promises";
+
+import { exportNativeTrace, setNativeTracing } from "./dbus";
+
+// libvesktop stamps its spans with the same clock, pid and tids as Chromium's tracing, so merging is just appending
+async function writeMergedTrace(path: string) {
+    const chromePath = await contentTracing.stopRecording();
+    setNativeTracing(false);
+
+    const chrome = JSON.parse(await readFile(chromePath, "utf8"));
+    const native = exportNativeTrace();
+    if (native) {
+        chrome.traceEvents = chrome.traceEvents.concat(JSON.parse(native.json).traceEvents);
+        if (native.dropped) console.warn(`[Trace] ${native.dropped} native spans did not fit and were dropped`);
+    }
+
+    await writeFile(path, JSON.stringify(chrome));
+    console.log("[Trace] Wrote trace to", path);
+}
+
+export async function recordTraceUntilQuit(path: string) {
+    await contentTracing.startRecording({
+        included_categories: ["toplevel", "benchmark", "blink", "cc", "gpu", "viz", "ipc", "v8", "disabled-by-default-devtools.timeline"]
+    });
+    if (!setNativeTracing(true)) console.warn("[Trace] libvesktop is unavailable, recording Chromium only");
+
+    let written = false;
+    app.on("will-quit", event => {
+        if (written) return;
+
+        event.preventDefault();
+        written = true;
+        writeMergedTrace(path)
+            .catch(e => console.error("[Trace] Failed to write trace:", e))
+            .finally(() => app.quit());
+    });
+}
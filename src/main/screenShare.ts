@@ -4,15 +4,22 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-import { desktopCapturer, session, Streams } from "electron";
+import { desktopCapturer, NativeImage, session, Streams } from "electron";
 import type { StreamPick } from "renderer/components/ScreenSharePicker";
 import { IpcCommands, IpcEvents } from "shared/IpcEvents";
 
 import { isWayland } from "./constants";
+import { thumbnailDataUrls } from "./dbus";
 import { getPlatformSpoofInfo } from "./gnuSpoofing";
 import { sendRendererCommand } from "./ipcCommands";
 import { handle } from "./utils/ipcWrappers";
 
+// toDataURL is a full zlib PNG encode on the main thread per source; on Linux libvesktop does it on worker threads
+async function toDataUrls(images: NativeImage[], width: number, height: number) {
+    if (process.platform === "linux") return thumbnailDataUrls(images, width, height);
+    return images.map(image => image.toDataURL());
+}
+
 export function registerScreenShareHandler() {
     handle(IpcEvents.CAPTURER_GET_LARGE_THUMBNAIL, async (_, id: string) => {
         const sources = await desktopCapturer.getSources({
@@ -22,28 +29,31 @@ export function registerScreenShareHandler() {
                 height: 1080
             }
         });
-        return sources.find(s => s.id === id)?.thumbnail.toDataURL();
+        const thumbnail = sources.find(s => s.id === id)?.thumbnail;
+        if (!thumbnail) return undefined;
+
+        const [url] = await toDataUrls([thumbnail], 1920, 1080);
+        return url;
     });
 
     session.defaultSession.setDisplayMediaRequestHandler(async (request, callback) => {
         // request full resolution on wayland right away because we always only end up with one result anyway
         const width = isWayland ? 1920 : 176;
+        const height = width * (9 / 16);
         const sources = await desktopCapturer
             .getSources({
                 types: ["window", "screen"],
-                thumbnailSize: {
-                    width,
-                    height: width * (9 / 16)
-                }
+                thumbnailSize: { width, height }
             })
             .catch(err => console.error("Error during screenshare picker", err));
 
         if (!sources) return callback({});
 
-        const data = sources.map(({ id, name, thumbnail }) => ({
+        const urls = await toDataUrls(sources.map(s => s.thumbnail), width, height);
+        const data = sources.map(({ id, name }, i) => ({
             id,
             name,
-            url: thumbnail.toDataURL()
+            url: urls[i]
         }));
 
         if (isWayland) {
@@ -11,10 +11,14 @@ import "./vesktopProtocol";
 
 import { app, BrowserWindow, nativeTheme } from "electron";
 
+import { CommandLine } from "./cli";
 import { DATA_DIR } from "./constants";
+import { initNativeLog, onMemoryPressure } from "./dbus";
+import { AppEvents } from "./events";
 import { createFirstLaunchTour } from "./firstLaunch";
 import { createWindows } from "./mainWindow";
 import { registerMediaPermissionsHandler } from "./mediaPermissions";
+import { recordTraceUntilQuit } from "./nativeTrace";
 import { registerScreenShareHandler } from "./screenShare";
 import { Settings, State } from "./settings";
 import { setAsDefaultProtocolClient } from "./utils/setAsDefaultProtocolClient";
@@ -113,6 +117,15 @@ function init() {
 
     app.whenReady().then(async () => {
         if (process.platform === "win32") app.setAppUserModelId("org.equicord.equibop");
+        if (isLinux) {
+            initNativeLog();
+            onMemoryPressure(level => AppEvents.emit("memoryPressure", level));
+        }
+
+        const tracePath = CommandLine.values["trace-native"];
+        if (typeof tracePath === "string") {
+            await recordTraceUntilQuit(tracePath).catch(e => console.error("[Trace] Failed to start tracing:", e));
+        }
 
         registerScreenShareHandler();
         registerMediaPermissionsHandler();
@@ -4,13 +4,15 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-import { app, BrowserWindow, Menu, NativeImage, nativeImage, Tray } from "electron";
+import { app, BrowserWindow, Menu, NativeImage, nativeImage, nativeTheme, Tray } from "electron";
 import { join } from "path";
+import { IpcEvents } from "shared/IpcEvents";
 import { STATIC_DIR } from "shared/paths";
 
 import { createAboutWindow } from "./about";
 import { createArgumentsWindow } from "./arguments";
 import { restartArRPC } from "./arrpc";
+import { getAccentColor, updateUnityLauncherCount } from "./dbus";
 import { AppEvents } from "./events";
 import { Settings } from "./settings";
 import { resolveAssetPath, UserAssetType } from "./userAssets";
@@ -19,9 +21,32 @@ import { downloadVencordAsar } from "./utils/vencordLoader";
 
 type TrayVariant = "tray" | "trayUnread" | "traySpeaking" | "trayIdle" | "trayMuted" | "trayDeafened";
 
+const TRAY_VARIANTS: TrayVariant[] = ["tray", "trayUnread", "traySpeaking", "trayIdle", "trayMuted", "trayDeafened"];
+
 const isLinux = process.platform === "linux";
 
+type NativeTrayItem = Pick<
+    import("libvesktop").StatusNotifierItem,
+    "setIcon" | "setMenu" | "updateMenuItem" | "onMenuClick" | "onActivate" | "destroy"
+> &
+    Partial<import("libvesktop").StatusNotifierItem>;
+
+// The prebuilt binaries predate the StatusNotifierItem class and only have one global item behind these functions.
+// Packaged builds use the prebuilds until they are rebuilt, so the tray keeps working on them, just without what
+// only the class has (scroll, middle-click, registration state, desktop state).
+interface LegacyStatusNotifierExports {
+    initStatusNotifierItem(): boolean;
+    setStatusNotifierIcon(pixmapData: Buffer): boolean;
+    setStatusNotifierTitle(title: string): boolean;
+    setStatusNotifierMenu(items: import("libvesktop").MenuItem[]): boolean;
+    updateStatusNotifierMenuItem(id: number, label: string): boolean;
+    setStatusNotifierMenuClickCallback(callback: (id: number) => void): boolean;
+    setStatusNotifierActivateCallback(callback: () => void): boolean;
+    destroyStatusNotifierItem(): void;
+}
+
 let nativeSNI: typeof import("libvesktop") | null = null;
+let nativeTrayItem: NativeTrayItem | null = null;
 if (isLinux) {
     try {
         nativeSNI = require(join(STATIC_DIR, `dist/libvesktop-${process.arch}.node`));
@@ -30,6 +55,24 @@ if (isLinux) {
     }
 }
 
+function createNativeTrayItem(sni: typeof import("libvesktop"), title: string): NativeTrayItem {
+    if (typeof sni.StatusNotifierItem === "function") return new sni.StatusNotifierItem({ title });
+
+    const legacy = sni as unknown as LegacyStatusNotifierExports;
+    if (typeof legacy.initStatusNotifierItem !== "function") throw new Error("libvesktop has no StatusNotifierItem");
+    if (!legacy.initStatusNotifierItem()) throw new Error("Failed to export the StatusNotifierItem");
+
+    legacy.setStatusNotifierTitle(title);
+    return {
+        setIcon: pixmapData => legacy.setStatusNotifierIcon(pixmapData),
+        setMenu: items => legacy.setStatusNotifierMenu(items),
+        updateMenuItem: (id, label) => legacy.updateStatusNotifierMenuItem(id, label),
+        onMenuClick: callback => void legacy.setStatusNotifierMenuClickCallback(callback),
+        onActivate: callback => void legacy.setStatusNotifierActivateCallback(callback),
+        destroy: () => legacy.destroyStatusNotifierItem()
+    };
+}
+
 let tray: Tray | null = null;
 let trayVariant: TrayVariant = "tray";
 let onTrayClick: (() => void) | null = null;
@@ -39,10 +82,25 @@ let nativeTrayWindow: BrowserWindow | null = null;
 let nativeTrayUpdateCallback: (() => void) | null = null;
 
 const trayImageCache = new Map<string, NativeImage>();
+const trayPixmapCache = new Map<string, Buffer>();
+
+let trayTints: import("libvesktop").TrayIconTints | null = null;
+let trayTint: { accent: number; scheme: "dark" | "light" } | null = null;
+let trayTintsTrimmed = false;
 
 let useNativeTray = false;
 let nativeTrayInitialized = false;
 
+// the variants that say whether we are deafened, i.e. the ones shown while in a call
+const VOICE_TRAY_VARIANTS: TrayVariant[] = ["traySpeaking", "trayIdle", "trayMuted", "trayDeafened"];
+
+// Scrolling over the tray deafens (down) or undeafens (up) and never toggles blindly, so a stray wheel tick can at
+// most repeat what the user already has. The requested state counts as current until the renderer reports it back,
+// so the rest of a gesture doesn't send a second toggle; libvesktop already folds a gesture into one event per frame.
+// It is dropped once the call ends or after a second, in case the renderer ignored the toggle.
+const TRAY_SCROLL_TARGET_TIMEOUT_MS = 1000;
+let trayScrollDeafTarget: { deafen: boolean; requestedAt: number } | null = null;
+
 async function getCachedTrayImage(variant: TrayVariant): Promise<NativeImage> {
     const path = await resolveAssetPath(variant as UserAssetType);
 
@@ -93,15 +151,86 @@ function nativeImageToPixmap(image: NativeImage): Promise<Buffer> {
     });
 }
 
+async function decodeTrayPixmap(path: string): Promise<Buffer> {
+    try {
+        if (nativeSNI?.decodeStatusNotifierIcon) return await nativeSNI.decodeStatusNotifierIcon(path, 32);
+    } catch {
+        // libvesktop only decodes png and ico, anything else goes through nativeImage
+    }
+    return nativeImageToPixmap(nativeImage.createFromPath(path));
+}
+
+async function getCachedTrayPixmap(variant: TrayVariant): Promise<Buffer> {
+    const path = await resolveAssetPath(variant as UserAssetType);
+
+    const cached = trayPixmapCache.get(path);
+    if (cached) return cached;
+
+    const pixmap = await decodeTrayPixmap(path);
+    trayPixmapCache.set(path, pixmap);
+
+    return pixmap;
+}
+
+async function getTrayIconPixmap(variant: TrayVariant): Promise<Buffer> {
+    if (trayTints && trayTint) {
+        const tinted = trayTints.get(variant, trayTint.accent, trayTint.scheme);
+        if (tinted) return tinted;
+
+        // a critical warning dropped the tints; tint again now that an icon is wanted, showing the plain one meanwhile
+        if (trayTintsTrimmed) {
+            trayTintsTrimmed = false;
+            trayTintListener();
+        }
+    }
+
+    return getCachedTrayPixmap(variant);
+}
+
+// nativeTheme sends "updated" in bursts, so runs are queued to never overlap and one that was superseded while it
+// waited is skipped
+let trayTintQueue: Promise<void> = Promise.resolve();
+let trayTintGeneration = 0;
+
+function refreshTrayTint(): Promise<void> {
+    const generation = ++trayTintGeneration;
+    const run = trayTintQueue.then(() => (generation === trayTintGeneration ? applyTrayTint() : undefined));
+    trayTintQueue = run.catch(() => {});
+    return run;
+}
+
+// Every variant is tinted once per theme change on a libvesktop worker, after which switching variants is a lookup
+async function applyTrayTint() {
+    if (!useNativeTray || !nativeTrayItem || !nativeSNI?.TrayIconTints) return;
+
+    const accent = Settings.store.trayAccentTint ? await getAccentColor() : null;
+    if (accent == null) {
+        trayTint = null;
+    } else {
+        trayTints ??= new nativeSNI.TrayIconTints();
+
+        const pixmaps = await Promise.all(TRAY_VARIANTS.map(getCachedTrayPixmap));
+        TRAY_VARIANTS.forEach((variant, i) => trayTints!.setSource(variant, pixmaps[i]));
+
+        const tint = { accent, scheme: nativeTheme.shouldUseDarkColors ? "dark" : "light" } as const;
+        await trayTints.retint(tint.accent, tint.scheme);
+        trayTint = tint;
+    }
+
+    applyNativeTrayState({ icon: await getTrayIconPixmap(trayVariant) });
+}
+
+const trayTintListener = () =>
+    refreshTrayTint().catch(e => console.error("[Tray] Failed to tint tray icons:", e));
+
 const userAssetChangedListener = async (asset: string) => {
     if (!asset.startsWith("tray")) return;
 
     try {
-        if (useNativeTray && nativeSNI) {
-            trayImageCache.clear();
-            const image = await getCachedTrayImage(trayVariant);
-            const pixmap = await nativeImageToPixmap(image);
-            nativeSNI.setStatusNotifierIcon(pixmap);
+        if (useNativeTray && nativeTrayItem) {
+            trayPixmapCache.clear();
+            if (trayTint) await refreshTrayTint();
+            else applyNativeTrayState({ icon: await getCachedTrayPixmap(trayVariant) });
         } else if (tray) {
             trayImageCache.clear();
             const image = await getCachedTrayImage(trayVariant);
@@ -112,16 +241,38 @@ const userAssetChangedListener = async (asset: string) => {
     }
 };
 
-async function updateTrayIconNative(variant: TrayVariant) {
-    if (trayVariant === variant) return;
+// Everything that changes together goes out in one applyDesktopState: one crossing into libvesktop and one batch of
+// signals. The legacy exports only have the separate setters.
+function applyNativeTrayState(state: import("libvesktop").DesktopState) {
+    if (!nativeTrayItem) return false;
+    if (nativeTrayItem.applyDesktopState) {
+        const applied = nativeTrayItem.applyDesktopState(state);
+        if (applied || !state.badge) return applied;
+
+        // a badge without a launcher entry fails the whole state, so the tray half still has to go out
+        nativeTrayItem.applyDesktopState({ ...state, badge: undefined });
+        return false;
+    }
+
+    let ok = true;
+    if (state.icon) ok = nativeTrayItem.setIcon(state.icon) && ok;
+    for (const patch of state.menuPatch ?? []) {
+        if (patch.label !== undefined) ok = nativeTrayItem.updateMenuItem(patch.id, patch.label) && ok;
+    }
+    if (state.badge?.count !== undefined) ok = updateUnityLauncherCount(state.badge.count) && ok;
+    return ok;
+}
+
+async function updateTrayIconNative(variant: TrayVariant, badge?: import("libvesktop").LauncherEntryState) {
+    const iconChanged = trayVariant !== variant;
+    if (!iconChanged && !badge) return;
 
     trayVariant = variant;
 
     try {
-        if (useNativeTray && nativeSNI) {
-            const image = await getCachedTrayImage(variant);
-            const pixmap = await nativeImageToPixmap(image);
-            nativeSNI.setStatusNotifierIcon(pixmap);
+        if (useNativeTray && nativeTrayItem) {
+            const icon = iconChanged ? await getTrayIconPixmap(variant) : undefined;
+            applyNativeTrayState({ icon, badge });
         }
     } catch (e) {
         console.error("[Tray] Failed to update native tray icon:", e);
@@ -140,7 +291,31 @@ async function updateTrayIconElectron(variant: TrayVariant) {
     }
 }
 
+function settleTrayScrollDeafTarget(variant: TrayVariant) {
+    if (
+        trayScrollDeafTarget &&
+        (!VOICE_TRAY_VARIANTS.includes(variant) || (variant === "trayDeafened") === trayScrollDeafTarget.deafen)
+    ) {
+        trayScrollDeafTarget = null;
+    }
+}
+
+/**
+ * The unread badge usually changes together with the tray icon, so on the native tray both go out as one desktop
+ * state. variant is null when a call owns the icon. Returns false if there is no native tray and the caller has to
+ * update both itself.
+ */
+export function setNativeTrayBadge(variant: "tray" | "trayUnread" | null, count: number) {
+    if (!useNativeTray || !nativeTrayItem) return false;
+
+    if (variant) settleTrayScrollDeafTarget(variant);
+    updateTrayIconNative(variant ?? trayVariant, { count });
+    return true;
+}
+
 const setTrayVariantListener = (variant: TrayVariant) => {
+    settleTrayScrollDeafTarget(variant);
+
     if (useNativeTray) {
         updateTrayIconNative(variant);
     } else {
@@ -169,9 +344,26 @@ if (!AppEvents.listeners("setTrayVariant").includes(setTrayVariantListener)) {
     AppEvents.on("setTrayVariant", setTrayVariantListener);
 }
 
+// the icon on screen keeps its own copy, the others are reloaded when next shown
+const memoryPressureListener = (level: string) => {
+    if (level === "low") return;
+
+    trayImageCache.clear();
+    trayPixmapCache.clear();
+    // libvesktop drops the tinted copies too, only at critical
+    if (level === "critical" && trayTint) trayTintsTrimmed = true;
+};
+
+if (!AppEvents.listeners("memoryPressure").includes(memoryPressureListener)) {
+    AppEvents.on("memoryPressure", memoryPressureListener);
+}
+
 export function destroyTray() {
     AppEvents.off("userAssetChanged", userAssetChangedListener);
     AppEvents.off("setTrayVariant", setTrayVariantListener);
+    AppEvents.off("memoryPressure", memoryPressureListener);
+    nativeTheme.off("updated", trayTintListener);
+    Settings.removeChangeListener("trayAccentTint", trayTintListener);
 
     if (trayUpdateTimeout) {
         clearTimeout(trayUpdateTimeout);
@@ -179,7 +371,7 @@ export function destroyTray() {
     }
     pendingTrayVariant = null;
 
-    if (useNativeTray && nativeSNI) {
+    if (useNativeTray && nativeTrayItem) {
         try {
             if (nativeTrayWindow && nativeTrayUpdateCallback) {
                 nativeTrayWindow.off("show", nativeTrayUpdateCallback);
@@ -187,7 +379,8 @@ export function destroyTray() {
                 nativeTrayWindow = null;
                 nativeTrayUpdateCallback = null;
             }
-            nativeSNI.destroyStatusNotifierItem();
+            nativeTrayItem.destroy();
+            nativeTrayItem = null;
             nativeTrayInitialized = false;
         } catch (e) {
             console.error("[Tray] Failed to destroy native StatusNotifierItem:", e);
@@ -208,6 +401,11 @@ export function destroyTray() {
     }
 
     trayImageCache.clear();
+    trayPixmapCache.clear();
+    trayTints = null;
+    trayTint = null;
+    trayTintsTrimmed = false;
+    trayScrollDeafTarget = null;
     useNativeTray = false;
 }
 
@@ -222,95 +420,119 @@ export async function initTray(win: BrowserWindow, setIsQuitting: (val: boolean)
 
     if (isLinux && nativeSNI) {
         try {
-            const success = nativeSNI.initStatusNotifierItem();
-            if (success) {
-                useNativeTray = true;
-                nativeTrayInitialized = true;
-
-                const initialImage = await getCachedTrayImage(trayVariant);
-                const pixmap = await nativeImageToPixmap(initialImage);
-                nativeSNI.setStatusNotifierIcon(pixmap);
-                nativeSNI.setStatusNotifierTitle("Equibop");
-
-                const menuItems = [
-                    { id: 1, label: win.isVisible() ? "Hide" : "Open", enabled: true, visible: true },
-                    { id: 2, label: "About", enabled: true, visible: true },
-                    { id: 3, label: "Repair Equicord", enabled: true, visible: true },
-                    { id: 4, label: "Reset Equibop", enabled: true, visible: true },
-                    { id: 5, label: "Launch Arguments", enabled: true, visible: true },
-                    {
-                        id: 6,
-                        label: "Restart arRPC",
-                        enabled: true,
-                        visible: Settings.store.arRPC === true
-                    },
-                    { id: 7, type: "separator" as const, enabled: true, visible: true },
-                    { id: 8, label: "Restart", enabled: true, visible: true },
-                    { id: 9, label: "Quit", enabled: true, visible: true }
-                ];
-
-                const menuResult = nativeSNI.setStatusNotifierMenu(menuItems);
-
-                nativeTrayWindow = win;
-                nativeTrayUpdateCallback = () => {
-                    try {
-                        nativeSNI.updateStatusNotifierMenuItem(1, win.isVisible() ? "Hide" : "Open");
-                    } catch (e) {
-                        console.error("[Tray] Failed to update native menu item:", e);
-                    }
-                };
-
-                win.on("show", nativeTrayUpdateCallback);
-                win.on("hide", nativeTrayUpdateCallback);
-
-                nativeSNI.setStatusNotifierMenuClickCallback((id: number) => {
-                    switch (id) {
-                        case 1: // open/hide
-                            if (win.isVisible()) win.hide();
-                            else win.show();
-                            break;
-                        case 2: // about
-                            createAboutWindow();
-                            break;
-                        case 3: // repair equicord
-                            downloadVencordAsar().then(() => {
-                                setTimeout(() => {
-                                    destroyTray();
-                                    app.relaunch();
-                                    app.quit();
-                                }, 0);
-                            });
-                            break;
-                        case 4: // reset Equibop
-                            clearData(win);
-                            break;
-                        case 5: // launch arguments
-                            createArgumentsWindow();
-                            break;
-                        case 6: // restart arRPC-bun
-                            restartArRPC();
-                            break;
-                        case 8: // restart
+            nativeTrayItem = createNativeTrayItem(nativeSNI, "Equibop");
+            nativeTrayItem.onStateChange?.(state => {
+                if (state === "failed") console.warn("[Tray] StatusNotifierWatcher is not responding, tray icon is hidden");
+            });
+            useNativeTray = true;
+            nativeTrayInitialized = true;
+
+            const pixmap = await getCachedTrayPixmap(trayVariant);
+            nativeTrayItem.setIcon(pixmap);
+
+            nativeTheme.on("updated", trayTintListener);
+            Settings.addChangeListener("trayAccentTint", trayTintListener);
+            if (Settings.store.trayAccentTint) trayTintListener();
+
+            const menuItems = [
+                { id: 1, label: win.isVisible() ? "Hide" : "Open", enabled: true, visible: true },
+                { id: 2, label: "About", enabled: true, visible: true },
+                { id: 3, label: "Repair Equicord", enabled: true, visible: true },
+                { id: 4, label: "Reset Equibop", enabled: true, visible: true },
+                { id: 5, label: "Launch Arguments", enabled: true, visible: true },
+                {
+                    id: 6,
+                    label: "Restart arRPC",
+                    enabled: true,
+                    visible: Settings.store.arRPC === true
+                },
+                { id: 7, type: "separator" as const, enabled: true, visible: true },
+                { id: 8, label: "Restart", enabled: true, visible: true },
+                { id: 9, label: "Quit", enabled: true, visible: true }
+            ];
+
+            nativeTrayItem.setMenu(menuItems);
+
+            nativeTrayWindow = win;
+            nativeTrayUpdateCallback = () => {
+                try {
+                    applyNativeTrayState({ menuPatch: [{ id: 1, label: win.isVisible() ? "Hide" : "Open" }] });
+                } catch (e) {
+                    console.error("[Tray] Failed to update native menu item:", e);
+                }
+            };
+
+            win.on("show", nativeTrayUpdateCallback);
+            win.on("hide", nativeTrayUpdateCallback);
+
+            nativeTrayItem.onMenuClick((id: number) => {
+                switch (id) {
+                    case 1: // open/hide
+                        if (win.isVisible()) win.hide();
+                        else win.show();
+                        break;
+                    case 2: // about
+                        createAboutWindow();
+                        break;
+                    case 3: // repair equicord
+                        downloadVencordAsar().then(() => {
                             setTimeout(() => {
                                 destroyTray();
                                 app.relaunch();
                                 app.quit();
                             }, 0);
-                            break;
-                        case 9: // quit
-                            setIsQuitting(true);
+                        });
+                        break;
+                    case 4: // reset Equibop
+                        clearData(win);
+                        break;
+                    case 5: // launch arguments
+                        createArgumentsWindow();
+                        break;
+                    case 6: // restart arRPC-bun
+                        restartArRPC();
+                        break;
+                    case 8: // restart
+                        setTimeout(() => {
+                            destroyTray();
+                            app.relaunch();
                             app.quit();
-                            break;
-                    }
-                });
+                        }, 0);
+                        break;
+                    case 9: // quit
+                        setIsQuitting(true);
+                        app.quit();
+                        break;
+                }
+            });
 
-                nativeSNI.setStatusNotifierActivateCallback(() => {
-                    if (Settings.store.clickTrayToShowHide && win.isVisible()) win.hide();
-                    else win.show();
-                });
+            nativeTrayItem.onActivate(() => {
+                if (Settings.store.clickTrayToShowHide && win.isVisible()) win.hide();
+                else win.show();
+            });
 
-                return;
-            }
+            nativeTrayItem.onSecondaryActivate?.(() => win.webContents.send(IpcEvents.TOGGLE_SELF_MUTE));
+
+            nativeTrayItem.onScroll?.((delta, orientation) => {
+                if (orientation !== "vertical" || delta === 0) return;
+
+                if (!VOICE_TRAY_VARIANTS.includes(trayVariant)) return;
+
+                const now = Date.now();
+                if (trayScrollDeafTarget && now - trayScrollDeafTarget.requestedAt > TRAY_SCROLL_TARGET_TIMEOUT_MS) {
+                    trayScrollDeafTarget = null;
+                }
+
+                // hosts send a positive delta for scrolling up
+                const deafen = delta < 0;
+                const deafened = trayScrollDeafTarget?.deafen ?? trayVariant === "trayDeafened";
+                if (deafen === deafened) return;
+
+                trayScrollDeafTarget = { deafen, requestedAt: now };
+                win.webContents.send(IpcEvents.TOGGLE_SELF_DEAF);
+            });
+
+            return;
         } catch (e) {
             console.warn("[Tray] Failed to initialize native StatusNotifierItem, falling back to Electron Tray:", e);
         }
@@ -11,6 +11,7 @@ import { IpcEvents, UpdaterIpcEvents } from "shared/IpcEvents";
 import { STATIC_DIR } from "shared/paths";
 import { Millis } from "shared/utils/millis";
 
+import { updateLauncherEntry } from "./dbus";
 import { State } from "./settings";
 import { handle } from "./utils/ipcWrappers";
 import { makeLinksOpenExternally } from "./utils/makeLinksOpenExternally";
@@ -25,11 +26,18 @@ autoUpdater.on("update-available", update => {
     openUpdater(update);
 });
 
-autoUpdater.on("update-downloaded", () => setTimeout(() => autoUpdater.quitAndInstall(), 100));
-autoUpdater.on("download-progress", p =>
-    updaterWindow?.webContents.send(UpdaterIpcEvents.DOWNLOAD_PROGRESS, p.percent)
-);
-autoUpdater.on("error", err => updaterWindow?.webContents.send(UpdaterIpcEvents.ERROR, err.message));
+autoUpdater.on("update-downloaded", () => {
+    if (process.platform === "linux") updateLauncherEntry({ progress: null });
+    setTimeout(() => autoUpdater.quitAndInstall(), 100);
+});
+autoUpdater.on("download-progress", p => {
+    updaterWindow?.webContents.send(UpdaterIpcEvents.DOWNLOAD_PROGRESS, p.percent);
+    if (process.platform === "linux") updateLauncherEntry({ progress: p.percent / 100 });
+});
+autoUpdater.on("error", err => {
+    updaterWindow?.webContents.send(UpdaterIpcEvents.ERROR, err.message);
+    if (process.platform === "linux") updateLauncherEntry({ progress: null });
+});
 
 autoUpdater.autoDownload = false;
 autoUpdater.autoInstallOnAppQuit = false;
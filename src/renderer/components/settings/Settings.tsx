@@ -10,7 +10,7 @@ import { classNameFactory } from "@equicord/types/api/Styles";
 import { BaseText, Divider, ErrorBoundary } from "@equicord/types/components";
 import { ComponentType } from "react";
 import { Settings, useSettings } from "renderer/settings";
-import { isMac, isWindows } from "renderer/utils";
+import { isLinux, isMac, isWindows } from "renderer/utils";
 
 import { ArRPCSettingsButton } from "./ArRPCSettings";
 import { AutoStartToggle } from "./AutoStartToggle";
@@ -119,6 +119,14 @@ const SettingsOptions: Record<string, Array<BooleanSetting | SettingsComponent>>
             description: "Left clicking tray icon will toggle the Equibop window visibility.",
             defaultValue: false
         },
+        {
+            key: "trayAccentTint",
+            title: "Tint tray icon with accent color",
+            description: "Recolors the tray icon to follow your desktop accent color and light/dark style.",
+            defaultValue: false,
+            invisible: () => !isLinux,
+            disabled: () => Settings.store.tray === false
+        },
         {
             key: "disableMinSize",
             title: "Disable minimum window size",
@@ -36,6 +36,7 @@ export interface Settings {
     enableTaskbarFlashing?: boolean;
     disableMinSize?: boolean;
     clickTrayToShowHide?: boolean;
+    trayAccentTint?: boolean;
     customTitleBar?: boolean;
 
     enableSplashScreen?: boolean;